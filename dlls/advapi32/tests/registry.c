@@ -2332,6 +2332,149 @@ static void test_rw_order(void)
     ok(!RegDeleteKeyA(HKEY_CURRENT_USER, keyname), "Failed to delete key\n");
 }
 
+static void test_subkey_order(void)
+{
+    HKEY hkey, subkey;
+    char name[16], prev[16];
+    DWORD i, count, len;
+    LONG ret;
+
+    ret = RegCreateKeyA(hkey_main, "wide", &hkey);
+    ok(!ret, "RegCreateKeyA failed: %ld\n", ret);
+
+    /* enough subkeys to use a hash table, created in scrambled order */
+    for (i = 0; i < 500; i++)
+    {
+        sprintf(name, "key%03lu", (i * 7) % 500);
+        ret = RegCreateKeyA(hkey, name, &subkey);
+        ok(!ret, "RegCreateKeyA %s failed: %ld\n", name, ret);
+        RegCloseKey(subkey);
+    }
+    for (i = 0; i < 500; i += 2)
+    {
+        sprintf(name, "KEY%03lu", i);
+        ret = RegDeleteKeyA(hkey, name);
+        ok(!ret, "RegDeleteKeyA %s failed: %ld\n", name, ret);
+    }
+    ret = RegCreateKeyA(hkey, "key000", &subkey);
+    ok(!ret, "RegCreateKeyA failed: %ld\n", ret);
+    RegCloseKey(subkey);
+
+    ret = RegOpenKeyA(hkey, "KEY499", &subkey);
+    ok(!ret, "RegOpenKeyA failed: %ld\n", ret);
+    RegCloseKey(subkey);
+    ret = RegOpenKeyA(hkey, "key498", &subkey);
+    ok(ret == ERROR_FILE_NOT_FOUND, "RegOpenKeyA returned %ld\n", ret);
+
+    ret = RegQueryInfoKeyA(hkey, NULL, NULL, NULL, &count, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+    ok(!ret, "RegQueryInfoKeyA failed: %ld\n", ret);
+    ok(count == 251, "got %lu subkeys\n", count);
+
+    /* subkeys are enumerated in sorted order */
+    prev[0] = 0;
+    for (i = 0; ; i++)
+    {
+        len = sizeof(name);
+        if (RegEnumKeyExA(hkey, i, name, &len, NULL, NULL, NULL, NULL)) break;
+        ok(strcmp(prev, name) < 0, "%lu: got %s after %s\n", i, name, prev);
+        strcpy(prev, name);
+    }
+    ok(i == 251, "enumerated %lu subkeys\n", i);
+
+    delete_key(hkey);
+    RegCloseKey(hkey);
+}
+
+static void test_machine_value_changes(void)
+{
+    HKEY hkey, hkey2, subkey;
+    DWORD type, size, dw;
+    HANDLE process;
+    LONG ret;
+
+    if (limited_user)
+    {
+        skip("not enough privileges to modify HKLM\n");
+        return;
+    }
+
+    ret = RegCreateKeyExA(HKEY_LOCAL_MACHINE, "Software\\Wine\\Test", 0, NULL, 0,
+                          KEY_ALL_ACCESS, NULL, &hkey, NULL);
+    ok(!ret, "RegCreateKeyExA failed: %ld\n", ret);
+    ret = RegOpenKeyExA(HKEY_LOCAL_MACHINE, "Software\\Wine\\Test", 0, KEY_ALL_ACCESS, &hkey2);
+    ok(!ret, "RegOpenKeyExA failed: %ld\n", ret);
+
+    /* values read repeatedly must reflect changes made through other handles */
+    size = sizeof(dw);
+    ret = RegQueryValueExA(hkey, "Value", NULL, &type, (BYTE *)&dw, &size);
+    ok(ret == ERROR_FILE_NOT_FOUND, "RegQueryValueExA returned %ld\n", ret);
+    dw = 1;
+    ret = RegSetValueExA(hkey2, "Value", 0, REG_DWORD, (BYTE *)&dw, sizeof(dw));
+    ok(!ret, "RegSetValueExA failed: %ld\n", ret);
+    size = sizeof(dw);
+    dw = 0;
+    ret = RegQueryValueExA(hkey, "Value", NULL, &type, (BYTE *)&dw, &size);
+    ok(!ret, "RegQueryValueExA failed: %ld\n", ret);
+    ok(type == REG_DWORD && dw == 1, "got type %lu value %lu\n", type, dw);
+    dw = 2;
+    ret = RegSetValueExA(hkey2, "Value", 0, REG_DWORD, (BYTE *)&dw, sizeof(dw));
+    ok(!ret, "RegSetValueExA failed: %ld\n", ret);
+    size = sizeof(dw);
+    dw = 0;
+    ret = RegQueryValueExA(hkey, "VALUE", NULL, &type, (BYTE *)&dw, &size);
+    ok(!ret, "RegQueryValueExA failed: %ld\n", ret);
+    ok(type == REG_DWORD && dw == 2, "got type %lu value %lu\n", type, dw);
+    ret = RegDeleteValueA(hkey2, "Value");
+    ok(!ret, "RegDeleteValueA failed: %ld\n", ret);
+    size = sizeof(dw);
+    ret = RegQueryValueExA(hkey, "Value", NULL, &type, (BYTE *)&dw, &size);
+    ok(ret == ERROR_FILE_NOT_FOUND, "RegQueryValueExA returned %ld\n", ret);
+
+    /* the handle may be reused for another key once closed */
+    ret = RegSetValueExA(hkey, "Value", 0, REG_DWORD, (BYTE *)&dw, sizeof(dw));
+    ok(!ret, "RegSetValueExA failed: %ld\n", ret);
+    ret = RegQueryValueExA(hkey, "Value", NULL, &type, (BYTE *)&dw, &size);
+    ok(!ret, "RegQueryValueExA failed: %ld\n", ret);
+    RegCloseKey(hkey);
+    ret = RegCreateKeyExA(hkey2, "Subkey", 0, NULL, 0, KEY_ALL_ACCESS, NULL, &subkey, NULL);
+    ok(!ret, "RegCreateKeyExA failed: %ld\n", ret);
+    size = sizeof(dw);
+    ret = RegQueryValueExA(subkey, "Value", NULL, &type, (BYTE *)&dw, &size);
+    ok(ret == ERROR_FILE_NOT_FOUND, "RegQueryValueExA returned %ld\n", ret);
+
+    /* deleting the key invalidates its values */
+    ret = RegDeleteKeyA(subkey, "");
+    ok(!ret, "RegDeleteKeyA failed: %ld\n", ret);
+    size = sizeof(dw);
+    ret = RegQueryValueExA(subkey, "Value", NULL, &type, (BYTE *)&dw, &size);
+    ok(ret == ERROR_KEY_DELETED, "RegQueryValueExA returned %ld\n", ret);
+    RegCloseKey(subkey);
+
+    /* the handle may also be closed through a process handle */
+    ret = RegOpenKeyExA(hkey2, NULL, 0, KEY_ALL_ACCESS, &hkey);
+    ok(!ret, "RegOpenKeyExA failed: %ld\n", ret);
+    ret = RegSetValueExA(hkey, "Value", 0, REG_DWORD, (BYTE *)&dw, sizeof(dw));
+    ok(!ret, "RegSetValueExA failed: %ld\n", ret);
+    size = sizeof(dw);
+    ret = RegQueryValueExA(hkey, "Value", NULL, &type, (BYTE *)&dw, &size);
+    ok(!ret, "RegQueryValueExA failed: %ld\n", ret);
+    process = OpenProcess(PROCESS_DUP_HANDLE, FALSE, GetCurrentProcessId());
+    ok(process != NULL, "OpenProcess failed: %lu\n", GetLastError());
+    ret = DuplicateHandle(process, hkey, NULL, NULL, 0, FALSE, DUPLICATE_CLOSE_SOURCE);
+    ok(ret, "DuplicateHandle failed: %lu\n", GetLastError());
+    CloseHandle(process);
+    ret = RegCreateKeyExA(hkey2, "Subkey", 0, NULL, 0, KEY_ALL_ACCESS, NULL, &subkey, NULL);
+    ok(!ret, "RegCreateKeyExA failed: %ld\n", ret);
+    size = sizeof(dw);
+    ret = RegQueryValueExA(subkey, "Value", NULL, &type, (BYTE *)&dw, &size);
+    ok(ret == ERROR_FILE_NOT_FOUND, "RegQueryValueExA returned %ld\n", ret);
+    RegDeleteKeyA(subkey, "");
+    RegCloseKey(subkey);
+
+    delete_key(hkey2);
+    RegCloseKey(hkey2);
+}
+
 static void test_symlinks(void)
 {
     static const WCHAR targetW[] = L"\\Software\\Wine\\Test\\target";
@@ -4505,6 +4648,8 @@ START_TEST(registry)
     test_reg_copy_tree();
     test_reg_delete_tree();
     test_rw_order();
+    test_subkey_order();
+    test_machine_value_changes();
     test_deleted_key();
     test_delete_value();
     test_delete_key_value();
@@ -34,6 +34,8 @@ WINE_DEFAULT_DEBUG_CHANNEL(enhmetafile);
 struct emf
 {
     ENHMETAHEADER  *emh;
+    DWORD    size;     /* allocated size of emh */
+    DWORD    written;  /* size of the records already written to file */
     DC_ATTR *dc_attr;
     UINT     handles_size, cur_handles;
     HGDIOBJ *handles;
@@ -44,8 +46,25 @@ struct emf
 };
 
 #define HANDLE_LIST_INC 20
+/* disk based metafiles write their records to the file once the buffer reaches that size */
+#define EMF_WRITE_SIZE (1024 * 1024)
 static const RECTL empty_bounds = { 0, 0, -1, -1 };
 
+/* write the buffered records of a disk based metafile, the header is written on close */
+static BOOL emfdc_write_records( struct emf *emf )
+{
+    DWORD len = emf->emh->nBytes - emf->emh->nSize - emf->written;
+    LARGE_INTEGER pos;
+
+    if (!len) return TRUE;
+    pos.QuadPart = emf->emh->nSize + emf->written;
+    if (!SetFilePointerEx( emf->file, pos, NULL, FILE_BEGIN ) ||
+        !WriteFile( emf->file, (char *)emf->emh + emf->emh->nSize, len, NULL, NULL ))
+        return FALSE;
+    emf->written += len;
+    return TRUE;
+}
+
 static BOOL emfdc_record( struct emf *emf, EMR *emr )
 {
     DWORD len, size;
@@ -55,19 +74,23 @@ static BOOL emfdc_record( struct emf *emf, EMR *emr )
 
     assert( !(emr->nSize & 3) );
 
-    emf->emh->nBytes += emr->nSize;
-    emf->emh->nRecords++;
-
-    size = HeapSize( GetProcessHeap(), 0, emf->emh );
-    len = emf->emh->nBytes;
-    if (len > size)
+    len = emf->emh->nBytes - emf->written + emr->nSize;
+    if (len > emf->size && emf->file && emf->size >= EMF_WRITE_SIZE)
+    {
+        if (!emfdc_write_records( emf )) return FALSE;
+        len = emf->emh->nBytes - emf->written + emr->nSize;
+    }
+    if (len > emf->size)
     {
-        size += (size / 2) + emr->nSize;
+        size = max( emf->size + emf->size / 2, len );
         emh = HeapReAlloc( GetProcessHeap(), 0, emf->emh, size );
         if (!emh) return FALSE;
         emf->emh = emh;
+        emf->size = size;
     }
-    memcpy( (char *)emf->emh + emf->emh->nBytes - emr->nSize, emr, emr->nSize );
+    memcpy( (char *)emf->emh + len - emr->nSize, emr, emr->nSize );
+    emf->emh->nBytes += emr->nSize;
+    emf->emh->nRecords++;
     return TRUE;
 }
 
@@ -2432,6 +2455,8 @@ HDC WINAPI CreateEnhMetaFileW( HDC hdc, const WCHAR *filename, const RECT *rect,
                               HANDLE_LIST_INC * sizeof(emf->handles[0]) );
     emf->handles_size = HANDLE_LIST_INC;
     emf->cur_handles = 1;
+    emf->size = size;
+    emf->written = 0;
     emf->file = 0;
     emf->dc_brush = 0;
     emf->dc_pen = 0;
@@ -2545,7 +2570,9 @@ HENHMETAFILE WINAPI CloseEnhMetaFile( HDC hdc )
 
     if (emf->file)  /* disk based metafile */
     {
-        if (!WriteFile( emf->file, emf->emh, emf->emh->nBytes, NULL, NULL ))
+        if (!emfdc_write_records( emf ) ||
+            SetFilePointer( emf->file, 0, NULL, FILE_BEGIN ) ||
+            !WriteFile( emf->file, emf->emh, emf->emh->nSize, NULL, NULL ))
         {
             CloseHandle( emf->file );
             return 0;
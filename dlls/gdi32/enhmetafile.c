@@ -44,6 +44,7 @@
 #include "winerror.h"
 #include "gdi_private.h"
 
+#include "wine/list.h"
 #include "wine/debug.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(enhmetafile);
@@ -62,8 +63,40 @@ typedef struct
 {
     ENHMETAHEADER        *emh;
     BOOL                  on_disk;   /* true if metafile is on disk */
+    struct emf_object_cache *objects;
 } ENHMETAFILEOBJ;
 
+/* objects created by the records of a metafile, kept across PlayEnhMetaFile calls */
+struct emf_object_cache
+{
+    struct list     entry;    /* entry in the global list, most recently played first */
+    ENHMETAFILEOBJ *owner;    /* metafile the cache is attached to, NULL once detached */
+    UINT            users;    /* number of playbacks using the cache */
+    UINT            count;
+    struct
+    {
+        DWORD   offset;   /* offset of the record that created the object */
+        HGDIOBJ handle;
+    } objects[1];
+};
+
+/* cached objects hold GDI handles, so keep their number small for the whole process */
+#define EMF_MAX_CACHED_OBJECTS 128   /* per metafile */
+#define EMF_CACHE_BUDGET       512   /* for all the metafiles of the process */
+
+static struct list object_caches = LIST_INIT( object_caches );
+static UINT cached_objects_count;
+
+/* state of a PlayEnhMetaFile call */
+struct emf_playback
+{
+    const ENHMETAHEADER     *emh;
+    const struct emf_object_cache *cache;  /* objects cached by a previous playback */
+    struct emf_object_cache *new_cache;    /* objects to cache if there wasn't any */
+    UINT                     new_size;
+    BOOL                    *cached;       /* whether each handle table entry belongs to a cache */
+};
+
 static const struct emr_name {
     DWORD type;
     const char *name;
@@ -288,6 +321,7 @@ HENHMETAFILE EMF_Create_HENHMETAFILE(ENHMETAHEADER *emh, DWORD filesize, BOOL on
 
     metaObj->emh = emh;
     metaObj->on_disk = on_disk;
+    metaObj->objects = NULL;
 
     if ((hmf = NtGdiCreateClientObj( NTGDI_OBJ_ENHMETAFILE )))
         set_gdi_client_ptr( hmf, metaObj );
@@ -296,12 +330,70 @@ HENHMETAFILE EMF_Create_HENHMETAFILE(ENHMETAHEADER *emh, DWORD filesize, BOOL on
     return hmf;
 }
 
+/****************************************************************************
+ *          free_object_cache
+ */
+static void free_object_cache( struct emf_object_cache *cache )
+{
+    UINT i;
+
+    if (!cache) return;
+    for (i = 0; i < cache->count; i++) DeleteObject( cache->objects[i].handle );
+    HeapFree( GetProcessHeap(), 0, cache );
+}
+
+/****************************************************************************
+ *          detach_object_cache
+ *
+ * Detach a cache from its metafile. Must be called with enhmetafile_cs held.
+ * Returns TRUE if the cache isn't used anymore and can be freed.
+ */
+static BOOL detach_object_cache( struct emf_object_cache *cache )
+{
+    list_remove( &cache->entry );
+    cached_objects_count -= cache->count;
+    cache->owner->objects = NULL;
+    cache->owner = NULL;
+    return !cache->users;
+}
+
+/****************************************************************************
+ *          attach_object_cache
+ *
+ * Attach the objects created by a playback to the metafile, evicting the least
+ * recently played caches to stay within the budget. Must be called with
+ * enhmetafile_cs held. Returns FALSE if the cache can't be kept.
+ */
+static BOOL attach_object_cache( ENHMETAFILEOBJ *metafile, struct emf_object_cache *cache )
+{
+    struct emf_object_cache *cur, *next;
+
+    if (metafile->objects) return FALSE;
+
+    LIST_FOR_EACH_ENTRY_SAFE_REV( cur, next, &object_caches, struct emf_object_cache, entry )
+    {
+        if (cached_objects_count + cache->count <= EMF_CACHE_BUDGET) break;
+        if (cur->users) continue;
+        detach_object_cache( cur );
+        free_object_cache( cur );
+    }
+    if (cached_objects_count + cache->count > EMF_CACHE_BUDGET) return FALSE;
+
+    cache->owner = metafile;
+    cache->users = 0;
+    metafile->objects = cache;
+    list_add_head( &object_caches, &cache->entry );
+    cached_objects_count += cache->count;
+    return TRUE;
+}
+
 /****************************************************************************
  *          EMF_Delete_HENHMETAFILE
  */
 static BOOL EMF_Delete_HENHMETAFILE( HENHMETAFILE hmf )
 {
     ENHMETAFILEOBJ *metafile;
+    struct emf_object_cache *cache;
 
     EnterCriticalSection( &enhmetafile_cs );
     if (!(metafile = get_gdi_client_ptr( hmf, NTGDI_OBJ_ENHMETAFILE )) ||
@@ -316,6 +408,8 @@ static BOOL EMF_Delete_HENHMETAFILE( HENHMETAFILE hmf )
         UnmapViewOfFile( metafile->emh );
     else
         HeapFree( GetProcessHeap(), 0, metafile->emh );
+    if ((cache = metafile->objects) && detach_object_cache( cache ))
+        free_object_cache( cache );
     HeapFree( GetProcessHeap(), 0, metafile );
     LeaveCriticalSection( &enhmetafile_cs );
     return TRUE;
@@ -2323,46 +2417,13 @@ BOOL WINAPI PlayEnhMetaFileRecord(
 
 
 /*****************************************************************************
+ *           enum_enh_metafile
  *
- *        EnumEnhMetaFile  (GDI32.@)
- *
- *  Walk an enhanced metafile, calling a user-specified function _EnhMetaFunc_
- *  for each
- *  record. Returns when either every record has been used or
- *  when _EnhMetaFunc_ returns FALSE.
- *
- *
- * RETURNS
- *  TRUE if every record is used, FALSE if any invocation of _EnhMetaFunc_
- *  returns FALSE.
- *
- * BUGS
- *   Ignores rect.
- *
- * NOTES
- *   This function behaves differently in Win9x and WinNT.
- *
- *   In WinNT, the DC's world transform is updated as the EMF changes
- *    the Window/Viewport Extent and Origin or its world transform.
- *    The actual Window/Viewport Extent and Origin are left untouched.
- *
- *   In Win9x, the DC is left untouched, and PlayEnhMetaFileRecord
- *    updates the scaling itself but only just before a record that
- *    writes anything to the DC.
- *
- *   I'm not sure where the data (enum_emh_data) is stored in either
- *    version. For this implementation, it is stored before the handle
- *    table, but it could be stored in the DC, in the EMF handle or in
- *    TLS.
- *             MJM  5 Oct 2002
+ * Objects of the handle table that belong to the playback cache are not
+ * deleted at the end.
  */
-BOOL WINAPI EnumEnhMetaFile(
-     HDC hdc,                /* [in] device context to pass to _EnhMetaFunc_ */
-     HENHMETAFILE hmf,       /* [in] EMF to walk */
-     ENHMFENUMPROC callback, /* [in] callback function */
-     LPVOID data,            /* [in] optional data for callback function */
-     const RECT *lpRect      /* [in] bounding rectangle for rendered metafile */
-    )
+static BOOL enum_enh_metafile( HDC hdc, HENHMETAFILE hmf, ENHMFENUMPROC callback, void *data,
+                               const RECT *lpRect, const struct emf_playback *play )
 {
     BOOL ret;
     ENHMETAHEADER *emh;
@@ -2558,7 +2619,7 @@ BOOL WINAPI EnumEnhMetaFile(
     }
 
     for(i = 1; i < emh->nHandles; i++) /* Don't delete element 0 (hmf) */
-        if( (ht->objectHandle)[i] )
+        if( (ht->objectHandle)[i] && !(play && play->cached[i]) )
 	    DeleteObject( (ht->objectHandle)[i] );
 
     while (info->saved_state)
@@ -2571,11 +2632,159 @@ BOOL WINAPI EnumEnhMetaFile(
     return ret;
 }
 
+/*****************************************************************************
+ *
+ *        EnumEnhMetaFile  (GDI32.@)
+ *
+ *  Walk an enhanced metafile, calling a user-specified function _EnhMetaFunc_
+ *  for each
+ *  record. Returns when either every record has been used or
+ *  when _EnhMetaFunc_ returns FALSE.
+ *
+ *
+ * RETURNS
+ *  TRUE if every record is used, FALSE if any invocation of _EnhMetaFunc_
+ *  returns FALSE.
+ *
+ * BUGS
+ *   Ignores rect.
+ *
+ * NOTES
+ *   This function behaves differently in Win9x and WinNT.
+ *
+ *   In WinNT, the DC's world transform is updated as the EMF changes
+ *    the Window/Viewport Extent and Origin or its world transform.
+ *    The actual Window/Viewport Extent and Origin are left untouched.
+ *
+ *   In Win9x, the DC is left untouched, and PlayEnhMetaFileRecord
+ *    updates the scaling itself but only just before a record that
+ *    writes anything to the DC.
+ *
+ *   I'm not sure where the data (enum_emh_data) is stored in either
+ *    version. For this implementation, it is stored before the handle
+ *    table, but it could be stored in the DC, in the EMF handle or in
+ *    TLS.
+ *             MJM  5 Oct 2002
+ */
+BOOL WINAPI EnumEnhMetaFile(
+     HDC hdc,                /* [in] device context to pass to _EnhMetaFunc_ */
+     HENHMETAFILE hmf,       /* [in] EMF to walk */
+     ENHMFENUMPROC callback, /* [in] callback function */
+     LPVOID data,            /* [in] optional data for callback function */
+     const RECT *lpRect      /* [in] bounding rectangle for rendered metafile */
+    )
+{
+    return enum_enh_metafile( hdc, hmf, callback, data, lpRect, NULL );
+}
+
+/* return the handle table index of the object created by a record that can be cached */
+static DWORD get_cacheable_object_index( const ENHMETARECORD *emr )
+{
+    switch (emr->iType)
+    {
+    case EMR_CREATEPEN:
+        return ((const EMRCREATEPEN *)emr)->ihPen;
+    case EMR_EXTCREATEPEN:
+        return ((const EMREXTCREATEPEN *)emr)->ihPen;
+    case EMR_CREATEBRUSHINDIRECT:
+        return ((const EMRCREATEBRUSHINDIRECT *)emr)->ihBrush;
+    case EMR_EXTCREATEFONTINDIRECTW:
+        return ((const EMREXTCREATEFONTINDIRECTW *)emr)->ihFont;
+    case EMR_CREATEDIBPATTERNBRUSHPT:
+        return ((const EMRCREATEDIBPATTERNBRUSHPT *)emr)->ihBrush;
+    default:  /* other objects depend on the DC or can be modified by later records */
+        return 0;
+    }
+}
+
+static HGDIOBJ find_cached_object( const struct emf_object_cache *cache, DWORD offset )
+{
+    int pos, min = 0, max = cache->count - 1;
+
+    while (min <= max)
+    {
+        pos = (min + max) / 2;
+        if (cache->objects[pos].offset == offset) return cache->objects[pos].handle;
+        if (cache->objects[pos].offset < offset) min = pos + 1;
+        else max = pos - 1;
+    }
+    return 0;
+}
+
+static BOOL add_cached_object( struct emf_playback *play, DWORD offset, HGDIOBJ handle )
+{
+    struct emf_object_cache *cache = play->new_cache;
+    UINT size;
+
+    if (cache && cache->count == play->new_size)
+    {
+        if (play->new_size == EMF_MAX_CACHED_OBJECTS) return FALSE;
+        size = min( play->new_size * 2, EMF_MAX_CACHED_OBJECTS );
+        if (!(cache = HeapReAlloc( GetProcessHeap(), 0, cache,
+                                   offsetof( struct emf_object_cache, objects[size] ))))
+            return FALSE;
+        play->new_cache = cache;
+        play->new_size = size;
+    }
+    else if (!cache)
+    {
+        size = 16;
+        if (!(cache = HeapAlloc( GetProcessHeap(), 0, offsetof( struct emf_object_cache, objects[size] ))))
+            return FALSE;
+        cache->count = 0;
+        play->new_cache = cache;
+        play->new_size = size;
+    }
+    cache->objects[cache->count].offset = offset;
+    cache->objects[cache->count].handle = handle;
+    cache->count++;
+    return TRUE;
+}
+
+/*****************************************************************************
+ *           EMF_PlayEnhMetaFileCallback
+ *
+ * Objects that only depend on their record are kept in a cache attached to
+ * the metafile, so that playing it again doesn't need to create them again.
+ */
 static INT CALLBACK EMF_PlayEnhMetaFileCallback(HDC hdc, HANDLETABLE *ht,
 						const ENHMETARECORD *emr,
 						INT handles, LPARAM data)
 {
-    return PlayEnhMetaFileRecord(hdc, ht, emr, handles);
+    struct emf_playback *play = (struct emf_playback *)data;
+    DWORD offset = (const BYTE *)emr - (const BYTE *)play->emh;
+    DWORD index;
+    HGDIOBJ obj;
+    INT ret;
+
+    if (!play) return PlayEnhMetaFileRecord( hdc, ht, emr, handles );
+
+    if (emr->iType == EMR_DELETEOBJECT)
+    {
+        index = ((const EMRDELETEOBJECT *)emr)->ihObject;
+        if (index < handles && play->cached[index])
+        {
+            ht->objectHandle[index] = 0;
+            play->cached[index] = FALSE;
+            return TRUE;
+        }
+    }
+    else if ((index = get_cacheable_object_index( emr )) && index < handles)
+    {
+        if (play->cache && (obj = find_cached_object( play->cache, offset )))
+        {
+            ht->objectHandle[index] = obj;
+            play->cached[index] = TRUE;
+            return TRUE;
+        }
+        play->cached[index] = FALSE;
+        ret = PlayEnhMetaFileRecord( hdc, ht, emr, handles );
+        if (!play->cache && ht->objectHandle[index] &&
+            add_cached_object( play, offset, ht->objectHandle[index] ))
+            play->cached[index] = TRUE;
+        return ret;
+    }
+    return PlayEnhMetaFileRecord( hdc, ht, emr, handles );
 }
 
 /**************************************************************************
@@ -2594,8 +2803,45 @@ BOOL WINAPI PlayEnhMetaFile(
        const RECT *lpRect /* [in] rectangle to place metafile inside */
       )
 {
-    return EnumEnhMetaFile(hdc, hmf, EMF_PlayEnhMetaFileCallback, NULL,
-			   lpRect);
+    struct emf_playback play;
+    struct emf_object_cache *cache = NULL;
+    ENHMETAFILEOBJ *metafile;
+    BOOL ret;
+
+    memset( &play, 0, sizeof(play) );
+    EnterCriticalSection( &enhmetafile_cs );
+    if ((metafile = get_gdi_client_ptr( hmf, NTGDI_OBJ_ENHMETAFILE )))
+    {
+        play.emh = metafile->emh;
+        if ((cache = metafile->objects))
+        {
+            /* keep it alive while playing, and away from eviction */
+            cache->users++;
+            list_remove( &cache->entry );
+            list_add_head( &object_caches, &cache->entry );
+        }
+    }
+    LeaveCriticalSection( &enhmetafile_cs );
+    play.cache = cache;
+
+    if (!play.emh || !(play.cached = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                                play.emh->nHandles * sizeof(*play.cached) )))
+        ret = EnumEnhMetaFile( hdc, hmf, EMF_PlayEnhMetaFileCallback, NULL, lpRect );
+    else
+        ret = enum_enh_metafile( hdc, hmf, EMF_PlayEnhMetaFileCallback, &play, lpRect, &play );
+
+    EnterCriticalSection( &enhmetafile_cs );
+    if (cache && (--cache->users || cache->owner)) cache = NULL;
+    if (play.new_cache && (metafile = get_gdi_client_ptr( hmf, NTGDI_OBJ_ENHMETAFILE )) &&
+        attach_object_cache( metafile, play.new_cache ))
+        play.new_cache = NULL;
+    LeaveCriticalSection( &enhmetafile_cs );
+
+    /* the metafile was deleted while we were using its cache */
+    free_object_cache( cache );
+    free_object_cache( play.new_cache );
+    HeapFree( GetProcessHeap(), 0, play.cached );
+    return ret;
 }
 
 /*****************************************************************************
@@ -3485,6 +3485,151 @@ static INT check_StretchDIBits_stretch( HDC hdcDst, UINT32 *dstBuffer, UINT32 *s
     return ret;
 }
 
+/* create a memory DC with a top-down DIB section selected into it */
+static HDC create_dib_dc( int width, int height, WORD bpp, void **bits )
+{
+    BITMAPINFO info;
+    HBITMAP bmp;
+    HDC hdc;
+
+    memset( &info, 0, sizeof(info) );
+    info.bmiHeader.biSize = sizeof(info.bmiHeader);
+    info.bmiHeader.biWidth = width;
+    info.bmiHeader.biHeight = -height;
+    info.bmiHeader.biPlanes = 1;
+    info.bmiHeader.biBitCount = bpp;
+    info.bmiHeader.biCompression = BI_RGB;
+
+    hdc = CreateCompatibleDC( 0 );
+    bmp = CreateDIBSection( 0, &info, DIB_RGB_COLORS, bits, NULL, 0 );
+    ok( bmp != NULL, "CreateDIBSection failed err %lu\n", GetLastError() );
+    SelectObject( hdc, bmp );
+    return hdc;
+}
+
+static void delete_dib_dc( HDC hdc )
+{
+    HBITMAP bmp = GetCurrentObject( hdc, OBJ_BITMAP );
+
+    DeleteDC( hdc );
+    DeleteObject( bmp );
+}
+
+static void test_StretchBlt_large(void)
+{
+    HBITMAP ddb;
+    HDC hdc, dst_dc, src_dc;
+    DWORD *dst_bits, *src_bits;
+    int x, y, errors = 0;
+    BOOL ret;
+
+    dst_dc = create_dib_dc( 1024, 1024, 32, (void **)&dst_bits );
+    src_dc = create_dib_dc( 16, 16, 32, (void **)&src_bits );
+
+    for (y = 0; y < 16; y++)
+        for (x = 0; x < 16; x++) src_bits[y * 16 + x] = (y << 16) | (x << 8) | 0x55;
+
+    /* large enough to be split in bands, the rows must still come out in order */
+    SetStretchBltMode( dst_dc, COLORONCOLOR );
+    ret = StretchBlt( dst_dc, 0, 0, 1024, 1024, src_dc, 0, 0, 16, 16, SRCCOPY );
+    ok( ret, "StretchBlt failed\n" );
+    for (y = 0; y < 1024; y++)
+        for (x = 0; x < 1024; x++)
+            if (dst_bits[y * 1024 + x] != (((y / 64) << 16) | ((x / 64) << 8) | 0x55)) errors++;
+    ok( !errors, "got %d wrong pixels\n", errors );
+
+    /* mirrored */
+    ret = StretchBlt( dst_dc, 0, 1023, 1024, -1024, src_dc, 0, 0, 16, 16, SRCCOPY );
+    ok( ret, "StretchBlt failed\n" );
+    for (y = errors = 0; y < 1024; y++)
+        for (x = 0; x < 1024; x++)
+            if (dst_bits[y * 1024 + x] != ((((1023 - y) / 64) << 16) | ((x / 64) << 8) | 0x55)) errors++;
+    ok( !errors, "got %d wrong pixels\n", errors );
+
+    /* large pattern fill */
+    SelectObject( dst_dc, GetStockObject( WHITE_BRUSH ));
+    ret = PatBlt( dst_dc, 1, 1, 1022, 1022, PATINVERT );
+    ok( ret, "PatBlt failed\n" );
+    for (y = errors = 0; y < 1024; y++)
+    {
+        for (x = 0; x < 1024; x++)
+        {
+            DWORD expect = (((1023 - y) / 64) << 16) | ((x / 64) << 8) | 0x55;
+            if (x && y && x < 1023 && y < 1023) expect ^= 0xffffff;
+            if (dst_bits[y * 1024 + x] != expect) errors++;
+        }
+    }
+    ok( !errors, "got %d wrong pixels\n", errors );
+
+    delete_dib_dc( dst_dc );
+    delete_dib_dc( src_dc );
+
+    /* the bits of a device-dependent bitmap can be split in bands too */
+    hdc = GetDC( 0 );
+    dst_dc = CreateCompatibleDC( hdc );
+    ddb = CreateCompatibleBitmap( hdc, 1024, 1024 );
+    ReleaseDC( 0, hdc );
+    SelectObject( dst_dc, ddb );
+    SelectObject( dst_dc, GetStockObject( WHITE_BRUSH ));
+    ret = PatBlt( dst_dc, 0, 0, 1024, 1024, PATINVERT );
+    ok( ret, "PatBlt failed\n" );
+    ok( GetPixel( dst_dc, 0, 0 ) == 0xffffff, "got %06lx\n", GetPixel( dst_dc, 0, 0 ));
+    ok( GetPixel( dst_dc, 1023, 1023 ) == 0xffffff, "got %06lx\n", GetPixel( dst_dc, 1023, 1023 ));
+    ret = PatBlt( dst_dc, 0, 0, 1024, 1024, PATINVERT );
+    ok( ret, "PatBlt failed\n" );
+    ok( GetPixel( dst_dc, 0, 0 ) == 0, "got %06lx\n", GetPixel( dst_dc, 0, 0 ));
+    ok( GetPixel( dst_dc, 1023, 1023 ) == 0, "got %06lx\n", GetPixel( dst_dc, 1023, 1023 ));
+    DeleteDC( dst_dc );
+    DeleteObject( ddb );
+}
+
+static void test_StretchBlt_halftone(void)
+{
+    HDC dst_dc, src_dc;
+    DWORD *dst_bits, *src_bits;
+    COLORREF expect;
+    int x, y, bpp;
+    BOOL ret;
+
+    for (bpp = 16; bpp <= 32; bpp += 8)
+    {
+        dst_dc = create_dib_dc( 8, 8, bpp, (void **)&dst_bits );
+        src_dc = create_dib_dc( 64, 64, 32, (void **)&src_bits );
+        SetStretchBltMode( dst_dc, HALFTONE );
+
+        /* a fine checkerboard averages out to grey when shrunk */
+        for (y = 0; y < 64; y++)
+            for (x = 0; x < 64; x++) src_bits[y * 64 + x] = ((x ^ y) & 1) ? 0xffffff : 0;
+        ret = StretchBlt( dst_dc, 0, 0, 8, 8, src_dc, 0, 0, 64, 64, SRCCOPY );
+        ok( ret, "%u bpp: StretchBlt failed\n", bpp );
+        for (y = 0; y < 8; y++)
+        {
+            for (x = 0; x < 8; x++)
+            {
+                COLORREF color = GetPixel( dst_dc, x, y );
+                ok( GetRValue( color ) >= 0x60 && GetRValue( color ) <= 0xa0 &&
+                    GetGValue( color ) >= 0x60 && GetGValue( color ) <= 0xa0 &&
+                    GetBValue( color ) >= 0x60 && GetBValue( color ) <= 0xa0,
+                    "%u bpp: %d,%d: got %06lx\n", bpp, x, y, color );
+            }
+        }
+
+        /* a solid color stays solid when stretched, in both directions */
+        for (y = 0; y < 64; y++)
+            for (x = 0; x < 64; x++) src_bits[y * 64 + x] = 0x00ff00;
+        expect = SetPixel( dst_dc, 0, 0, RGB( 0, 0xff, 0 ));
+        ret = StretchBlt( dst_dc, 7, 7, -8, -8, src_dc, 0, 0, 3, 5, SRCCOPY );
+        ok( ret, "%u bpp: StretchBlt failed\n", bpp );
+        for (y = 0; y < 8; y++)
+            for (x = 0; x < 8; x++)
+                ok( GetPixel( dst_dc, x, y ) == expect, "%u bpp: %d,%d: got %06lx expected %06lx\n",
+                    bpp, x, y, GetPixel( dst_dc, x, y ), expect );
+
+        delete_dib_dc( dst_dc );
+        delete_dib_dc( src_dc );
+    }
+}
+
 static void test_StretchDIBits(void)
 {
     HBITMAP bmpDst;
@@ -3851,6 +3996,71 @@ static void test_GdiAlphaBlend(void)
     HeapFree(GetProcessHeap(), 0, bmi);
 }
 
+static BOOL compare_argb( DWORD color1, DWORD color2 )
+{
+    int i;
+
+    for (i = 0; i < 32; i += 8)
+        if (abs( (int)((color1 >> i) & 0xff) - (int)((color2 >> i) & 0xff) ) > 1) return FALSE;
+    return TRUE;
+}
+
+static void test_GdiAlphaBlend_rows(void)
+{
+    static const int width = 13, height = 3;
+    HDC dst_dc, src_dc;
+    DWORD *dst_bits, *src_bits, expect;
+    BLENDFUNCTION blend = { AC_SRC_OVER, 0, 255, AC_SRC_ALPHA };
+    int i, alpha;
+    BOOL ret;
+
+    if (!pGdiAlphaBlend)
+    {
+        win_skip("GdiAlphaBlend() is not implemented\n");
+        return;
+    }
+
+    dst_dc = create_dib_dc( width, height, 32, (void **)&dst_bits );
+    src_dc = create_dib_dc( width, height, 32, (void **)&src_bits );
+
+    /* widths that are not a multiple of the pixel group size, with premultiplied sources */
+    for (i = 0; i < width * height; i++)
+    {
+        alpha = (i * 23) & 0xff;
+        src_bits[i] = (alpha << 24) | ((alpha / 2) << 16) | ((alpha / 3) << 8) | (alpha / 5);
+        dst_bits[i] = 0x80402010 + i;
+    }
+    ret = pGdiAlphaBlend( dst_dc, 0, 0, width, height, src_dc, 0, 0, width, height, blend );
+    ok( ret, "GdiAlphaBlend failed err %lu\n", GetLastError() );
+    for (i = 0; i < width * height; i++)
+    {
+        DWORD src = src_bits[i], dst = 0x80402010 + i;
+
+        alpha = src >> 24;
+        expect = (((src >> 24) + ((dst >> 24) * (255 - alpha) + 127) / 255) << 24) |
+                 ((((src >> 16) & 0xff) + (((dst >> 16) & 0xff) * (255 - alpha) + 127) / 255) << 16) |
+                 ((((src >> 8) & 0xff) + (((dst >> 8) & 0xff) * (255 - alpha) + 127) / 255) << 8) |
+                 ((src & 0xff) + ((dst & 0xff) * (255 - alpha) + 127) / 255);
+        ok( compare_argb( dst_bits[i], expect ), "%d: got %08lx expected %08lx\n", i, dst_bits[i], expect );
+    }
+
+    /* constant alpha only */
+    for (i = 0; i < width * height; i++)
+    {
+        src_bits[i] = 0x00ffffff;
+        dst_bits[i] = 0;
+    }
+    blend.SourceConstantAlpha = 0x80;
+    blend.AlphaFormat = 0;
+    ret = pGdiAlphaBlend( dst_dc, 0, 0, width, height, src_dc, 0, 0, width, height, blend );
+    ok( ret, "GdiAlphaBlend failed err %lu\n", GetLastError() );
+    for (i = 0; i < width * height; i++)
+        ok( compare_argb( dst_bits[i], 0x00808080 ), "%d: got %08lx\n", i, dst_bits[i] );
+
+    delete_dib_dc( dst_dc );
+    delete_dib_dc( src_dc );
+}
+
 static void test_GdiGradientFill(void)
 {
     HDC hdc;
@@ -6004,8 +6214,11 @@ START_TEST(bitmap)
     test_CreateBitmap();
     test_BitBlt();
     test_StretchBlt();
+    test_StretchBlt_large();
+    test_StretchBlt_halftone();
     test_StretchDIBits();
     test_GdiAlphaBlend();
+    test_GdiAlphaBlend_rows();
     test_GdiGradientFill();
     test_32bit_ddb();
     test_bitmapinfoheadersize();
@@ -559,6 +559,73 @@ static void test_CreatePolyPolygonRgn(void)
     DeleteObject(region);
 }
 
+static void test_RectInRegion(void)
+{
+    HRGN region, tmp, dst;
+    RGNDATA *data;
+    DWORD size;
+    RECT rect;
+    BOOL ret, expect;
+    int x, y, i;
+
+    /* a region with many bands and many rectangles per band */
+    region = CreateRectRgn( 0, 0, 0, 0 );
+    for (y = 0; y < 64; y++)
+        for (x = (y % 2); x < 64; x += 2)
+        {
+            tmp = CreateRectRgn( x * 8, y * 6, x * 8 + 5, y * 6 + 4 );
+            CombineRgn( region, region, tmp, RGN_OR );
+            DeleteObject( tmp );
+        }
+
+    for (i = 0; i < 1000; i++)
+    {
+        x = (i * 37) % 520 - 4;
+        y = (i * 53) % 390 - 4;
+        SetRect( &rect, x, y, x + 1 + (i % 7), y + 1 + (i % 5) );
+        expect = FALSE;
+        for (x = rect.left; x < rect.right && !expect; x++)
+            for (y = rect.top; y < rect.bottom && !expect; y++)
+                expect = PtInRegion( region, x, y );
+        ret = RectInRegion( region, &rect );
+        ok( ret == expect, "%s: got %d, expected %d\n", wine_dbgstr_rect( &rect ), ret, expect );
+    }
+
+    DeleteObject( region );
+
+    /* lookups in a wide band */
+    data = HeapAlloc( GetProcessHeap(), 0, FIELD_OFFSET( RGNDATA, Buffer[4096 * sizeof(RECT)] ));
+    data->rdh.dwSize = sizeof(data->rdh);
+    data->rdh.iType = RDH_RECTANGLES;
+    data->rdh.nCount = 4096;
+    data->rdh.nRgnSize = 4096 * sizeof(RECT);
+    SetRect( &data->rdh.rcBound, 0, 0, 4095 * 4 + 2, 10 );
+    for (x = 0; x < 4096; x++) SetRect( (RECT *)data->Buffer + x, x * 4, 0, x * 4 + 2, 10 );
+    region = ExtCreateRegion( NULL, FIELD_OFFSET( RGNDATA, Buffer[4096 * sizeof(RECT)] ), data );
+    ok( region != 0, "ExtCreateRegion failed\n" );
+    HeapFree( GetProcessHeap(), 0, data );
+    for (x = 0; x < 4096; x += 97)
+    {
+        SetRect( &rect, x * 4, 2, x * 4 + 2, 4 );
+        ok( RectInRegion( region, &rect ), "%s: not in region\n", wine_dbgstr_rect( &rect ));
+        SetRect( &rect, x * 4 + 2, 2, x * 4 + 4, 4 );
+        ok( !RectInRegion( region, &rect ), "%s: in region\n", wine_dbgstr_rect( &rect ));
+    }
+
+    /* every union allocates a new array for the result and frees the previous one */
+    tmp = CreateRectRgn( 0, 20, 10, 30 );
+    dst = CreateRectRgn( 0, 0, 0, 0 );
+    for (i = 0; i < 2; i++)
+    {
+        CombineRgn( dst, region, tmp, RGN_OR );
+        size = GetRegionData( dst, 0, NULL );
+        ok( size == sizeof(RGNDATAHEADER) + 4097 * sizeof(RECT), "got size %lu\n", size );
+    }
+    DeleteObject( dst );
+    DeleteObject( tmp );
+    DeleteObject( region );
+}
+
 START_TEST(clipping)
 {
     test_GetRandomRgn();
@@ -567,4 +634,5 @@ START_TEST(clipping)
     test_memory_dc_clipping();
     test_window_dc_clipping();
     test_CreatePolyPolygonRgn();
+    test_RectInRegion();
 }
@@ -28,6 +28,7 @@
 #include "wingdi.h"
 #include "winuser.h"
 #include "winnls.h"
+#include "winreg.h"
 
 #include "wine/heap.h"
 #include "wine/test.h"
@@ -7651,11 +7652,375 @@ static void test_GetOutlineTextMetrics_subst(void)
     ReleaseDC(0, hdc);
 }
 
+static void test_glyph_bitmap_cache(void)
+{
+    static const WCHAR text[] = L"The quick brown fox";
+    static const BYTE qualities[] = { NONANTIALIASED_QUALITY, ANTIALIASED_QUALITY };
+    static const char *faces[] = { "Tahoma", "Arial" };
+    BITMAPINFO bmi = {{ sizeof(bmi.bmiHeader), 256, 32, 1, 32, BI_RGB }};
+    WORD indices[ARRAY_SIZE(text)];
+    HBITMAP bitmap[3], old_bitmap;
+    HFONT hfont[2], old_font;
+    void *bits[3];
+    LOGFONTA lf;
+    HDC hdc;
+    int i, j, k, len = lstrlenW( text );
+    DWORD ret;
+
+    hdc = CreateCompatibleDC( 0 );
+    for (i = 0; i < 3; i++)
+    {
+        bitmap[i] = CreateDIBSection( hdc, &bmi, DIB_RGB_COLORS, &bits[i], NULL, 0 );
+        ok( bitmap[i] != NULL, "CreateDIBSection failed\n" );
+    }
+    old_bitmap = SelectObject( hdc, bitmap[0] );
+
+    for (i = 0; i < ARRAY_SIZE(faces); i++)
+    {
+        if (!is_truetype_font_installed( faces[i] ))
+        {
+            skip( "%s is not installed\n", faces[i] );
+            continue;
+        }
+        for (j = 0; j < ARRAY_SIZE(qualities); j++)
+        {
+            /* two logical fonts that realize the same font */
+            memset( &lf, 0, sizeof(lf) );
+            lf.lfHeight = -20;
+            lf.lfQuality = qualities[j];
+            strcpy( lf.lfFaceName, faces[i] );
+            hfont[0] = CreateFontIndirectA( &lf );
+            lf.lfOutPrecision = OUT_TT_PRECIS;
+            hfont[1] = CreateFontIndirectA( &lf );
+
+            old_font = SelectObject( hdc, hfont[0] );
+            ret = GetGlyphIndicesW( hdc, text, len, indices, 0 );
+            ok( ret == len, "GetGlyphIndicesW returned %lu\n", ret );
+
+            for (k = 0; k < 3; k++)
+            {
+                SelectObject( hdc, bitmap[k] );
+                SelectObject( hdc, hfont[k == 2] );
+                memset( bits[k], 0xcc, 256 * 32 * 4 );
+                if (k == 1) ret = ExtTextOutW( hdc, 0, 0, ETO_GLYPH_INDEX, NULL, indices, len, NULL );
+                else ret = ExtTextOutW( hdc, 0, 0, 0, NULL, text, len, NULL );
+                ok( ret, "ExtTextOutW failed\n" );
+            }
+            ok( !memcmp( bits[0], bits[1], 256 * 32 * 4 ),
+                "%s quality %u: glyph index rendering differs\n", faces[i], qualities[j] );
+            ok( !memcmp( bits[0], bits[2], 256 * 32 * 4 ),
+                "%s quality %u: rendering differs between logical fonts\n", faces[i], qualities[j] );
+
+            SelectObject( hdc, old_font );
+            DeleteObject( hfont[0] );
+            DeleteObject( hfont[1] );
+        }
+    }
+
+    SelectObject( hdc, old_bitmap );
+    for (i = 0; i < 3; i++) DeleteObject( bitmap[i] );
+    DeleteDC( hdc );
+}
+
+static HBITMAP create_text_dib( HDC hdc, WORD bpp, DWORD compression, BYTE **bits )
+{
+    char buffer[FIELD_OFFSET( BITMAPINFO, bmiColors[3] )];
+    BITMAPINFO *bmi = (BITMAPINFO *)buffer;
+    DWORD *masks = (DWORD *)bmi->bmiColors;
+
+    memset( buffer, 0, sizeof(buffer) );
+    bmi->bmiHeader.biSize = sizeof(bmi->bmiHeader);
+    bmi->bmiHeader.biWidth = 512;
+    bmi->bmiHeader.biHeight = -64;
+    bmi->bmiHeader.biPlanes = 1;
+    bmi->bmiHeader.biBitCount = bpp;
+    bmi->bmiHeader.biCompression = compression;
+    if (compression == BI_BITFIELDS)
+    {
+        masks[0] = 0xf800;
+        masks[1] = 0x07e0;
+        masks[2] = 0x001f;
+    }
+    return CreateDIBSection( hdc, bmi, DIB_RGB_COLORS, (void **)bits, NULL, 0 );
+}
+
+static void test_clipped_text(void)
+{
+    static const WCHAR text[] = L"The quick brown fox jumps over the lazy dog";
+    static const struct
+    {
+        WORD  bpp;
+        DWORD compression;
+    }
+    formats[] =
+    {
+        { 32, BI_RGB },
+        { 24, BI_RGB },
+        { 16, BI_RGB },       /* 555 */
+        { 16, BI_BITFIELDS }, /* 565 */
+    };
+    static const BYTE qualities[] = { NONANTIALIASED_QUALITY, ANTIALIASED_QUALITY, CLEARTYPE_QUALITY };
+    HBITMAP bitmap[3], old_bitmap;
+    HFONT hfont, big_font, old_font;
+    BYTE *bits[3];
+    LOGFONTA lf;
+    HRGN rgn, stripe;
+    HDC hdc;
+    int i, j, k, x, y, errors, size, len = lstrlenW( text );
+
+    if (!is_truetype_font_installed( "Arial" ))
+    {
+        skip( "Arial is not installed\n" );
+        return;
+    }
+
+    /* a clip region made of many small rectangles */
+    rgn = CreateRectRgn( 0, 0, 0, 0 );
+    for (y = 0; y < 64; y += 4)
+    {
+        for (x = (y / 4) % 2; x < 512; x += 16)
+        {
+            stripe = CreateRectRgn( x, y, x + 7, y + 3 );
+            CombineRgn( rgn, rgn, stripe, RGN_OR );
+            DeleteObject( stripe );
+        }
+    }
+
+    for (i = 0; i < ARRAY_SIZE(formats); i++)
+    {
+        size = 512 * 64 * formats[i].bpp / 8;
+
+        for (j = 0; j < ARRAY_SIZE(qualities); j++)
+        {
+            /* a new DC doesn't have any blend table for the text color yet */
+            hdc = CreateCompatibleDC( 0 );
+            for (k = 0; k < 3; k++)
+            {
+                bitmap[k] = create_text_dib( hdc, formats[i].bpp, formats[i].compression, &bits[k] );
+                ok( bitmap[k] != NULL, "CreateDIBSection failed\n" );
+                memset( bits[k], 0x80, size );
+            }
+            memset( &lf, 0, sizeof(lf) );
+            lf.lfHeight = -24;
+            lf.lfQuality = qualities[j];
+            strcpy( lf.lfFaceName, "Arial" );
+            hfont = CreateFontIndirectA( &lf );
+            lf.lfHeight = -120;
+            big_font = CreateFontIndirectA( &lf );
+            old_font = SelectObject( hdc, hfont );
+            SetTextColor( hdc, RGB( 0x20, 0x40, 0xc0 ));
+            SetBkMode( hdc, TRANSPARENT );
+
+            /* the small string is drawn without building a blend table */
+            old_bitmap = SelectObject( hdc, bitmap[0] );
+            ExtTextOutW( hdc, 2, 20, 0, NULL, text, len, NULL );
+
+            /* a large string builds the table, which is then used for the small one too */
+            SelectObject( hdc, bitmap[2] );
+            SelectObject( hdc, big_font );
+            ExtTextOutW( hdc, 0, 0, 0, NULL, text, len, NULL );
+            memset( bits[2], 0x80, size );
+            SelectObject( hdc, hfont );
+            ExtTextOutW( hdc, 2, 20, 0, NULL, text, len, NULL );
+            ok( !memcmp( bits[0], bits[2], size ), "%u bpp %lu quality %u: blend table output differs\n",
+                formats[i].bpp, formats[i].compression, qualities[j] );
+
+            /* the clipped string must give the same pixels */
+            SelectObject( hdc, bitmap[1] );
+            SelectClipRgn( hdc, rgn );
+            ExtTextOutW( hdc, 2, 20, 0, NULL, text, len, NULL );
+            SelectClipRgn( hdc, NULL );
+            for (y = errors = 0; y < 64; y++)
+            {
+                for (x = 0; x < 512; x++)
+                {
+                    int pos = (y * 512 + x) * formats[i].bpp / 8;
+                    const BYTE *expect = PtInRegion( rgn, x, y ) ? bits[0] + pos : NULL;
+
+                    for (k = 0; k < formats[i].bpp / 8; k++)
+                        if (bits[1][pos + k] != (expect ? expect[k] : 0x80)) break;
+                    if (k < formats[i].bpp / 8) errors++;
+                }
+            }
+            ok( !errors, "%u bpp %lu quality %u: got %d wrong pixels\n",
+                formats[i].bpp, formats[i].compression, qualities[j], errors );
+
+            SelectObject( hdc, old_bitmap );
+            SelectObject( hdc, old_font );
+            DeleteObject( hfont );
+            DeleteObject( big_font );
+            DeleteDC( hdc );
+            for (k = 0; k < 3; k++) DeleteObject( bitmap[k] );
+        }
+    }
+    DeleteObject( rgn );
+}
+
+struct font_index_face
+{
+    ENUMLOGFONTEXA   elf;
+    NEWTEXTMETRICEXA ntm;
+};
+
+static INT CALLBACK font_index_enum_proc( const LOGFONTA *lf, const TEXTMETRICA *tm, DWORD type, LPARAM lparam )
+{
+    struct font_index_face *face = (struct font_index_face *)lparam;
+
+    if (lf->lfCharSet != ANSI_CHARSET) return 1;
+    face->elf = *(const ENUMLOGFONTEXA *)lf;
+    face->ntm = *(const NEWTEXTMETRICEXA *)tm;
+    return 0;
+}
+
+static BOOL get_font_index_face( const char *family, struct font_index_face *face )
+{
+    LOGFONTA lf;
+    HDC hdc = GetDC( 0 );
+    BOOL found;
+
+    memset( &lf, 0, sizeof(lf) );
+    lf.lfCharSet = DEFAULT_CHARSET;
+    strcpy( lf.lfFaceName, family );
+    memset( face, 0, sizeof(*face) );
+    found = !EnumFontFamiliesExA( hdc, &lf, font_index_enum_proc, (LPARAM)face, 0 );
+    ReleaseDC( 0, hdc );
+    return found;
+}
+
+/* child side: report the face that was loaded with the font list */
+static void test_font_index_child( const char *family, const char *result )
+{
+    struct font_index_face face;
+    HANDLE file;
+    DWORD size = 0;
+
+    file = CreateFileA( result, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, 0 );
+    ok( file != INVALID_HANDLE_VALUE, "CreateFile failed err %lu\n", GetLastError() );
+    if (get_font_index_face( family, &face )) WriteFile( file, &face, sizeof(face), &size, NULL );
+    CloseHandle( file );
+}
+
+static BOOL run_font_index_child( const char *family, struct font_index_face *face )
+{
+    PROCESS_INFORMATION info;
+    STARTUPINFOA startup;
+    char cmdline[3 * MAX_PATH], result[MAX_PATH], tmp_path[MAX_PATH], **argv;
+    HANDLE file;
+    DWORD size = 0;
+
+    winetest_get_mainargs( &argv );
+    GetTempPathA( MAX_PATH, tmp_path );
+    GetTempFileNameA( tmp_path, "idx", 0, result );
+    sprintf( cmdline, "%s font font_index %s %s", argv[0], family, result );
+    memset( &startup, 0, sizeof(startup) );
+    startup.cb = sizeof(startup);
+    ok( CreateProcessA( NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &startup, &info ),
+        "CreateProcess failed err %lu\n", GetLastError() );
+    wait_child_process( info.hProcess );
+    CloseHandle( info.hProcess );
+    CloseHandle( info.hThread );
+
+    file = CreateFileA( result, GENERIC_READ, 0, NULL, OPEN_EXISTING, 0, 0 );
+    ok( file != INVALID_HANDLE_VALUE, "CreateFile failed err %lu\n", GetLastError() );
+    ReadFile( file, face, sizeof(*face), &size, NULL );
+    CloseHandle( file );
+    DeleteFileA( result );
+    return size == sizeof(*face);
+}
+
+static void check_font_index_face( const char *family, const char *ttf_name )
+{
+    struct font_index_face face, child_face;
+    int i;
+
+    ok( AddFontResourceExA( ttf_name, FR_PRIVATE, 0 ), "AddFontResourceEx failed\n" );
+    ok( get_font_index_face( family, &face ), "%s not found\n", family );
+    RemoveFontResourceExA( ttf_name, FR_PRIVATE, 0 );
+
+    /* the first child loads the file, the second one finds it in the index */
+    for (i = 0; i < 2; i++)
+    {
+        if (!run_font_index_child( family, &child_face ))
+        {
+            ok( 0, "%d: %s not found in the child\n", i, family );
+            continue;
+        }
+        ok( !strcmp( (char *)child_face.elf.elfFullName, (char *)face.elf.elfFullName ),
+            "%d: got full name %s, expected %s\n", i, child_face.elf.elfFullName, face.elf.elfFullName );
+        ok( !strcmp( (char *)child_face.elf.elfStyle, (char *)face.elf.elfStyle ),
+            "%d: got style %s, expected %s\n", i, child_face.elf.elfStyle, face.elf.elfStyle );
+        ok( child_face.ntm.ntmTm.ntmFlags == face.ntm.ntmTm.ntmFlags,
+            "%d: got flags %#lx, expected %#lx\n", i, child_face.ntm.ntmTm.ntmFlags, face.ntm.ntmTm.ntmFlags );
+        ok( !memcmp( &child_face.ntm.ntmFontSig, &face.ntm.ntmFontSig, sizeof(face.ntm.ntmFontSig) ),
+            "%d: font signature differs\n", i );
+        ok( child_face.ntm.ntmTm.tmHeight == face.ntm.ntmTm.tmHeight,
+            "%d: got height %ld, expected %ld\n", i, child_face.ntm.ntmTm.tmHeight, face.ntm.ntmTm.tmHeight );
+    }
+}
+
+static BOOL rewrite_ttf_file( const char *fontname, const char *ttf_name )
+{
+    void *data;
+    DWORD size;
+    HANDLE file;
+    BOOL ret;
+
+    if (!(data = get_res_data( fontname, &size ))) return FALSE;
+    file = CreateFileA( ttf_name, GENERIC_WRITE, 0, NULL, TRUNCATE_EXISTING, 0, 0 );
+    if (file == INVALID_HANDLE_VALUE) return FALSE;
+    ret = WriteFile( file, data, size, &size, NULL );
+    CloseHandle( file );
+    return ret;
+}
+
+static void test_font_index(void)
+{
+    static const char value[] = "wine_index_test (TrueType)";
+    struct font_index_face face;
+    char ttf_name[MAX_PATH];
+    HKEY key = 0;
+    LONG ret;
+
+    if (strcmp( winetest_platform, "wine" ))
+    {
+        /* Windows only loads the registered fonts at logon */
+        skip( "registered fonts are not loaded by new processes\n" );
+        return;
+    }
+    if (!write_ttf_file( "wine_test.ttf", ttf_name ))
+    {
+        skip( "Failed to create ttf file for testing\n" );
+        return;
+    }
+    ret = RegOpenKeyExA( HKEY_LOCAL_MACHINE, "Software\\Microsoft\\Windows NT\\CurrentVersion\\Fonts",
+                         0, KEY_SET_VALUE, &key );
+    if (!ret) ret = RegSetValueExA( key, value, 0, REG_SZ, (BYTE *)ttf_name, strlen( ttf_name ) + 1 );
+    if (ret)
+    {
+        skip( "Failed to register the font, error %ld\n", ret );
+        if (key) RegCloseKey( key );
+        DeleteFileA( ttf_name );
+        return;
+    }
+
+    check_font_index_face( "wine_test", ttf_name );
+
+    /* replace the file in place, the index entry must not be used anymore */
+    ok( rewrite_ttf_file( "wine_vdmx.ttf", ttf_name ), "failed to rewrite %s\n", ttf_name );
+    check_font_index_face( "wine_vdmx", ttf_name );
+    ok( !run_font_index_child( "wine_test", &face ), "wine_test still found in the child\n" );
+
+    RegDeleteValueA( key, value );
+    RegCloseKey( key );
+    DeleteFileA( ttf_name );
+}
+
 START_TEST(font)
 {
     static const char *test_names[] =
     {
         "AddFontMemResource",
+        "glyph_bitmap_cache",
     };
     char path_name[MAX_PATH];
     STARTUPINFOA startup;
@@ -7669,6 +8034,10 @@ START_TEST(font)
     {
         if (!strcmp(argv[2], "AddFontMemResource"))
             test_AddFontMemResource();
+        else if (!strcmp(argv[2], "glyph_bitmap_cache"))
+            test_glyph_bitmap_cache();
+        else if (!strcmp(argv[2], "font_index") && argc >= 5)
+            test_font_index_child( argv[3], argv[4] );
         return;
     }
 
@@ -7739,6 +8108,9 @@ START_TEST(font)
     test_lang_names();
     test_char_width();
     test_select_object();
+    test_glyph_bitmap_cache();
+    test_clipped_text();
+    test_font_index();
 
     /* These tests should be last test until RemoveFontResource
      * is properly implemented.
@@ -197,6 +197,65 @@ static void test_thread_objects(void)
     CloseHandle(hgdiobj_event.ready_event);
 }
 
+static DWORD WINAPI draw_thread_proc(void *param)
+{
+    BITMAPINFO info = {{ sizeof(info.bmiHeader), 32, -32, 1, 32, BI_RGB }};
+    COLORREF color = RGB( 0x10, 0x20, (UINT_PTR)param );
+    HBITMAP bitmap, old_bitmap;
+    HBRUSH brush, old_brush;
+    HPEN pen, old_pen;
+    DWORD *bits;
+    HDC hdc, src;
+    int i, x;
+
+    hdc = CreateCompatibleDC( 0 );
+    src = CreateCompatibleDC( 0 );
+    bitmap = CreateDIBSection( hdc, &info, DIB_RGB_COLORS, (void **)&bits, NULL, 0 );
+    old_bitmap = SelectObject( src, bitmap );
+
+    for (i = 0; i < 1000; i++)
+    {
+        brush = CreateSolidBrush( color );
+        pen = CreatePen( PS_SOLID, 1, color );
+        old_brush = SelectObject( src, brush );
+        old_pen = SelectObject( src, pen );
+        Rectangle( src, 0, 0, 32, 32 );
+        PatBlt( src, 0, 0, 16, 16, PATCOPY );
+        BitBlt( hdc, 0, 0, 32, 32, src, 0, 0, SRCCOPY );
+        SelectObject( src, old_pen );
+        SelectObject( src, old_brush );
+        DeleteObject( pen );
+        DeleteObject( brush );
+    }
+
+    GdiFlush();
+    for (x = 0; x < 32 * 32; x++)
+        if (bits[x] != ((0x10 << 16) | (0x20 << 8) | (UINT_PTR)param)) break;
+    ok( x == 32 * 32, "thread %Iu: got %08lx at %u\n", (UINT_PTR)param, bits[min( x, 32 * 32 - 1 )], x );
+
+    SelectObject( src, old_bitmap );
+    DeleteObject( bitmap );
+    DeleteDC( src );
+    DeleteDC( hdc );
+    return 0;
+}
+
+static void test_threaded_drawing(void)
+{
+    HANDLE threads[4];
+    DWORD status;
+    UINT i;
+
+    for (i = 0; i < ARRAY_SIZE(threads); i++)
+    {
+        threads[i] = CreateThread( NULL, 0, draw_thread_proc, (void *)(UINT_PTR)(i + 1), 0, NULL );
+        ok( threads[i] != NULL, "CreateThread error %lu\n", GetLastError() );
+    }
+    status = WaitForMultipleObjects( ARRAY_SIZE(threads), threads, TRUE, 30000 );
+    ok( status == WAIT_OBJECT_0, "WaitForMultipleObjects returned %lu\n", status );
+    for (i = 0; i < ARRAY_SIZE(threads); i++) CloseHandle( threads[i] );
+}
+
 static void test_GetCurrentObject(void)
 {
     DWORD type;
@@ -492,6 +551,7 @@ START_TEST(gdiobj)
 
     test_gdi_objects();
     test_thread_objects();
+    test_threaded_drawing();
     test_GetCurrentObject();
     test_region();
     test_handles_on_win64();
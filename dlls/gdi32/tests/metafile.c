@@ -10529,6 +10529,136 @@ static void test_emf_text_extents(void)
     ReleaseDC(0, dc);
 }
 
+static HDC create_dib_dc( int width, int height, DWORD **bits )
+{
+    BITMAPINFO info;
+    HBITMAP bmp;
+    HDC hdc;
+
+    memset( &info, 0, sizeof(info) );
+    info.bmiHeader.biSize = sizeof(info.bmiHeader);
+    info.bmiHeader.biWidth = width;
+    info.bmiHeader.biHeight = -height;
+    info.bmiHeader.biPlanes = 1;
+    info.bmiHeader.biBitCount = 32;
+    info.bmiHeader.biCompression = BI_RGB;
+
+    hdc = CreateCompatibleDC( 0 );
+    bmp = CreateDIBSection( 0, &info, DIB_RGB_COLORS, (void **)bits, NULL, 0 );
+    ok( bmp != NULL, "CreateDIBSection failed err %lu\n", GetLastError() );
+    SelectObject( hdc, bmp );
+    return hdc;
+}
+
+static void delete_dib_dc( HDC hdc )
+{
+    HBITMAP bmp = GetCurrentObject( hdc, OBJ_BITMAP );
+
+    DeleteDC( hdc );
+    DeleteObject( bmp );
+}
+
+static void draw_emf_pens( HDC hdc )
+{
+    HPEN pen, old_pen;
+    int i;
+
+    for (i = 0; i < 20000; i++)
+    {
+        pen = CreatePen( PS_SOLID, 1, RGB( i, i >> 8, 0x80 ) );
+        old_pen = SelectObject( hdc, pen );
+        Rectangle( hdc, i % 90, (i / 90) % 90, i % 90 + 10, (i / 90) % 90 + 10 );
+        SelectObject( hdc, old_pen );
+        DeleteObject( pen );
+    }
+}
+
+static void test_emf_large(void)
+{
+    char temp_path[MAX_PATH], emf_name[MAX_PATH];
+    HENHMETAFILE mem_emf, file_emf, copies[6];
+    BYTE *mem_bits, *file_bits;
+    UINT mem_size, file_size;
+    DWORD *bits, *first;
+    HDC hdc;
+    RECT rect;
+    BOOL ret;
+    int i, j;
+
+    GetTempPathA( MAX_PATH, temp_path );
+    GetTempFileNameA( temp_path, "emf", 0, emf_name );
+
+    hdc = CreateEnhMetaFileA( NULL, NULL, NULL, NULL );
+    ok( hdc != 0, "CreateEnhMetaFileA failed\n" );
+    draw_emf_pens( hdc );
+    mem_emf = CloseEnhMetaFile( hdc );
+    ok( mem_emf != 0, "CloseEnhMetaFile failed\n" );
+
+    /* large disk based metafiles are written while they are recorded */
+    hdc = CreateEnhMetaFileA( NULL, emf_name, NULL, NULL );
+    ok( hdc != 0, "CreateEnhMetaFileA failed\n" );
+    draw_emf_pens( hdc );
+    file_emf = CloseEnhMetaFile( hdc );
+    ok( file_emf != 0, "CloseEnhMetaFile failed\n" );
+
+    mem_size = GetEnhMetaFileBits( mem_emf, 0, NULL );
+    file_size = GetEnhMetaFileBits( file_emf, 0, NULL );
+    ok( mem_size > 1024 * 1024, "got size %u\n", mem_size );
+    ok( mem_size == file_size, "got sizes %u and %u\n", mem_size, file_size );
+    mem_bits = HeapAlloc( GetProcessHeap(), 0, mem_size );
+    file_bits = HeapAlloc( GetProcessHeap(), 0, file_size );
+    GetEnhMetaFileBits( mem_emf, mem_size, mem_bits );
+    GetEnhMetaFileBits( file_emf, file_size, file_bits );
+    ok( mem_size == file_size && !memcmp( mem_bits, file_bits, mem_size ), "contents differ\n" );
+    HeapFree( GetProcessHeap(), 0, mem_bits );
+    HeapFree( GetProcessHeap(), 0, file_bits );
+
+    /* playing the same metafile again gives the same result */
+    hdc = create_dib_dc( 100, 100, &bits );
+    first = HeapAlloc( GetProcessHeap(), 0, 100 * 100 * sizeof(*bits) );
+    SetRect( &rect, 0, 0, 100, 100 );
+
+    memset( bits, 0xcc, 100 * 100 * sizeof(*bits) );
+    ret = PlayEnhMetaFile( hdc, file_emf, &rect );
+    ok( ret, "PlayEnhMetaFile failed\n" );
+    memcpy( first, bits, 100 * 100 * sizeof(*bits) );
+
+    memset( bits, 0xcc, 100 * 100 * sizeof(*bits) );
+    ret = PlayEnhMetaFile( hdc, file_emf, &rect );
+    ok( ret, "PlayEnhMetaFile failed\n" );
+    ok( !memcmp( first, bits, 100 * 100 * sizeof(*bits) ), "second playback differs\n" );
+    ok( GetCurrentObject( hdc, OBJ_PEN ) == GetStockObject( BLACK_PEN ), "pen not restored\n" );
+
+    /* objects kept for more metafiles than the cache can hold are evicted */
+    for (i = 0; i < ARRAY_SIZE(copies); i++)
+    {
+        copies[i] = CopyEnhMetaFileA( mem_emf, NULL );
+        ok( copies[i] != 0, "CopyEnhMetaFileA failed\n" );
+    }
+    for (j = 0; j < 2; j++)
+    {
+        for (i = 0; i < ARRAY_SIZE(copies); i++)
+        {
+            memset( bits, 0xcc, 100 * 100 * sizeof(*bits) );
+            ret = PlayEnhMetaFile( hdc, copies[i], &rect );
+            ok( ret, "PlayEnhMetaFile failed\n" );
+            ok( !memcmp( first, bits, 100 * 100 * sizeof(*bits) ), "%d: playback %d differs\n", i, j );
+        }
+        /* deleting a metafile releases its objects */
+        DeleteEnhMetaFile( copies[j] );
+        copies[j] = CopyEnhMetaFileA( mem_emf, NULL );
+        ok( copies[j] != 0, "CopyEnhMetaFileA failed\n" );
+    }
+    for (i = 0; i < ARRAY_SIZE(copies); i++) DeleteEnhMetaFile( copies[i] );
+
+    HeapFree( GetProcessHeap(), 0, first );
+    delete_dib_dc( hdc );
+    DeleteEnhMetaFile( mem_emf );
+    DeleteEnhMetaFile( file_emf );
+    ret = DeleteFileA( emf_name );
+    ok( ret, "DeleteFile failed, error %ld\n", GetLastError() );
+}
+
 static const unsigned char MF_SETLAYOUT_BITS[] =
 {
 /*  Winedump output. Note that there is no META_SELECTOBJECT records after META_SETLAYOUT.
@@ -10626,6 +10756,7 @@ START_TEST(metafile)
     test_emf_GradientFill();
     test_emf_WorldTransform();
     test_emf_text_extents();
+    test_emf_large();
     test_enhmetafile_file();
     test_emf_SetPixel();
     test_emf_attrs();
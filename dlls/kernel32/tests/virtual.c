@@ -81,7 +81,7 @@ static void test_VirtualAllocEx(void)
     BOOL b;
     DWORD old_prot;
     MEMORY_BASIC_INFORMATION info;
-    HANDLE hProcess;
+    HANDLE hProcess, hDup;
 
     hProcess = create_target_process("sleep");
     ok(hProcess != NULL, "Can't start process\n");
@@ -103,6 +103,37 @@ static void test_VirtualAllocEx(void)
     ok(b && (bytes_read == alloc_size), "%Iu bytes read\n", bytes_read);
     ok(!memcmp(src, dst, alloc_size), "Data from remote process differs\n");
 
+    /* unaligned transfers crossing page boundaries */
+
+    memset( dst, 0, alloc_size );
+    b = WriteProcessMemory(hProcess, (char *)addr1 + 0xffd, src + 3, 0x2005, &bytes_written);
+    ok(b && (bytes_written == 0x2005), "%Iu bytes written\n", bytes_written);
+    b = ReadProcessMemory(hProcess, (char *)addr1 + 0xffd, dst + 5, 0x2005, &bytes_read);
+    ok(b && (bytes_read == 0x2005), "%Iu bytes read\n", bytes_read);
+    ok(!memcmp(src + 3, dst + 5, 0x2005), "Data from remote process differs\n");
+
+    /* the current process goes through the same path */
+
+    memset( dst, 0, alloc_size );
+    b = ReadProcessMemory(GetCurrentProcess(), src + 1, dst, alloc_size - 1, &bytes_read);
+    ok(b && (bytes_read == alloc_size - 1), "%Iu bytes read\n", bytes_read);
+    ok(!memcmp(src + 1, dst, alloc_size - 1), "Data from current process differs\n");
+
+    /* handle without write access */
+
+    b = DuplicateHandle( GetCurrentProcess(), hProcess, GetCurrentProcess(), &hDup,
+                         PROCESS_VM_READ, FALSE, 0 );
+    ok( b, "DuplicateHandle failed error %lu\n", GetLastError() );
+    SetLastError(0xdeadbeef);
+    bytes_written = 0xdeadbeef;
+    b = WriteProcessMemory(hDup, addr1, src, alloc_size, &bytes_written);
+    ok( !b, "WriteProcessMemory succeeded\n" );
+    ok( GetLastError() == ERROR_ACCESS_DENIED, "wrong error %lu\n", GetLastError() );
+    ok( bytes_written == 0, "%Iu bytes written\n", bytes_written );
+    b = ReadProcessMemory(hDup, addr1, dst, alloc_size, &bytes_read);
+    ok(b && (bytes_read == alloc_size), "%Iu bytes read\n", bytes_read);
+    CloseHandle( hDup );
+
     /* test invalid source buffers */
 
     b = VirtualProtect( src + 0x2000, 0x2000, PAGE_NOACCESS, &old_prot );
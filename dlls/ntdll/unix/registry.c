@@ -26,12 +26,14 @@
 #endif
 
 #include <stdarg.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
 #include "winternl.h"
 #include "unix_private.h"
+#include "wine/list.h"
 #include "wine/debug.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(reg);
@@ -451,6 +453,194 @@ NTSTATUS WINAPI NtEnumerateValueKey( HANDLE handle, ULONG index, KEY_VALUE_INFOR
 }
 
 
+/* values of the machine hive are cached until the server increments the generation counter of their key */
+struct cached_value
+{
+    struct list  entry;        /* entry in hash bucket */
+    struct list  lru_entry;    /* entry in least recently used list */
+    HANDLE       handle;       /* key handle used to retrieve the value */
+    unsigned int slot;         /* index of the key generation counter */
+    unsigned int generation;   /* generation when the value was retrieved */
+    unsigned int closes;       /* remote handle close counter when the value was retrieved */
+    int          type;         /* value type, or -1 if the value doesn't exist */
+    unsigned int name_len;     /* length of value name in bytes */
+    unsigned int data_len;     /* length of value data */
+    WCHAR       *name;         /* value name */
+    BYTE        *data;         /* value data */
+};
+
+#define VALUE_CACHE_HASH_SIZE 256
+#define VALUE_CACHE_MAX_ENTRIES 1024
+#define VALUE_CACHE_MAX_DATA 1024
+
+static pthread_mutex_t value_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct list value_cache[VALUE_CACHE_HASH_SIZE];
+static struct list value_cache_lru = LIST_INIT( value_cache_lru );
+static unsigned int value_cache_count;
+static unsigned int value_cache_close_count;  /* incremented when a handle is closed */
+static BOOL value_cache_init;
+static const volatile unsigned int *registry_cache_generations;
+static BOOL registry_cache_mapped;
+
+static unsigned int value_cache_hash( HANDLE handle, const WCHAR *name, unsigned int len )
+{
+    unsigned int i, hash = (ULONG_PTR)handle >> 2;
+
+    for (i = 0; i < len / sizeof(WCHAR); i++) hash = hash * 65599 + towlower( name[i] );
+    return hash % VALUE_CACHE_HASH_SIZE;
+}
+
+/* map the generation counters of the registry cache */
+static void map_registry_cache(void)
+{
+    static const WCHAR nameW[] = {'\\','K','e','r','n','e','l','O','b','j','e','c','t','s',
+                                  '\\','_','_','w','i','n','e','_','r','e','g','i','s','t','r','y','_','c','a','c','h','e',0};
+    UNICODE_STRING name_str = { sizeof(nameW) - sizeof(WCHAR), sizeof(nameW), (WCHAR *)nameW };
+    OBJECT_ATTRIBUTES attr = { sizeof(attr), 0, &name_str };
+    HANDLE section;
+    SIZE_T size;
+    void *ptr;
+
+    if (!NtOpenSection( &section, SECTION_MAP_READ, &attr ))
+    {
+        if (!map_section( section, &ptr, &size, PAGE_READONLY ))
+        {
+            if (size < REGISTRY_CACHE_SLOTS * sizeof(unsigned int) ||
+                InterlockedCompareExchangePointer( (void **)&registry_cache_generations, ptr, NULL ))
+                NtUnmapViewOfSection( NtCurrentProcess(), ptr );
+        }
+        NtClose( section );
+    }
+    registry_cache_mapped = TRUE;
+}
+
+static BOOL value_name_equal( const WCHAR *name1, const WCHAR *name2, unsigned int len )
+{
+    unsigned int i;
+
+    for (i = 0; i < len / sizeof(WCHAR); i++)
+        if (towlower( name1[i] ) != towlower( name2[i] )) return FALSE;
+    return TRUE;
+}
+
+static void free_cached_value( struct cached_value *value )
+{
+    list_remove( &value->entry );
+    list_remove( &value->lru_entry );
+    value_cache_count--;
+    free( value );
+}
+
+/* retrieve a value from the cache if its key hasn't been modified since */
+/* returns the close counts to use for caching the server reply if not found */
+static BOOL get_cached_value( HANDLE handle, const UNICODE_STRING *name, void *data, DWORD length,
+                              int *type, DWORD *total, NTSTATUS *status, unsigned int *close_count,
+                              unsigned int *closes )
+{
+    struct cached_value *value;
+    unsigned int hash;
+    BOOL ret = FALSE;
+
+    if (!registry_cache_mapped) map_registry_cache();
+
+    mutex_lock( &value_cache_mutex );
+    *close_count = value_cache_close_count;
+    *closes = 0;
+    if (!registry_cache_generations) goto done;
+    /* read before the server request, so that a handle closed remotely during the request is detected */
+    *closes = registry_cache_generations[REGISTRY_CACHE_CLOSE_SLOT];
+    if (!value_cache_count) goto done;
+
+    hash = value_cache_hash( handle, name->Buffer, name->Length );
+    LIST_FOR_EACH_ENTRY( value, &value_cache[hash], struct cached_value, entry )
+    {
+        if (value->handle != handle || value->name_len != name->Length) continue;
+        if (!value_name_equal( value->name, name->Buffer, name->Length )) continue;
+        if (value->generation != registry_cache_generations[value->slot] || value->closes != *closes)
+        {
+            free_cached_value( value );
+            break;
+        }
+        if (value->type == -1) *status = STATUS_OBJECT_NAME_NOT_FOUND;
+        else
+        {
+            *type = value->type;
+            *total = value->data_len;
+            if (data) memcpy( data, value->data, min( length, value->data_len ));
+            *status = STATUS_SUCCESS;
+        }
+        list_remove( &value->lru_entry );
+        list_add_head( &value_cache_lru, &value->lru_entry );
+        ret = TRUE;
+        break;
+    }
+done:
+    mutex_unlock( &value_cache_mutex );
+    return ret;
+}
+
+/* add a value retrieved from the server to the cache */
+static void cache_value( HANDLE handle, const UNICODE_STRING *name, unsigned int slot, unsigned int generation,
+                         int type, const void *data, DWORD len, unsigned int close_count, unsigned int closes )
+{
+    struct cached_value *value;
+    unsigned int hash;
+
+    if (slot == REGISTRY_CACHE_CLOSE_SLOT || slot >= REGISTRY_CACHE_SLOTS || len > VALUE_CACHE_MAX_DATA) return;
+    if (!(value = malloc( sizeof(*value) + name->Length + len ))) return;
+    value->handle     = handle;
+    value->slot       = slot;
+    value->generation = generation;
+    value->closes     = closes;
+    value->type       = type;
+    value->name_len   = name->Length;
+    value->data_len   = len;
+    value->name       = (WCHAR *)(value + 1);
+    value->data       = (BYTE *)value->name + name->Length;
+    memcpy( value->name, name->Buffer, name->Length );
+    if (len) memcpy( value->data, data, len );
+
+    mutex_lock( &value_cache_mutex );
+    /* don't add it if the handle may have been closed in the meantime */
+    if (registry_cache_generations && close_count == value_cache_close_count)
+    {
+        if (!value_cache_init)
+        {
+            for (hash = 0; hash < VALUE_CACHE_HASH_SIZE; hash++) list_init( &value_cache[hash] );
+            value_cache_init = TRUE;
+        }
+        if (value_cache_count == VALUE_CACHE_MAX_ENTRIES)
+            free_cached_value( LIST_ENTRY( list_tail( &value_cache_lru ), struct cached_value, lru_entry ));
+        hash = value_cache_hash( handle, name->Buffer, name->Length );
+        list_add_head( &value_cache[hash], &value->entry );
+        list_add_head( &value_cache_lru, &value->lru_entry );
+        value_cache_count++;
+        value = NULL;
+    }
+    mutex_unlock( &value_cache_mutex );
+    free( value );
+}
+
+/***********************************************************************
+ *           invalidate_registry_cache
+ *
+ * Remove the cached values of a handle that is being closed.
+ */
+void invalidate_registry_cache( HANDLE handle )
+{
+    struct cached_value *value, *next;
+
+    mutex_lock( &value_cache_mutex );
+    value_cache_close_count++;
+    if (value_cache_count)
+    {
+        LIST_FOR_EACH_ENTRY_SAFE( value, next, &value_cache_lru, struct cached_value, lru_entry )
+            if (value->handle == handle) free_cached_value( value );
+    }
+    mutex_unlock( &value_cache_mutex );
+}
+
+
 /******************************************************************************
  *              NtQueryValueKey  (NTDLL.@)
  */
@@ -460,7 +650,9 @@ NTSTATUS WINAPI NtQueryValueKey( HANDLE handle, const UNICODE_STRING *name,
 {
     NTSTATUS ret;
     UCHAR *data_ptr;
-    unsigned int fixed_size, min_size;
+    unsigned int fixed_size, min_size, close_count, closes;
+    DWORD data_size, total = 0;
+    int type = 0;
 
     TRACE( "(%p,%s,%d,%p,%d)\n", handle, debugstr_us(name), info_class, info, length );
 
@@ -501,21 +693,38 @@ NTSTATUS WINAPI NtQueryValueKey( HANDLE handle, const UNICODE_STRING *name,
         return STATUS_INVALID_PARAMETER;
     }
 
-    SERVER_START_REQ( get_key_value )
+    data_size = (length > fixed_size && data_ptr) ? length - fixed_size : 0;
+
+    if (!get_cached_value( handle, name, data_ptr, data_size, &type, &total, &ret, &close_count, &closes ))
     {
-        req->hkey = wine_server_obj_handle( handle );
-        wine_server_add_data( req, name->Buffer, name->Length );
-        if (length > fixed_size && data_ptr) wine_server_set_reply( req, data_ptr, length - fixed_size );
-        if (!(ret = wine_server_call( req )))
+        SERVER_START_REQ( get_key_value )
         {
-            copy_key_value_info( info_class, info, length, reply->type,
-                                 name->Length, reply->total );
-            *result_len = fixed_size + (info_class == KeyValueBasicInformation ? 0 : reply->total);
-            if (length < min_size) ret = STATUS_BUFFER_TOO_SMALL;
-            else if (length < *result_len) ret = STATUS_BUFFER_OVERFLOW;
+            req->hkey = wine_server_obj_handle( handle );
+            wine_server_add_data( req, name->Buffer, name->Length );
+            if (data_size) wine_server_set_reply( req, data_ptr, data_size );
+            ret = wine_server_call( req );
+            type  = reply->type;
+            total = reply->total;
+            if (reply->cache_slot != -1)
+            {
+                if (ret == STATUS_OBJECT_NAME_NOT_FOUND)
+                    cache_value( handle, name, reply->cache_slot, reply->generation, -1, NULL, 0,
+                                 close_count, closes );
+                else if (!ret && wine_server_reply_size( reply ) == total)
+                    cache_value( handle, name, reply->cache_slot, reply->generation, type,
+                                 data_ptr, total, close_count, closes );
+            }
         }
+        SERVER_END_REQ;
+    }
+
+    if (!ret)
+    {
+        copy_key_value_info( info_class, info, length, type, name->Length, total );
+        *result_len = fixed_size + (info_class == KeyValueBasicInformation ? 0 : total);
+        if (length < min_size) ret = STATUS_BUFFER_TOO_SMALL;
+        else if (length < *result_len) ret = STATUS_BUFFER_OVERFLOW;
     }
-    SERVER_END_REQ;
     return ret;
 }
 
@@ -1651,7 +1651,10 @@ NTSTATUS WINAPI NtDuplicateObject( HANDLE source_process, HANDLE source, HANDLE
     /* always remove the cached fd; if the server request fails we'll just
      * retrieve it again */
     if (options & DUPLICATE_CLOSE_SOURCE)
+    {
         fd = remove_fd_from_cache( source );
+        invalidate_registry_cache( source );
+    }
 
     SERVER_START_REQ( dup_handle )
     {
@@ -1709,6 +1712,7 @@ NTSTATUS WINAPI NtClose( HANDLE handle )
     /* always remove the cached fd; if the server request fails we'll just
      * retrieve it again */
     fd = remove_fd_from_cache( handle );
+    invalidate_registry_cache( handle );
 
     SERVER_START_REQ( close_handle )
     {
@@ -51,11 +51,18 @@
 #ifdef HAVE_SYS_USER_H
 # include <sys/user.h>
 #endif
+#ifdef HAVE_SYS_UIO_H
+# include <sys/uio.h>
+#endif
 #ifdef HAVE_LIBPROCSTAT_H
 # include <libprocstat.h>
 #endif
 #include <unistd.h>
 #include <dlfcn.h>
+#include <poll.h>
+#ifdef HAVE_SYS_SYSCALL_H
+# include <sys/syscall.h>
+#endif
 #ifdef HAVE_VALGRIND_VALGRIND_H
 # include <valgrind/valgrind.h>
 #endif
@@ -4809,6 +4816,81 @@ NTSTATUS WINAPI NtResetWriteWatch( HANDLE process, PVOID base, SIZE_T size )
 }
 
 
+#if defined(HAVE_PROCESS_VM_READV) && defined(__NR_pidfd_open)
+
+/***********************************************************************
+ *           get_process_vm_pid
+ *
+ * Retrieve the Unix pid to use for direct access to a process address space.
+ */
+static pid_t get_process_vm_pid( HANDLE process )
+{
+    pid_t pid = -1;
+
+    SERVER_START_REQ( get_process_vm_pid )
+    {
+        req->handle = wine_server_obj_handle( process );
+        if (!wine_server_call( req )) pid = reply->unix_pid;
+    }
+    SERVER_END_REQ;
+    return pid;
+}
+
+
+/***********************************************************************
+ *           read_process_memory_direct
+ *
+ * Read another process memory without going through the server ptrace path.
+ * Returns FALSE if the whole range couldn't be read, in which case the caller
+ * falls back to the server to get the proper error.
+ *
+ * The pid is pinned with a pidfd that is opened before the server confirms
+ * the pid again, so that it can't refer to a process that reused the pid of
+ * an exited one. The data is only returned if the process was still alive
+ * once the copy is done.
+ */
+static BOOL read_process_memory_direct( HANDLE process, const void *addr, void *buffer, SIZE_T size )
+{
+    struct iovec local, remote;
+    struct pollfd pfd;
+    BOOL ret = FALSE;
+    pid_t pid;
+    int pidfd;
+
+    local.iov_base = buffer;
+    local.iov_len = size;
+    remote.iov_base = (void *)addr;
+    remote.iov_len = size;
+
+    if (process == NtCurrentProcess())
+        return process_vm_readv( getpid(), &local, 1, &remote, 1, 0 ) == size;
+
+    if ((pid = get_process_vm_pid( process )) == -1) return FALSE;
+    if ((pidfd = syscall( __NR_pidfd_open, pid, 0 )) == -1) return FALSE;
+    if (get_process_vm_pid( process ) != pid) goto done;
+    if (process_vm_readv( pid, &local, 1, &remote, 1, 0 ) != size) goto done;
+
+    /* a pidfd becomes readable once the process has exited */
+    pfd.fd = pidfd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    ret = !poll( &pfd, 1, 0 );
+
+done:
+    close( pidfd );
+    return ret;
+}
+
+#else  /* HAVE_PROCESS_VM_READV && __NR_pidfd_open */
+
+static BOOL read_process_memory_direct( HANDLE process, const void *addr, void *buffer, SIZE_T size )
+{
+    return FALSE;
+}
+
+#endif  /* HAVE_PROCESS_VM_READV && __NR_pidfd_open */
+
+
 /***********************************************************************
  *             NtReadVirtualMemory   (NTDLL.@)
  *             ZwReadVirtualMemory   (NTDLL.@)
@@ -4820,6 +4902,11 @@ NTSTATUS WINAPI NtReadVirtualMemory( HANDLE process, const void *addr, void *buf
 
     if (virtual_check_buffer_for_write( buffer, size ))
     {
+        if (size && read_process_memory_direct( process, addr, buffer, size ))
+        {
+            if (bytes_read) *bytes_read = size;
+            return STATUS_SUCCESS;
+        }
         SERVER_START_REQ( read_process_memory )
         {
             req->handle = wine_server_obj_handle( process );
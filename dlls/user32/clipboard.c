@@ -622,7 +622,7 @@ static HANDLE render_synthesized_format( UINT format, UINT from )
  */
 UINT WINAPI RegisterClipboardFormatW( LPCWSTR name )
 {
-    return GlobalAddAtomW( name );
+    return register_user_atom( name );
 }
 
 
@@ -631,7 +631,7 @@ UINT WINAPI RegisterClipboardFormatW( LPCWSTR name )
  */
 UINT WINAPI RegisterClipboardFormatA( LPCSTR name )
 {
-    return GlobalAddAtomA( name );
+    return register_user_atom_a( name );
 }
 
 
@@ -43,6 +43,7 @@
 #include "controls.h"
 #include "wine/debug.h"
 #include "wine/exception.h"
+#include "wine/rbtree.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(msg);
 WINE_DECLARE_DEBUG_CHANNEL(key);
@@ -2192,13 +2193,95 @@ DWORD WINAPI WaitForInputIdle( HANDLE process, DWORD timeout )
 }
 
 
+/* registered message and clipboard format atoms are pinned, so they can be cached */
+struct user_atom
+{
+    struct wine_rb_entry entry;
+    UINT                 atom;
+    WCHAR                name[1];
+};
+
+static int user_atom_compare( const void *key, const struct wine_rb_entry *entry )
+{
+    const struct user_atom *atom = WINE_RB_ENTRY_VALUE( entry, struct user_atom, entry );
+    return wcsicmp( key, atom->name );
+}
+
+static struct wine_rb_tree user_atoms = { user_atom_compare };
+
+static CRITICAL_SECTION user_atom_cs;
+static CRITICAL_SECTION_DEBUG user_atom_cs_debug =
+{
+    0, 0, &user_atom_cs,
+    { &user_atom_cs_debug.ProcessLocksList, &user_atom_cs_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": user_atom_cs") }
+};
+static CRITICAL_SECTION user_atom_cs = { &user_atom_cs_debug, -1, 0, 0, 0, 0 };
+
+/***********************************************************************
+ *		register_user_atom
+ *
+ * Register a message or clipboard format name. The atom is pinned in the
+ * global table, so that further registrations don't need the server.
+ */
+UINT register_user_atom( const WCHAR *name )
+{
+    struct wine_rb_entry *entry;
+    struct user_atom *atom;
+    UINT ret = 0;
+    size_t len;
+
+    /* integral atoms and invalid names are handled by kernel32 */
+    if (IS_INTRESOURCE(name) || !name[0] || name[0] == '#' || (len = lstrlenW( name )) > MAX_ATOM_LEN)
+        return GlobalAddAtomW( name );
+
+    EnterCriticalSection( &user_atom_cs );
+    if ((entry = wine_rb_get( &user_atoms, name )))
+        ret = WINE_RB_ENTRY_VALUE( entry, struct user_atom, entry )->atom;
+    LeaveCriticalSection( &user_atom_cs );
+    if (ret) return ret;
+
+    SERVER_START_REQ( add_atom )
+    {
+        req->pin = 1;
+        wine_server_add_data( req, name, len * sizeof(WCHAR) );
+        if (!wine_server_call_err( req )) ret = reply->atom;
+    }
+    SERVER_END_REQ;
+    if (!ret) return 0;
+
+    if ((atom = HeapAlloc( GetProcessHeap(), 0, FIELD_OFFSET( struct user_atom, name[len + 1] ))))
+    {
+        atom->atom = ret;
+        memcpy( atom->name, name, (len + 1) * sizeof(WCHAR) );
+        EnterCriticalSection( &user_atom_cs );
+        if (wine_rb_put( &user_atoms, atom->name, &atom->entry ))
+            HeapFree( GetProcessHeap(), 0, atom );  /* added by another thread */
+        LeaveCriticalSection( &user_atom_cs );
+    }
+    return ret;
+}
+
+/***********************************************************************
+ *		register_user_atom_a
+ */
+UINT register_user_atom_a( const char *name )
+{
+    WCHAR buffer[MAX_ATOM_LEN + 1];
+
+    if (IS_INTRESOURCE(name) || !MultiByteToWideChar( CP_ACP, 0, name, -1, buffer, ARRAY_SIZE(buffer) ))
+        return GlobalAddAtomA( name );
+    return register_user_atom( buffer );
+}
+
+
 /***********************************************************************
  *		RegisterWindowMessageA (USER32.@)
  *		RegisterWindowMessage (USER.118)
  */
 UINT WINAPI RegisterWindowMessageA( LPCSTR str )
 {
-    UINT ret = GlobalAddAtomA(str);
+    UINT ret = register_user_atom_a( str );
     TRACE("%s, ret=%x\n", str, ret);
     return ret;
 }
@@ -2209,7 +2292,7 @@ UINT WINAPI RegisterWindowMessageA( LPCSTR str )
  */
 UINT WINAPI RegisterWindowMessageW( LPCWSTR str )
 {
-    UINT ret = GlobalAddAtomW(str);
+    UINT ret = register_user_atom( str );
     TRACE("%s ret=%x\n", debugstr_w(str), ret);
     return ret;
 }
@@ -1596,6 +1596,84 @@ static void test_class_name(void)
     UnregisterClassW(class_name, hinst);
 }
 
+static void test_many_classes(void)
+{
+    HINSTANCE hinst = GetModuleHandleA(0);
+    ATOM atoms[200], atom, new_atom;
+    WNDCLASSA cls;
+    char name[32];
+    unsigned int i;
+    HWND hwnd, hwnd2;
+    BOOL ret;
+
+    for (i = 0; i < ARRAY_SIZE(atoms); i++)
+    {
+        memset(&cls, 0, sizeof(cls));
+        cls.lpfnWndProc   = ClassTest_WndProc;
+        cls.hInstance     = hinst;
+        cls.cbWndExtra    = i % 40;
+        sprintf(name, "WineManyClass%u", i);
+        cls.lpszClassName = name;
+        atoms[i] = RegisterClassA(&cls);
+        ok(atoms[i] != 0, "%u: RegisterClassA failed, error %lu\n", i, GetLastError());
+    }
+
+    for (i = 0; i < ARRAY_SIZE(atoms); i++)
+    {
+        sprintf(name, "WINEMANYCLASS%u", i);
+        ret = GetClassInfoA(hinst, name, &cls);
+        ok(ret, "%u: GetClassInfoA failed\n", i);
+        ok(cls.cbWndExtra == i % 40, "%u: got cbWndExtra %d\n", i, cls.cbWndExtra);
+        ret = GetClassInfoA(hinst, (const char *)MAKEINTATOM(atoms[i]), &cls);
+        ok(ret, "%u: GetClassInfoA failed\n", i);
+        ok(cls.cbWndExtra == i % 40, "%u: got cbWndExtra %d\n", i, cls.cbWndExtra);
+    }
+
+    hwnd = CreateWindowA("winemanyclass123", NULL, WS_OVERLAPPED, 0, 0, 0, 0, NULL, NULL, hinst, 0);
+    ok(hwnd != NULL, "CreateWindowA failed, error %lu\n", GetLastError());
+    ok(GetClassLongA(hwnd, GCW_ATOM) == atoms[123], "got atom %04lx\n", GetClassLongA(hwnd, GCW_ATOM));
+    DestroyWindow(hwnd);
+
+    /* the class is found under its new atom and name once the atom is changed */
+    new_atom = RegisterWindowMessageA("WineRenamedClass");
+    ok(new_atom != 0, "RegisterWindowMessageA failed\n");
+    hwnd = CreateWindowA("WineManyClass7", NULL, WS_OVERLAPPED, 0, 0, 0, 0, NULL, NULL, hinst, 0);
+    ok(hwnd != NULL, "CreateWindowA failed, error %lu\n", GetLastError());
+    atom = SetClassWord(hwnd, GCW_ATOM, new_atom);
+    ok(atom == atoms[7], "got atom %04x\n", atom);
+    ok(GetClassWord(hwnd, GCW_ATOM) == new_atom, "got atom %04x\n", GetClassWord(hwnd, GCW_ATOM));
+    ret = GetClassInfoA(hinst, (const char *)MAKEINTATOM(new_atom), &cls);
+    ok(ret, "GetClassInfoA failed\n");
+    ok(cls.cbWndExtra == 7, "got cbWndExtra %d\n", cls.cbWndExtra);
+    ret = GetClassInfoA(hinst, "WineRenamedClass", &cls);
+    ok(ret, "GetClassInfoA failed\n");
+    ok(cls.cbWndExtra == 7, "got cbWndExtra %d\n", cls.cbWndExtra);
+    ret = GetClassInfoA(hinst, "WineManyClass7", &cls);
+    ok(!ret, "GetClassInfoA succeeded\n");
+    hwnd2 = CreateWindowA("WineRenamedClass", NULL, WS_OVERLAPPED, 0, 0, 0, 0, NULL, NULL, hinst, 0);
+    ok(hwnd2 != NULL, "CreateWindowA failed, error %lu\n", GetLastError());
+    ok(GetClassWord(hwnd2, GCW_ATOM) == new_atom, "got atom %04x\n", GetClassWord(hwnd2, GCW_ATOM));
+    DestroyWindow(hwnd2);
+    atom = SetClassWord(hwnd, GCW_ATOM, atoms[7]);
+    ok(atom == new_atom, "got atom %04x\n", atom);
+    ret = GetClassInfoA(hinst, "WineManyClass7", &cls);
+    ok(ret, "GetClassInfoA failed\n");
+    DestroyWindow(hwnd);
+
+    for (i = 0; i < ARRAY_SIZE(atoms); i += 2)
+    {
+        sprintf(name, "WineManyClass%u", i);
+        ok(UnregisterClassA(name, hinst), "%u: UnregisterClassA failed\n", i);
+    }
+    for (i = 0; i < ARRAY_SIZE(atoms); i++)
+    {
+        sprintf(name, "WineManyClass%u", i);
+        ret = GetClassInfoA(hinst, name, &cls);
+        ok(!ret == !(i & 1), "%u: GetClassInfoA returned %d\n", i, ret);
+        if (i & 1) ok(UnregisterClassA(name, hinst), "%u: UnregisterClassA failed\n", i);
+    }
+}
+
 START_TEST(class)
 {
     char **argv;
@@ -1630,6 +1708,7 @@ START_TEST(class)
     test_comctl32_classes();
     test_actctx_classes();
     test_class_name();
+    test_many_classes();
 
     /* this test unregisters the Button class so it should be executed at the end */
     test_instances();
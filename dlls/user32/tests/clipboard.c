@@ -537,6 +537,19 @@ static void test_RegisterClipboardFormatA(void)
 
     format_id = RegisterClipboardFormatA("#1234");
     ok(format_id == 1234, "invalid clipboard format id %04x\n", format_id);
+
+    /* registered formats stay valid until the session ends */
+    format_id = RegisterClipboardFormatA("my_pinned_clipboard_format");
+    ok(format_id > 0xc000 && format_id < 0xffff, "invalid clipboard format id %04x\n", format_id);
+    GlobalDeleteAtom(format_id);
+    GlobalDeleteAtom(format_id);
+    format_id2 = RegisterClipboardFormatA("MY_PINNED_CLIPBOARD_FORMAT");
+    ok(format_id2 == format_id, "got %04x, expected %04x\n", format_id2, format_id);
+    len = GetClipboardFormatNameA(format_id, buf, ARRAY_SIZE(buf));
+    ok(len == lstrlenA("my_pinned_clipboard_format"), "wrong format name length %d\n", len);
+    ok(!lstrcmpA(buf, "my_pinned_clipboard_format"), "wrong format name \"%s\"\n", buf);
+    format_id2 = RegisterWindowMessageA("my_pinned_clipboard_format");
+    ok(format_id2 == format_id, "got %04x, expected %04x\n", format_id2, format_id);
 }
 
 static HGLOBAL create_textA(void)
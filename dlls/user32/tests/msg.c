@@ -12832,6 +12832,70 @@ done:
     flush_events();
 }
 
+static DWORD WINAPI polling_thread_proc( void *arg )
+{
+    HWND hwnd = arg;
+
+    Sleep( 50 );
+    PostMessageA( hwnd, WM_USER + 1, 0, 0 );
+    Sleep( 50 );
+    return SendMessageA( hwnd, WM_USER + 2, 0, 0 );
+}
+
+static LRESULT WINAPI polling_wnd_proc( HWND hwnd, UINT message, WPARAM wparam, LPARAM lparam )
+{
+    if (message == WM_USER + 2) return 0x1234;
+    return DefWindowProcA( hwnd, message, wparam, lparam );
+}
+
+static void test_PeekMessage_polling(void)
+{
+    DWORD start, status, code;
+    HANDLE thread;
+    HWND hwnd;
+    BOOL ret;
+    MSG msg;
+
+    hwnd = CreateWindowA( "static", "polling", WS_POPUP, 0, 0, 10, 10, 0, 0, 0, NULL );
+    ok( hwnd != NULL, "CreateWindow failed\n" );
+    SetWindowLongPtrA( hwnd, GWLP_WNDPROC, (LONG_PTR)polling_wnd_proc );
+    flush_events();
+
+    /* a tight polling loop must see messages posted by other threads */
+    thread = CreateThread( NULL, 0, polling_thread_proc, hwnd, 0, NULL );
+    start = GetTickCount();
+    while (!(ret = PeekMessageA( &msg, 0, 0, 0, PM_REMOVE )) && GetTickCount() - start < 5000);
+    ok( ret, "PeekMessage didn't return a message\n" );
+    ok( msg.message == WM_USER + 1, "got message %04x\n", msg.message );
+    status = GetQueueStatus( QS_POSTMESSAGE );
+    ok( !LOWORD(status), "got queue status %08lx\n", status );
+
+    /* and process messages sent while polling */
+    start = GetTickCount();
+    while (WaitForSingleObject( thread, 0 ) == WAIT_TIMEOUT && GetTickCount() - start < 5000)
+    {
+        ret = PeekMessageA( &msg, 0, 0, 0, PM_REMOVE );
+        if (ret) DispatchMessageA( &msg );
+    }
+    ok( !WaitForSingleObject( thread, 0 ), "sent message not processed\n" );
+    GetExitCodeThread( thread, &code );
+    ok( code == 0x1234, "got exit code %lx\n", code );
+    CloseHandle( thread );
+
+    /* the changed bits are reported until the queue is checked again */
+    PostMessageA( hwnd, WM_USER + 1, 0, 0 );
+    status = GetQueueStatus( QS_POSTMESSAGE );
+    ok( status == MAKELONG( QS_POSTMESSAGE, QS_POSTMESSAGE ), "got queue status %08lx\n", status );
+    ret = PeekMessageA( &msg, 0, WM_TIMER, WM_TIMER, PM_REMOVE );
+    ok( !ret, "PeekMessage returned message %04x\n", msg.message );
+    ret = PeekMessageA( &msg, 0, 0, 0, PM_REMOVE );
+    ok( ret && msg.message == WM_USER + 1, "PeekMessage returned %d message %04x\n", ret, msg.message );
+    ret = PeekMessageA( &msg, 0, 0, 0, PM_REMOVE );
+    ok( !ret, "PeekMessage returned message %04x\n", msg.message );
+
+    DestroyWindow( hwnd );
+}
+
 static void test_PeekMessage3(void)
 {
     HWND hwnd;
@@ -17120,6 +17184,81 @@ static const struct message WmSetParentSeq_2[] = {
 };
 
 
+/* EndDeferWindowPos sends all the WM_WINDOWPOSCHANGING messages before moving the windows */
+static const struct message WmDeferWindowPosSeq[] = {
+    { WM_WINDOWPOSCHANGING, sent|wparam, SWP_NOACTIVATE|SWP_NOSIZE },
+    { WM_WINDOWPOSCHANGING, sent|wparam, SWP_NOACTIVATE|SWP_NOSIZE },
+    { WM_NCPAINT, sent|optional },
+    { WM_ERASEBKGND, sent|optional },
+    { WM_WINDOWPOSCHANGED, sent|wparam, SWP_NOACTIVATE|SWP_NOSIZE|SWP_NOCLIENTSIZE },
+    { WM_MOVE, sent|defwinproc|wparam, 0 },
+    { EVENT_OBJECT_LOCATIONCHANGE, winevent_hook|wparam|lparam|optional, 0, 0 },
+    { WM_WINDOWPOSCHANGED, sent|wparam, SWP_NOACTIVATE|SWP_NOSIZE|SWP_NOCLIENTSIZE },
+    { WM_MOVE, sent|defwinproc|wparam, 0 },
+    { EVENT_OBJECT_LOCATIONCHANGE, winevent_hook|wparam|lparam|optional, 0, 0 },
+    { 0 }
+};
+
+static void test_DeferWindowPos(void)
+{
+    HWND parent, child1, child2;
+    HDWP hdwp;
+    BOOL ret;
+
+    parent = CreateWindowExA(0, "TestParentClass", "Test parent", WS_OVERLAPPEDWINDOW | WS_VISIBLE,
+                             100, 100, 200, 200, 0, 0, 0, NULL);
+    ok(parent != 0, "Failed to create parent window\n");
+    child1 = CreateWindowExA(0, "TestWindowClass", "Test child 1", WS_CHILD | WS_VISIBLE,
+                             0, 0, 50, 50, parent, (HMENU)1, 0, NULL);
+    ok(child1 != 0, "Failed to create child window\n");
+    child2 = CreateWindowExA(0, "TestWindowClass", "Test child 2", WS_CHILD | WS_VISIBLE,
+                             60, 0, 50, 50, parent, (HMENU)2, 0, NULL);
+    ok(child2 != 0, "Failed to create child window\n");
+    flush_events();
+    flush_sequence();
+
+    hdwp = BeginDeferWindowPos(2);
+    ok(hdwp != NULL, "BeginDeferWindowPos failed\n");
+    hdwp = DeferWindowPos(hdwp, child1, 0, 10, 10, 0, 0, SWP_NOSIZE | SWP_NOZORDER | SWP_NOACTIVATE);
+    ok(hdwp != NULL, "DeferWindowPos failed\n");
+    hdwp = DeferWindowPos(hdwp, child2, 0, 70, 10, 0, 0, SWP_NOSIZE | SWP_NOZORDER | SWP_NOACTIVATE);
+    ok(hdwp != NULL, "DeferWindowPos failed\n");
+    ret = EndDeferWindowPos(hdwp);
+    ok(ret, "EndDeferWindowPos failed\n");
+    ok_sequence(WmDeferWindowPosSeq, "EndDeferWindowPos", FALSE);
+
+    /* z-order changes are applied in order, each one seeing the result of the previous ones */
+    SetWindowPos(child1, HWND_TOP, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE | SWP_NOACTIVATE);
+    SetWindowPos(child2, HWND_TOP, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE | SWP_NOACTIVATE);
+    ok(GetWindow(parent, GW_CHILD) == child2, "wrong first child %p\n", GetWindow(parent, GW_CHILD));
+    ok(GetWindow(child2, GW_HWNDNEXT) == child1, "wrong next child %p\n", GetWindow(child2, GW_HWNDNEXT));
+
+    hdwp = BeginDeferWindowPos(2);
+    ok(hdwp != NULL, "BeginDeferWindowPos failed\n");
+    hdwp = DeferWindowPos(hdwp, child1, HWND_TOP, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE | SWP_NOACTIVATE);
+    ok(hdwp != NULL, "DeferWindowPos failed\n");
+    hdwp = DeferWindowPos(hdwp, child2, HWND_TOP, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE | SWP_NOACTIVATE);
+    ok(hdwp != NULL, "DeferWindowPos failed\n");
+    ret = EndDeferWindowPos(hdwp);
+    ok(ret, "EndDeferWindowPos failed\n");
+    ok(GetWindow(parent, GW_CHILD) == child2, "wrong first child %p\n", GetWindow(parent, GW_CHILD));
+    ok(GetWindow(child2, GW_HWNDNEXT) == child1, "wrong next child %p\n", GetWindow(child2, GW_HWNDNEXT));
+
+    hdwp = BeginDeferWindowPos(2);
+    ok(hdwp != NULL, "BeginDeferWindowPos failed\n");
+    hdwp = DeferWindowPos(hdwp, child2, HWND_BOTTOM, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE | SWP_NOACTIVATE);
+    ok(hdwp != NULL, "DeferWindowPos failed\n");
+    hdwp = DeferWindowPos(hdwp, child1, child2, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE | SWP_NOACTIVATE);
+    ok(hdwp != NULL, "DeferWindowPos failed\n");
+    ret = EndDeferWindowPos(hdwp);
+    ok(ret, "EndDeferWindowPos failed\n");
+    ok(GetWindow(parent, GW_CHILD) == child2, "wrong first child %p\n", GetWindow(parent, GW_CHILD));
+    ok(GetWindow(child2, GW_HWNDNEXT) == child1, "wrong next child %p\n", GetWindow(child2, GW_HWNDNEXT));
+
+    DestroyWindow(parent);
+    flush_sequence();
+}
+
 static void test_SetParent(void)
 {
     HWND parent1, parent2, child, popup;
@@ -18735,6 +18874,175 @@ static void test_button_style(void)
     }
 }
 
+static LRESULT WINAPI copydata_wnd_proc( HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam )
+{
+    if (msg == WM_COPYDATA)
+    {
+        const COPYDATASTRUCT *cds = (const COPYDATASTRUCT *)lparam;
+        unsigned char *data = cds->lpData;
+        DWORD i;
+
+        ok( cds->dwData == 0xdead0000 + cds->cbData, "got dwData %#Ix\n", cds->dwData );
+        for (i = 0; i < cds->cbData; i++) if (data[i] != (unsigned char)(i * 7)) break;
+        ok( i == cds->cbData, "%lu: data mismatch at %lu\n", cds->cbData, i );
+        /* the receiver gets its own copy of the data, which it can modify */
+        for (i = 0; i < cds->cbData; i += 4096) data[i] = 0;
+        return cds->cbData;
+    }
+    return DefWindowProcA( hwnd, msg, wparam, lparam );
+}
+
+static void do_copydata_child( HWND hwnd )
+{
+    static const DWORD sizes[] = { 16, 64 * 1024 - 1, 64 * 1024, 4 * 1024 * 1024 };
+    COPYDATASTRUCT cds;
+    unsigned char *data;
+    unsigned int i, j;
+    LRESULT res;
+
+    data = HeapAlloc( GetProcessHeap(), 0, sizes[ARRAY_SIZE(sizes) - 1] );
+    for (j = 0; j < sizes[ARRAY_SIZE(sizes) - 1]; j++) data[j] = j * 7;
+
+    for (i = 0; i < ARRAY_SIZE(sizes); i++)
+    {
+        cds.dwData = 0xdead0000 + sizes[i];
+        cds.cbData = sizes[i];
+        cds.lpData = data;
+        res = SendMessageA( hwnd, WM_COPYDATA, 0, (LPARAM)&cds );
+        ok( res == sizes[i], "%lu: got %Id\n", sizes[i], res );
+    }
+    for (j = 0; j < sizes[ARRAY_SIZE(sizes) - 1]; j++)
+        if (data[j] != (unsigned char)(j * 7)) break;
+    ok( j == sizes[ARRAY_SIZE(sizes) - 1], "sender data modified at %u\n", j );
+    HeapFree( GetProcessHeap(), 0, data );
+}
+
+static void test_copydata_other_process( char *argv0 )
+{
+    char path[MAX_PATH + 64];
+    STARTUPINFOA startup = {sizeof(startup)};
+    PROCESS_INFORMATION pi;
+    WNDCLASSA cls = {0};
+    HWND hwnd;
+    MSG msg;
+    BOOL ret;
+
+    cls.lpfnWndProc = copydata_wnd_proc;
+    cls.hInstance = GetModuleHandleA( 0 );
+    cls.lpszClassName = "TestCopyDataClass";
+    RegisterClassA( &cls );
+
+    hwnd = CreateWindowA( "TestCopyDataClass", NULL, WS_OVERLAPPED, 0, 0, 10, 10, 0, 0, 0, NULL );
+    ok( hwnd != 0, "CreateWindowA failed, error %lu\n", GetLastError() );
+
+    sprintf( path, "%s msg copydata %p", argv0, hwnd );
+    ret = CreateProcessA( NULL, path, NULL, NULL, FALSE, 0, NULL, NULL, &startup, &pi );
+    ok( ret, "CreateProcess '%s' failed err %lu.\n", path, GetLastError() );
+    if (ret)
+    {
+        while (MsgWaitForMultipleObjects( 1, &pi.hProcess, FALSE, 5000, QS_ALLINPUT ) == WAIT_OBJECT_0 + 1)
+            while (PeekMessageA( &msg, 0, 0, 0, PM_REMOVE )) DispatchMessageA( &msg );
+        wait_child_process( pi.hProcess );
+        CloseHandle( pi.hProcess );
+        CloseHandle( pi.hThread );
+    }
+
+    DestroyWindow( hwnd );
+    UnregisterClassA( "TestCopyDataClass", GetModuleHandleA( 0 ) );
+}
+
+static LONG round_trip_callbacks;
+
+static LRESULT WINAPI round_trip_wnd_proc( HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam )
+{
+    switch (msg)
+    {
+    case WM_USER:
+        return wparam + 1;
+    case WM_USER + 1:
+        if (wparam) SetEvent( (HANDLE)lparam );
+        return 0;
+    case WM_DESTROY:
+        PostQuitMessage( 0 );
+        return 0;
+    }
+    return DefWindowProcA( hwnd, msg, wparam, lparam );
+}
+
+struct round_trip_thread_params
+{
+    HWND   hwnd;
+    HANDLE ready;
+};
+
+static DWORD CALLBACK round_trip_thread( void *arg )
+{
+    struct round_trip_thread_params *params = arg;
+    MSG msg;
+
+    params->hwnd = CreateWindowA( "TestRoundTripClass", NULL, WS_OVERLAPPED, 0, 0, 10, 10, 0, 0, 0, NULL );
+    ok( params->hwnd != 0, "CreateWindowA failed, error %lu\n", GetLastError() );
+    SetEvent( params->ready );
+    while (GetMessageA( &msg, 0, 0, 0 )) DispatchMessageA( &msg );
+    return 0;
+}
+
+static void CALLBACK round_trip_callback( HWND hwnd, UINT msg, ULONG_PTR data, LRESULT result )
+{
+    InterlockedIncrement( &round_trip_callbacks );
+}
+
+/* messages sent and posted to another thread all get processed */
+static void test_thread_round_trips(void)
+{
+    static const unsigned int count = 100;
+    WNDCLASSA cls = {0};
+    struct round_trip_thread_params params;
+    HANDLE thread, done;
+    unsigned int i;
+    LRESULT res;
+    MSG msg;
+
+    cls.lpfnWndProc = round_trip_wnd_proc;
+    cls.hInstance = GetModuleHandleA( 0 );
+    cls.lpszClassName = "TestRoundTripClass";
+    RegisterClassA( &cls );
+
+    params.hwnd = 0;
+    params.ready = CreateEventA( NULL, FALSE, FALSE, NULL );
+    done = CreateEventA( NULL, FALSE, FALSE, NULL );
+    thread = CreateThread( NULL, 0, round_trip_thread, &params, 0, NULL );
+    WaitForSingleObject( params.ready, 5000 );
+
+    for (i = 0; i < count; i++)
+    {
+        res = SendMessageA( params.hwnd, WM_USER, i, 0 );
+        if (res != i + 1) break;
+    }
+    ok( i == count, "%u: got %Id\n", i, res );
+
+    for (i = 0; i < count - 1; i++) PostMessageA( params.hwnd, WM_USER + 1, 0, 0 );
+    PostMessageA( params.hwnd, WM_USER + 1, 1, (LPARAM)done );
+    res = WaitForSingleObject( done, 5000 );
+    ok( res == WAIT_OBJECT_0, "messages not processed\n" );
+
+    for (i = 0; i < count; i++)
+        SendMessageCallbackA( params.hwnd, WM_USER, i, 0, round_trip_callback, 0 );
+    while (round_trip_callbacks < count)
+    {
+        if (MsgWaitForMultipleObjects( 0, NULL, FALSE, 5000, QS_SENDMESSAGE ) == WAIT_TIMEOUT) break;
+        while (PeekMessageA( &msg, 0, 0, 0, PM_REMOVE )) DispatchMessageA( &msg );
+    }
+    ok( round_trip_callbacks == count, "got %lu callbacks\n", round_trip_callbacks );
+
+    SendMessageA( params.hwnd, WM_CLOSE, 0, 0 );
+    WaitForSingleObject( thread, 5000 );
+    CloseHandle( thread );
+    CloseHandle( done );
+    CloseHandle( params.ready );
+    UnregisterClassA( "TestRoundTripClass", GetModuleHandleA( 0 ) );
+}
+
 START_TEST(msg)
 {
     char **test_argv;
@@ -18749,6 +19057,13 @@ START_TEST(msg)
     {
         unsigned int arg;
         /* Child process. */
+        if (!strcmp( test_argv[2], "copydata" ) && argc >= 4)
+        {
+            HWND hwnd;
+            sscanf( test_argv[3], "%p", &hwnd );
+            do_copydata_child( hwnd );
+            return;
+        }
         sscanf (test_argv[2], "%d", (unsigned int *) &arg);
         do_wait_idle_child( arg );
         return;
@@ -18793,13 +19108,17 @@ START_TEST(msg)
     test_InSendMessage();
     test_SetFocus();
     test_SetParent();
+    test_DeferWindowPos();
     test_PostMessage();
     test_broadcast();
     test_ShowWindow();
     test_PeekMessage();
     test_PeekMessage2();
     test_PeekMessage3();
+    test_PeekMessage_polling();
     test_WaitForInputIdle( test_argv[0] );
+    test_copydata_other_process( test_argv[0] );
+    test_thread_round_trips();
     test_scrollwindowex();
     test_messages();
     test_setwindowpos();
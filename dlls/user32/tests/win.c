@@ -10606,6 +10606,78 @@ static void test_update_region(void)
     DestroyWindow(parent);
 }
 
+static BOOL is_point_visible( HWND hwnd, int x, int y )
+{
+    HRGN hrgn = CreateRectRgn( 0, 0, 0, 0 );
+    POINT pt = { x, y };
+    BOOL ret;
+    HDC hdc;
+
+    hdc = GetDC( hwnd );
+    ok( GetRandomRgn( hdc, hrgn, SYSRGN ) != 0, "GetRandomRgn failed\n" );
+    ReleaseDC( hwnd, hdc );
+    ClientToScreen( hwnd, &pt );
+    ret = PtInRegion( hrgn, pt.x, pt.y );
+    DeleteObject( hrgn );
+    return ret;
+}
+
+static void test_sibling_vis_rgn(void)
+{
+    HWND parent, top, siblings[4];
+    unsigned int i;
+
+    parent = CreateWindowA( "static", NULL, WS_POPUP | WS_VISIBLE | WS_CLIPCHILDREN,
+                            100, 100, 200, 100, NULL, 0, 0, NULL );
+    ok( parent != NULL, "CreateWindow failed\n" );
+    top = CreateWindowA( "static", NULL, WS_CHILD | WS_VISIBLE | WS_CLIPSIBLINGS,
+                         0, 50, 50, 50, parent, 0, 0, NULL );
+    ok( top != NULL, "CreateWindow failed\n" );
+    for (i = 0; i < ARRAY_SIZE(siblings); i++)
+    {
+        siblings[i] = CreateWindowA( "static", NULL, WS_CHILD | WS_VISIBLE | WS_CLIPSIBLINGS,
+                                     i * 50, 0, 50, 50, parent, 0, 0, NULL );
+        ok( siblings[i] != NULL, "CreateWindow failed\n" );
+    }
+    flush_events( TRUE );
+
+    for (i = 0; i < ARRAY_SIZE(siblings); i++)
+        ok( is_point_visible( siblings[i], 25, 25 ), "%u: point not visible\n", i );
+
+    /* move the top window over each sibling in turn */
+    for (i = 0; i < ARRAY_SIZE(siblings); i++)
+    {
+        SetWindowPos( top, 0, i * 50, 0, 0, 0, SWP_NOSIZE | SWP_NOZORDER | SWP_NOACTIVATE );
+        ok( !is_point_visible( siblings[i], 25, 25 ), "%u: point visible\n", i );
+        if (i) ok( is_point_visible( siblings[i - 1], 25, 25 ), "%u: point not visible\n", i );
+    }
+
+    /* bring the covered sibling to the top */
+    SetWindowPos( siblings[3], HWND_TOP, 0, 0, 0, 0, SWP_NOSIZE | SWP_NOMOVE | SWP_NOACTIVATE );
+    ok( is_point_visible( siblings[3], 25, 25 ), "point not visible\n" );
+    SetWindowPos( top, HWND_TOP, 0, 0, 0, 0, SWP_NOSIZE | SWP_NOMOVE | SWP_NOACTIVATE );
+    ok( !is_point_visible( siblings[3], 25, 25 ), "point visible\n" );
+
+    /* hiding the top window uncovers the sibling */
+    ShowWindow( top, SW_HIDE );
+    ok( is_point_visible( siblings[3], 25, 25 ), "point not visible\n" );
+    ShowWindow( top, SW_SHOWNA );
+    ok( !is_point_visible( siblings[3], 25, 25 ), "point visible\n" );
+
+    /* so does changing its shape */
+    SetWindowRgn( top, CreateRectRgn( 0, 0, 10, 10 ), FALSE );
+    ok( is_point_visible( siblings[3], 25, 25 ), "point not visible\n" );
+
+    SetWindowRgn( top, 0, FALSE );
+    ok( !is_point_visible( siblings[3], 25, 25 ), "point visible\n" );
+
+    /* and destroying it */
+    DestroyWindow( top );
+    ok( is_point_visible( siblings[3], 25, 25 ), "point not visible\n" );
+
+    DestroyWindow( parent );
+}
+
 static void test_window_without_child_style(void)
 {
     HWND hwnd;
@@ -11266,6 +11338,144 @@ static void test_deferwindowpos(void)
     ok(ret, "got %d\n", ret);
 }
 
+static void test_deferwindowpos_children(void)
+{
+    HWND parent, children[8];
+    HRGN hrgn;
+    RECT rect;
+    HDWP hdwp;
+    unsigned int i;
+    BOOL ret;
+
+    parent = CreateWindowA( "static", NULL, WS_POPUP | WS_VISIBLE | WS_CLIPCHILDREN,
+                            100, 100, 200, 200, NULL, 0, 0, NULL );
+    ok( parent != NULL, "CreateWindow failed\n" );
+    for (i = 0; i < ARRAY_SIZE(children); i++)
+    {
+        children[i] = CreateWindowA( "static", NULL, WS_CHILD | WS_VISIBLE | WS_CLIPSIBLINGS,
+                                     0, i * 20, 50, 20, parent, 0, 0, NULL );
+        ok( children[i] != NULL, "CreateWindow failed\n" );
+    }
+    flush_events( TRUE );
+
+    hdwp = BeginDeferWindowPos( 0 );
+    ok( hdwp != NULL, "BeginDeferWindowPos failed\n" );
+    for (i = 0; i < ARRAY_SIZE(children); i++)
+    {
+        hdwp = DeferWindowPos( hdwp, children[i], NULL, 100, i * 20, 60, 20,
+                               SWP_NOZORDER | SWP_NOACTIVATE );
+        ok( hdwp != NULL, "DeferWindowPos failed\n" );
+    }
+    hdwp = DeferWindowPos( hdwp, children[5], HWND_TOP, 0, 0, 0, 0,
+                           SWP_NOMOVE | SWP_NOSIZE | SWP_NOACTIVATE );
+    ok( hdwp != NULL, "DeferWindowPos failed\n" );
+    ret = EndDeferWindowPos( hdwp );
+    ok( ret, "EndDeferWindowPos failed\n" );
+
+    for (i = 0; i < ARRAY_SIZE(children); i++)
+    {
+        GetWindowRect( children[i], &rect );
+        MapWindowPoints( 0, parent, (POINT *)&rect, 2 );
+        ok( rect.left == 100 && rect.top == i * 20 && rect.right == 160 && rect.bottom == (i + 1) * 20,
+            "%u: wrong rect %s\n", i, wine_dbgstr_rect( &rect ));
+    }
+    ok( GetWindow( parent, GW_CHILD ) == children[5], "wrong first child %p\n", GetWindow( parent, GW_CHILD ));
+
+    /* the area uncovered by the children is invalidated in the parent */
+    hrgn = CreateRectRgn( 0, 0, 0, 0 );
+    ok( GetUpdateRgn( parent, hrgn, FALSE ) != NULLREGION, "parent not invalidated\n" );
+    for (i = 0; i < ARRAY_SIZE(children); i++)
+        ok( PtInRegion( hrgn, 25, i * 20 + 10 ), "%u: point not invalidated\n", i );
+    DeleteObject( hrgn );
+
+    DestroyWindow( parent );
+}
+
+static void test_many_children_from_point(void)
+{
+    HWND parent, children[16 * 16], hwnd;
+    unsigned int i, count;
+    POINT pt;
+
+    parent = CreateWindowA( "static", NULL, WS_POPUP | WS_VISIBLE,
+                            100, 100, 320, 320, NULL, 0, 0, NULL );
+    ok( parent != NULL, "CreateWindow failed\n" );
+    for (i = 0; i < ARRAY_SIZE(children); i++)
+    {
+        children[i] = CreateWindowA( "button", NULL, WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON,
+                                     (i % 16) * 20, (i / 16) * 20, 20, 20, parent, 0, 0, NULL );
+        ok( children[i] != NULL, "CreateWindow failed\n" );
+    }
+    flush_events( TRUE );
+
+    for (i = 0; i < ARRAY_SIZE(children); i += 17)
+    {
+        pt.x = 100 + (i % 16) * 20 + 10;
+        pt.y = 100 + (i / 16) * 20 + 10;
+        hwnd = WindowFromPoint( pt );
+        ok( hwnd == children[i], "%u: got %p, expected %p\n", i, hwnd, children[i] );
+    }
+
+    /* move a child over another one */
+    SetWindowPos( children[0], HWND_TOP, 5 * 20, 5 * 20, 20, 20, SWP_NOACTIVATE );
+    pt.x = 100 + 5 * 20 + 10;
+    pt.y = 100 + 5 * 20 + 10;
+    hwnd = WindowFromPoint( pt );
+    ok( hwnd == children[0], "got %p, expected %p\n", hwnd, children[0] );
+    SetWindowPos( children[0], HWND_BOTTOM, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE | SWP_NOACTIVATE );
+    hwnd = WindowFromPoint( pt );
+    ok( hwnd == children[5 * 16 + 5], "got %p, expected %p\n", hwnd, children[5 * 16 + 5] );
+
+    /* hidden children are skipped */
+    ShowWindow( children[5 * 16 + 5], SW_HIDE );
+    hwnd = WindowFromPoint( pt );
+    ok( hwnd == children[0], "got %p, expected %p\n", hwnd, children[0] );
+
+    DestroyWindow( children[0] );
+    hwnd = WindowFromPoint( pt );
+    ok( hwnd != children[0], "got destroyed window %p\n", hwnd );
+
+    for (count = 0, hwnd = GetWindow( parent, GW_CHILD ); hwnd; hwnd = GetWindow( hwnd, GW_HWNDNEXT ))
+        count++;
+    ok( count == ARRAY_SIZE(children) - 1, "got %u children\n", count );
+
+    DestroyWindow( parent );
+
+    /* children of a mirrored parent keep their position relative to its right edge when it is resized */
+    parent = CreateWindowExA( WS_EX_LAYOUTRTL, "static", NULL, WS_POPUP | WS_VISIBLE,
+                              100, 100, 320, 320, NULL, 0, 0, NULL );
+    ok( parent != NULL, "CreateWindow failed\n" );
+    for (i = 0; i < ARRAY_SIZE(children); i++)
+    {
+        children[i] = CreateWindowA( "button", NULL, WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON,
+                                     (i % 16) * 20, (i / 16) * 20, 20, 20, parent, 0, 0, NULL );
+        ok( children[i] != NULL, "CreateWindow failed\n" );
+    }
+    flush_events( TRUE );
+
+    for (i = 0; i < ARRAY_SIZE(children); i += 17)
+    {
+        pt.x = (i % 16) * 20 + 10;
+        pt.y = (i / 16) * 20 + 10;
+        hwnd = ChildWindowFromPoint( parent, pt );
+        ok( hwnd == children[i], "%u: got %p, expected %p\n", i, hwnd, children[i] );
+    }
+    SetWindowPos( parent, 0, 0, 0, 420, 320, SWP_NOMOVE | SWP_NOZORDER | SWP_NOACTIVATE );
+    for (i = 0; i < ARRAY_SIZE(children); i += 17)
+    {
+        pt.x = (i % 16) * 20 + 10;
+        pt.y = (i / 16) * 20 + 10;
+        hwnd = ChildWindowFromPoint( parent, pt );
+        ok( hwnd == children[i], "%u: got %p, expected %p\n", i, hwnd, children[i] );
+    }
+    pt.x = 330;
+    pt.y = 10;
+    hwnd = ChildWindowFromPoint( parent, pt );
+    ok( hwnd == parent, "got %p, expected %p\n", hwnd, parent );
+
+    DestroyWindow( parent );
+}
+
 static void test_LockWindowUpdate(HWND parent)
 {
     typedef struct
@@ -11331,6 +11541,45 @@ static void test_LockWindowUpdate(HWND parent)
     DestroyWindow(child);
 }
 
+static void test_surface_updates(void)
+{
+    COLORREF color;
+    HWND hwnd;
+    HDC hdc;
+    MSG msg;
+    int i, full;
+
+    hwnd = CreateWindowA( "static", NULL, WS_POPUP | WS_VISIBLE, 0, 0, 800, 600, NULL, 0, 0, NULL );
+    ok( hwnd != NULL, "CreateWindow failed\n" );
+    flush_events( TRUE );
+
+    /* small updates in opposite corners, and updates of the whole window */
+    for (full = 0; full < 2; full++)
+    {
+        for (i = 0; i < 4; i++)
+        {
+            hdc = GetDC( hwnd );
+            if (full) PatBlt( hdc, 0, 0, 800, 600, (i & 1) ? BLACKNESS : WHITENESS );
+            else
+            {
+                PatBlt( hdc, 0, 0, 16, 16, (i & 1) ? BLACKNESS : WHITENESS );
+                PatBlt( hdc, 784, 584, 16, 16, (i & 1) ? BLACKNESS : WHITENESS );
+            }
+            ReleaseDC( hwnd, hdc );
+            while (PeekMessageA( &msg, 0, 0, 0, PM_REMOVE )) DispatchMessageA( &msg );
+        }
+
+        hdc = GetDC( hwnd );
+        color = GetPixel( hdc, 0, 0 );
+        ok( color == RGB( 0, 0, 0 ), "got %06lx\n", color );
+        color = GetPixel( hdc, 799, 599 );
+        ok( color == RGB( 0, 0, 0 ), "got %06lx\n", color );
+        ReleaseDC( hwnd, hdc );
+    }
+
+    DestroyWindow( hwnd );
+}
+
 static void test_hide_window(void)
 {
     HWND hwnd, hwnd2, hwnd3;
@@ -12668,7 +12917,9 @@ static void other_process_proc(HWND hwnd)
 {
     HANDLE window_ready_event, test_done_event;
     WINDOWPLACEMENT wp;
-    DWORD ret;
+    DWORD ret, tid, pid = 0;
+    LONG style;
+    RECT rect;
 
     window_ready_event = OpenEventA(EVENT_ALL_ACCESS, FALSE, "test_opw_window");
     ok(!!window_ready_event, "OpenEvent failed.\n");
@@ -12682,6 +12933,20 @@ static void other_process_proc(HWND hwnd)
     ok(ret, "Unexpected ret %#lx.\n", ret);
     ok(wp.showCmd == SW_SHOWNORMAL, "Unexpected showCmd %#x.\n", wp.showCmd);
     ok(!wp.flags, "Unexpected flags %#x.\n", wp.flags);
+    ok(IsWindow(hwnd), "IsWindow failed.\n");
+    ok(IsWindowVisible(hwnd), "Window isn't visible.\n");
+    style = GetWindowLongA(hwnd, GWL_STYLE);
+    ok((style & (WS_POPUP | WS_VISIBLE)) == (WS_POPUP | WS_VISIBLE), "Unexpected style %#lx.\n", style);
+    ok(!GetParent(hwnd), "Unexpected parent %p.\n", GetParent(hwnd));
+    tid = GetWindowThreadProcessId(hwnd, &pid);
+    ok(tid && tid != GetCurrentThreadId(), "Unexpected thread %#lx.\n", tid);
+    ok(pid && pid != GetCurrentProcessId(), "Unexpected process %#lx.\n", pid);
+    GetWindowRect(hwnd, &rect);
+    ok(rect.left == 100 && rect.top == 100 && rect.right == 200 && rect.bottom == 200,
+       "Unexpected window rect %s.\n", wine_dbgstr_rect(&rect));
+    GetClientRect(hwnd, &rect);
+    ok(rect.left == 0 && rect.top == 0 && rect.right == 100 && rect.bottom == 100,
+       "Unexpected client rect %s.\n", wine_dbgstr_rect(&rect));
     SetEvent(test_done_event);
 
     /* SW_SHOWMAXIMIZED */
@@ -13152,12 +13417,16 @@ START_TEST(win)
     test_winregion();
     test_map_points();
     test_update_region();
+    test_sibling_vis_rgn();
     test_window_without_child_style();
     test_smresult();
     test_GetMessagePos();
     test_activateapp(hwndMain);
     test_winproc_handles(argv[0]);
     test_deferwindowpos();
+    test_deferwindowpos_children();
+    test_many_children_from_point();
+    test_surface_updates();
     test_LockWindowUpdate(hwndMain);
     test_desktop();
     test_display_affinity(hwndMain);
@@ -90,6 +90,8 @@ extern BOOL process_hardware_message( MSG *msg, UINT hw_id, const struct hardwar
 extern BOOL unpack_dde_message( HWND hwnd, UINT message, WPARAM *wparam, LPARAM *lparam,
                                 void **buffer, size_t size ) DECLSPEC_HIDDEN;
 
+extern UINT register_user_atom( const WCHAR *name ) DECLSPEC_HIDDEN;
+extern UINT register_user_atom_a( const char *name ) DECLSPEC_HIDDEN;
 extern void CLIPBOARD_ReleaseOwner( HWND hwnd ) DECLSPEC_HIDDEN;
 extern BOOL FOCUS_MouseActivate( HWND hwnd ) DECLSPEC_HIDDEN;
 extern BOOL set_capture_window( HWND hwnd, UINT gui_flags, HWND *prev_ret ) DECLSPEC_HIDDEN;
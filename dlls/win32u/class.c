@@ -41,7 +41,8 @@ WINE_DECLARE_DEBUG_CHANNEL(win);
 
 typedef struct tagCLASS
 {
-    struct list  entry;         /* Entry in class list */
+    struct list  name_entry;    /* Entry in class name hash list */
+    struct list  atom_entry;    /* Entry in class atom hash list */
     UINT         style;         /* Class style */
     BOOL         local;         /* Local class? */
     WNDPROC      winproc;       /* Window procedure */
@@ -64,7 +65,11 @@ static WINDOWPROC winproc_array[MAX_WINPROCS];
 static UINT winproc_used = NB_BUILTIN_WINPROCS;
 static pthread_mutex_t winproc_lock = PTHREAD_MUTEX_INITIALIZER;
 
-static struct list class_list = LIST_INIT( class_list );
+/* classes are hashed both by name and by atom; within a hash list, local classes come
+ * first in reverse registration order, then global classes in registration order */
+#define CLASS_HASH_SIZE 64
+static struct list class_name_hash[CLASS_HASH_SIZE];
+static struct list class_atom_hash[CLASS_HASH_SIZE];
 
 static HINSTANCE user32_module;
 
@@ -295,32 +300,75 @@ static void release_class_ptr( CLASS *ptr )
     user_unlock();
 }
 
+static struct list *get_class_bucket( struct list *hash, UINT index )
+{
+    struct list *bucket = &hash[index % CLASS_HASH_SIZE];
+    if (!bucket->next) list_init( bucket );
+    return bucket;
+}
+
+static UINT hash_class_name( const WCHAR *name, UINT len )
+{
+    UINT hash = 0;
+    while (len--) hash = hash * 65599 + towupper( *name++ );
+    return hash;
+}
+
+static void link_class( CLASS *class )
+{
+    struct list *name_bucket = get_class_bucket( class_name_hash,
+                                                 hash_class_name( class->name, wcslen( class->name )));
+    struct list *atom_bucket = get_class_bucket( class_atom_hash, class->atomName );
+
+    if (class->local)
+    {
+        list_add_head( name_bucket, &class->name_entry );
+        list_add_head( atom_bucket, &class->atom_entry );
+    }
+    else
+    {
+        list_add_tail( name_bucket, &class->name_entry );
+        list_add_tail( atom_bucket, &class->atom_entry );
+    }
+}
+
+static void unlink_class( CLASS *class )
+{
+    list_remove( &class->name_entry );
+    list_remove( &class->atom_entry );
+}
+
 static CLASS *find_class( HINSTANCE module, UNICODE_STRING *name )
 {
     ATOM atom = get_int_atom_value( name );
     ULONG_PTR instance = (UINT_PTR)module & ~0xffff;
+    UINT len = name->Length / sizeof(WCHAR);
     CLASS *class;
 
     user_lock();
-    LIST_FOR_EACH_ENTRY( class, &class_list, CLASS, entry )
+    if (atom)
     {
-        if (atom)
+        LIST_FOR_EACH_ENTRY( class, get_class_bucket( class_atom_hash, atom ), CLASS, atom_entry )
         {
             if (class->atomName != atom) continue;
+            if (!class->local || !module || (class->instance & ~0xffff) == instance) goto found;
         }
-        else
-        {
-            if (wcsnicmp( class->name, name->Buffer, name->Length / sizeof(WCHAR) ) ||
-                class->name[name->Length / sizeof(WCHAR)]) continue;
-        }
-        if (!class->local || !module || (class->instance & ~0xffff) == instance)
+    }
+    else
+    {
+        LIST_FOR_EACH_ENTRY( class, get_class_bucket( class_name_hash, hash_class_name( name->Buffer, len )),
+                             CLASS, name_entry )
         {
-            TRACE( "%s %lx -> %p\n", debugstr_us(name), instance, class );
-            return class;
+            if (wcsnicmp( class->name, name->Buffer, len ) || class->name[len]) continue;
+            if (!class->local || !module || (class->instance & ~0xffff) == instance) goto found;
         }
     }
     user_unlock();
     return NULL;
+
+found:
+    TRACE( "%s %lx -> %p\n", debugstr_us(name), instance, class );
+    return class;
 }
 
 /***********************************************************************
@@ -429,8 +477,7 @@ ATOM WINAPI NtUserRegisterClassExWOW( const WNDCLASSEXW *wc, UNICODE_STRING *nam
     /* Other non-null values must be set by caller */
 
     user_lock();
-    if (class->local) list_add_head( &class_list, &class->entry );
-    else list_add_tail( &class_list, &class->entry );
+    link_class( class );
 
     atom = class->atomName;
 
@@ -478,7 +525,7 @@ BOOL WINAPI NtUserUnregisterClass( UNICODE_STRING *name, HINSTANCE instance,
 
     user_lock();
     if (class->dce) free_dce( class->dce, 0 );
-    list_remove( &class->entry );
+    unlink_class( class );
     if (class->hbrBackground > (HBRUSH)(COLOR_GRADIENTINACTIVECAPTION + 1))
         NtGdiDeleteObjectApp( class->hbrBackground );
     *client_menu_name = class->menu_name;
@@ -740,10 +787,13 @@ static ULONG_PTR set_class_long( HWND hwnd, INT offset, LONG_PTR newval, UINT si
             UNICODE_STRING us;
             if (!set_server_info( hwnd, offset, newval, size )) break;
             retval = class->atomName;
+            /* the class is hashed by its atom and name, move it to the new buckets */
+            unlink_class( class );
             class->atomName = newval;
             us.Buffer = class->name;
             us.MaximumLength = sizeof(class->name);
             NtUserGetAtomName( newval, &us );
+            link_class( class );
         }
         break;
     case GCL_CBCLSEXTRA:  /* cannot change this one */
@@ -27,6 +27,7 @@
 #pragma makedep unix
 #endif
 
+#include <pthread.h>
 #include "win32u_private.h"
 #include "ntuser_private.h"
 #include "wine/server.h"
@@ -164,6 +165,17 @@ INT WINAPI NtUserGetPriorityClipboardFormat( UINT *list, INT count )
     return -1;
 }
 
+/* names of pinned format atoms, which stay valid until the session ends */
+struct format_name
+{
+    UINT  format;
+    UINT  len;
+    WCHAR name[MAX_ATOM_LEN];
+};
+
+static struct format_name format_names[32];
+static pthread_mutex_t format_names_lock = PTHREAD_MUTEX_INITIALIZER;
+
 /**************************************************************************
  *	     NtUserGetClipboardFormatName    (win32u.@)
  */
@@ -171,6 +183,7 @@ INT WINAPI NtUserGetClipboardFormatName( UINT format, WCHAR *buffer, INT maxlen
 {
     char buf[sizeof(ATOM_BASIC_INFORMATION) + MAX_ATOM_LEN * sizeof(WCHAR)];
     ATOM_BASIC_INFORMATION *abi = (ATOM_BASIC_INFORMATION *)buf;
+    struct format_name *cache;
     UINT length = 0;
 
     if (format < MAXINTATOM || format > 0xffff) return 0;
@@ -179,10 +192,32 @@ INT WINAPI NtUserGetClipboardFormatName( UINT format, WCHAR *buffer, INT maxlen
         SetLastError( ERROR_MORE_DATA );
         return 0;
     }
+
+    cache = &format_names[format % ARRAY_SIZE(format_names)];
+    pthread_mutex_lock( &format_names_lock );
+    if (cache->format == format)
+    {
+        length = min( cache->len, maxlen - 1 );
+        memcpy( buffer, cache->name, length * sizeof(WCHAR) );
+        buffer[length] = 0;
+        pthread_mutex_unlock( &format_names_lock );
+        return length;
+    }
+    pthread_mutex_unlock( &format_names_lock );
+
     if (!set_ntstatus( NtQueryInformationAtom( format, AtomBasicInformation,
                                                buf, sizeof(buf), NULL )))
         return 0;
 
+    if (abi->Pinned)
+    {
+        pthread_mutex_lock( &format_names_lock );
+        cache->format = format;
+        cache->len = abi->NameLength / sizeof(WCHAR);
+        memcpy( cache->name, abi->Name, abi->NameLength );
+        pthread_mutex_unlock( &format_names_lock );
+    }
+
     length = min( abi->NameLength / sizeof(WCHAR), maxlen - 1 );
     if (length) memcpy( buffer, abi->Name, length * sizeof(WCHAR) );
     buffer[length] = 0;
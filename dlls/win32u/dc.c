@@ -283,15 +283,31 @@ void free_dc_ptr( DC *dc )
 /***********************************************************************
  *           get_dc_ptr
  *
- * Retrieve a DC pointer but release the GDI lock.
+ * Retrieve a DC pointer without holding the GDI lock.
  */
 DC *get_dc_ptr( HDC hdc )
 {
-    DC *dc = get_dc_obj( hdc );
-    if (!dc) return NULL;
+    DWORD type;
+    DC *dc;
+
+    /* the handle entry lock is enough to keep the DC alive until we own it */
+    if (!(dc = lock_obj_entry( hdc, &type ))) return NULL;
+
+    switch (type)
+    {
+    case NTGDI_OBJ_DC:
+    case NTGDI_OBJ_MEMDC:
+    case NTGDI_OBJ_ENHMETADC:
+        break;
+    default:
+        unlock_obj_entry( hdc );
+        SetLastError( ERROR_INVALID_HANDLE );
+        return NULL;
+    }
+
     if (dc->attr->disabled)
     {
-        GDI_ReleaseObj( hdc );
+        unlock_obj_entry( hdc );
         return NULL;
     }
 
@@ -301,13 +317,13 @@ DC *get_dc_ptr( HDC hdc )
     }
     else if (dc->thread != GetCurrentThreadId())
     {
+        unlock_obj_entry( hdc );
         WARN( "dc %p belongs to thread %04x\n", hdc, dc->thread );
-        GDI_ReleaseObj( hdc );
         return NULL;
     }
     else InterlockedIncrement( &dc->refcount );
 
-    GDI_ReleaseObj( hdc );
+    unlock_obj_entry( hdc );
     return dc;
 }
 
@@ -23,6 +23,9 @@
 #endif
 
 #include <assert.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
 
 #include "ntgdi_private.h"
 #include "dibdrv.h"
@@ -435,6 +438,185 @@ static const unsigned char BITBLT_Opcodes[256][MAX_OP_LEN] =
     { OP(PAT,DST,R2_WHITE) }                                        /* 0xff  1              */
 };
 
+/* operations covering fewer pixels than this are not worth handing to the band workers */
+#define BAND_MIN_PIXELS  (256 * 256)
+#define BAND_MIN_HEIGHT  16
+#define MAX_BAND_THREADS 7
+
+struct band_job
+{
+    void (*func)( void *ctx, int band );
+    void *ctx;
+    int   count;    /* number of bands */
+    int   next;     /* next band to hand out */
+    int   pending;  /* bands not completed yet */
+};
+
+static pthread_mutex_t band_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t band_start_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t band_done_cond = PTHREAD_COND_INITIALIZER;
+static pthread_once_t band_init_once = PTHREAD_ONCE_INIT;
+static struct band_job *band_job;
+static int band_threads;
+
+/* pick the next band of the current job and run it; band_mutex must be held */
+static BOOL run_next_band(void)
+{
+    struct band_job *job = band_job;
+    int band;
+
+    if (!job || job->next >= job->count) return FALSE;
+    band = job->next++;
+    pthread_mutex_unlock( &band_mutex );
+    job->func( job->ctx, band );
+    pthread_mutex_lock( &band_mutex );
+    if (!--job->pending) pthread_cond_broadcast( &band_done_cond );
+    return TRUE;
+}
+
+/* the band workers are plain host threads, they must only run the pixel primitives */
+static void *band_thread( void *arg )
+{
+    pthread_mutex_lock( &band_mutex );
+    for (;;) if (!run_next_band()) pthread_cond_wait( &band_start_cond, &band_mutex );
+    return NULL;
+}
+
+static void init_band_threads(void)
+{
+    long cpus = sysconf( _SC_NPROCESSORS_ONLN );
+    sigset_t set, old_set;
+    pthread_attr_t attr;
+    pthread_t thread;
+    int i, count = min( cpus - 1, MAX_BAND_THREADS );
+
+    /* make sure none of the process signals get delivered to the workers */
+    sigfillset( &set );
+    pthread_sigmask( SIG_SETMASK, &set, &old_set );
+    pthread_attr_init( &attr );
+    pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+    for (i = 0; i < count; i++)
+    {
+        if (pthread_create( &thread, &attr, band_thread, NULL )) break;
+        band_threads++;
+    }
+    pthread_attr_destroy( &attr );
+    pthread_sigmask( SIG_SETMASK, &old_set, NULL );
+    TRACE( "started %u band threads\n", band_threads );
+}
+
+/* number of bands an operation of the given size should be split into */
+static int get_band_count( int height, UINT64 pixels )
+{
+    if (pixels < BAND_MIN_PIXELS || height < 2 * BAND_MIN_HEIGHT) return 1;
+    pthread_once( &band_init_once, init_band_threads );
+    return max( 1, min( band_threads + 1, height / BAND_MIN_HEIGHT ));
+}
+
+/* run func for every band, using the band workers if they are not busy already */
+static void run_bands( int count, void (*func)( void *ctx, int band ), void *ctx )
+{
+    struct band_job job;
+    int i;
+
+    if (count > 1 && !pthread_mutex_trylock( &band_mutex ))
+    {
+        if (!band_job)
+        {
+            job.func    = func;
+            job.ctx     = ctx;
+            job.count   = count;
+            job.next    = 0;
+            job.pending = count;
+            band_job = &job;
+            pthread_cond_broadcast( &band_start_cond );
+            while (run_next_band());
+            while (job.pending) pthread_cond_wait( &band_done_cond, &band_mutex );
+            band_job = NULL;
+            pthread_mutex_unlock( &band_mutex );
+            return;
+        }
+        pthread_mutex_unlock( &band_mutex );
+    }
+    for (i = 0; i < count; i++) func( ctx, i );
+}
+
+struct rect_bands
+{
+    int         count;
+    const RECT *rects;
+    RECT        bounds;
+    int         bands;
+    void      (*func)( void *ctx, int count, const RECT *rects );
+    void       *ctx;
+};
+
+static void rect_band_proc( void *arg, int band )
+{
+    struct rect_bands *bands = arg;
+    int i, count = 0, height = bands->bounds.bottom - bands->bounds.top;
+    RECT clip, buffer[32], *rects = buffer;
+
+    clip.left   = bands->bounds.left;
+    clip.right  = bands->bounds.right;
+    clip.top    = bands->bounds.top + height * band / bands->bands;
+    clip.bottom = bands->bounds.top + height * (band + 1) / bands->bands;
+
+    if (bands->count > ARRAY_SIZE(buffer) && !(rects = malloc( bands->count * sizeof(*rects) )))
+    {
+        /* fall back to doing the band rect by rect */
+        for (i = 0; i < bands->count; i++)
+            if (intersect_rect( &buffer[0], &bands->rects[i], &clip )) bands->func( bands->ctx, 1, buffer );
+        return;
+    }
+    for (i = 0; i < bands->count; i++)
+        if (intersect_rect( &rects[count], &bands->rects[i], &clip )) count++;
+    if (count) bands->func( bands->ctx, count, rects );
+    if (rects != buffer) free( rects );
+}
+
+/***********************************************************************
+ *           run_rects_in_bands
+ *
+ * Call func for the rectangles, split into horizontal bands that are processed
+ * in parallel when the total area is large enough. Only suitable for operations
+ * where every destination pixel depends on nothing but its own position.
+ * The band workers can't handle page faults, so bits that the app can get
+ * at (DIB sections, StretchDIBits sources) are always done on this thread.
+ */
+void run_rects_in_bands( const dib_info *dst, const dib_info *src, int count, const RECT *rects,
+                         void (*func)( void *ctx, int count, const RECT *rects ), void *ctx )
+{
+    struct rect_bands bands;
+    UINT64 pixels = 0;
+    int i;
+
+    if (!dst->private_bits || (src && !src->private_bits))
+    {
+        if (count) func( ctx, count, rects );
+        return;
+    }
+
+    reset_bounds( &bands.bounds );
+    for (i = 0; i < count; i++)
+    {
+        pixels += (UINT64)(rects[i].right - rects[i].left) * (rects[i].bottom - rects[i].top);
+        add_bounds_rect( &bands.bounds, &rects[i] );
+    }
+
+    bands.bands = count ? get_band_count( bands.bounds.bottom - bands.bounds.top, pixels ) : 1;
+    if (bands.bands <= 1)
+    {
+        if (count) func( ctx, count, rects );
+        return;
+    }
+    bands.count = count;
+    bands.rects = rects;
+    bands.func  = func;
+    bands.ctx   = ctx;
+    run_bands( bands.bands, rect_band_proc, &bands );
+}
+
 static int get_overlap( const dib_info *dst, const RECT *dst_rect,
                         const dib_info *src, const RECT *src_rect )
 {
@@ -585,17 +767,38 @@ static void mask_rect( dib_info *dst, const RECT *dst_rect, const dib_info *src,
     }
 }
 
+struct blend_rects_params
+{
+    const dib_info *dst;
+    const dib_info *src;
+    POINT           offset;
+    BLENDFUNCTION   blend;
+};
+
+static void blend_rects_proc( void *ctx, int count, const RECT *rects )
+{
+    struct blend_rects_params *params = ctx;
+
+    params->dst->funcs->blend_rects( params->dst, count, rects, params->src, &params->offset, params->blend );
+}
+
 static DWORD blend_rect( dib_info *dst, const RECT *dst_rect, const dib_info *src, const RECT *src_rect,
                          HRGN clip, BLENDFUNCTION blend )
 {
-    POINT offset;
+    struct blend_rects_params params;
     struct clipped_rects clipped_rects;
 
     if (!get_clipped_rects( dst, dst_rect, clip, &clipped_rects )) return ERROR_SUCCESS;
 
-    offset.x = src_rect->left - dst_rect->left;
-    offset.y = src_rect->top  - dst_rect->top;
-    dst->funcs->blend_rects( dst, clipped_rects.count, clipped_rects.rects, src, &offset, blend );
+    params.dst = dst;
+    params.src = src;
+    params.offset.x = src_rect->left - dst_rect->left;
+    params.offset.y = src_rect->top  - dst_rect->top;
+    params.blend = blend;
+    if (get_overlap( dst, dst_rect, src, src_rect ))
+        blend_rects_proc( &params, clipped_rects.count, clipped_rects.rects );
+    else
+        run_rects_in_bands( dst, src, clipped_rects.count, clipped_rects.rects, blend_rects_proc, &params );
 
     free_clipped_rects( &clipped_rects );
     return ERROR_SUCCESS;
@@ -680,19 +883,42 @@ static void get_gradient_triangle_vertices( const GRADIENT_TRIANGLE *tri, const
     bounds->bottom = v[2].y;
 }
 
-static BOOL gradient_rect( dib_info *dib, TRIVERTEX *v, int mode, HRGN clip, const RECT *bounds )
+struct gradient_rects_params
+{
+    const dib_info  *dib;
+    const TRIVERTEX *v;
+    int              mode;
+    BOOL             ret;
+};
+
+static void gradient_rects_proc( void *ctx, int count, const RECT *rects )
 {
+    struct gradient_rects_params *params = ctx;
     int i;
-    struct clipped_rects clipped_rects;
-    BOOL ret = TRUE;
 
-    if (!get_clipped_rects( dib, bounds, clip, &clipped_rects )) return TRUE;
-    for (i = 0; i < clipped_rects.count; i++)
+    for (i = 0; i < count; i++)
     {
-        if (!(ret = dib->funcs->gradient_rect( dib, &clipped_rects.rects[i], v, mode ))) break;
+        if (!params->dib->funcs->gradient_rect( params->dib, &rects[i], params->v, params->mode ))
+        {
+            params->ret = FALSE;
+            break;
+        }
     }
+}
+
+static BOOL gradient_rect( dib_info *dib, TRIVERTEX *v, int mode, HRGN clip, const RECT *bounds )
+{
+    struct gradient_rects_params params;
+    struct clipped_rects clipped_rects;
+
+    if (!get_clipped_rects( dib, bounds, clip, &clipped_rects )) return TRUE;
+    params.dib  = dib;
+    params.v    = v;
+    params.mode = mode;
+    params.ret  = TRUE;
+    run_rects_in_bands( dib, NULL, clipped_rects.count, clipped_rects.rects, gradient_rects_proc, &params );
     free_clipped_rects( &clipped_rects );
-    return ret;
+    return params.ret;
 }
 
 static DWORD copy_src_bits( dib_info *src, RECT *src_rect )
@@ -1198,20 +1424,156 @@ static DWORD calc_1d_stretch_params( INT dst_start, INT dst_length, INT dst_vis_
 }
 
 
-DWORD stretch_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, struct bitblt_coords *src,
-                          const BITMAPINFO *dst_info, void *dst_bits, struct bitblt_coords *dst,
-                          INT mode )
+struct stretch_band
+{
+    POINT dst_start;
+    POINT src_start;
+    int   err;
+    int   length;
+};
+
+struct stretch_rows_params
+{
+    dib_info                    *dst_dib;
+    const dib_info              *src_dib;
+    const struct stretch_params *v_params;
+    const struct stretch_params *h_params;
+    void (*row_fn)(const dib_info *dst_dib, const POINT *dst_start,
+                   const dib_info *src_dib, const POINT *src_start,
+                   const struct stretch_params *params, int mode, BOOL keep_dst);
+    int                          mode;
+    BOOL                         vstretch;
+    int                          width;
+    struct stretch_band          bands[MAX_BAND_THREADS + 1];
+};
+
+/* split the rows of a stretch into bands; a band can only start on a new destination row */
+static int get_stretch_bands( struct stretch_rows_params *params, const POINT *dst_start,
+                              const POINT *src_start, int count )
+{
+    const struct stretch_params *v_params = params->v_params;
+    struct stretch_band state;
+    BOOL new_row = TRUE;
+    int i, band = 0, start = 0;
+
+    state.dst_start = *dst_start;
+    state.src_start = *src_start;
+    state.err = v_params->err_start;
+    params->bands[0] = state;
+
+    if (count > 1)
+    {
+        for (i = 0; i < v_params->length; i++)
+        {
+            if (band + 1 < count && new_row && i >= v_params->length * (band + 1) / count)
+            {
+                params->bands[band++].length = i - start;
+                params->bands[band] = state;
+                start = i;
+            }
+            if (params->vstretch)
+            {
+                if (state.err > 0)
+                {
+                    state.src_start.y += v_params->src_inc;
+                    state.err += v_params->err_add_1;
+                }
+                else state.err += v_params->err_add_2;
+                state.dst_start.y += v_params->dst_inc;
+            }
+            else
+            {
+                if ((new_row = state.err > 0))
+                {
+                    state.dst_start.y += v_params->dst_inc;
+                    state.err += v_params->err_add_1;
+                }
+                else state.err += v_params->err_add_2;
+                state.src_start.y += v_params->src_inc;
+            }
+        }
+    }
+    params->bands[band].length = v_params->length - start;
+    return band + 1;
+}
+
+static void stretch_rows_proc( void *ctx, int band )
+{
+    struct stretch_rows_params *params = ctx;
+    const struct stretch_params *v_params = params->v_params;
+    POINT dst_start = params->bands[band].dst_start;
+    POINT src_start = params->bands[band].src_start;
+    int err = params->bands[band].err, length = params->bands[band].length;
+
+    if (params->vstretch)
+    {
+        BOOL need_row = TRUE;
+        RECT last_row, this_row;
+        last_row.left = 0;
+        last_row.right = params->width;
+
+        while (length--)
+        {
+            if (need_row)
+            {
+                params->row_fn( params->dst_dib, &dst_start, params->src_dib, &src_start,
+                                params->h_params, params->mode, FALSE );
+                need_row = FALSE;
+            }
+            else
+            {
+                last_row.top = dst_start.y - v_params->dst_inc;
+                last_row.bottom = last_row.top + 1;
+                this_row = last_row;
+                offset_rect( &this_row, 0, v_params->dst_inc );
+                copy_rect( params->dst_dib, &this_row, params->dst_dib, &last_row, NULL, R2_COPYPEN );
+            }
+
+            if (err > 0)
+            {
+                src_start.y += v_params->src_inc;
+                need_row = TRUE;
+                err += v_params->err_add_1;
+            }
+            else err += v_params->err_add_2;
+            dst_start.y += v_params->dst_inc;
+        }
+    }
+    else
+    {
+        int merged_rows = 0;
+
+        while (length--)
+        {
+            if (params->mode != STRETCH_DELETESCANS || !merged_rows)
+                params->row_fn( params->dst_dib, &dst_start, params->src_dib, &src_start,
+                                params->h_params, params->mode, merged_rows != 0 );
+            merged_rows++;
+
+            if (err > 0)
+            {
+                dst_start.y += v_params->dst_inc;
+                merged_rows = 0;
+                err += v_params->err_add_1;
+            }
+            else err += v_params->err_add_2;
+            src_start.y += v_params->src_inc;
+        }
+    }
+}
+
+DWORD stretch_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, BOOL src_private,
+                          struct bitblt_coords *src, const BITMAPINFO *dst_info, void *dst_bits,
+                          struct bitblt_coords *dst, INT mode )
 {
     dib_info src_dib, dst_dib;
     POINT dst_start, src_start, dst_end, src_end;
     RECT rect;
     BOOL hstretch, vstretch;
     struct stretch_params v_params, h_params;
-    int err;
+    struct stretch_rows_params params;
+    int count;
     DWORD ret;
-    void (* row_fn)(const dib_info *dst_dib, const POINT *dst_start,
-                    const dib_info *src_dib, const POINT *src_start,
-                    const struct stretch_params *params, int mode, BOOL keep_dst);
 
     TRACE("dst %d, %d - %d x %d visrect %s src %d, %d - %d x %d visrect %s\n",
           dst->x, dst->y, dst->width, dst->height, wine_dbgstr_rect(&dst->visrect),
@@ -1219,6 +1581,8 @@ DWORD stretch_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, struct bit
 
     init_dib_info_from_bitmapinfo( &src_dib, src_info, src_bits );
     init_dib_info_from_bitmapinfo( &dst_dib, dst_info, dst_bits );
+    src_dib.private_bits = src_private;
+    dst_dib.private_bits = TRUE;  /* always a temporary buffer */
 
     if (mode == HALFTONE)
     {
@@ -1251,64 +1615,21 @@ DWORD stretch_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, struct bit
     dst_start.x -= dst->visrect.left;
     dst_start.y -= dst->visrect.top;
 
-    err = v_params.err_start;
-
-    row_fn = hstretch ? dst_dib.funcs->stretch_row : dst_dib.funcs->shrink_row;
-
-    if (vstretch)
-    {
-        BOOL need_row = TRUE;
-        RECT last_row, this_row;
-        if (hstretch) mode = STRETCH_DELETESCANS;
-        last_row.left = 0;
-        last_row.right = dst->visrect.right - dst->visrect.left;
-
-        while (v_params.length--)
-        {
-            if (need_row)
-            {
-                row_fn( &dst_dib, &dst_start, &src_dib, &src_start, &h_params, mode, FALSE );
-                need_row = FALSE;
-            }
-            else
-            {
-                last_row.top = dst_start.y - v_params.dst_inc;
-                last_row.bottom = last_row.top + 1;
-                this_row = last_row;
-                offset_rect( &this_row, 0, v_params.dst_inc );
-                copy_rect( &dst_dib, &this_row, &dst_dib, &last_row, NULL, R2_COPYPEN );
-            }
-
-            if (err > 0)
-            {
-                src_start.y += v_params.src_inc;
-                need_row = TRUE;
-                err += v_params.err_add_1;
-            }
-            else err += v_params.err_add_2;
-            dst_start.y += v_params.dst_inc;
-        }
-    }
-    else
-    {
-        int merged_rows = 0;
-
-        while (v_params.length--)
-        {
-            if (mode != STRETCH_DELETESCANS || !merged_rows)
-                row_fn( &dst_dib, &dst_start, &src_dib, &src_start, &h_params, mode, merged_rows != 0 );
-            merged_rows++;
-
-            if (err > 0)
-            {
-                dst_start.y += v_params.dst_inc;
-                merged_rows = 0;
-                err += v_params.err_add_1;
-            }
-            else err += v_params.err_add_2;
-            src_start.y += v_params.src_inc;
-        }
-    }
+    params.dst_dib  = &dst_dib;
+    params.src_dib  = &src_dib;
+    params.v_params = &v_params;
+    params.h_params = &h_params;
+    params.row_fn   = hstretch ? dst_dib.funcs->stretch_row : dst_dib.funcs->shrink_row;
+    params.mode     = (vstretch && hstretch) ? STRETCH_DELETESCANS : mode;
+    params.vstretch = vstretch;
+    params.width    = dst->visrect.right - dst->visrect.left;
+
+    count = 1;
+    if (src_dib.private_bits && src_bits != dst_bits)
+        count = get_band_count( dst->visrect.bottom - dst->visrect.top,
+                                (UINT64)params.width * (dst->visrect.bottom - dst->visrect.top) );
+    count = get_stretch_bands( &params, &dst_start, &src_start, count );
+    run_bands( count, stretch_rows_proc, &params );
 
 done:
     /* update coordinates, the destination rectangle is always stored at 0,0 */
@@ -25,6 +25,7 @@ typedef struct
     RECT rect;  /* visible rectangle relative to bitmap origin */
     int stride; /* stride in bytes.  Will be -ve for bottom-up dibs (see bits). */
     struct gdi_image_bits bits; /* bits.ptr points to the top-left corner of the dib. */
+    BOOL private_bits; /* bits are allocated by win32u and never seen by the app */
 
     DWORD red_mask, green_mask, blue_mask;
     int red_shift, green_shift, blue_shift;
@@ -85,10 +86,20 @@ struct intensity_range
     BYTE b_min, b_max;
 };
 
+/* precomputed results of aa_color for a given text color */
+struct aa_text_table
+{
+    DWORD text;                 /* text color as 0x00rrggbb */
+    BYTE  blend[17][3][256];    /* blue, green and red results per glyph level and destination value */
+};
+
+#define AA_TEXT_TABLES 4        /* number of tables cached per device */
+
 struct font_intensities
 {
     struct intensity_range ranges[17];
     const struct font_gamma_ramp *gamma_ramp;
+    const struct aa_text_table *table;  /* optional, used when it matches the text color */
 };
 
 typedef struct dibdrv_physdev
@@ -100,6 +111,7 @@ typedef struct dibdrv_physdev
     HRGN clip;
     RECT *bounds;
     struct cached_font *font;
+    struct aa_text_table *text_tables[AA_TEXT_TABLES];  /* most recently used first */
 
     /* pen */
     DWORD pen_style, pen_endcap, pen_join;
@@ -193,7 +205,7 @@ typedef struct primitive_funcs
     void              (* mask_rect)(const dib_info *dst, const RECT *rc, const dib_info *src,
                                     const POINT *origin, int rop2);
     void             (* draw_glyph)(const dib_info *dst, const RECT *rc, const dib_info *glyph,
-                                    const POINT *origin, DWORD text_pixel, const struct intensity_range *ranges);
+                                    const POINT *origin, DWORD text_pixel, const struct font_intensities *intensity);
     void    (* draw_subpixel_glyph)(const dib_info *dst, const RECT *rc, const dib_info *glyph,
                                     const POINT *origin, DWORD text_pixel, const struct font_gamma_ramp *gamma_ramp);
     DWORD             (* get_pixel)(const dib_info *dib, int x, int y);
@@ -213,11 +225,11 @@ typedef struct primitive_funcs
                                     const dib_info *src_dib, const struct bitblt_coords *src);
 } primitive_funcs;
 
-extern const primitive_funcs funcs_8888 DECLSPEC_HIDDEN;
-extern const primitive_funcs funcs_32   DECLSPEC_HIDDEN;
+extern primitive_funcs funcs_8888       DECLSPEC_HIDDEN;
+extern primitive_funcs funcs_32         DECLSPEC_HIDDEN;
 extern const primitive_funcs funcs_24   DECLSPEC_HIDDEN;
-extern const primitive_funcs funcs_555  DECLSPEC_HIDDEN;
-extern const primitive_funcs funcs_16   DECLSPEC_HIDDEN;
+extern primitive_funcs funcs_555        DECLSPEC_HIDDEN;
+extern primitive_funcs funcs_16         DECLSPEC_HIDDEN;
 extern const primitive_funcs funcs_8    DECLSPEC_HIDDEN;
 extern const primitive_funcs funcs_4    DECLSPEC_HIDDEN;
 extern const primitive_funcs funcs_1    DECLSPEC_HIDDEN;
@@ -263,6 +275,10 @@ extern void add_clipped_bounds( dibdrv_physdev *dev, const RECT *rect, HRGN clip
 extern int clip_line(const POINT *start, const POINT *end, const RECT *clip,
                      const bres_params *params, POINT *pt1, POINT *pt2) DECLSPEC_HIDDEN;
 extern void release_cached_font( struct cached_font *font ) DECLSPEC_HIDDEN;
+extern void init_aa_text_table( struct aa_text_table *table, DWORD text,
+                                const struct intensity_range *ranges ) DECLSPEC_HIDDEN;
+extern void run_rects_in_bands( const dib_info *dst, const dib_info *src, int count, const RECT *rects,
+                                void (*func)( void *ctx, int count, const RECT *rects ), void *ctx ) DECLSPEC_HIDDEN;
 extern BOOL fill_with_pixel( DC *dc, dib_info *dib, DWORD pixel, int num, const RECT *rects, INT rop ) DECLSPEC_HIDDEN;
 
 static inline void init_clipped_rects( struct clipped_rects *clip_rects )
@@ -27,6 +27,7 @@
 #include "ntgdi_private.h"
 #include "dibdrv.h"
 
+#include "wine/server.h"
 #include "wine/debug.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(dib);
@@ -62,6 +63,37 @@ static struct list font_cache = LIST_INIT( font_cache );
 
 static pthread_mutex_t font_cache_lock = PTHREAD_MUTEX_INITIALIZER;
 
+/* Glyph bitmaps are also published in a mapping shared by all processes.
+ * Entries are appended to an arena and chained in hash buckets; both the
+ * allocation pointer and the bucket heads are tagged with a generation
+ * number. When the arena is full the generation is incremented, which
+ * invalidates all the existing entries at once. Readers don't lock, they
+ * copy an entry and check its generation and checksum afterwards. */
+
+#define GLYPH_SHM_BUCKETS   8192
+#define GLYPH_SHM_MAX_CHAIN 64
+
+struct glyph_shm_header
+{
+    LONG64 alloc;                         /* generation and offset of the free space */
+    LONG64 buckets[GLYPH_SHM_BUCKETS];    /* generation and offset of the first entry */
+};
+
+struct glyph_shm_entry
+{
+    struct glyph_cache_key key;
+    UINT                   index;     /* glyph index in the font */
+    UINT                   next;      /* next entry in the bucket, same generation */
+    UINT                   size;      /* size of the bits */
+    UINT                   checksum;  /* checksum of all the other fields and the bits */
+    GLYPHMETRICS           metrics;
+    BYTE                   bits[1];
+};
+
+#define GLYPH_SHM_START ((sizeof(struct glyph_shm_header) + 15) & ~15)
+
+static struct glyph_shm_header *glyph_shm;
+
 
 static BOOL brush_rect( dibdrv_physdev *pdev, dib_brush *brush, const RECT *rect, HRGN clip )
 {
@@ -657,6 +689,168 @@ static struct cached_glyph *get_cached_glyph( struct cached_font *font, UINT ind
     return font->glyphs[type][page][index % GLYPH_CACHE_PAGE_SIZE];
 }
 
+static void init_glyph_shm(void)
+{
+    static const WCHAR valsW[] = {'n','N','f','F','0',0};
+    char value_buffer[FIELD_OFFSET(KEY_VALUE_PARTIAL_INFORMATION, Data[20 * sizeof(WCHAR)])];
+    KEY_VALUE_PARTIAL_INFORMATION *info = (void *)value_buffer;
+    HKEY hkey;
+
+    /* @@ Wine registry key: HKCU\Software\Wine\Fonts */
+    if ((hkey = reg_open_hkcu_key( "Software\\Wine\\Fonts" )))
+    {
+        BOOL disabled = query_reg_ascii_value( hkey, "SharedGlyphCache", info, sizeof(value_buffer) ) &&
+                        info->Type == REG_SZ && wcschr( valsW, *(const WCHAR *)info->Data );
+        NtClose( hkey );
+        if (disabled)
+        {
+            TRACE( "shared glyph cache disabled\n" );
+            return;
+        }
+    }
+    glyph_shm = map_writable_shared_section( "\\KernelObjects\\__wine_glyph_cache", GLYPH_CACHE_SIZE );
+    TRACE( "shared glyph cache %p\n", glyph_shm );
+}
+
+static struct glyph_shm_header *get_glyph_shm(void)
+{
+    static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+
+    pthread_once( &init_once, init_glyph_shm );
+    return glyph_shm;
+}
+
+static UINT glyph_key_hash( const struct glyph_cache_key *key, UINT index )
+{
+    const UINT *ptr = (const UINT *)key;
+    UINT i, hash = index;
+
+    for (i = 0; i < sizeof(*key) / sizeof(UINT); i++) hash = hash * 65599 + ptr[i];
+    return hash;
+}
+
+static UINT glyph_shm_checksum( const struct glyph_shm_entry *entry )
+{
+    const BYTE *ptr = (const BYTE *)&entry->metrics;
+    UINT i, sum = glyph_key_hash( &entry->key, entry->index ) ^ entry->size ^ entry->next;
+
+    for (i = 0; i < sizeof(entry->metrics); i++) sum = sum * 65599 + ptr[i];
+    for (i = 0; i < entry->size; i++) sum = sum * 65599 + entry->bits[i];
+    return sum;
+}
+
+static inline BOOL glyph_shm_range_valid( UINT offset, UINT size )
+{
+    return offset >= GLYPH_SHM_START && !(offset & 15) && size <= GLYPH_CACHE_SIZE - offset;
+}
+
+/***********************************************************************
+ *         find_shared_glyph
+ *
+ * Copy a glyph bitmap out of the shared glyph cache.
+ */
+static struct cached_glyph *find_shared_glyph( const struct glyph_cache_key *key, UINT index )
+{
+    struct glyph_shm_header *shm = get_glyph_shm();
+    const struct glyph_shm_entry *entry;
+    struct glyph_shm_entry *copy = NULL;
+    struct cached_glyph *glyph;
+    UINT i, hash, gen, offset, next, size;
+    LONG64 head;
+
+    if (!shm) return NULL;
+
+    hash = glyph_key_hash( key, index );
+    gen = __atomic_load_n( &shm->alloc, __ATOMIC_ACQUIRE ) >> 32;
+    head = __atomic_load_n( &shm->buckets[hash % GLYPH_SHM_BUCKETS], __ATOMIC_ACQUIRE );
+    if ((UINT)(head >> 32) != gen) return NULL;
+
+    for (i = 0, offset = (UINT)head; offset && i < GLYPH_SHM_MAX_CHAIN; i++, offset = next)
+    {
+        if (!glyph_shm_range_valid( offset, sizeof(*entry) )) return NULL;
+        entry = (const struct glyph_shm_entry *)((char *)shm + offset);
+        if (entry->index != index || memcmp( &entry->key, key, sizeof(*key) ))
+        {
+            /* only follow the link if the entry can't have been recycled under us */
+            next = __atomic_load_n( &entry->next, __ATOMIC_ACQUIRE );
+            if ((UINT)(__atomic_load_n( &shm->alloc, __ATOMIC_ACQUIRE ) >> 32) != gen) return NULL;
+            continue;
+        }
+
+        size = entry->size;
+        if (size > GLYPH_CACHE_SIZE - offset - FIELD_OFFSET( struct glyph_shm_entry, bits )) return NULL;
+        if (!(copy = malloc( FIELD_OFFSET( struct glyph_shm_entry, bits[size] )))) return NULL;
+        memcpy( copy, entry, FIELD_OFFSET( struct glyph_shm_entry, bits[size] ));
+        __atomic_thread_fence( __ATOMIC_ACQUIRE );
+
+        /* the entry may have been recycled while we were copying it */
+        if ((UINT)(__atomic_load_n( &shm->alloc, __ATOMIC_ACQUIRE ) >> 32) != gen ||
+            copy->size != size || copy->checksum != glyph_shm_checksum( copy ) ||
+            copy->index != index || memcmp( &copy->key, key, sizeof(*key) ))
+            break;
+
+        if ((glyph = malloc( FIELD_OFFSET( struct cached_glyph, bits[size] ))))
+        {
+            glyph->metrics = copy->metrics;
+            memcpy( glyph->bits, copy->bits, size );
+        }
+        free( copy );
+        return glyph;
+    }
+    free( copy );
+    return NULL;
+}
+
+/***********************************************************************
+ *         publish_shared_glyph
+ *
+ * Add a glyph bitmap to the shared glyph cache, recycling the cache if it is full.
+ */
+static void publish_shared_glyph( const struct glyph_cache_key *key, UINT index,
+                                  const struct cached_glyph *glyph, UINT size )
+{
+    struct glyph_shm_header *shm = get_glyph_shm();
+    struct glyph_shm_entry *entry;
+    LONG64 alloc, new_alloc, head, *bucket;
+    UINT gen, offset, entry_size;
+
+    if (!shm || size > (GLYPH_CACHE_SIZE - GLYPH_SHM_START) / 16) return;
+    entry_size = (FIELD_OFFSET( struct glyph_shm_entry, bits[size] ) + 15) & ~15;
+    if (entry_size > (GLYPH_CACHE_SIZE - GLYPH_SHM_START) / 16) return;
+
+    alloc = __atomic_load_n( &shm->alloc, __ATOMIC_ACQUIRE );
+    do
+    {
+        gen = alloc >> 32;
+        offset = max( (UINT)alloc, GLYPH_SHM_START );
+        if (offset > GLYPH_CACHE_SIZE - entry_size)
+        {
+            TRACE( "recycling shared glyph cache, generation %u\n", gen + 1 );
+            gen++;
+            offset = GLYPH_SHM_START;
+        }
+        new_alloc = ((LONG64)gen << 32) | (offset + entry_size);
+    } while (!__atomic_compare_exchange_n( &shm->alloc, &alloc, new_alloc, FALSE,
+                                           __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ));
+
+    entry = (struct glyph_shm_entry *)((char *)shm + offset);
+    entry->key      = *key;
+    entry->index    = index;
+    entry->size     = size;
+    entry->metrics  = glyph->metrics;
+    memcpy( entry->bits, glyph->bits, size );
+
+    bucket = &shm->buckets[glyph_key_hash( key, index ) % GLYPH_SHM_BUCKETS];
+    head = __atomic_load_n( bucket, __ATOMIC_ACQUIRE );
+    do
+    {
+        if ((UINT)(head >> 32) > gen) return;  /* the cache has been recycled in the meantime */
+        entry->next = ((UINT)(head >> 32) == gen) ? (UINT)head : 0;
+        entry->checksum = glyph_shm_checksum( entry );
+    } while (!__atomic_compare_exchange_n( bucket, &head, ((LONG64)gen << 32) | offset, FALSE,
+                                           __ATOMIC_RELEASE, __ATOMIC_ACQUIRE ));
+}
+
 /**********************************************************************
  *                 get_text_bkgnd_masks
  *
@@ -678,36 +872,77 @@ static inline void get_text_bkgnd_masks( DC *dc, const dib_info *dib, rop_mask *
     }
 }
 
-static void draw_glyph( dib_info *dib, int x, int y, const GLYPHMETRICS *metrics,
-                        const dib_info *glyph_dib, DWORD text_color,
-                        const struct font_intensities *intensity,
-                        const struct clipped_rects *clipped_rects, RECT *bounds )
+struct glyph_run
 {
-    int i;
-    RECT rect, clipped_rect;
+    const struct cached_glyph *glyph;
+    RECT                       rect;   /* glyph black box in device coordinates */
+};
+
+/* blackbox area from which building a blend table for the text color pays off */
+#define AA_TEXT_TABLE_MIN_AREA 16384
+
+static void draw_glyph( dib_info *dib, const struct glyph_run *run, dib_info *glyph_dib,
+                        DWORD text_color, const struct font_intensities *intensity,
+                        const RECT *clip )
+{
+    const GLYPHMETRICS *metrics = &run->glyph->metrics;
+    RECT clipped_rect;
     POINT src_origin;
 
-    rect.left   = x          + metrics->gmptGlyphOrigin.x;
-    rect.top    = y          - metrics->gmptGlyphOrigin.y;
-    rect.right  = rect.left  + metrics->gmBlackBoxX;
-    rect.bottom = rect.top   + metrics->gmBlackBoxY;
-    if (bounds) add_bounds_rect( bounds, &rect );
+    if (!clip) clipped_rect = run->rect;
+    else if (!intersect_rect( &clipped_rect, &run->rect, clip )) return;
 
-    for (i = 0; i < clipped_rects->count; i++)
+    glyph_dib->width       = metrics->gmBlackBoxX;
+    glyph_dib->height      = metrics->gmBlackBoxY;
+    glyph_dib->rect.right  = metrics->gmBlackBoxX;
+    glyph_dib->rect.bottom = metrics->gmBlackBoxY;
+    glyph_dib->stride      = get_dib_stride( metrics->gmBlackBoxX, glyph_dib->bit_count );
+    glyph_dib->bits.ptr    = (void *)run->glyph->bits;
+
+    src_origin.x = clipped_rect.left - run->rect.left;
+    src_origin.y = clipped_rect.top  - run->rect.top;
+
+    if (glyph_dib->bit_count == 32)
+        dib->funcs->draw_subpixel_glyph( dib, &clipped_rect, glyph_dib, &src_origin,
+                                         text_color, intensity->gamma_ramp );
+    else
+        dib->funcs->draw_glyph( dib, &clipped_rect, glyph_dib, &src_origin,
+                                text_color, intensity );
+}
+
+/***********************************************************************
+ *         get_aa_text_table
+ *
+ * Find the blend table for the given text color, moving it to the front
+ * of the cache. A new table is only built when the caller has enough
+ * pixels to draw to amortize its cost.
+ */
+static const struct aa_text_table *get_aa_text_table( struct aa_text_table **tables, DWORD text,
+                                                      const struct intensity_range *ranges,
+                                                      BOOL create )
+{
+    struct aa_text_table *table;
+    int i;
+
+    for (i = 0; i < AA_TEXT_TABLES; i++)
     {
-        if (intersect_rect( &clipped_rect, &rect, clipped_rects->rects + i ))
-        {
-            src_origin.x = clipped_rect.left - rect.left;
-            src_origin.y = clipped_rect.top  - rect.top;
+        if (!tables[i]) break;
+        if (tables[i]->text != text) continue;
+        table = tables[i];
+        memmove( tables + 1, tables, i * sizeof(*tables) );
+        return tables[0] = table;
+    }
+    if (!create) return NULL;
 
-            if (glyph_dib->bit_count == 32)
-                dib->funcs->draw_subpixel_glyph( dib, &clipped_rect, glyph_dib, &src_origin,
-                                                 text_color, intensity->gamma_ramp );
-            else
-                dib->funcs->draw_glyph( dib, &clipped_rect, glyph_dib, &src_origin,
-                                        text_color, intensity->ranges );
-        }
+    if (i == AA_TEXT_TABLES)
+    {
+        table = tables[--i];
     }
+    else if (!(table = malloc( sizeof(*table) ))) return NULL;
+
+    init_aa_text_table( table, text, ranges );
+    memmove( tables + 1, tables, i * sizeof(*tables) );
+    return tables[0] = table;
 }
 
 static int get_glyph_depth( UINT aa_flags )
@@ -753,8 +988,15 @@ static struct cached_glyph *cache_glyph_bitmap( DC *dc, struct cached_font *font
     int pad = 0, stride, bit_count;
     GLYPHMETRICS metrics;
     struct cached_glyph *glyph;
+    struct glyph_cache_key key;
+    UINT key_index;
+    BOOL shared;
 
     if (flags & ETO_GLYPH_INDEX) ggo_flags |= GGO_GLYPH_INDEX;
+    if ((shared = get_glyph_cache_key( dc, index, ggo_flags, &key, &key_index )) &&
+        (glyph = find_shared_glyph( &key, key_index )))
+        return add_cached_glyph( font, index, flags, glyph );
+
     indices[0] = index;
     for (i = 0; i < ARRAY_SIZE( indices ); i++)
     {
@@ -804,45 +1046,48 @@ static struct cached_glyph *cache_glyph_bitmap( DC *dc, struct cached_font *font
 
 done:
     glyph->metrics = metrics;
+    if (shared && !i) publish_shared_glyph( &key, key_index, glyph, size );
     return add_cached_glyph( font, index, flags, glyph );
 }
 
+/***********************************************************************
+ *         render_string
+ *
+ * Glyphs are looked up and positioned once, then the whole run is drawn
+ * for each clip rectangle it touches.
+ */
 static void render_string( DC *dc, dib_info *dib, struct cached_font *font, INT x, INT y,
                            UINT flags, const WCHAR *str, UINT count, const INT *dx,
-                           const struct clipped_rects *clipped_rects, RECT *bounds )
+                           const struct clipped_rects *clipped_rects, RECT *bounds,
+                           struct aa_text_table **tables )
 {
-    UINT i;
+    UINT i, j, runs = 0, area = 0;
+    struct glyph_run buffer[64], *run = buffer;
     struct cached_glyph *glyph;
     dib_info glyph_dib;
     DWORD text_color;
     struct font_intensities intensity;
+    RECT run_rect, clipped_rect;
 
-    glyph_dib.bit_count    = get_glyph_depth( font->aa_flags );
-    glyph_dib.rect.left    = 0;
-    glyph_dib.rect.top     = 0;
-    glyph_dib.bits.is_copy = FALSE;
-    glyph_dib.bits.free    = NULL;
-
-    text_color = get_pixel_color( dc, dib, dc->attr->text_color, TRUE );
-
-    if (glyph_dib.bit_count == 32)
-        intensity.gamma_ramp = dc->font_gamma_ramp;
-    else
-        get_aa_ranges( dib->funcs->pixel_to_colorref( dib, text_color ), intensity.ranges );
+    if (count > ARRAY_SIZE(buffer) && !(run = malloc( count * sizeof(*run) ))) return;
 
+    reset_bounds( &run_rect );
     for (i = 0; i < count; i++)
     {
         if (!(glyph = get_cached_glyph( font, str[i], flags )) &&
             !(glyph = cache_glyph_bitmap( dc, font, str[i], flags ))) continue;
 
-        glyph_dib.width       = glyph->metrics.gmBlackBoxX;
-        glyph_dib.height      = glyph->metrics.gmBlackBoxY;
-        glyph_dib.rect.right  = glyph->metrics.gmBlackBoxX;
-        glyph_dib.rect.bottom = glyph->metrics.gmBlackBoxY;
-        glyph_dib.stride      = get_dib_stride( glyph->metrics.gmBlackBoxX, glyph_dib.bit_count );
-        glyph_dib.bits.ptr    = glyph->bits;
-
-        draw_glyph( dib, x, y, &glyph->metrics, &glyph_dib, text_color, &intensity, clipped_rects, bounds );
+        run[runs].glyph       = glyph;
+        run[runs].rect.left   = x + glyph->metrics.gmptGlyphOrigin.x;
+        run[runs].rect.top    = y - glyph->metrics.gmptGlyphOrigin.y;
+        run[runs].rect.right  = run[runs].rect.left + glyph->metrics.gmBlackBoxX;
+        run[runs].rect.bottom = run[runs].rect.top  + glyph->metrics.gmBlackBoxY;
+        if (!is_rect_empty( &run[runs].rect ))
+        {
+            add_bounds_rect( &run_rect, &run[runs].rect );
+            area += glyph->metrics.gmBlackBoxX * glyph->metrics.gmBlackBoxY;
+            runs++;
+        }
 
         if (dx)
         {
@@ -860,6 +1105,46 @@ static void render_string( DC *dc, dib_info *dib, struct cached_font *font, INT
             y += glyph->metrics.gmCellIncY;
         }
     }
+    if (!runs) goto done;
+    if (bounds) add_bounds_rect( bounds, &run_rect );
+
+    glyph_dib.bit_count    = get_glyph_depth( font->aa_flags );
+    glyph_dib.rect.left    = 0;
+    glyph_dib.rect.top     = 0;
+    glyph_dib.bits.is_copy = FALSE;
+    glyph_dib.bits.free    = NULL;
+
+    text_color = get_pixel_color( dc, dib, dc->attr->text_color, TRUE );
+    intensity.table = NULL;
+
+    if (glyph_dib.bit_count == 32)
+        intensity.gamma_ramp = dc->font_gamma_ramp;
+    else
+    {
+        COLORREF color = dib->funcs->pixel_to_colorref( dib, text_color );
+
+        get_aa_ranges( color, intensity.ranges );
+        if (tables && font->aa_flags != GGO_BITMAP)
+            intensity.table = get_aa_text_table( tables, GetRValue(color) << 16 |
+                                                 GetGValue(color) << 8 | GetBValue(color),
+                                                 intensity.ranges, area >= AA_TEXT_TABLE_MIN_AREA );
+    }
+
+    for (i = 0; i < clipped_rects->count; i++)
+    {
+        if (!intersect_rect( &clipped_rect, &run_rect, clipped_rects->rects + i )) continue;
+
+        /* no need to clip the individual glyphs if the whole run is visible */
+        if (!memcmp( &clipped_rect, &run_rect, sizeof(RECT) ))
+            for (j = 0; j < runs; j++)
+                draw_glyph( dib, run + j, &glyph_dib, text_color, &intensity, NULL );
+        else
+            for (j = 0; j < runs; j++)
+                draw_glyph( dib, run + j, &glyph_dib, text_color, &intensity, &clipped_rect );
+    }
+
+done:
+    if (run != buffer) free( run );
 }
 
 BOOL render_aa_text_bitmapinfo( DC *dc, BITMAPINFO *info, struct gdi_image_bits *bits,
@@ -886,7 +1171,7 @@ BOOL render_aa_text_bitmapinfo( DC *dc, BITMAPINFO *info, struct gdi_image_bits
 
     if (!(font = add_cached_font( dc, dc->hFont, aa_flags ))) return FALSE;
 
-    render_string( dc, &dib, font, x, y, flags, str, count, dx, &visrect, NULL );
+    render_string( dc, &dib, font, x, y, flags, str, count, dx, &visrect, NULL, NULL );
     release_cached_font( font );
     return TRUE;
 }
@@ -932,7 +1217,7 @@ BOOL CDECL dibdrv_ExtTextOut( PHYSDEV dev, INT x, INT y, UINT flags,
     if (!clipped_rects.count) goto done;
 
     render_string( dc, &pdev->dib, pdev->font, x, y, flags, str, count, dx,
-                   &clipped_rects, &bounds );
+                   &clipped_rects, &bounds, pdev->text_tables );
 
 done:
     add_clipped_bounds( pdev, &bounds, pdev->clip );
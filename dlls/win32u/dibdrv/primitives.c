@@ -23,6 +23,11 @@
 #endif
 
 #include <assert.h>
+#include <pthread.h>
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#include <emmintrin.h>
+#define USE_SSE2_PRIMITIVES
+#endif
 
 #include "ntgdi_private.h"
 #include "dibdrv.h"
@@ -6133,11 +6138,42 @@ static inline DWORD aa_rgb( BYTE r_dst, BYTE g_dst, BYTE b_dst, DWORD text, cons
             aa_color( r_dst, text >> 16, range->r_min, range->r_max ) << 16);
 }
 
+static inline DWORD aa_rgb_table( BYTE r_dst, BYTE g_dst, BYTE b_dst, const BYTE (*blend)[256] )
+{
+    return blend[0][b_dst] | blend[1][g_dst] << 8 | blend[2][r_dst] << 16;
+}
+
+/* blend tables are only valid for the text color they were built for */
+static inline const struct aa_text_table *get_aa_table( const struct font_intensities *intensity, DWORD text )
+{
+    if (intensity->table && intensity->table->text == (text & 0xffffff)) return intensity->table;
+    return NULL;
+}
+
+void init_aa_text_table( struct aa_text_table *table, DWORD text, const struct intensity_range *ranges )
+{
+    int level, dst;
+
+    table->text = text & 0xffffff;
+    for (level = 2; level < 16; level++)
+    {
+        const struct intensity_range *range = ranges + level;
+
+        for (dst = 0; dst < 256; dst++)
+        {
+            table->blend[level][0][dst] = aa_color( dst, text,       range->b_min, range->b_max );
+            table->blend[level][1][dst] = aa_color( dst, text >> 8,  range->g_min, range->g_max );
+            table->blend[level][2][dst] = aa_color( dst, text >> 16, range->r_min, range->r_max );
+        }
+    }
+}
+
 static void draw_glyph_8888( const dib_info *dib, const RECT *rect, const dib_info *glyph,
-                             const POINT *origin, DWORD text_pixel, const struct intensity_range *ranges )
+                             const POINT *origin, DWORD text_pixel, const struct font_intensities *intensity )
 {
     DWORD *dst_ptr = get_pixel_ptr_32( dib, rect->left, rect->top );
     const BYTE *glyph_ptr = get_pixel_ptr_8( glyph, origin->x, origin->y );
+    const struct aa_text_table *table = get_aa_table( intensity, text_pixel );
     int x, y;
 
     for (y = rect->top; y < rect->bottom; y++)
@@ -6146,7 +6182,12 @@ static void draw_glyph_8888( const dib_info *dib, const RECT *rect, const dib_in
         {
             if (glyph_ptr[x] <= 1) continue;
             if (glyph_ptr[x] >= 16) { dst_ptr[x] = text_pixel; continue; }
-            dst_ptr[x] = aa_rgb( dst_ptr[x] >> 16, dst_ptr[x] >> 8, dst_ptr[x], text_pixel, ranges + glyph_ptr[x] );
+            if (table)
+                dst_ptr[x] = aa_rgb_table( dst_ptr[x] >> 16, dst_ptr[x] >> 8, dst_ptr[x],
+                                           table->blend[glyph_ptr[x]] );
+            else
+                dst_ptr[x] = aa_rgb( dst_ptr[x] >> 16, dst_ptr[x] >> 8, dst_ptr[x], text_pixel,
+                                     intensity->ranges + glyph_ptr[x] );
         }
         dst_ptr += dib->stride / 4;
         glyph_ptr += glyph->stride;
@@ -6154,16 +6195,18 @@ static void draw_glyph_8888( const dib_info *dib, const RECT *rect, const dib_in
 }
 
 static void draw_glyph_32( const dib_info *dib, const RECT *rect, const dib_info *glyph,
-                           const POINT *origin, DWORD text_pixel, const struct intensity_range *ranges )
+                           const POINT *origin, DWORD text_pixel, const struct font_intensities *intensity )
 {
     DWORD *dst_ptr = get_pixel_ptr_32( dib, rect->left, rect->top );
     const BYTE *glyph_ptr = get_pixel_ptr_8( glyph, origin->x, origin->y );
+    const struct aa_text_table *table;
     int x, y;
     DWORD text, val;
 
     text = get_field( text_pixel, dib->red_shift,   dib->red_len ) << 16 |
            get_field( text_pixel, dib->green_shift, dib->green_len ) << 8 |
            get_field( text_pixel, dib->blue_shift,  dib->blue_len );
+    table = get_aa_table( intensity, text );
 
     for (y = rect->top; y < rect->bottom; y++)
     {
@@ -6171,10 +6214,16 @@ static void draw_glyph_32( const dib_info *dib, const RECT *rect, const dib_info
         {
             if (glyph_ptr[x] <= 1) continue;
             if (glyph_ptr[x] >= 16) { dst_ptr[x] = text_pixel; continue; }
-            val = aa_rgb( get_field(dst_ptr[x], dib->red_shift,   dib->red_len),
-                          get_field(dst_ptr[x], dib->green_shift, dib->green_len),
-                          get_field(dst_ptr[x], dib->blue_shift,  dib->blue_len),
-                          text, ranges + glyph_ptr[x] );
+            if (table)
+                val = aa_rgb_table( get_field(dst_ptr[x], dib->red_shift,   dib->red_len),
+                                    get_field(dst_ptr[x], dib->green_shift, dib->green_len),
+                                    get_field(dst_ptr[x], dib->blue_shift,  dib->blue_len),
+                                    table->blend[glyph_ptr[x]] );
+            else
+                val = aa_rgb( get_field(dst_ptr[x], dib->red_shift,   dib->red_len),
+                              get_field(dst_ptr[x], dib->green_shift, dib->green_len),
+                              get_field(dst_ptr[x], dib->blue_shift,  dib->blue_len),
+                              text, intensity->ranges + glyph_ptr[x] );
             dst_ptr[x] = rgb_to_pixel_masks( dib, val >> 16, val >> 8, val );
         }
         dst_ptr += dib->stride / 4;
@@ -6183,13 +6232,16 @@ static void draw_glyph_32( const dib_info *dib, const RECT *rect, const dib_info
 }
 
 static void draw_glyph_24( const dib_info *dib, const RECT *rect, const dib_info *glyph,
-                           const POINT *origin, DWORD text_pixel, const struct intensity_range *ranges )
+                           const POINT *origin, DWORD text_pixel, const struct font_intensities *intensity )
 {
     BYTE *dst_ptr = get_pixel_ptr_24( dib, rect->left, rect->top );
     const BYTE *glyph_ptr = get_pixel_ptr_8( glyph, origin->x, origin->y );
+    const struct aa_text_table *table;
     int x, y;
     DWORD val;
 
+    table = get_aa_table( intensity, text_pixel );
+
     for (y = rect->top; y < rect->bottom; y++)
     {
         for (x = 0; x < rect->right - rect->left; x++)
@@ -6197,9 +6249,12 @@ static void draw_glyph_24( const dib_info *dib, const RECT *rect, const dib_info
             if (glyph_ptr[x] <= 1) continue;
             if (glyph_ptr[x] >= 16)
                 val = text_pixel;
+            else if (table)
+                val = aa_rgb_table( dst_ptr[x * 3 + 2], dst_ptr[x * 3 + 1], dst_ptr[x * 3],
+                                    table->blend[glyph_ptr[x]] );
             else
                 val = aa_rgb( dst_ptr[x * 3 + 2], dst_ptr[x * 3 + 1], dst_ptr[x * 3],
-                              text_pixel, ranges + glyph_ptr[x] );
+                              text_pixel, intensity->ranges + glyph_ptr[x] );
             dst_ptr[x * 3]     = val;
             dst_ptr[x * 3 + 1] = val >> 8;
             dst_ptr[x * 3 + 2] = val >> 16;
@@ -6210,16 +6265,18 @@ static void draw_glyph_24( const dib_info *dib, const RECT *rect, const dib_info
 }
 
 static void draw_glyph_555( const dib_info *dib, const RECT *rect, const dib_info *glyph,
-                            const POINT *origin, DWORD text_pixel, const struct intensity_range *ranges )
+                            const POINT *origin, DWORD text_pixel, const struct font_intensities *intensity )
 {
     WORD *dst_ptr = get_pixel_ptr_16( dib, rect->left, rect->top );
     const BYTE *glyph_ptr = get_pixel_ptr_8( glyph, origin->x, origin->y );
+    const struct aa_text_table *table;
     int x, y;
     DWORD text, val;
 
     text = ((text_pixel << 9) & 0xf80000) | ((text_pixel << 4) & 0x070000) |
            ((text_pixel << 6) & 0x00f800) | ((text_pixel << 1) & 0x000700) |
            ((text_pixel << 3) & 0x0000f8) | ((text_pixel >> 2) & 0x000007);
+    table = get_aa_table( intensity, text );
 
     for (y = rect->top; y < rect->bottom; y++)
     {
@@ -6227,10 +6284,16 @@ static void draw_glyph_555( const dib_info *dib, const RECT *rect, const dib_inf
         {
             if (glyph_ptr[x] <= 1) continue;
             if (glyph_ptr[x] >= 16) { dst_ptr[x] = text_pixel; continue; }
-            val = aa_rgb( ((dst_ptr[x] >> 7) & 0xf8) | ((dst_ptr[x] >> 12) & 0x07),
-                          ((dst_ptr[x] >> 2) & 0xf8) | ((dst_ptr[x] >>  7) & 0x07),
-                          ((dst_ptr[x] << 3) & 0xf8) | ((dst_ptr[x] >>  2) & 0x07),
-                          text, ranges + glyph_ptr[x] );
+            if (table)
+                val = aa_rgb_table( ((dst_ptr[x] >> 7) & 0xf8) | ((dst_ptr[x] >> 12) & 0x07),
+                                    ((dst_ptr[x] >> 2) & 0xf8) | ((dst_ptr[x] >>  7) & 0x07),
+                                    ((dst_ptr[x] << 3) & 0xf8) | ((dst_ptr[x] >>  2) & 0x07),
+                                    table->blend[glyph_ptr[x]] );
+            else
+                val = aa_rgb( ((dst_ptr[x] >> 7) & 0xf8) | ((dst_ptr[x] >> 12) & 0x07),
+                              ((dst_ptr[x] >> 2) & 0xf8) | ((dst_ptr[x] >>  7) & 0x07),
+                              ((dst_ptr[x] << 3) & 0xf8) | ((dst_ptr[x] >>  2) & 0x07),
+                              text, intensity->ranges + glyph_ptr[x] );
             dst_ptr[x] = ((val >> 9) & 0x7c00) | ((val >> 6) & 0x03e0) | ((val >> 3) & 0x001f);
         }
         dst_ptr += dib->stride / 2;
@@ -6239,16 +6302,18 @@ static void draw_glyph_555( const dib_info *dib, const RECT *rect, const dib_inf
 }
 
 static void draw_glyph_16( const dib_info *dib, const RECT *rect, const dib_info *glyph,
-                           const POINT *origin, DWORD text_pixel, const struct intensity_range *ranges )
+                           const POINT *origin, DWORD text_pixel, const struct font_intensities *intensity )
 {
     WORD *dst_ptr = get_pixel_ptr_16( dib, rect->left, rect->top );
     const BYTE *glyph_ptr = get_pixel_ptr_8( glyph, origin->x, origin->y );
+    const struct aa_text_table *table;
     int x, y;
     DWORD text, val;
 
     text = get_field( text_pixel, dib->red_shift,   dib->red_len ) << 16 |
            get_field( text_pixel, dib->green_shift, dib->green_len ) << 8 |
            get_field( text_pixel, dib->blue_shift,  dib->blue_len );
+    table = get_aa_table( intensity, text );
 
     for (y = rect->top; y < rect->bottom; y++)
     {
@@ -6256,10 +6321,16 @@ static void draw_glyph_16( const dib_info *dib, const RECT *rect, const dib_info
         {
             if (glyph_ptr[x] <= 1) continue;
             if (glyph_ptr[x] >= 16) { dst_ptr[x] = text_pixel; continue; }
-            val = aa_rgb( get_field(dst_ptr[x], dib->red_shift,   dib->red_len),
-                          get_field(dst_ptr[x], dib->green_shift, dib->green_len),
-                          get_field(dst_ptr[x], dib->blue_shift,  dib->blue_len),
-                          text, ranges + glyph_ptr[x] );
+            if (table)
+                val = aa_rgb_table( get_field(dst_ptr[x], dib->red_shift,   dib->red_len),
+                                    get_field(dst_ptr[x], dib->green_shift, dib->green_len),
+                                    get_field(dst_ptr[x], dib->blue_shift,  dib->blue_len),
+                                    table->blend[glyph_ptr[x]] );
+            else
+                val = aa_rgb( get_field(dst_ptr[x], dib->red_shift,   dib->red_len),
+                              get_field(dst_ptr[x], dib->green_shift, dib->green_len),
+                              get_field(dst_ptr[x], dib->blue_shift,  dib->blue_len),
+                              text, intensity->ranges + glyph_ptr[x] );
             dst_ptr[x] = rgb_to_pixel_masks( dib, val >> 16, val >> 8, val );
         }
         dst_ptr += dib->stride / 2;
@@ -6268,7 +6339,7 @@ static void draw_glyph_16( const dib_info *dib, const RECT *rect, const dib_info
 }
 
 static void draw_glyph_8( const dib_info *dib, const RECT *rect, const dib_info *glyph,
-                          const POINT *origin, DWORD text_pixel, const struct intensity_range *ranges )
+                          const POINT *origin, DWORD text_pixel, const struct font_intensities *intensity )
 {
     BYTE *dst_ptr = get_pixel_ptr_8( dib, rect->left, rect->top );
     const BYTE *glyph_ptr = get_pixel_ptr_8( glyph, origin->x, origin->y );
@@ -6288,7 +6359,7 @@ static void draw_glyph_8( const dib_info *dib, const RECT *rect, const dib_info
 }
 
 static void draw_glyph_4( const dib_info *dib, const RECT *rect, const dib_info *glyph,
-                          const POINT *origin, DWORD text_pixel, const struct intensity_range *ranges )
+                          const POINT *origin, DWORD text_pixel, const struct font_intensities *intensity )
 {
     BYTE *dst_ptr = get_pixel_ptr_4( dib, rect->left, rect->top );
     const BYTE *glyph_ptr = get_pixel_ptr_8( glyph, origin->x, origin->y );
@@ -6313,7 +6384,7 @@ static void draw_glyph_4( const dib_info *dib, const RECT *rect, const dib_info
 }
 
 static void draw_glyph_1( const dib_info *dib, const RECT *rect, const dib_info *glyph,
-                          const POINT *origin, DWORD text_pixel, const struct intensity_range *ranges )
+                          const POINT *origin, DWORD text_pixel, const struct font_intensities *intensity )
 {
     BYTE *dst_ptr = get_pixel_ptr_1( dib, rect->left, rect->top );
     const BYTE *glyph_ptr = get_pixel_ptr_8( glyph, origin->x, origin->y );
@@ -6335,7 +6406,7 @@ static void draw_glyph_1( const dib_info *dib, const RECT *rect, const dib_info
 }
 
 static void draw_glyph_null( const dib_info *dib, const RECT *rect, const dib_info *glyph,
-                             const POINT *origin, DWORD text_pixel, const struct intensity_range *ranges )
+                             const POINT *origin, DWORD text_pixel, const struct font_intensities *intensity )
 {
     return;
 }
@@ -7481,321 +7552,266 @@ static void calc_halftone_params( const struct bitblt_coords *dst, const struct
     *src_inc_y = mirrored_y ? -(float)src_height / dst_height : (float)src_height / dst_height;
 }
 
-static void halftone_888( const dib_info *dst_dib, const struct bitblt_coords *dst,
-                          const dib_info *src_dib, const struct bitblt_coords *src )
+/* weights of the halftone resampling filters are fixed point numbers with this many fractional bits */
+#define HALFTONE_WEIGHT_BITS 14
+#define HALFTONE_MAX_FILTERS 8
+
+/* resampling filter for one dimension, from src_len to dst_len pixels */
+struct halftone_filter
 {
-    int src_start_x, src_start_y, src_ptr_dy, dst_x, dst_y, x0, x1, y0, y1;
-    DWORD *dst_ptr, *src_ptr, *c00_ptr, *c01_ptr, *c10_ptr, *c11_ptr;
-    float src_inc_x, src_inc_y, float_x, float_y, dx, dy;
-    BYTE c00_r, c01_r, c10_r, c11_r;
-    BYTE c00_g, c01_g, c10_g, c11_g;
-    BYTE c00_b, c01_b, c10_b, c11_b;
-    RECT dst_rect, src_rect;
-    BYTE r, g, b;
+    struct list  entry;
+    unsigned int refcount;
+    int          src_len;
+    int          dst_len;
+    int          taps;      /* number of source pixels used for each destination pixel */
+    int         *start;     /* first source pixel for each destination pixel */
+    short       *weights;   /* taps weights for each destination pixel */
+};
 
-    calc_halftone_params( dst, src, &dst_rect, &src_rect, &src_start_x, &src_start_y, &src_inc_x,
-                          &src_inc_y );
+static struct list halftone_filters = LIST_INIT( halftone_filters );
+static unsigned int halftone_filter_count;
+static pthread_mutex_t halftone_filter_lock = PTHREAD_MUTEX_INITIALIZER;
 
-    float_y = src_start_y;
-    dst_ptr = get_pixel_ptr_32( dst_dib, dst_rect.left, dst_rect.top );
-    for (dst_y = 0; dst_y < dst_rect.bottom - dst_rect.top; ++dst_y)
-    {
-        float_y = clampf( float_y, src_rect.top, src_rect.bottom - 1 );
-        y0 = float_y;
-        y1 = clamp( y0 + 1, src_rect.top, src_rect.bottom - 1 );
-        dy = float_y - y0;
+/* area averaging when shrinking, linear interpolation between pixel centers when stretching */
+static struct halftone_filter *create_halftone_filter( int src_len, int dst_len )
+{
+    struct halftone_filter *filter;
+    double scale = (double)src_len / dst_len, x0, x1, pos, total;
+    int i, j, first, last, start, taps, prev, next;
+    short *w;
 
-        float_x = src_start_x;
-        src_ptr = get_pixel_ptr_32( src_dib, 0, y0 );
-        src_ptr_dy = (y1 - y0) * src_dib->stride / 4;
-        for (dst_x = 0; dst_x < dst_rect.right - dst_rect.left; ++dst_x)
-        {
-            float_x = clampf( float_x, src_rect.left, src_rect.right - 1 );
-            x0 = float_x;
-            x1 = clamp( x0 + 1, src_rect.left, src_rect.right - 1 );
-            dx = float_x - x0;
+    if (src_len > dst_len) taps = min( (int)ceil( scale ) + 1, src_len );
+    else taps = min( 2, src_len );
 
-            c00_ptr = src_ptr + x0;
-            c01_ptr = src_ptr + x1;
-            c10_ptr = c00_ptr + src_ptr_dy;
-            c11_ptr = c01_ptr + src_ptr_dy;
-            c00_r = (*c00_ptr >> 16) & 0xff;
-            c01_r = (*c01_ptr >> 16) & 0xff;
-            c10_r = (*c10_ptr >> 16) & 0xff;
-            c11_r = (*c11_ptr >> 16) & 0xff;
-            c00_g = (*c00_ptr >> 8) & 0xff;
-            c01_g = (*c01_ptr >> 8) & 0xff;
-            c10_g = (*c10_ptr >> 8) & 0xff;
-            c11_g = (*c11_ptr >> 8) & 0xff;
-            c00_b = *c00_ptr & 0xff;
-            c01_b = *c01_ptr & 0xff;
-            c10_b = *c10_ptr & 0xff;
-            c11_b = *c11_ptr & 0xff;
-            r = bilinear_interpolate( c00_r, c01_r, c10_r, c11_r, dx, dy );
-            g = bilinear_interpolate( c00_g, c01_g, c10_g, c11_g, dx, dy );
-            b = bilinear_interpolate( c00_b, c01_b, c10_b, c11_b, dx, dy );
-            dst_ptr[dst_x] = ((r << 16) & 0xff0000) | ((g << 8) & 0x00ff00) | (b & 0x0000ff);
+    if (!(filter = malloc( sizeof(*filter) + dst_len * (sizeof(int) + taps * sizeof(short)) ))) return NULL;
+    filter->src_len = src_len;
+    filter->dst_len = dst_len;
+    filter->taps    = taps;
+    filter->start   = (int *)(filter + 1);
+    filter->weights = (short *)(filter->start + dst_len);
+    memset( filter->weights, 0, dst_len * taps * sizeof(short) );
 
-            float_x += src_inc_x;
+    for (i = 0; i < dst_len; i++)
+    {
+        x0 = x1 = pos = 0.0;
+        if (src_len > dst_len)
+        {
+            x0 = i * scale;
+            x1 = (i + 1) * scale;
+            first = floor( x0 );
+            last = min( (int)ceil( x1 ), src_len ) - 1;
         }
+        else
+        {
+            pos = max( 0.0, min( (i + 0.5) * scale - 0.5, src_len - 1.0 ));
+            first = floor( pos );
+            last = min( first + 1, src_len - 1 );
+        }
+        start = min( first, src_len - taps );
+        w = filter->weights + i * taps;
 
-        dst_ptr += dst_dib->stride / 4;
-        float_y += src_inc_y;
+        /* round the running total so that the weights add up exactly to one */
+        for (j = first, total = 0.0, prev = 0; j <= last; j++)
+        {
+            if (src_len > dst_len) total += (min( x1, j + 1.0 ) - max( x0, (double)j )) / scale;
+            else if (j == first) total += 1.0 - (pos - first);
+            else total += pos - first;
+            next = (j == last) ? 1 << HALFTONE_WEIGHT_BITS : floor( total * (1 << HALFTONE_WEIGHT_BITS) + 0.5 );
+            w[j - start] = next - prev;
+            prev = next;
+        }
+        filter->start[i] = start;
     }
+    return filter;
 }
 
-static void halftone_32( const dib_info *dst_dib, const struct bitblt_coords *dst,
-                         const dib_info *src_dib, const struct bitblt_coords *src )
+static void release_halftone_filter( struct halftone_filter *filter )
 {
-    int src_start_x, src_start_y, src_ptr_dy, dst_x, dst_y, x0, x1, y0, y1;
-    DWORD *dst_ptr, *src_ptr, *c00_ptr, *c01_ptr, *c10_ptr, *c11_ptr;
-    float src_inc_x, src_inc_y, float_x, float_y, dx, dy;
-    BYTE c00_r, c01_r, c10_r, c11_r;
-    BYTE c00_g, c01_g, c10_g, c11_g;
-    BYTE c00_b, c01_b, c10_b, c11_b;
-    RECT dst_rect, src_rect;
-    BYTE r, g, b;
+    unsigned int refcount;
 
-    calc_halftone_params( dst, src, &dst_rect, &src_rect, &src_start_x, &src_start_y, &src_inc_x,
-                          &src_inc_y );
-
-    float_y = src_start_y;
-    dst_ptr = get_pixel_ptr_32( dst_dib, dst_rect.left, dst_rect.top );
-    for (dst_y = 0; dst_y < dst_rect.bottom - dst_rect.top; ++dst_y)
-    {
-        float_y = clampf( float_y, src_rect.top, src_rect.bottom - 1 );
-        y0 = float_y;
-        y1 = clamp( y0 + 1, src_rect.top, src_rect.bottom - 1 );
-        dy = float_y - y0;
-
-        float_x = src_start_x;
-        src_ptr = get_pixel_ptr_32( src_dib, 0, y0 );
-        src_ptr_dy = (y1 - y0) * src_dib->stride / 4;
-        for (dst_x = 0; dst_x < dst_rect.right - dst_rect.left; ++dst_x)
-        {
-            float_x = clampf( float_x, src_rect.left, src_rect.right - 1 );
-            x0 = float_x;
-            x1 = clamp( x0 + 1, src_rect.left, src_rect.right - 1 );
-            dx = float_x - x0;
-
-            c00_ptr = src_ptr + x0;
-            c01_ptr = src_ptr + x1;
-            c10_ptr = c00_ptr + src_ptr_dy;
-            c11_ptr = c01_ptr + src_ptr_dy;
-            c00_r = get_field( *c00_ptr, src_dib->red_shift, src_dib->red_len );
-            c01_r = get_field( *c01_ptr, src_dib->red_shift, src_dib->red_len );
-            c10_r = get_field( *c10_ptr, src_dib->red_shift, src_dib->red_len );
-            c11_r = get_field( *c11_ptr, src_dib->red_shift, src_dib->red_len );
-            c00_g = get_field( *c00_ptr, src_dib->green_shift, src_dib->green_len );
-            c01_g = get_field( *c01_ptr, src_dib->green_shift, src_dib->green_len );
-            c10_g = get_field( *c10_ptr, src_dib->green_shift, src_dib->green_len );
-            c11_g = get_field( *c11_ptr, src_dib->green_shift, src_dib->green_len );
-            c00_b = get_field( *c00_ptr, src_dib->blue_shift, src_dib->blue_len );
-            c01_b = get_field( *c01_ptr, src_dib->blue_shift, src_dib->blue_len );
-            c10_b = get_field( *c10_ptr, src_dib->blue_shift, src_dib->blue_len );
-            c11_b = get_field( *c11_ptr, src_dib->blue_shift, src_dib->blue_len );
-            r = bilinear_interpolate( c00_r, c01_r, c10_r, c11_r, dx, dy );
-            g = bilinear_interpolate( c00_g, c01_g, c10_g, c11_g, dx, dy );
-            b = bilinear_interpolate( c00_b, c01_b, c10_b, c11_b, dx, dy );
-            dst_ptr[dst_x] = rgb_to_pixel_masks( dst_dib, r, g, b );
-
-            float_x += src_inc_x;
-        }
-
-        dst_ptr += dst_dib->stride / 4;
-        float_y += src_inc_y;
-    }
+    pthread_mutex_lock( &halftone_filter_lock );
+    refcount = --filter->refcount;
+    pthread_mutex_unlock( &halftone_filter_lock );
+    if (!refcount) free( filter );
 }
 
-static void halftone_24( const dib_info *dst_dib, const struct bitblt_coords *dst,
-                         const dib_info *src_dib, const struct bitblt_coords *src )
+/* filters are cached since the same scale factors tend to be used over and over */
+static struct halftone_filter *get_halftone_filter( int src_len, int dst_len )
 {
-    int src_start_x, src_start_y, src_ptr_dy, dst_x, dst_y, x0, x1, y0, y1;
-    BYTE *dst_ptr, *src_ptr, *c00_ptr, *c01_ptr, *c10_ptr, *c11_ptr;
-    float src_inc_x, src_inc_y, float_x, float_y, dx, dy;
-    BYTE c00_r, c01_r, c10_r, c11_r;
-    BYTE c00_g, c01_g, c10_g, c11_g;
-    BYTE c00_b, c01_b, c10_b, c11_b;
-    RECT dst_rect, src_rect;
-    BYTE r, g, b;
-
-    calc_halftone_params( dst, src, &dst_rect, &src_rect, &src_start_x, &src_start_y, &src_inc_x,
-                          &src_inc_y );
+    struct halftone_filter *filter, *old = NULL;
 
-    float_y = src_start_y;
-    dst_ptr = get_pixel_ptr_24( dst_dib, dst_rect.left, dst_rect.top );
-    for (dst_y = 0; dst_y < dst_rect.bottom - dst_rect.top; ++dst_y)
+    pthread_mutex_lock( &halftone_filter_lock );
+    LIST_FOR_EACH_ENTRY( filter, &halftone_filters, struct halftone_filter, entry )
     {
-        float_y = clampf( float_y, src_rect.top, src_rect.bottom - 1 );
-        y0 = float_y;
-        y1 = clamp( y0 + 1, src_rect.top, src_rect.bottom - 1 );
-        dy = float_y - y0;
-
-        float_x = src_start_x;
-        src_ptr = get_pixel_ptr_24( src_dib, 0, y0 );
-        src_ptr_dy = (y1 - y0) * src_dib->stride;
-        for (dst_x = 0; dst_x < dst_rect.right - dst_rect.left; ++dst_x)
-        {
-            float_x = clampf( float_x, src_rect.left, src_rect.right - 1 );
-            x0 = float_x;
-            x1 = clamp( x0 + 1, src_rect.left, src_rect.right - 1 );
-            dx = float_x - x0;
-
-            c00_ptr = src_ptr + x0 * 3;
-            c01_ptr = src_ptr + x1 * 3;
-            c10_ptr = c00_ptr + src_ptr_dy;
-            c11_ptr = c01_ptr + src_ptr_dy;
-            c00_b = c00_ptr[0];
-            c01_b = c01_ptr[0];
-            c10_b = c10_ptr[0];
-            c11_b = c11_ptr[0];
-            c00_g = c00_ptr[1];
-            c01_g = c01_ptr[1];
-            c10_g = c10_ptr[1];
-            c11_g = c11_ptr[1];
-            c00_r = c00_ptr[2];
-            c01_r = c01_ptr[2];
-            c10_r = c10_ptr[2];
-            c11_r = c11_ptr[2];
-            r = bilinear_interpolate( c00_r, c01_r, c10_r, c11_r, dx, dy );
-            g = bilinear_interpolate( c00_g, c01_g, c10_g, c11_g, dx, dy );
-            b = bilinear_interpolate( c00_b, c01_b, c10_b, c11_b, dx, dy );
-            dst_ptr[dst_x * 3] = b;
-            dst_ptr[dst_x * 3 + 1] = g;
-            dst_ptr[dst_x * 3 + 2] = r;
+        if (filter->src_len != src_len || filter->dst_len != dst_len) continue;
+        list_remove( &filter->entry );
+        list_add_head( &halftone_filters, &filter->entry );
+        filter->refcount++;
+        pthread_mutex_unlock( &halftone_filter_lock );
+        return filter;
+    }
+    pthread_mutex_unlock( &halftone_filter_lock );
 
-            float_x += src_inc_x;
-        }
+    if (!(filter = create_halftone_filter( src_len, dst_len ))) return NULL;
+    filter->refcount = 2;  /* one for the cache, one for the caller */
 
-        dst_ptr += dst_dib->stride;
-        float_y += src_inc_y;
+    pthread_mutex_lock( &halftone_filter_lock );
+    list_add_head( &halftone_filters, &filter->entry );
+    if (++halftone_filter_count > HALFTONE_MAX_FILTERS)
+    {
+        old = LIST_ENTRY( list_tail( &halftone_filters ), struct halftone_filter, entry );
+        list_remove( &old->entry );
+        halftone_filter_count--;
     }
+    pthread_mutex_unlock( &halftone_filter_lock );
+
+    if (old) release_halftone_filter( old );
+    return filter;
 }
 
-static void halftone_555( const dib_info *dst_dib, const struct bitblt_coords *dst,
-                          const dib_info *src_dib, const struct bitblt_coords *src )
+/* filter a source row horizontally, results have 6 fractional bits */
+static void halftone_filter_row( const struct halftone_filter *filter, const DWORD *src,
+                                 WORD *dst, BOOL mirrored )
 {
-    int src_start_x, src_start_y, src_ptr_dy, dst_x, dst_y, x0, x1, y0, y1;
-    WORD *dst_ptr, *src_ptr, *c00_ptr, *c01_ptr, *c10_ptr, *c11_ptr;
-    float src_inc_x, src_inc_y, float_x, float_y, dx, dy;
-    BYTE c00_r, c01_r, c10_r, c11_r;
-    BYTE c00_g, c01_g, c10_g, c11_g;
-    BYTE c00_b, c01_b, c10_b, c11_b;
-    RECT dst_rect, src_rect;
-    BYTE r, g, b;
-
-    calc_halftone_params( dst, src, &dst_rect, &src_rect, &src_start_x, &src_start_y, &src_inc_x,
-                          &src_inc_y );
+    const short *w = filter->weights;
+    int x, k, r, g, b;
 
-    float_y = src_start_y;
-    dst_ptr = get_pixel_ptr_16( dst_dib, dst_rect.left, dst_rect.top );
-    for (dst_y = 0; dst_y < dst_rect.bottom - dst_rect.top; ++dst_y)
+    for (x = 0; x < filter->dst_len; x++, w += filter->taps)
     {
-        float_y = clampf( float_y, src_rect.top, src_rect.bottom - 1 );
-        y0 = float_y;
-        y1 = clamp( y0 + 1, src_rect.top, src_rect.bottom - 1 );
-        dy = float_y - y0;
+        const DWORD *ptr = src + filter->start[x];
+        WORD *out = dst + 3 * (mirrored ? filter->dst_len - 1 - x : x);
 
-        float_x = src_start_x;
-        src_ptr = get_pixel_ptr_16( src_dib, 0, y0 );
-        src_ptr_dy = (y1 - y0) * src_dib->stride / 2;
-        for (dst_x = 0; dst_x < dst_rect.right - dst_rect.left; ++dst_x)
+        for (k = r = g = b = 0; k < filter->taps; k++)
         {
-            float_x = clampf( float_x, src_rect.left, src_rect.right - 1 );
-            x0 = float_x;
-            x1 = clamp( x0 + 1, src_rect.left, src_rect.right - 1 );
-            dx = float_x - x0;
-
-            c00_ptr = src_ptr + x0;
-            c01_ptr = src_ptr + x1;
-            c10_ptr = c00_ptr + src_ptr_dy;
-            c11_ptr = c01_ptr + src_ptr_dy;
-            c00_r = ((*c00_ptr >> 7) & 0xf8) | ((*c00_ptr >> 12) & 0x07);
-            c01_r = ((*c01_ptr >> 7) & 0xf8) | ((*c01_ptr >> 12) & 0x07);
-            c10_r = ((*c10_ptr >> 7) & 0xf8) | ((*c10_ptr >> 12) & 0x07);
-            c11_r = ((*c11_ptr >> 7) & 0xf8) | ((*c11_ptr >> 12) & 0x07);
-            c00_g = ((*c00_ptr >> 2) & 0xf8) | ((*c00_ptr >>  7) & 0x07);
-            c01_g = ((*c01_ptr >> 2) & 0xf8) | ((*c01_ptr >>  7) & 0x07);
-            c10_g = ((*c10_ptr >> 2) & 0xf8) | ((*c10_ptr >>  7) & 0x07);
-            c11_g = ((*c11_ptr >> 2) & 0xf8) | ((*c11_ptr >>  7) & 0x07);
-            c00_b = ((*c00_ptr << 3) & 0xf8) | ((*c00_ptr >>  2) & 0x07);
-            c01_b = ((*c01_ptr << 3) & 0xf8) | ((*c01_ptr >>  2) & 0x07);
-            c10_b = ((*c10_ptr << 3) & 0xf8) | ((*c10_ptr >>  2) & 0x07);
-            c11_b = ((*c11_ptr << 3) & 0xf8) | ((*c11_ptr >>  2) & 0x07);
-            r = bilinear_interpolate( c00_r, c01_r, c10_r, c11_r, dx, dy );
-            g = bilinear_interpolate( c00_g, c01_g, c10_g, c11_g, dx, dy );
-            b = bilinear_interpolate( c00_b, c01_b, c10_b, c11_b, dx, dy );
-            dst_ptr[dst_x] = ((r << 7) & 0x7c00) | ((g << 2) & 0x03e0) | ((b >> 3) & 0x001f);
-
-            float_x += src_inc_x;
+            r += w[k] * ((ptr[k] >> 16) & 0xff);
+            g += w[k] * ((ptr[k] >> 8) & 0xff);
+            b += w[k] * (ptr[k] & 0xff);
         }
-
-        dst_ptr += dst_dib->stride / 2;
-        float_y += src_inc_y;
+        out[0] = (r + (1 << 7)) >> 8;
+        out[1] = (g + (1 << 7)) >> 8;
+        out[2] = (b + (1 << 7)) >> 8;
     }
 }
 
-static void halftone_16( const dib_info *dst_dib, const struct bitblt_coords *dst,
-                         const dib_info *src_dib, const struct bitblt_coords *src )
+/***********************************************************************
+ *           halftone_rgb
+ *
+ * Separable fixed point resampling used by the HALFTONE mode for true color
+ * destinations. Source rows are converted to 8888 and filtered horizontally
+ * once, then combined vertically through a small ring of filtered rows.
+ */
+static void halftone_rgb( const dib_info *dst_dib, const struct bitblt_coords *dst,
+                          const dib_info *src_dib, const struct bitblt_coords *src )
 {
-    int src_start_x, src_start_y, src_ptr_dy, dst_x, dst_y, x0, x1, y0, y1;
-    WORD *dst_ptr, *src_ptr, *c00_ptr, *c01_ptr, *c10_ptr, *c11_ptr;
-    float src_inc_x, src_inc_y, float_x, float_y, dx, dy;
-    BYTE c00_r, c01_r, c10_r, c11_r;
-    BYTE c00_g, c01_g, c10_g, c11_g;
-    BYTE c00_b, c01_b, c10_b, c11_b;
-    RECT dst_rect, src_rect;
-    BYTE r, g, b;
+    struct halftone_filter *filter_x = NULL, *filter_y = NULL;
+    int src_start_x, src_start_y, src_width, src_height, dst_width, dst_height;
+    int x, y, i, row, slot, weight, bytes_pp = dst_dib->bit_count / 8;
+    float src_inc_x, src_inc_y;
+    RECT dst_rect, src_rect, row_rect;
+    dib_info rgb_dib, out_dib, row_dib;
+    DWORD *src_row = NULL, *out_row = NULL;
+    WORD *ring = NULL;
+    int *ring_rows = NULL, *sums = NULL;
+    BYTE *row_bits = NULL, *dst_ptr;
 
     calc_halftone_params( dst, src, &dst_rect, &src_rect, &src_start_x, &src_start_y, &src_inc_x,
                           &src_inc_y );
-
-    float_y = src_start_y;
-    dst_ptr = get_pixel_ptr_16( dst_dib, dst_rect.left, dst_rect.top );
-    for (dst_y = 0; dst_y < dst_rect.bottom - dst_rect.top; ++dst_y)
-    {
-        float_y = clampf( float_y, src_rect.top, src_rect.bottom - 1 );
-        y0 = float_y;
-        y1 = clamp( y0 + 1, src_rect.top, src_rect.bottom - 1 );
-        dy = float_y - y0;
-
-        float_x = src_start_x;
-        src_ptr = get_pixel_ptr_16( src_dib, 0, y0 );
-        src_ptr_dy = (y1 - y0) * src_dib->stride / 2;
-        for (dst_x = 0; dst_x < dst_rect.right - dst_rect.left; ++dst_x)
+    src_width = src_rect.right - src_rect.left;
+    src_height = src_rect.bottom - src_rect.top;
+    dst_width = dst_rect.right - dst_rect.left;
+    dst_height = dst_rect.bottom - dst_rect.top;
+    if (src_width <= 0 || src_height <= 0 || dst_width <= 0 || dst_height <= 0) return;
+
+    if (!(filter_x = get_halftone_filter( src_width, dst_width ))) goto done;
+    if (!(filter_y = get_halftone_filter( src_height, dst_height ))) goto done;
+    if (!(src_row = malloc( src_width * sizeof(*src_row) ))) goto done;
+    if (!(out_row = malloc( dst_width * sizeof(*out_row) ))) goto done;
+    if (!(ring = malloc( filter_y->taps * dst_width * 3 * sizeof(*ring) ))) goto done;
+    if (!(ring_rows = malloc( filter_y->taps * sizeof(*ring_rows) ))) goto done;
+    if (!(sums = malloc( dst_width * 3 * sizeof(*sums) ))) goto done;
+    if (!(row_bits = malloc( get_dib_stride( dst_width, dst_dib->bit_count )))) goto done;
+    for (i = 0; i < filter_y->taps; i++) ring_rows[i] = -1;
+
+    memset( &rgb_dib, 0, sizeof(rgb_dib) );
+    rgb_dib.bit_count   = 32;
+    rgb_dib.width       = src_width;
+    rgb_dib.height      = 1;
+    rgb_dib.compression = BI_RGB;
+    rgb_dib.rect.right  = src_width;
+    rgb_dib.rect.bottom = 1;
+    rgb_dib.stride      = src_width * 4;
+    rgb_dib.bits.ptr    = src_row;
+    rgb_dib.red_mask    = 0xff0000;
+    rgb_dib.green_mask  = 0x00ff00;
+    rgb_dib.blue_mask   = 0x0000ff;
+    rgb_dib.red_shift   = 16;
+    rgb_dib.green_shift = 8;
+    rgb_dib.red_len = rgb_dib.green_len = rgb_dib.blue_len = 8;
+    rgb_dib.funcs       = &funcs_8888;
+
+    out_dib = rgb_dib;
+    out_dib.width      = dst_width;
+    out_dib.rect.right = dst_width;
+    out_dib.stride     = dst_width * 4;
+    out_dib.bits.ptr   = out_row;
+
+    row_dib = *dst_dib;
+    row_dib.width       = dst_width;
+    row_dib.height      = 1;
+    set_rect( &row_dib.rect, 0, 0, dst_width, 1 );
+    row_dib.stride      = get_dib_stride( dst_width, dst_dib->bit_count );
+    row_dib.bits.ptr    = row_bits;
+    row_dib.bits.is_copy = FALSE;
+    row_dib.bits.free   = NULL;
+
+    row_rect.left = src_rect.left;
+    row_rect.right = src_rect.right;
+
+    for (y = 0; y < dst_height; y++)
+    {
+        const short *w = filter_y->weights + y * filter_y->taps;
+
+        memset( sums, 0, dst_width * 3 * sizeof(*sums) );
+        for (i = 0; i < filter_y->taps; i++)
+        {
+            if (!(weight = w[i])) continue;
+            row = filter_y->start[y] + i;
+            slot = row % filter_y->taps;
+            if (ring_rows[slot] != row)
+            {
+                row_rect.top = src_rect.top + row;
+                row_rect.bottom = row_rect.top + 1;
+                convert_to_8888( &rgb_dib, src_dib, &row_rect, FALSE );
+                halftone_filter_row( filter_x, src_row, ring + slot * dst_width * 3, src_inc_x < 0 );
+                ring_rows[slot] = row;
+            }
+            for (x = 0; x < dst_width * 3; x++) sums[x] += weight * ring[slot * dst_width * 3 + x];
+        }
+        for (x = 0; x < dst_width; x++)
+            out_row[x] = (((sums[3 * x] + (1 << 19)) >> 20) << 16) |
+                         (((sums[3 * x + 1] + (1 << 19)) >> 20) << 8) |
+                         ((sums[3 * x + 2] + (1 << 19)) >> 20);
+
+        dst_ptr = (BYTE *)dst_dib->bits.ptr + (dst_dib->rect.left + dst_rect.left) * bytes_pp +
+                  (dst_dib->rect.top + dst_rect.top + (src_inc_y < 0 ? dst_height - 1 - y : y)) * dst_dib->stride;
+        if (dst_dib->funcs == &funcs_8888)
+            memcpy( dst_ptr, out_row, dst_width * 4 );
+        else
         {
-            float_x = clampf( float_x, src_rect.left, src_rect.right - 1 );
-            x0 = float_x;
-            x1 = clamp( x0 + 1, src_rect.left, src_rect.right - 1 );
-            dx = float_x - x0;
-
-            c00_ptr = src_ptr + x0;
-            c01_ptr = src_ptr + x1;
-            c10_ptr = c00_ptr + src_ptr_dy;
-            c11_ptr = c01_ptr + src_ptr_dy;
-            c00_r = get_field( *c00_ptr, src_dib->red_shift, src_dib->red_len );
-            c01_r = get_field( *c01_ptr, src_dib->red_shift, src_dib->red_len );
-            c10_r = get_field( *c10_ptr, src_dib->red_shift, src_dib->red_len );
-            c11_r = get_field( *c11_ptr, src_dib->red_shift, src_dib->red_len );
-            c00_g = get_field( *c00_ptr, src_dib->green_shift, src_dib->green_len );
-            c01_g = get_field( *c01_ptr, src_dib->green_shift, src_dib->green_len );
-            c10_g = get_field( *c10_ptr, src_dib->green_shift, src_dib->green_len );
-            c11_g = get_field( *c11_ptr, src_dib->green_shift, src_dib->green_len );
-            c00_b = get_field( *c00_ptr, src_dib->blue_shift, src_dib->blue_len );
-            c01_b = get_field( *c01_ptr, src_dib->blue_shift, src_dib->blue_len );
-            c10_b = get_field( *c10_ptr, src_dib->blue_shift, src_dib->blue_len );
-            c11_b = get_field( *c11_ptr, src_dib->blue_shift, src_dib->blue_len );
-            r = bilinear_interpolate( c00_r, c01_r, c10_r, c11_r, dx, dy );
-            g = bilinear_interpolate( c00_g, c01_g, c10_g, c11_g, dx, dy );
-            b = bilinear_interpolate( c00_b, c01_b, c10_b, c11_b, dx, dy );
-            dst_ptr[dst_x] = rgb_to_pixel_masks( dst_dib, r, g, b );
-
-            float_x += src_inc_x;
+            dst_dib->funcs->convert_to( &row_dib, &out_dib, &out_dib.rect, FALSE );
+            memcpy( dst_ptr, row_bits, dst_width * bytes_pp );
         }
-
-        dst_ptr += dst_dib->stride / 2;
-        float_y += src_inc_y;
     }
+
+done:
+    if (filter_x) release_halftone_filter( filter_x );
+    if (filter_y) release_halftone_filter( filter_y );
+    free( src_row );
+    free( out_row );
+    free( ring );
+    free( ring_rows );
+    free( sums );
+    free( row_bits );
 }
 
 static void halftone_8( const dib_info *dst_dib, const struct bitblt_coords *dst,
@@ -8036,7 +8052,251 @@ static void halftone_null( const dib_info *dst_dib, const struct bitblt_coords *
                            const dib_info *src_dib, const struct bitblt_coords *src )
 {}
 
-const primitive_funcs funcs_8888 =
+#ifdef USE_SSE2_PRIMITIVES
+
+#define SSE2_FUNC __attribute__((target("sse2")))
+
+static SSE2_FUNC void solid_rects_32_sse2(const dib_info *dib, int num, const RECT *rc, DWORD and, DWORD xor)
+{
+    __m128i and4 = _mm_set1_epi32( and ), xor4 = _mm_set1_epi32( xor );
+    DWORD *ptr, *start;
+    int x, y, i, len;
+
+    if (!and)
+    {
+        solid_rects_32( dib, num, rc, and, xor );
+        return;
+    }
+
+    for (i = 0; i < num; i++, rc++)
+    {
+        assert( !is_rect_empty( rc ));
+
+        start = get_pixel_ptr_32( dib, rc->left, rc->top );
+        len = rc->right - rc->left;
+        for (y = rc->top; y < rc->bottom; y++, start += dib->stride / 4)
+        {
+            for (x = 0, ptr = start; x + 4 <= len; x += 4, ptr += 4)
+            {
+                __m128i val = _mm_loadu_si128( (__m128i *)ptr );
+                _mm_storeu_si128( (__m128i *)ptr, _mm_xor_si128( _mm_and_si128( val, and4 ), xor4 ));
+            }
+            for (; x < len; x++) do_rop_32( ptr++, and, xor );
+        }
+    }
+}
+
+static SSE2_FUNC void solid_rects_16_sse2(const dib_info *dib, int num, const RECT *rc, DWORD and, DWORD xor)
+{
+    __m128i and8 = _mm_set1_epi16( and ), xor8 = _mm_set1_epi16( xor );
+    WORD *ptr, *start;
+    int x, y, i, len;
+
+    if (!and)
+    {
+        solid_rects_16( dib, num, rc, and, xor );
+        return;
+    }
+
+    for (i = 0; i < num; i++, rc++)
+    {
+        assert( !is_rect_empty( rc ));
+
+        start = get_pixel_ptr_16( dib, rc->left, rc->top );
+        len = rc->right - rc->left;
+        for (y = rc->top; y < rc->bottom; y++, start += dib->stride / 2)
+        {
+            for (x = 0, ptr = start; x + 8 <= len; x += 8, ptr += 8)
+            {
+                __m128i val = _mm_loadu_si128( (__m128i *)ptr );
+                _mm_storeu_si128( (__m128i *)ptr, _mm_xor_si128( _mm_and_si128( val, and8 ), xor8 ));
+            }
+            for (; x < len; x++) do_rop_16( ptr++, and, xor );
+        }
+    }
+}
+
+/* (val + 127) / 255 on 16-bit lanes, exact for the whole range used by blend_color() */
+static SSE2_FUNC inline __m128i div255_sse2( __m128i val )
+{
+    val = _mm_add_epi16( val, _mm_set1_epi16( 127 ));
+    return _mm_srli_epi16( _mm_mulhi_epu16( val, _mm_set1_epi16( 0x8081 )), 7 );
+}
+
+/* same as blend_argb() on two pixels expanded to 16-bit lanes, except that channels
+ * are not allowed to carry into the next one; the caller checks for that */
+static SSE2_FUNC inline __m128i blend_argb_sse2( __m128i dst, __m128i src )
+{
+    __m128i alpha = _mm_shufflehi_epi16( _mm_shufflelo_epi16( src, 0xff ), 0xff );
+
+    alpha = _mm_sub_epi16( _mm_set1_epi16( 255 ), alpha );
+    return _mm_add_epi16( src, div255_sse2( _mm_mullo_epi16( dst, alpha )));
+}
+
+static SSE2_FUNC inline __m128i blend_constant_alpha_sse2( __m128i dst, __m128i src, __m128i alpha )
+{
+    __m128i inv_alpha = _mm_sub_epi16( _mm_set1_epi16( 255 ), alpha );
+
+    return div255_sse2( _mm_add_epi16( _mm_mullo_epi16( src, alpha ), _mm_mullo_epi16( dst, inv_alpha )));
+}
+
+static SSE2_FUNC void blend_rects_8888_sse2(const dib_info *dst, int num, const RECT *rc,
+                                            const dib_info *src, const POINT *offset, BLENDFUNCTION blend)
+{
+    __m128i zero = _mm_setzero_si128(), alpha = _mm_set1_epi16( blend.SourceConstantAlpha );
+    __m128i src_or = _mm_setzero_si128(), max = _mm_set1_epi16( 255 );
+    BOOL src_alpha = (blend.AlphaFormat & AC_SRC_ALPHA) != 0;
+    int i, x, y, len;
+    RECT tail;
+
+    if (!src_alpha && src->compression != BI_RGB) src_or = _mm_set1_epi32( 0xff000000 );
+
+    for (i = 0; i < num; i++, rc++)
+    {
+        DWORD *src_ptr = get_pixel_ptr_32( src, rc->left + offset->x, rc->top + offset->y );
+        DWORD *dst_ptr = get_pixel_ptr_32( dst, rc->left, rc->top );
+
+        len = rc->right - rc->left;
+        for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
+        {
+            tail.top = y;
+            tail.bottom = y + 1;
+            for (x = 0; x + 4 <= len; x += 4)
+            {
+                __m128i s = _mm_or_si128( _mm_loadu_si128( (__m128i *)(src_ptr + x) ), src_or );
+                __m128i d = _mm_loadu_si128( (__m128i *)(dst_ptr + x) );
+                __m128i s_lo = _mm_unpacklo_epi8( s, zero ), s_hi = _mm_unpackhi_epi8( s, zero );
+                __m128i d_lo = _mm_unpacklo_epi8( d, zero ), d_hi = _mm_unpackhi_epi8( d, zero );
+
+                if (src_alpha)
+                {
+                    if (blend.SourceConstantAlpha != 255)
+                    {
+                        s_lo = div255_sse2( _mm_mullo_epi16( s_lo, alpha ));
+                        s_hi = div255_sse2( _mm_mullo_epi16( s_hi, alpha ));
+                    }
+                    d_lo = blend_argb_sse2( d_lo, s_lo );
+                    d_hi = blend_argb_sse2( d_hi, s_hi );
+                    /* source isn't properly premultiplied, let the scalar code handle the carries */
+                    if (_mm_movemask_epi8( _mm_cmpgt_epi16( _mm_or_si128( d_lo, d_hi ), max )))
+                    {
+                        tail.left = rc->left + x;
+                        tail.right = tail.left + 4;
+                        blend_rects_8888( dst, 1, &tail, src, offset, blend );
+                        continue;
+                    }
+                }
+                else
+                {
+                    d_lo = blend_constant_alpha_sse2( d_lo, s_lo, alpha );
+                    d_hi = blend_constant_alpha_sse2( d_hi, s_hi, alpha );
+                }
+                _mm_storeu_si128( (__m128i *)(dst_ptr + x), _mm_packus_epi16( d_lo, d_hi ));
+            }
+            if (x == len) continue;
+            tail.left = rc->left + x;
+            tail.right = rc->right;
+            blend_rects_8888( dst, 1, &tail, src, offset, blend );
+        }
+    }
+}
+
+static SSE2_FUNC void convert_to_8888_sse2(dib_info *dst, const dib_info *src, const RECT *src_rect, BOOL dither)
+{
+    DWORD *dst_start = get_pixel_ptr_32(dst, 0, 0), *dst_pixel;
+    WORD *src_start, *src_pixel;
+    int x, y, len = src_rect->right - src_rect->left, pad_size = (dst->width - len) * 4;
+    __m128i zero = _mm_setzero_si128();
+
+    if (src->funcs != &funcs_555)
+    {
+        convert_to_8888( dst, src, src_rect, dither );
+        return;
+    }
+
+    src_start = get_pixel_ptr_16(src, src_rect->left, src_rect->top);
+    for (y = src_rect->top; y < src_rect->bottom; y++)
+    {
+        dst_pixel = dst_start;
+        src_pixel = src_start;
+        for (x = 0; x + 8 <= len; x += 8, src_pixel += 8, dst_pixel += 8)
+        {
+            __m128i val = _mm_loadu_si128( (__m128i *)src_pixel ), lo, hi;
+
+#define EXPAND_555(v) \
+    _mm_or_si128( _mm_or_si128( \
+        _mm_or_si128( _mm_and_si128( _mm_slli_epi32( v, 9 ), _mm_set1_epi32( 0xf80000 )), \
+                      _mm_and_si128( _mm_slli_epi32( v, 4 ), _mm_set1_epi32( 0x070000 ))), \
+        _mm_or_si128( _mm_and_si128( _mm_slli_epi32( v, 6 ), _mm_set1_epi32( 0x00f800 )), \
+                      _mm_and_si128( _mm_slli_epi32( v, 1 ), _mm_set1_epi32( 0x000700 )))), \
+        _mm_or_si128( _mm_and_si128( _mm_slli_epi32( v, 3 ), _mm_set1_epi32( 0x0000f8 )), \
+                      _mm_and_si128( _mm_srli_epi32( v, 2 ), _mm_set1_epi32( 0x000007 ))))
+
+            lo = _mm_unpacklo_epi16( val, zero );
+            hi = _mm_unpackhi_epi16( val, zero );
+            _mm_storeu_si128( (__m128i *)dst_pixel, EXPAND_555( lo ));
+            _mm_storeu_si128( (__m128i *)(dst_pixel + 4), EXPAND_555( hi ));
+#undef EXPAND_555
+        }
+        for (; x < len; x++)
+        {
+            DWORD src_val = *src_pixel++;
+            *dst_pixel++ = ((src_val << 9) & 0xf80000) | ((src_val << 4) & 0x070000) |
+                           ((src_val << 6) & 0x00f800) | ((src_val << 1) & 0x000700) |
+                           ((src_val << 3) & 0x0000f8) | ((src_val >> 2) & 0x000007);
+        }
+        if (pad_size) memset( dst_pixel, 0, pad_size );
+        dst_start += dst->stride / 4;
+        src_start += src->stride / 2;
+    }
+}
+
+static SSE2_FUNC void convert_to_555_sse2(dib_info *dst, const dib_info *src, const RECT *src_rect, BOOL dither)
+{
+    WORD *dst_start = get_pixel_ptr_16(dst, 0, 0), *dst_pixel;
+    DWORD *src_start, *src_pixel;
+    int x, y, len = src_rect->right - src_rect->left, pad_size = ((dst->width + 1) & ~1) * 2 - len * 2;
+
+    if (src->funcs != &funcs_8888)
+    {
+        convert_to_555( dst, src, src_rect, dither );
+        return;
+    }
+
+    src_start = get_pixel_ptr_32(src, src_rect->left, src_rect->top);
+    for (y = src_rect->top; y < src_rect->bottom; y++)
+    {
+        dst_pixel = dst_start;
+        src_pixel = src_start;
+        for (x = 0; x + 8 <= len; x += 8, src_pixel += 8, dst_pixel += 8)
+        {
+            __m128i lo = _mm_loadu_si128( (__m128i *)src_pixel );
+            __m128i hi = _mm_loadu_si128( (__m128i *)(src_pixel + 4) );
+
+#define PACK_555(v) \
+    _mm_or_si128( _mm_or_si128( _mm_and_si128( _mm_srli_epi32( v, 9 ), _mm_set1_epi32( 0x7c00 )), \
+                                _mm_and_si128( _mm_srli_epi32( v, 6 ), _mm_set1_epi32( 0x03e0 ))), \
+                  _mm_and_si128( _mm_srli_epi32( v, 3 ), _mm_set1_epi32( 0x001f )))
+
+            _mm_storeu_si128( (__m128i *)dst_pixel, _mm_packs_epi32( PACK_555( lo ), PACK_555( hi )));
+#undef PACK_555
+        }
+        for (; x < len; x++)
+        {
+            DWORD src_val = *src_pixel++;
+            *dst_pixel++ = ((src_val >> 9) & 0x7c00) |
+                           ((src_val >> 6) & 0x03e0) |
+                           ((src_val >> 3) & 0x001f);
+        }
+        if (pad_size) memset( dst_pixel, 0, pad_size );
+        dst_start += dst->stride / 2;
+        src_start += src->stride / 4;
+    }
+}
+
+#endif  /* USE_SSE2_PRIMITIVES */
+
+primitive_funcs funcs_8888 =
 {
     solid_rects_32,
     solid_line_32,
@@ -8055,10 +8315,10 @@ const primitive_funcs funcs_8888 =
     create_dither_masks_null,
     stretch_row_32,
     shrink_row_32,
-    halftone_888
+    halftone_rgb
 };
 
-const primitive_funcs funcs_32 =
+primitive_funcs funcs_32 =
 {
     solid_rects_32,
     solid_line_32,
@@ -8077,7 +8337,7 @@ const primitive_funcs funcs_32 =
     create_dither_masks_null,
     stretch_row_32,
     shrink_row_32,
-    halftone_32
+    halftone_rgb
 };
 
 const primitive_funcs funcs_24 =
@@ -8099,10 +8359,10 @@ const primitive_funcs funcs_24 =
     create_dither_masks_null,
     stretch_row_24,
     shrink_row_24,
-    halftone_24
+    halftone_rgb
 };
 
-const primitive_funcs funcs_555 =
+primitive_funcs funcs_555 =
 {
     solid_rects_16,
     solid_line_16,
@@ -8121,10 +8381,10 @@ const primitive_funcs funcs_555 =
     create_dither_masks_null,
     stretch_row_16,
     shrink_row_16,
-    halftone_555
+    halftone_rgb
 };
 
-const primitive_funcs funcs_16 =
+primitive_funcs funcs_16 =
 {
     solid_rects_16,
     solid_line_16,
@@ -8143,7 +8403,7 @@ const primitive_funcs funcs_16 =
     create_dither_masks_null,
     stretch_row_16,
     shrink_row_16,
-    halftone_16
+    halftone_rgb
 };
 
 const primitive_funcs funcs_8 =
@@ -8233,3 +8493,27 @@ const primitive_funcs funcs_null =
     shrink_row_null,
     halftone_null
 };
+
+/***********************************************************************
+ *           init_primitive_funcs
+ *
+ * Switch the hot 32 and 16 bpp primitives to vectorized versions when the cpu supports them.
+ */
+void init_primitive_funcs(void)
+{
+#ifdef USE_SSE2_PRIMITIVES
+    SYSTEM_CPU_INFORMATION info;
+
+    if (NtQuerySystemInformation( SystemCpuInformation, &info, sizeof(info), NULL )) return;
+    if (!(info.ProcessorFeatureBits & CPU_FEATURE_SSE2)) return;
+
+    TRACE( "using SSE2 primitives\n" );
+    funcs_8888.solid_rects = solid_rects_32_sse2;
+    funcs_8888.blend_rects = blend_rects_8888_sse2;
+    funcs_8888.convert_to  = convert_to_8888_sse2;
+    funcs_32.solid_rects   = solid_rects_32_sse2;
+    funcs_555.solid_rects  = solid_rects_16_sse2;
+    funcs_555.convert_to   = convert_to_555_sse2;
+    funcs_16.solid_rects   = solid_rects_16_sse2;
+#endif
+}
@@ -6398,6 +6398,7 @@ UINT font_init(void)
         load_registry_fonts();
         load_font_list_from_cache();
     }
+    font_funcs->save_font_index();
 
     reorder_font_list();
     load_gdi_font_subst();
@@ -6591,6 +6592,54 @@ BOOL WINAPI NtGdiGetFontFileData( DWORD instance_id, DWORD file_index, UINT64 *o
     return ret;
 }
 
+/*************************************************************************
+ *             get_glyph_cache_key
+ *
+ * Build the key identifying the bitmap of a glyph of the font selected in a DC,
+ * independently of the process and of the logical font. Fails for glyphs that
+ * come from linked fonts or need vertical substitution.
+ */
+BOOL get_glyph_cache_key( DC *dc, UINT glyph, UINT format, struct glyph_cache_key *key, UINT *index )
+{
+    PHYSDEV dev = dc->physDev;
+    struct gdi_font *font;
+    const WCHAR *p;
+    BOOL ret = FALSE;
+
+    while (dev && dev->funcs != &font_driver) dev = dev->next;
+    if (!dev || !(font = get_font_dev( dev )->font)) return FALSE;
+
+    pthread_mutex_lock( &font_lock );
+    if (!font->file[0] || *get_gdi_font_name( font ) == '@') goto done;  /* memory or vertical font */
+
+    if (format & GGO_GLYPH_INDEX)
+    {
+        *index = glyph;
+        font_funcs->get_glyph_index( font, index, FALSE );
+    }
+    else if (!(*index = get_glyph_index( font, glyph ))) goto done;
+
+    memset( key, 0, sizeof(*key) );
+    key->file_size   = font->data_size;
+    key->writetime   = font->writetime;
+    for (p = font->file; *p; p++) key->file_hash = key->file_hash * 65599 + *p;
+    key->face_index  = font->face_index;
+    key->ppem        = font->ppem;
+    key->scale_y     = font->scale_y;
+    key->ave_width   = font->aveWidth;
+    key->orientation = font->scalable ? font->lf.lfOrientation % 3600 : 0;
+    key->matrix      = font->matrix;
+    if (font->fake_bold) key->flags |= 1;
+    if (font->fake_italic) key->flags |= 2;
+    if (font->can_use_bitmap) key->flags |= 4;
+    key->format      = format & ~GGO_GLYPH_INDEX;
+    ret = TRUE;
+
+done:
+    pthread_mutex_unlock( &font_lock );
+    return ret;
+}
+
 /*************************************************************************
  *             NtGdiGetFontFileInfo   (win32u.@)
  */
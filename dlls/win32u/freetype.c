@@ -294,6 +294,7 @@ static LCID system_lcid;
 
 static BOOL freetype_set_outline_text_metrics( struct gdi_font *font );
 static BOOL freetype_set_bitmap_text_metrics( struct gdi_font *font );
+static char *get_unix_file_name( LPCWSTR path );
 
 /****************************************
  *   Notes on .fon files
@@ -1312,16 +1313,358 @@ static void unix_face_destroy( struct unix_face *This )
     free( This );
 }
 
+/* Font index
+ *
+ * Parsing the names and properties of every font file is the most expensive
+ * part of building the font list, and it is done again by every process.
+ * The results are therefore saved in an index file that the next processes
+ * map and look up by file name and face index. An entry is only used if the
+ * file still has the same inode, size and modification time.
+ */
+
+#define FONT_INDEX_MAGIC    0x78646977  /* "widx" */
+#define FONT_INDEX_VERSION  1
+#define FONT_INDEX_BUCKETS  1024
+
+#define FONT_INDEX_SCALABLE     0x01
+#define FONT_INDEX_NEEDS_BITMAP 0x02  /* only loaded with ADDFONT_ALLOW_BITMAP */
+
+struct font_index_header
+{
+    UINT magic;
+    UINT version;
+    UINT lcid;                          /* names depend on the system locale */
+    UINT size;                          /* size of the whole index */
+    UINT count;                         /* number of entries */
+    UINT buckets[FONT_INDEX_BUCKETS];   /* offset of the first entry of each bucket */
+};
+
+struct font_index_entry
+{
+    UINT                    next;       /* offset of the next entry in the bucket */
+    UINT                    size;       /* size of the entry, including the strings */
+    UINT64                  file_size;
+    UINT64                  inode;
+    INT64                   mtime;
+    UINT                    face_index;
+    UINT                    num_faces;
+    UINT                    flags;
+    UINT                    ntm_flags;
+    UINT                    font_version;
+    UINT                    name_len;   /* size of the unix file name, including the null */
+    FONTSIGNATURE           fs;
+    struct bitmap_font_size bitmap_size;
+    /* char unix_name[name_len] */
+    /* family, second, style and full names, each a WORD length (0xffff for none) and WCHARs */
+};
+
+static const struct font_index_header *font_index;
+static SIZE_T font_index_size;
+
+/* entries seen while loading the font list, to be saved in a new index */
+static struct font_index_entry **font_index_entries;
+static UINT font_index_count, font_index_capacity;
+static BOOL font_index_stale;
+
+static const WCHAR font_index_pathW[] =
+    {'\\','?','?','\\','C',':','\\','w','i','n','d','o','w','s','\\','f','o','n','t','i','n','d','e','x','.','d','a','t',0};
+
+static UINT font_index_hash( const char *unix_name, UINT face_index )
+{
+    UINT hash = face_index;
+
+    while (*unix_name) hash = hash * 65599 + (unsigned char)*unix_name++;
+    return hash % FONT_INDEX_BUCKETS;
+}
+
+static void map_font_index(void)
+{
+    static BOOL mapped;
+    const struct font_index_header *header;
+    struct stat st;
+    char *unix_name;
+    void *ptr;
+    int fd;
+
+    if (mapped) return;
+    mapped = TRUE;
+
+    if (!(unix_name = get_unix_file_name( font_index_pathW ))) return;
+    fd = open( unix_name, O_RDONLY );
+    free( unix_name );
+    if (fd == -1) return;
+
+    if (!fstat( fd, &st ) && st.st_size >= sizeof(*header) && st.st_size < UINT_MAX &&
+        (ptr = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 )) != MAP_FAILED)
+    {
+        header = ptr;
+        if (header->magic == FONT_INDEX_MAGIC && header->version == FONT_INDEX_VERSION &&
+            header->lcid == system_lcid && header->size == st.st_size)
+        {
+            TRACE( "using font index with %u entries\n", header->count );
+            font_index = header;
+            font_index_size = st.st_size;
+        }
+        else munmap( ptr, st.st_size );
+    }
+    close( fd );
+}
+
+static void add_font_index_entry( struct font_index_entry *entry )
+{
+    if (font_index_count == font_index_capacity)
+    {
+        UINT capacity = max( 256, font_index_capacity * 2 );
+        struct font_index_entry **entries;
+
+        if (!(entries = realloc( font_index_entries, capacity * sizeof(*entries) )))
+        {
+            free( entry );
+            return;
+        }
+        font_index_entries = entries;
+        font_index_capacity = capacity;
+    }
+    font_index_entries[font_index_count++] = entry;
+}
+
+static BOOL get_index_string( const char **ptr, const char *end, WCHAR **str )
+{
+    WORD len;
+
+    *str = NULL;
+    if (end - *ptr < sizeof(len)) return FALSE;
+    memcpy( &len, *ptr, sizeof(len) );
+    *ptr += sizeof(len);
+    if (len == 0xffff) return TRUE;
+    if (end - *ptr < len * sizeof(WCHAR)) return FALSE;
+    if (!(*str = malloc( (len + 1) * sizeof(WCHAR) ))) return FALSE;
+    memcpy( *str, *ptr, len * sizeof(WCHAR) );
+    (*str)[len] = 0;
+    *ptr += len * sizeof(WCHAR);
+    return TRUE;
+}
+
+static char *put_index_string( char *ptr, const WCHAR *str )
+{
+    WORD len = str ? lstrlenW( str ) : 0xffff;
+
+    memcpy( ptr, &len, sizeof(len) );
+    ptr += sizeof(len);
+    if (!str) return ptr;
+    memcpy( ptr, str, len * sizeof(WCHAR) );
+    return ptr + len * sizeof(WCHAR);
+}
+
+/*************************************************************
+ * find_indexed_face
+ *
+ * Retrieve the properties of a face from the font index.
+ */
+static struct unix_face *find_indexed_face( const char *unix_name, const struct stat *st,
+                                            UINT face_index, DWORD flags )
+{
+    const struct font_index_entry *entry;
+    struct font_index_entry *copy;
+    struct unix_face *This;
+    const char *ptr, *end;
+    UINT offset, count = 0;
+    UINT name_len = strlen( unix_name ) + 1;
+
+    map_font_index();
+    if (!font_index) return NULL;
+
+    for (offset = font_index->buckets[font_index_hash( unix_name, face_index )];
+         offset; offset = entry->next)
+    {
+        if (offset % 8 || offset > font_index_size - sizeof(*entry) || ++count > font_index->count)
+            return NULL;
+        entry = (const struct font_index_entry *)((const char *)font_index + offset);
+        if (entry->size < sizeof(*entry) + entry->name_len || entry->size > font_index_size - offset)
+            return NULL;
+        if (entry->face_index != face_index || entry->name_len != name_len ||
+            memcmp( entry + 1, unix_name, name_len ))
+            continue;
+        if (entry->file_size != st->st_size || entry->inode != st->st_ino || entry->mtime != st->st_mtime)
+            return NULL;  /* the file changed */
+        if ((entry->flags & FONT_INDEX_NEEDS_BITMAP) && !(flags & ADDFONT_ALLOW_BITMAP))
+            return NULL;
+        break;
+    }
+    if (!offset) return NULL;
+
+    if (!(This = calloc( 1, sizeof(*This) ))) return NULL;
+    This->scalable     = !!(entry->flags & FONT_INDEX_SCALABLE);
+    This->num_faces    = entry->num_faces;
+    This->ntm_flags    = entry->ntm_flags;
+    This->font_version = entry->font_version;
+    This->fs           = entry->fs;
+    This->size         = entry->bitmap_size;
+
+    ptr = (const char *)(entry + 1) + entry->name_len;
+    end = (const char *)entry + entry->size;
+    if (!get_index_string( &ptr, end, &This->family_name ) || !This->family_name ||
+        !get_index_string( &ptr, end, &This->second_name ) ||
+        !get_index_string( &ptr, end, &This->style_name ) ||
+        !get_index_string( &ptr, end, &This->full_name ))
+    {
+        unix_face_destroy( This );
+        return NULL;
+    }
+
+    /* keep the entry for the next index */
+    if (font_index_entries && (copy = malloc( entry->size )))
+    {
+        memcpy( copy, entry, entry->size );
+        add_font_index_entry( copy );
+    }
+    return This;
+}
+
+/*************************************************************
+ * add_face_to_index
+ *
+ * Remember the properties of a face that had to be loaded from its file.
+ */
+static void add_face_to_index( const char *unix_name, UINT face_index, struct unix_face *face )
+{
+    struct font_index_entry *entry;
+    struct stat st;
+    UINT name_len = strlen( unix_name ) + 1, size;
+    const WCHAR *names[4];
+    char *ptr;
+    int i;
+
+    if (!font_index_entries) return;
+    font_index_stale = TRUE;
+    if (stat( unix_name, &st ) == -1) return;
+
+    names[0] = face->family_name;
+    names[1] = face->second_name;
+    names[2] = face->style_name;
+    names[3] = face->full_name;
+    size = sizeof(*entry) + name_len;
+    for (i = 0; i < ARRAY_SIZE(names); i++)
+        size += sizeof(WORD) + (names[i] ? lstrlenW( names[i] ) * sizeof(WCHAR) : 0);
+
+    if (!(entry = calloc( 1, size ))) return;
+    entry->size         = size;
+    entry->file_size    = st.st_size;
+    entry->inode        = st.st_ino;
+    entry->mtime        = st.st_mtime;
+    entry->face_index   = face_index;
+    entry->num_faces    = face->num_faces;
+    entry->flags        = face->scalable ? FONT_INDEX_SCALABLE : 0;
+    if (face->ft_face && !FT_IS_SFNT( face->ft_face )) entry->flags |= FONT_INDEX_NEEDS_BITMAP;
+    entry->ntm_flags    = face->ntm_flags;
+    entry->font_version = face->font_version;
+    entry->name_len     = name_len;
+    entry->fs           = face->fs;
+    entry->bitmap_size  = face->size;
+
+    ptr = (char *)(entry + 1);
+    memcpy( ptr, unix_name, name_len );
+    ptr += name_len;
+    for (i = 0; i < ARRAY_SIZE(names); i++) ptr = put_index_string( ptr, names[i] );
+    add_font_index_entry( entry );
+}
+
+/*************************************************************
+ * freetype_save_font_index
+ *
+ * Write the entries seen while loading the font list to a new index,
+ * if some faces had to be loaded from their files.
+ */
+static void freetype_save_font_index(void)
+{
+    struct font_index_header *header;
+    struct font_index_entry *entry, *other;
+    UINT i, hash, offset, size = sizeof(*header);
+    char *unix_name, *tmp_name = NULL, *buffer;
+    int fd;
+
+    if (!font_index_entries || (!font_index_stale && !font_index)) goto done;
+
+    for (i = 0; i < font_index_count; i++) size += (font_index_entries[i]->size + 7) & ~7;
+    if (!(buffer = calloc( 1, size ))) goto done;
+
+    header = (struct font_index_header *)buffer;
+    offset = (sizeof(*header) + 7) & ~7;
+    for (i = 0; i < font_index_count; i++)
+    {
+        entry = font_index_entries[i];
+        hash = font_index_hash( (const char *)(entry + 1), entry->face_index );
+
+        /* the same file may have been added more than once */
+        for (other = header->buckets[hash] ? (struct font_index_entry *)(buffer + header->buckets[hash]) : NULL;
+             other; other = other->next ? (struct font_index_entry *)(buffer + other->next) : NULL)
+        {
+            if (other->face_index == entry->face_index && other->name_len == entry->name_len &&
+                !memcmp( other + 1, entry + 1, entry->name_len ))
+                break;
+        }
+        if (other) continue;
+
+        memcpy( buffer + offset, entry, entry->size );
+        other = (struct font_index_entry *)(buffer + offset);
+        other->next = header->buckets[hash];
+        header->buckets[hash] = offset;
+        offset += (entry->size + 7) & ~7;
+        header->count++;
+    }
+    header->magic   = FONT_INDEX_MAGIC;
+    header->version = FONT_INDEX_VERSION;
+    header->lcid    = system_lcid;
+    header->size    = offset;
+
+    /* nothing to do if all the faces were found in the current index */
+    if (!font_index_stale && header->count == font_index->count)
+    {
+        free( buffer );
+        goto done;
+    }
+
+    /* write to a temporary file and rename it, processes that have mapped the old index keep using it */
+    if ((unix_name = get_unix_file_name( font_index_pathW )) &&
+        (tmp_name = malloc( strlen( unix_name ) + 16 )))
+    {
+        sprintf( tmp_name, "%s.%u", unix_name, (unsigned int)getpid() );
+        if ((fd = open( tmp_name, O_WRONLY | O_CREAT | O_TRUNC, 0666 )) != -1)
+        {
+            BOOL ok = write( fd, buffer, offset ) == offset;
+            close( fd );
+            if (!ok || rename( tmp_name, unix_name ) == -1) unlink( tmp_name );
+            else TRACE( "saved font index with %u entries\n", header->count );
+        }
+    }
+    free( tmp_name );
+    free( unix_name );
+    free( buffer );
+
+done:
+    for (i = 0; i < font_index_count; i++) free( font_index_entries[i] );
+    free( font_index_entries );
+    font_index_entries = NULL;
+    font_index_count = font_index_capacity = 0;
+}
+
 static int add_unix_face( const char *unix_name, const WCHAR *file, void *data_ptr, SIZE_T data_size,
                           DWORD face_index, DWORD flags, DWORD *num_faces )
 {
-    struct unix_face *unix_face;
+    struct unix_face *unix_face = NULL;
+    struct stat st;
     int ret;
 
     if (num_faces) *num_faces = 0;
 
-    if (!(unix_face = unix_face_create( unix_name, data_ptr, data_size, face_index, flags )))
-        return 0;
+    if (unix_name && !stat( unix_name, &st ))
+        unix_face = find_indexed_face( unix_name, &st, face_index, flags );
+    if (!unix_face)
+    {
+        if (!(unix_face = unix_face_create( unix_name, data_ptr, data_size, face_index, flags )))
+            return 0;
+        if (unix_name) add_face_to_index( unix_name, face_index, unix_face );
+    }
 
     if (unix_face->family_name[0] == '.') /* Ignore fonts with names beginning with a dot */
     {
@@ -4240,6 +4583,7 @@ static DWORD freetype_get_kerning_pairs( struct gdi_font *font, KERNINGPAIR **pa
 static const struct font_backend_funcs font_funcs =
 {
     freetype_load_fonts,
+    freetype_save_font_index,
     fontconfig_enum_family_fallbacks,
     freetype_add_font,
     freetype_add_mem_font,
@@ -4264,6 +4608,9 @@ const struct font_backend_funcs *init_freetype_lib(void)
     init_fontconfig();
 #endif
     NtQueryDefaultLocale( FALSE, &system_lcid );
+
+    /* collect the entries of the font index while the font list is loaded */
+    if ((font_index_entries = malloc( 256 * sizeof(*font_index_entries) ))) font_index_capacity = 256;
     return &font_funcs;
 }
 
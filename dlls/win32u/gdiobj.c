@@ -27,6 +27,7 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <pthread.h>
+#include <sched.h>
 
 #include "windef.h"
 #include "winbase.h"
@@ -92,6 +93,45 @@ static const LOGBRUSH DCBrush = { BS_SOLID, RGB(255,255,255), 0 };
 
 static pthread_mutex_t gdi_lock;
 
+/* Each handle entry also has a small lock, held only for short sections that don't take
+ * any other lock. It protects the entry and the object header against a concurrent
+ * free_gdi_handle, which holds both locks, so that operations that don't need the
+ * object itself can avoid the global lock. */
+static LONG entry_locks[GDI_MAX_HANDLE_COUNT];
+
+static inline void lock_entry( unsigned int idx )
+{
+    unsigned int spins = 0;
+
+    while (InterlockedCompareExchange( &entry_locks[idx], 1, 0 ))
+    {
+        if (++spins % 64) YieldProcessor();
+        else sched_yield();
+    }
+}
+
+static inline void unlock_entry( unsigned int idx )
+{
+    InterlockedExchange( &entry_locks[idx], 0 );
+}
+
+/* lock the entry of a handle, and return it if the handle is valid */
+static GDI_HANDLE_ENTRY *lock_handle_entry( HGDIOBJ handle )
+{
+    unsigned int idx = LOWORD(handle);
+    GDI_HANDLE_ENTRY *entry;
+
+    if (idx >= GDI_MAX_HANDLE_COUNT) return handle_entry( handle );
+    lock_entry( idx );
+    if (!(entry = handle_entry( handle ))) unlock_entry( idx );
+    return entry;
+}
+
+static inline void unlock_handle_entry( GDI_HANDLE_ENTRY *entry )
+{
+    unlock_entry( entry - gdi_shared->Handles );
+}
+
 
 /****************************************************************************
  *
@@ -456,9 +496,9 @@ void make_gdi_object_system( HGDIOBJ handle, BOOL set)
 {
     GDI_HANDLE_ENTRY *entry;
 
-    pthread_mutex_lock( &gdi_lock );
-    if ((entry = handle_entry( handle ))) entry_obj( entry )->system = !!set;
-    pthread_mutex_unlock( &gdi_lock );
+    if (!(entry = lock_handle_entry( handle ))) return;
+    entry_obj( entry )->system = !!set;
+    unlock_handle_entry( entry );
 }
 
 /******************************************************************************
@@ -512,9 +552,11 @@ UINT GDI_get_ref_count( HGDIOBJ handle )
     GDI_HANDLE_ENTRY *entry;
     UINT ret = 0;
 
-    pthread_mutex_lock( &gdi_lock );
-    if ((entry = handle_entry( handle ))) ret = entry_obj( entry )->selcount;
-    pthread_mutex_unlock( &gdi_lock );
+    if ((entry = lock_handle_entry( handle )))
+    {
+        ret = entry_obj( entry )->selcount;
+        unlock_handle_entry( entry );
+    }
     return ret;
 }
 
@@ -528,10 +570,9 @@ HGDIOBJ GDI_inc_ref_count( HGDIOBJ handle )
 {
     GDI_HANDLE_ENTRY *entry;
 
-    pthread_mutex_lock( &gdi_lock );
-    if ((entry = handle_entry( handle ))) entry_obj( entry )->selcount++;
-    else handle = 0;
-    pthread_mutex_unlock( &gdi_lock );
+    if (!(entry = lock_handle_entry( handle ))) return 0;
+    entry_obj( entry )->selcount++;
+    unlock_handle_entry( entry );
     return handle;
 }
 
@@ -545,22 +586,20 @@ BOOL GDI_dec_ref_count( HGDIOBJ handle )
 {
     GDI_HANDLE_ENTRY *entry;
 
-    pthread_mutex_lock( &gdi_lock );
-    if ((entry = handle_entry( handle )))
+    if (!(entry = lock_handle_entry( handle ))) return FALSE;
+
+    assert( entry_obj( entry )->selcount );
+    if (!--entry_obj( entry )->selcount && entry_obj( entry )->deleted)
     {
-        assert( entry_obj( entry )->selcount );
-        if (!--entry_obj( entry )->selcount && entry_obj( entry )->deleted)
-        {
-            /* handle delayed DeleteObject*/
-            entry_obj( entry )->deleted = 0;
-            pthread_mutex_unlock( &gdi_lock );
-            TRACE( "executing delayed DeleteObject for %p\n", handle );
-            NtGdiDeleteObjectApp( handle );
-            return TRUE;
-        }
+        /* handle delayed DeleteObject*/
+        entry_obj( entry )->deleted = 0;
+        unlock_handle_entry( entry );
+        TRACE( "executing delayed DeleteObject for %p\n", handle );
+        NtGdiDeleteObjectApp( handle );
+        return TRUE;
     }
-    pthread_mutex_unlock( &gdi_lock );
-    return entry != NULL;
+    unlock_handle_entry( entry );
+    return TRUE;
 }
 
 
@@ -757,11 +796,13 @@ HGDIOBJ alloc_gdi_handle( struct gdi_obj_header *obj, DWORD type, const struct g
     obj->selcount = 0;
     obj->system   = 0;
     obj->deleted  = 0;
+    lock_entry( entry - gdi_shared->Handles );
     entry->Object  = (UINT_PTR)obj;
     entry->ExtType = type >> NTGDI_HANDLE_TYPE_SHIFT;
     entry->Type    = entry->ExtType & 0x1f;
     if (++entry->Generation == 0xff) entry->Generation = 1;
     ret = entry_to_handle( entry );
+    unlock_handle_entry( entry );
     pthread_mutex_unlock( &gdi_lock );
     TRACE( "allocated %s %p %u/%u\n", gdi_obj_type(type), ret,
            InterlockedIncrement( &debug_count ), GDI_MAX_HANDLE_COUNT );
@@ -780,13 +821,14 @@ void *free_gdi_handle( HGDIOBJ handle )
     GDI_HANDLE_ENTRY *entry;
 
     pthread_mutex_lock( &gdi_lock );
-    if ((entry = handle_entry( handle )))
+    if ((entry = lock_handle_entry( handle )))
     {
         TRACE( "freed %s %p %u/%u\n", gdi_obj_type( entry->ExtType << NTGDI_HANDLE_TYPE_SHIFT ),
                handle, InterlockedDecrement( &debug_count ) + 1, GDI_MAX_HANDLE_COUNT );
         object = entry_obj( entry );
         entry->Type = 0;
         entry->Object = (UINT_PTR)next_free;
+        unlock_handle_entry( entry );
         next_free = entry;
     }
     pthread_mutex_unlock( &gdi_lock );
@@ -857,6 +899,30 @@ void GDI_ReleaseObj( HGDIOBJ handle )
     pthread_mutex_unlock( &gdi_lock );
 }
 
+/***********************************************************************
+ *           lock_obj_entry
+ *
+ * Return a pointer to, and the type of, the GDI object associated with the
+ * handle, holding only the lock of its handle entry instead of the GDI lock.
+ * No other GDI object may be locked until it's released with unlock_obj_entry.
+ */
+void *lock_obj_entry( HGDIOBJ handle, DWORD *type )
+{
+    GDI_HANDLE_ENTRY *entry;
+
+    if (!(entry = lock_handle_entry( handle ))) return NULL;
+    *type = entry->ExtType << NTGDI_HANDLE_TYPE_SHIFT;
+    return entry_obj( entry );
+}
+
+/***********************************************************************
+ *           unlock_obj_entry
+ */
+void unlock_obj_entry( HGDIOBJ handle )
+{
+    unlock_entry( LOWORD(handle) );
+}
+
 
 /***********************************************************************
  *           NtGdiDeleteObjectApp    (win32u.@)
@@ -878,18 +944,13 @@ BOOL WINAPI NtGdiDeleteObjectApp( HGDIOBJ obj )
     const struct gdi_obj_funcs *funcs = NULL;
     struct gdi_obj_header *header;
 
-    pthread_mutex_lock( &gdi_lock );
-    if (!(entry = handle_entry( obj )))
-    {
-        pthread_mutex_unlock( &gdi_lock );
-        return FALSE;
-    }
+    if (!(entry = lock_handle_entry( obj ))) return FALSE;
 
     header = entry_obj( entry );
     if (header->system)
     {
+        unlock_handle_entry( entry );
 	TRACE("Preserving system object %p\n", obj);
-        pthread_mutex_unlock( &gdi_lock );
 	return TRUE;
     }
 
@@ -902,7 +963,7 @@ BOOL WINAPI NtGdiDeleteObjectApp( HGDIOBJ obj )
     }
     else funcs = header->funcs;
 
-    pthread_mutex_unlock( &gdi_lock );
+    unlock_handle_entry( entry );
 
     TRACE("%p\n", obj );
 
@@ -949,13 +1010,12 @@ INT WINAPI NtGdiExtGetObjectW( HGDIOBJ handle, INT count, void *buffer )
 
     TRACE("%p %d %p\n", handle, count, buffer );
 
-    pthread_mutex_lock( &gdi_lock );
-    if ((entry = handle_entry( handle )))
+    if ((entry = lock_handle_entry( handle )))
     {
         funcs = entry_obj( entry )->funcs;
         handle = entry_to_handle( entry );  /* make it a full handle */
+        unlock_handle_entry( entry );
     }
-    pthread_mutex_unlock( &gdi_lock );
 
     if (funcs && funcs->pGetObjectW)
     {
@@ -1004,13 +1064,12 @@ BOOL WINAPI NtGdiUnrealizeObject( HGDIOBJ obj )
     const struct gdi_obj_funcs *funcs = NULL;
     GDI_HANDLE_ENTRY *entry;
 
-    pthread_mutex_lock( &gdi_lock );
-    if ((entry = handle_entry( obj )))
+    if ((entry = lock_handle_entry( obj )))
     {
         funcs = entry_obj( entry )->funcs;
         obj = entry_to_handle( entry );  /* make it a full handle */
+        unlock_handle_entry( entry );
     }
-    pthread_mutex_unlock( &gdi_lock );
 
     if (funcs && funcs->pUnrealizeObject) return funcs->pUnrealizeObject( obj );
     return funcs != NULL;
@@ -1253,6 +1312,7 @@ NTSTATUS gdi_init(void)
     NtQuerySystemInformation( SystemBasicInformation, &system_info, sizeof(system_info), NULL );
     init_gdi_shared();
     if (!gdi_shared) return STATUS_NO_MEMORY;
+    init_primitive_funcs();
 
     dpi = font_init();
     init_stock_objects( dpi );
@@ -67,6 +67,29 @@ BOOL WINAPI NtUserAttachThreadInput( DWORD from, DWORD to, BOOL attach )
     return ret;
 }
 
+/* check if raw mouse motion can be coalesced with the previous unread one in the server queues */
+static BOOL coalesce_raw_mouse_input(void)
+{
+    static const WCHAR valsW[] = {'y','Y','t','T','1',0};
+    static int coalesce = -1;
+    char value_buffer[FIELD_OFFSET(KEY_VALUE_PARTIAL_INFORMATION, Data[20 * sizeof(WCHAR)])];
+    KEY_VALUE_PARTIAL_INFORMATION *info = (void *)value_buffer;
+    HKEY hkey;
+    int ret = 0;
+
+    if (coalesce != -1) return coalesce;
+
+    /* @@ Wine registry key: HKCU\Software\Wine\Input */
+    if ((hkey = reg_open_hkcu_key( "Software\\Wine\\Input" )))
+    {
+        if (query_reg_ascii_value( hkey, "CoalesceRawMouse", info, sizeof(value_buffer) ) &&
+            info->Type == REG_SZ)
+            ret = (wcschr( valsW, *(const WCHAR *)info->Data ) != NULL);
+        NtClose( hkey );
+    }
+    return coalesce = ret;
+}
+
 /***********************************************************************
  *           __wine_send_input  (win32u.@)
  *
@@ -74,7 +97,10 @@ BOOL WINAPI NtUserAttachThreadInput( DWORD from, DWORD to, BOOL attach )
  */
 BOOL CDECL __wine_send_input( HWND hwnd, const INPUT *input, const RAWINPUT *rawinput )
 {
-    return set_ntstatus( send_hardware_message( hwnd, input, rawinput, 0 ));
+    UINT flags = 0;
+
+    if (input->type == INPUT_MOUSE && coalesce_raw_mouse_input()) flags |= SEND_HWMSG_COALESCE;
+    return set_ntstatus( send_hardware_message( hwnd, input, rawinput, flags ));
 }
 
 /***********************************************************************
@@ -45,6 +45,9 @@ WINE_DECLARE_DEBUG_CHANNEL(relay);
 
 #define MAX_PACK_COUNT 4
 
+/* WM_COPYDATA payloads of at least this size are passed to other processes in a section */
+#define COPYDATA_SECTION_THRESHOLD (64 * 1024)
+
 struct packed_hook_extra_info
 {
     user_handle_t handle;
@@ -1224,6 +1227,111 @@ static inline void call_sendmsg_callback( SENDASYNCPROC callback, HWND hwnd, UIN
                    callback, hwnd, debugstr_msg_name( msg, hwnd ), data, result );
 }
 
+/* map the server queue status mapping, shared by all threads of the process */
+static const volatile queue_status_t *map_queue_status(void)
+{
+    static const volatile queue_status_t *queue_status_slots;
+    static BOOL mapped;
+    void *ptr;
+
+    if (mapped) return queue_status_slots;
+
+    if ((ptr = map_shared_section( "\\KernelObjects\\__wine_queue_status",
+                                   QUEUE_STATUS_SLOTS * sizeof(queue_status_t) )) &&
+        InterlockedCompareExchangePointer( (void **)&queue_status_slots, ptr, NULL ))
+        NtUnmapViewOfSection( GetCurrentProcess(), ptr );
+    mapped = TRUE;
+    return queue_status_slots;
+}
+
+/***********************************************************************
+ *           get_server_queue_handle
+ *
+ * Get a handle to the server message queue for the current thread.
+ */
+static HANDLE get_server_queue_handle(void)
+{
+    struct user_thread_info *thread_info = get_user_thread_info();
+    const volatile queue_status_t *status;
+    HANDLE ret;
+    int slot = -1;
+
+    if (!(ret = thread_info->server_queue))
+    {
+        SERVER_START_REQ( get_msg_queue )
+        {
+            wine_server_call( req );
+            ret = wine_server_ptr_handle( reply->handle );
+            slot = reply->status_slot;
+        }
+        SERVER_END_REQ;
+        thread_info->server_queue = ret;
+        if (!ret) ERR( "Cannot get server thread queue\n" );
+        if (slot != -1 && (status = map_queue_status())) thread_info->queue_status = status + slot;
+    }
+    return ret;
+}
+
+/***********************************************************************
+ *           is_queue_empty
+ *
+ * Check the shared queue status to find out whether a get_message request
+ * would return no message and have no side effects, so that it can be skipped.
+ */
+static BOOL is_queue_empty( HWND hwnd, UINT first, UINT last, UINT flags, UINT changed_mask )
+{
+    struct user_thread_info *thread_info = get_user_thread_info();
+    const volatile queue_status_t *status;
+    UINT filter = flags >> 16, wake = QS_SENDMESSAGE, clear = 0;
+
+    if (hwnd || changed_mask) return FALSE;
+    if (!thread_info->server_queue) get_server_queue_handle();
+    if (!(status = thread_info->queue_status)) return FALSE;
+    /* the server considers the queue hung if it isn't checked regularly */
+    if (NtGetTickCount() - thread_info->last_getmsg_time > 1000) return FALSE;
+
+    if (!filter) filter = QS_ALLINPUT;
+    if (filter & QS_POSTMESSAGE)
+    {
+        wake |= QS_POSTMESSAGE | QS_ALLPOSTMESSAGE;
+        clear |= QS_POSTMESSAGE | QS_HOTKEY | QS_TIMER;
+        if (!first && last == ~0u) clear |= QS_ALLPOSTMESSAGE;
+    }
+    wake |= filter & (QS_HOTKEY | QS_INPUT | QS_PAINT | QS_TIMER);
+    clear |= filter & (QS_INPUT | QS_PAINT);
+
+    return !(status->wake_bits & wake) && !(status->changed_bits & clear);
+}
+
+/***********************************************************************
+ *           map_copydata_section
+ *
+ * Map the section holding the data of a large WM_COPYDATA message sent from another process.
+ */
+static void *map_copydata_section( HANDLE section, COPYDATASTRUCT *cds, const void *buffer, size_t size )
+{
+    const union packed_structs *ps = buffer;
+    LARGE_INTEGER offset;
+    SIZE_T view_size = 0;
+    void *view = NULL;
+
+    offset.QuadPart = 0;
+    if (size >= sizeof(ps->cds) &&
+        !NtMapViewOfSection( section, GetCurrentProcess(), &view, 0, 0, &offset,
+                             &view_size, ViewShare, 0, PAGE_WRITECOPY ) && view_size < ps->cds.cbData)
+    {
+        NtUnmapViewOfSection( GetCurrentProcess(), view );
+        view = NULL;
+    }
+    NtClose( section );
+    if (!view) return NULL;
+
+    cds->dwData = ps->cds.dwData;
+    cds->cbData = ps->cds.cbData;
+    cds->lpData = view;
+    return view;
+}
+
 /***********************************************************************
  *           peek_message
  *
@@ -1241,17 +1349,21 @@ static int peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags,
     void *buffer;
     size_t buffer_size = 1024;
 
-    if (!(buffer = malloc( buffer_size ))) return -1;
-
     if (!first && !last) last = ~0;
     if (hwnd == HWND_BROADCAST) hwnd = HWND_TOPMOST;
 
+    if (is_queue_empty( hwnd, first, last, flags, changed_mask )) return 0;
+    if (!(buffer = malloc( buffer_size ))) return -1;
+
     for (;;)
     {
         NTSTATUS res;
         size_t size = 0;
         const message_data_t *msg_data = buffer;
         BOOL needs_unpack = FALSE;
+        HANDLE section = 0;
+        COPYDATASTRUCT cds;
+        void *view = NULL;
 
         thread_info->msg_source = prev_source;
 
@@ -1265,7 +1377,9 @@ static int peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags,
             req->wake_mask = changed_mask & (QS_SENDMESSAGE | QS_SMRESULT);
             req->changed_mask = changed_mask;
             wine_server_set_reply( req, buffer, buffer_size );
-            if (!(res = wine_server_call( req )))
+            res = wine_server_call( req );
+            thread_info->last_getmsg_time = NtGetTickCount();
+            if (!res)
             {
                 size = wine_server_reply_size( reply );
                 info.type        = reply->type;
@@ -1276,6 +1390,7 @@ static int peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags,
                 info.msg.time    = reply->time;
                 info.msg.pt.x    = reply->x;
                 info.msg.pt.y    = reply->y;
+                section          = wine_server_ptr_handle( reply->section );
                 hw_id            = 0;
                 thread_info->active_hooks = reply->active_hooks;
             }
@@ -1389,6 +1504,20 @@ static int peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags,
             continue;
         case MSG_OTHER_PROCESS:
             info.flags = ISMEX_SEND;
+            if (section)
+            {
+                if (info.msg.message == WM_COPYDATA)
+                    view = map_copydata_section( section, &cds, buffer, size );
+                else
+                    NtClose( section );
+                if (!view)
+                {
+                    reply_message( &info, 0, &info.msg );
+                    continue;
+                }
+                info.msg.lParam = (LPARAM)&cds;
+                break;
+            }
             if (!unpack_message( info.msg.hwnd, info.msg.message, &info.msg.wParam,
                                  &info.msg.lParam, &buffer, size ))
             {
@@ -1461,6 +1590,7 @@ static int peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags,
         result = call_window_proc( info.msg.hwnd, info.msg.message, info.msg.wParam,
                                    info.msg.lParam, (info.type != MSG_ASCII), FALSE,
                                    WMCHAR_MAP_RECVMESSAGE, needs_unpack, buffer, size );
+        if (view) NtUnmapViewOfSection( GetCurrentProcess(), view );
         if (thread_info->receive_info == &info)
             reply_message_result( result, &info.msg );
 
@@ -1480,30 +1610,6 @@ static void process_sent_messages(void)
     peek_message( &msg, 0, 0, 0, PM_REMOVE | PM_QS_SENDMESSAGE, 0 );
 }
 
-/***********************************************************************
- *           get_server_queue_handle
- *
- * Get a handle to the server message queue for the current thread.
- */
-static HANDLE get_server_queue_handle(void)
-{
-    struct user_thread_info *thread_info = get_user_thread_info();
-    HANDLE ret;
-
-    if (!(ret = thread_info->server_queue))
-    {
-        SERVER_START_REQ( get_msg_queue )
-        {
-            wine_server_call( req );
-            ret = wine_server_ptr_handle( reply->handle );
-        }
-        SERVER_END_REQ;
-        thread_info->server_queue = ret;
-        if (!ret) ERR( "Cannot get server thread queue\n" );
-    }
-    return ret;
-}
-
 /* check for driver events if we detect that the app is not properly consuming messages */
 static inline void check_for_driver_events( UINT msg )
 {
@@ -1721,6 +1827,35 @@ BOOL WINAPI NtUserGetMessage( MSG *msg, HWND hwnd, UINT first, UINT last )
     return msg->message != WM_QUIT;
 }
 
+/***********************************************************************
+ *           create_copydata_section
+ *
+ * Copy the data of a large WM_COPYDATA message to a section that the receiving
+ * process can map, instead of copying it through the server.
+ */
+static HANDLE create_copydata_section( const void *data, size_t size )
+{
+    LARGE_INTEGER section_size, offset;
+    SIZE_T view_size = 0;
+    HANDLE section;
+    void *view = NULL;
+
+    section_size.QuadPart = size;
+    if (NtCreateSection( &section, SECTION_ALL_ACCESS, NULL, &section_size,
+                         PAGE_READWRITE, SEC_COMMIT, 0 ))
+        return 0;
+    offset.QuadPart = 0;
+    if (NtMapViewOfSection( section, GetCurrentProcess(), &view, 0, 0, &offset,
+                            &view_size, ViewShare, 0, PAGE_READWRITE ))
+    {
+        NtClose( section );
+        return 0;
+    }
+    memcpy( view, data, size );
+    NtUnmapViewOfSection( GetCurrentProcess(), view );
+    return section;
+}
+
 /***********************************************************************
  *           put_message_in_queue
  *
@@ -1732,6 +1867,7 @@ static BOOL put_message_in_queue( const struct send_message_info *info, size_t *
     struct packed_message data;
     message_data_t msg_data;
     unsigned int res;
+    HANDLE section = 0;
     int i;
     timeout_t timeout = TIMEOUT_INFINITE;
 
@@ -1757,6 +1893,12 @@ static BOOL put_message_in_queue( const struct send_message_info *info, size_t *
             WARN( "cannot pack message %x\n", info->msg );
             return FALSE;
         }
+        /* large WM_COPYDATA payloads are passed through a section, the server keeps
+         * it alive until the message result is freed */
+        if (info->type == MSG_OTHER_PROCESS && info->msg == WM_COPYDATA && data.count == 2 &&
+            data.size[1] >= COPYDATA_SECTION_THRESHOLD &&
+            (section = create_copydata_section( data.data[1], data.size[1] )))
+            data.count = 1;
     }
     else if (info->type == MSG_CALLBACK)
     {
@@ -1783,6 +1925,7 @@ static BOOL put_message_in_queue( const struct send_message_info *info, size_t *
         req->wparam  = info->wparam;
         req->lparam  = info->lparam;
         req->timeout = timeout;
+        req->section = wine_server_obj_handle( section );
 
         if (info->flags & SMTO_ABORTIFHUNG) req->flags |= SEND_MSG_ABORT_IF_HUNG;
         for (i = 0; i < data.count; i++) wine_server_add_data( req, data.data[i], data.size[i] );
@@ -1796,6 +1939,7 @@ static BOOL put_message_in_queue( const struct send_message_info *info, size_t *
         }
     }
     SERVER_END_REQ;
+    if (section) NtClose( section );
     return !res;
 }
 
@@ -193,9 +193,9 @@ extern BITMAPINFO *copy_packed_dib( const BITMAPINFO *src_info, UINT usage ) DEC
 extern DWORD convert_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, struct bitblt_coords *src,
                                  const BITMAPINFO *dst_info, void *dst_bits ) DECLSPEC_HIDDEN;
 
-extern DWORD stretch_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, struct bitblt_coords *src,
-                                 const BITMAPINFO *dst_info, void *dst_bits, struct bitblt_coords *dst,
-                                 INT mode ) DECLSPEC_HIDDEN;
+extern DWORD stretch_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, BOOL src_private,
+                                 struct bitblt_coords *src, const BITMAPINFO *dst_info, void *dst_bits,
+                                 struct bitblt_coords *dst, INT mode ) DECLSPEC_HIDDEN;
 extern DWORD blend_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, struct bitblt_coords *src,
                                const BITMAPINFO *dst_info, void *dst_bits, struct bitblt_coords *dst,
                                BLENDFUNCTION blend ) DECLSPEC_HIDDEN;
@@ -216,6 +216,7 @@ extern UINT set_dib_dc_color_table( HDC hdc, UINT startpos, UINT entries,
                                     const RGBQUAD *colors ) DECLSPEC_HIDDEN;
 extern void dibdrv_set_window_surface( DC *dc, struct window_surface *surface ) DECLSPEC_HIDDEN;
 extern struct opengl_funcs *dibdrv_get_wgl_driver(void) DECLSPEC_HIDDEN;
+extern void init_primitive_funcs(void) DECLSPEC_HIDDEN;
 
 /* driver.c */
 extern const struct gdi_dc_funcs null_driver DECLSPEC_HIDDEN;
@@ -290,6 +291,22 @@ struct gdi_font
     WCHAR                  file[1];
 };
 
+/* identity of a glyph bitmap, valid across processes */
+struct glyph_cache_key
+{
+    UINT64                 file_size;
+    FILETIME               writetime;
+    UINT                   file_hash;   /* hash of the font file name */
+    UINT                   face_index;
+    INT                    ppem;
+    INT                    scale_y;
+    INT                    ave_width;
+    INT                    orientation;
+    FMAT2                  matrix;
+    UINT                   flags;       /* simulations and embedded bitmaps usage */
+    UINT                   format;      /* GetGlyphOutline format of the bitmap */
+};
+
 #define MS_MAKE_TAG(ch1,ch2,ch3,ch4) \
     (((DWORD)ch4 << 24) | ((DWORD)ch3 << 16) | ((DWORD)ch2 << 8) | (DWORD)ch1)
 
@@ -312,6 +329,7 @@ struct gdi_font
 struct font_backend_funcs
 {
     void  (*load_fonts)(void);
+    void  (*save_font_index)(void);
     BOOL  (*enum_family_fallbacks)( DWORD pitch_and_family, int index, WCHAR buffer[LF_FACESIZE] );
     INT   (*add_font)( const WCHAR *file, DWORD flags );
     INT   (*add_mem_font)( void *ptr, SIZE_T size, DWORD flags );
@@ -339,6 +357,8 @@ extern int add_gdi_face( const WCHAR *family_name, const WCHAR *second_name,
                          DWORD ntmflags, DWORD version, DWORD flags,
                          const struct bitmap_font_size *size ) DECLSPEC_HIDDEN;
 extern UINT font_init(void) DECLSPEC_HIDDEN;
+extern BOOL get_glyph_cache_key( DC *dc, UINT glyph, UINT format, struct glyph_cache_key *key,
+                                 UINT *index ) DECLSPEC_HIDDEN;
 extern UINT get_acp(void) DECLSPEC_HIDDEN;
 extern CPTABLEINFO *get_cptable( WORD cp ) DECLSPEC_HIDDEN;
 extern const struct font_backend_funcs *init_freetype_lib(void) DECLSPEC_HIDDEN;
@@ -379,6 +399,8 @@ extern void *free_gdi_handle( HGDIOBJ handle ) DECLSPEC_HIDDEN;
 extern void *GDI_GetObjPtr( HGDIOBJ, DWORD ) DECLSPEC_HIDDEN;
 extern void *get_any_obj_ptr( HGDIOBJ, DWORD * ) DECLSPEC_HIDDEN;
 extern void GDI_ReleaseObj( HGDIOBJ ) DECLSPEC_HIDDEN;
+extern void *lock_obj_entry( HGDIOBJ handle, DWORD *type ) DECLSPEC_HIDDEN;
+extern void unlock_obj_entry( HGDIOBJ handle ) DECLSPEC_HIDDEN;
 extern UINT GDI_get_ref_count( HGDIOBJ handle ) DECLSPEC_HIDDEN;
 extern HGDIOBJ GDI_inc_ref_count( HGDIOBJ handle ) DECLSPEC_HIDDEN;
 extern BOOL GDI_dec_ref_count( HGDIOBJ handle ) DECLSPEC_HIDDEN;
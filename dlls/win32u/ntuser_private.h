@@ -24,6 +24,7 @@
 
 #include "ntuser.h"
 #include "wine/list.h"
+#include "wine/server_protocol.h"
 
 struct dce;
 struct tagWND;
@@ -142,6 +143,8 @@ struct user_thread_info
     HANDLE                        server_queue;           /* Handle to server-side queue */
     DWORD                         wake_mask;              /* Current queue wake mask */
     DWORD                         changed_mask;           /* Current queue changed mask */
+    const volatile queue_status_t *queue_status;          /* Queue status shared with the server */
+    DWORD                         last_getmsg_time;       /* Time of last get_message request */
     WORD                          recursion_count;        /* SendMessage recursion counter */
     WORD                          message_count;          /* Get/PeekMessage loop counter */
     WORD                          hook_call_depth;        /* Number of recursively called hook procs */
@@ -99,6 +99,7 @@ SOFTWARE.
 #endif
 
 #include <assert.h>
+#include <pthread.h>
 #include "ntgdi_private.h"
 #include "ntuser_private.h"
 #include "wine/debug.h"
@@ -122,6 +123,52 @@ static inline BOOL overlapping( const RECT *r1, const RECT *r2 )
             r1->bottom > r2->top && r1->top < r2->bottom);
 }
 
+/* one spare rectangle array is kept around, so that repeated operations on large
+ * regions can reuse the array freed by the previous one instead of allocating anew */
+#define RGN_SPARE_MAX_RECTS 65536
+
+static pthread_mutex_t spare_rects_lock = PTHREAD_MUTEX_INITIALIZER;
+static RECT *spare_rects;
+static INT spare_size;
+
+/* allocate an array of at least *size rectangles, and return its actual size */
+static RECT *alloc_rects( INT *size )
+{
+    RECT *rects = NULL;
+
+    pthread_mutex_lock( &spare_rects_lock );
+    /* don't hand out a much larger array than needed, the region would keep it */
+    if (spare_rects && spare_size >= *size && spare_size / 4 <= *size)
+    {
+        rects = spare_rects;
+        *size = spare_size;
+        spare_rects = NULL;
+    }
+    pthread_mutex_unlock( &spare_rects_lock );
+
+    if (!rects) rects = malloc( *size * sizeof(RECT) );
+    return rects;
+}
+
+static void free_rects( RECT *rects, INT size )
+{
+    if (size <= RGN_SPARE_MAX_RECTS)
+    {
+        RECT *old = rects;
+
+        pthread_mutex_lock( &spare_rects_lock );
+        if (!spare_rects || spare_size < size)
+        {
+            old = spare_rects;
+            spare_rects = rects;
+            spare_size = size;
+        }
+        pthread_mutex_unlock( &spare_rects_lock );
+        rects = old;
+    }
+    free( rects );
+}
+
 static BOOL grow_region( WINEREGION *rgn, int size )
 {
     RECT *new_rects;
@@ -408,7 +455,7 @@ static BOOL init_region( WINEREGION *pReg, INT n )
     if (n > RGN_DEFAULT_RECTS)
     {
         if (n > INT_MAX / sizeof(RECT)) return FALSE;
-        if (!(pReg->rects = malloc( n * sizeof( RECT ) )))
+        if (!(pReg->rects = alloc_rects( &n )))
             return FALSE;
     }
     else
@@ -425,7 +472,7 @@ static BOOL init_region( WINEREGION *pReg, INT n )
 static void destroy_region( WINEREGION *pReg )
 {
     if (pReg->rects != pReg->rects_buf)
-        free( pReg->rects );
+        free_rects( pReg->rects, pReg->size );
 }
 
 /***********************************************************************
@@ -981,6 +1028,56 @@ BOOL WINAPI NtGdiPtInRegion( HRGN hrgn, INT x, INT y )
 }
 
 
+/***********************************************************************
+ *           find_band_end
+ *
+ * Return the index of the first rectangle after the band starting at index start.
+ */
+static int find_band_end( const WINEREGION *rgn, int start )
+{
+    int i, top = rgn->rects[start].top, end = rgn->numRects;
+
+    start++;
+    while (start < end)
+    {
+        i = (start + end) / 2;
+        if (rgn->rects[i].top == top) start = i + 1;
+        else end = i;
+    }
+    return start;
+}
+
+/***********************************************************************
+ *           region_overlaps_rect
+ *
+ * Check whether rect overlaps the region, using a binary search to find the
+ * first band, and then to find the first candidate rectangle in each band.
+ */
+static BOOL region_overlaps_rect( const WINEREGION *rgn, const RECT *rect )
+{
+    int i, start, end, band_end;
+    BOOL ret;
+
+    for (start = region_find_pt( rgn, rect->left, rect->top, &ret );
+         !ret && start < rgn->numRects && rgn->rects[start].top < rect->bottom;
+         start = band_end)
+    {
+        band_end = find_band_end( rgn, start );
+
+        /* find the first rectangle of the band that ends after rect->left */
+        end = band_end;
+        while (start < end)
+        {
+            i = (start + end) / 2;
+            if (rgn->rects[i].right <= rect->left) start = i + 1;
+            else end = i;
+        }
+        if (start < band_end && rgn->rects[start].left < rect->right) ret = TRUE;
+    }
+    return ret;
+}
+
+
 /***********************************************************************
  *           NtGdiRectInRegion    (win32u.@)
  *
@@ -999,7 +1096,6 @@ BOOL WINAPI NtGdiRectInRegion( HRGN hrgn, const RECT *rect )
     WINEREGION *obj;
     BOOL ret = FALSE;
     RECT rc;
-    int i;
 
     /* swap the coordinates to make right >= left and bottom >= top */
     /* (region building rectangles are normalized the same way) */
@@ -1008,26 +1104,9 @@ BOOL WINAPI NtGdiRectInRegion( HRGN hrgn, const RECT *rect )
 
     if ((obj = GDI_GetObjPtr( hrgn, NTGDI_OBJ_REGION )))
     {
-	if ((obj->numRects > 0) && overlapping(&obj->extents, &rc))
-	{
-	    for (i = region_find_pt( obj, rc.left, rc.top, &ret ); !ret && i < obj->numRects; i++ )
-	    {
-	        if (obj->rects[i].bottom <= rc.top)
-		    continue;             /* not far enough down yet */
-
-		if (obj->rects[i].top >= rc.bottom)
-		    break;                /* too far down */
-
-		if (obj->rects[i].right <= rc.left)
-		    continue;              /* not far enough over yet */
-
-		if (obj->rects[i].left >= rc.right)
-		    continue;
-
-		ret = TRUE;
-	    }
-	}
-	GDI_ReleaseObj(hrgn);
+        if ((obj->numRects > 0) && overlapping(&obj->extents, &rc))
+            ret = region_overlaps_rect( obj, &rc );
+        GDI_ReleaseObj(hrgn);
     }
     return ret;
 }
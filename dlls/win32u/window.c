@@ -250,6 +250,45 @@ WND *get_win_ptr( HWND hwnd )
     return win;
 }
 
+/***********************************************************************
+ *           get_shared_window_info
+ *
+ * Retrieve the server information of a window from the shared window mapping.
+ * Used for windows of other processes, to avoid a server round trip.
+ */
+static BOOL get_shared_window_info( HWND hwnd, window_shm_t *info )
+{
+    static const volatile window_shm_t *window_shm_slots;
+    static BOOL mapped;
+    const volatile window_shm_t *shm;
+    WORD index = USER_HANDLE_TO_INDEX( hwnd );
+    unsigned int seq, retry;
+    void *ptr;
+
+    if (!mapped)
+    {
+        if ((ptr = map_shared_section( "\\KernelObjects\\__wine_windows",
+                                       WINDOW_SHM_SLOTS * sizeof(window_shm_t) )) &&
+            InterlockedCompareExchangePointer( (void **)&window_shm_slots, ptr, NULL ))
+            NtUnmapViewOfSection( GetCurrentProcess(), ptr );
+        mapped = TRUE;
+    }
+    if (!window_shm_slots || index >= WINDOW_SHM_SLOTS) return FALSE;
+
+    /* the entry is valid if the sequence counter is even and didn't change while we read it */
+    shm = &window_shm_slots[index];
+    for (retry = 0; retry < 16; retry++)
+    {
+        if ((seq = __atomic_load_n( &shm->seq, __ATOMIC_ACQUIRE )) & 1) continue;
+        *info = *shm;
+        __atomic_thread_fence( __ATOMIC_ACQUIRE );
+        if (shm->seq == seq) break;
+    }
+    if (retry == 16 || !info->handle) return FALSE;
+    if (HIWORD(hwnd) && HIWORD(hwnd) != 0xffff && info->handle != (UINT)(UINT_PTR)hwnd) return FALSE;
+    return TRUE;
+}
+
 /***********************************************************************
  *           is_current_thread_window
  *
@@ -286,6 +325,7 @@ HWND is_current_process_window( HWND hwnd )
 /* see IsWindow */
 BOOL is_window( HWND hwnd )
 {
+    window_shm_t info;
     WND *win;
     BOOL ret;
 
@@ -297,6 +337,7 @@ BOOL is_window( HWND hwnd )
         release_win_ptr( win );
         return TRUE;
     }
+    if (get_shared_window_info( hwnd, &info )) return TRUE;
 
     /* check other processes */
     SERVER_START_REQ( get_window_info )
@@ -311,6 +352,7 @@ BOOL is_window( HWND hwnd )
 /* see GetWindowThreadProcessId */
 DWORD get_window_thread( HWND hwnd, DWORD *process )
 {
+    window_shm_t info;
     WND *ptr;
     DWORD tid = 0;
 
@@ -328,6 +370,11 @@ DWORD get_window_thread( HWND hwnd, DWORD *process )
         release_win_ptr( ptr );
         return tid;
     }
+    if (ptr == WND_OTHER_PROCESS && get_shared_window_info( hwnd, &info ))
+    {
+        if (process) *process = info.pid;
+        return info.tid;
+    }
 
     /* check other processes */
     SERVER_START_REQ( get_window_info )
@@ -346,6 +393,7 @@ DWORD get_window_thread( HWND hwnd, DWORD *process )
 /* see GetParent */
 static HWND get_parent( HWND hwnd )
 {
+    window_shm_t info;
     HWND retval = 0;
     WND *win;
 
@@ -355,7 +403,12 @@ static HWND get_parent( HWND hwnd )
         return 0;
     }
     if (win == WND_DESKTOP) return 0;
-    if (win == WND_OTHER_PROCESS)
+    if (win == WND_OTHER_PROCESS && get_shared_window_info( hwnd, &info ))
+    {
+        if (info.style & WS_POPUP) retval = wine_server_ptr_handle( info.owner );
+        else if (info.style & WS_CHILD) retval = wine_server_ptr_handle( info.parent );
+    }
+    else if (win == WND_OTHER_PROCESS)
     {
         LONG style = get_window_long( hwnd, GWL_STYLE );
         if (style & (WS_POPUP | WS_CHILD))
@@ -783,6 +836,7 @@ static BOOL is_window_drawable( HWND hwnd, BOOL icon )
 /* see IsWindowUnicode */
 BOOL is_window_unicode( HWND hwnd )
 {
+    window_shm_t info;
     WND *win;
     BOOL ret = FALSE;
 
@@ -795,6 +849,10 @@ BOOL is_window_unicode( HWND hwnd )
         ret = (win->flags & WIN_ISUNICODE) != 0;
         release_win_ptr( win );
     }
+    else if (get_shared_window_info( hwnd, &info ))
+    {
+        ret = info.is_unicode;
+    }
     else
     {
         SERVER_START_REQ( get_window_info )
@@ -811,6 +869,7 @@ BOOL is_window_unicode( HWND hwnd )
 DPI_AWARENESS_CONTEXT get_window_dpi_awareness_context( HWND hwnd )
 {
     DPI_AWARENESS_CONTEXT ret = 0;
+    window_shm_t info;
     WND *win;
 
     if (!(win = get_win_ptr( hwnd )))
@@ -824,6 +883,10 @@ DPI_AWARENESS_CONTEXT get_window_dpi_awareness_context( HWND hwnd )
         ret = ULongToHandle( win->dpi_awareness | 0x10 );
         release_win_ptr( win );
     }
+    else if (get_shared_window_info( hwnd, &info ))
+    {
+        ret = ULongToHandle( info.awareness | 0x10 );
+    }
     else
     {
         SERVER_START_REQ( get_window_info )
@@ -839,6 +902,7 @@ DPI_AWARENESS_CONTEXT get_window_dpi_awareness_context( HWND hwnd )
 /* see GetDpiForWindow */
 UINT get_dpi_for_window( HWND hwnd )
 {
+    window_shm_t info;
     WND *win;
     UINT ret = 0;
 
@@ -858,6 +922,10 @@ UINT get_dpi_for_window( HWND hwnd )
         if (!ret) ret = get_win_monitor_dpi( hwnd );
         release_win_ptr( win );
     }
+    else if (get_shared_window_info( hwnd, &info ))
+    {
+        ret = info.dpi;
+    }
     else
     {
         SERVER_START_REQ( get_window_info )
@@ -924,6 +992,7 @@ static BOOL is_zoomed( HWND hwnd )
 static LONG_PTR get_window_long_size( HWND hwnd, INT offset, UINT size, BOOL ansi )
 {
     LONG_PTR retval = 0;
+    window_shm_t info;
     WND *win;
 
     if (offset == GWLP_HWNDPARENT)
@@ -969,6 +1038,17 @@ static LONG_PTR get_window_long_size( HWND hwnd, INT offset, UINT size, BOOL ans
             SetLastError( ERROR_ACCESS_DENIED );
             return 0;
         }
+        if (offset < 0 && get_shared_window_info( hwnd, &info ))
+        {
+            switch(offset)
+            {
+            case GWL_STYLE:      return info.style;
+            case GWL_EXSTYLE:    return info.ex_style;
+            case GWLP_ID:        return info.id;
+            case GWLP_HINSTANCE: return (ULONG_PTR)wine_server_get_ptr( info.instance );
+            case GWLP_USERDATA:  return info.user_data;
+            }
+        }
         SERVER_START_REQ( set_window_info )
         {
             req->handle = wine_server_user_handle( hwnd );
@@ -1516,6 +1596,62 @@ static void mirror_rect( const RECT *window_rect, RECT *rect )
     rect->right = width - tmp;
 }
 
+/* retrieve the rectangles of a window from the shared window mapping, see get_window_rectangles */
+static BOOL get_shared_window_rects( HWND hwnd, enum coords_relative relative, RECT *window_rect,
+                                     RECT *client_rect, UINT dpi )
+{
+    window_shm_t info, parent;
+    user_handle_t handle;
+    RECT window, client, rect;
+
+    if (!get_shared_window_info( hwnd, &info )) return FALSE;
+    /* leave the DPI scaling to the server */
+    if ((dpi ? dpi : info.monitor_dpi) != info.dpi) return FALSE;
+
+    SetRect( &window, info.window.left, info.window.top, info.window.right, info.window.bottom );
+    SetRect( &client, info.client.left, info.client.top, info.client.right, info.client.bottom );
+
+    switch (relative)
+    {
+    case COORDS_CLIENT:
+        rect = client;
+        OffsetRect( &window, -rect.left, -rect.top );
+        OffsetRect( &client, -rect.left, -rect.top );
+        if (info.ex_style & WS_EX_LAYOUTRTL) mirror_rect( &rect, &window );
+        break;
+    case COORDS_WINDOW:
+        rect = window;
+        OffsetRect( &window, -rect.left, -rect.top );
+        OffsetRect( &client, -rect.left, -rect.top );
+        if (info.ex_style & WS_EX_LAYOUTRTL) mirror_rect( &rect, &client );
+        break;
+    case COORDS_PARENT:
+        if (!info.parent) break;
+        if (!get_shared_window_info( wine_server_ptr_handle( info.parent ), &parent )) return FALSE;
+        if (parent.ex_style & WS_EX_LAYOUTRTL)
+        {
+            SetRect( &rect, parent.client.left, parent.client.top, parent.client.right, parent.client.bottom );
+            mirror_rect( &rect, &window );
+            mirror_rect( &rect, &client );
+        }
+        break;
+    case COORDS_SCREEN:
+        for (handle = info.parent; handle; handle = parent.parent)
+        {
+            if (!get_shared_window_info( wine_server_ptr_handle( handle ), &parent )) return FALSE;
+            if (!parent.parent) break;  /* desktop window */
+            OffsetRect( &window, parent.client.left, parent.client.top );
+            OffsetRect( &client, parent.client.left, parent.client.top );
+        }
+        break;
+    default:
+        return FALSE;
+    }
+    if (window_rect) *window_rect = window;
+    if (client_rect) *client_rect = client;
+    return TRUE;
+}
+
 /***********************************************************************
  *           get_window_rects
  *
@@ -1626,6 +1762,8 @@ BOOL get_window_rects( HWND hwnd, enum coords_relative relative, RECT *window_re
     }
 
 other_process:
+    if (get_shared_window_rects( hwnd, relative, window_rect, client_rect, dpi )) return TRUE;
+
     SERVER_START_REQ( get_window_rectangles )
     {
         req->handle = wine_server_user_handle( hwnd );
@@ -1733,18 +1871,46 @@ done:
     release_win_ptr( win );
 }
 
+/* state of a window position change between the server request and the driver notifications */
+struct window_pos_data
+{
+    HWND                   hwnd;
+    HWND                   insert_after;
+    UINT                   swp_flags;
+    RECT                   window_rect;
+    RECT                   client_rect;
+    RECT                   visible_rect;
+    RECT                   old_window_rect;
+    RECT                   old_visible_rect;
+    RECT                   old_client_rect;
+    RECT                   valid_buffer[2];
+    const RECT            *valid_rects;
+    struct window_surface *old_surface;
+    struct window_surface *new_surface;
+};
+
+static inline void rect_to_server( rectangle_t *dst, const RECT *src )
+{
+    dst->left   = src->left;
+    dst->top    = src->top;
+    dst->right  = src->right;
+    dst->bottom = src->bottom;
+}
+
 /***********************************************************************
- *           apply_window_pos
+ *           prepare_window_pos
  *
- * Backend implementation of SetWindowPos.
+ * First part of apply_window_pos: let the driver update the window surface,
+ * and build the server request data.
  */
-static BOOL apply_window_pos( HWND hwnd, HWND insert_after, UINT swp_flags,
-                              const RECT *window_rect, const RECT *client_rect, const RECT *valid_rects )
+static BOOL prepare_window_pos( struct window_pos_data *data, HWND hwnd, HWND insert_after,
+                                UINT swp_flags, const RECT *window_rect, const RECT *client_rect,
+                                const RECT *valid_rects, window_pos_t *pos )
 {
     WND *win;
-    HWND surface_win = 0, parent = NtUserGetAncestor( hwnd, GA_PARENT );
-    BOOL ret, needs_update = FALSE;
-    RECT visible_rect, old_visible_rect, old_window_rect, old_client_rect, extra_rects[3];
+    HWND parent = NtUserGetAncestor( hwnd, GA_PARENT );
+    BOOL ret;
+    RECT visible_rect;
     struct window_surface *old_surface, *new_surface = NULL;
 
     if (!parent || parent == get_desktop_window())
@@ -1764,7 +1930,7 @@ static BOOL apply_window_pos( HWND hwnd, HWND insert_after, UINT swp_flags,
         }
     }
 
-    get_window_rects( hwnd, COORDS_SCREEN, &old_window_rect, NULL, get_thread_dpi() );
+    get_window_rects( hwnd, COORDS_SCREEN, &data->old_window_rect, NULL, get_thread_dpi() );
     if (IsRectEmpty( &valid_rects[0] )) valid_rects = NULL;
 
     if (!(win = get_win_ptr( hwnd )) || win == WND_DESKTOP || win == WND_OTHER_PROCESS)
@@ -1783,8 +1949,6 @@ static BOOL apply_window_pos( HWND hwnd, HWND insert_after, UINT swp_flags,
         create_offscreen_window_surface( &visible_rect, &new_surface );
     }
 
-    old_visible_rect = win->visible_rect;
-    old_client_rect = win->client_rect;
     old_surface = win->surface;
     if (old_surface != new_surface) swp_flags |= SWP_FRAMECHANGED;  /* force refreshing non-client area */
     if (new_surface == &dummy_surface) swp_flags |= SWP_NOREDRAW;
@@ -1794,104 +1958,133 @@ static BOOL apply_window_pos( HWND hwnd, HWND insert_after, UINT swp_flags,
         valid_rects = NULL;
     }
 
-    SERVER_START_REQ( set_window_pos )
+    data->hwnd             = hwnd;
+    data->insert_after     = insert_after;
+    data->swp_flags        = swp_flags;
+    data->window_rect      = *window_rect;
+    data->client_rect      = *client_rect;
+    data->visible_rect     = visible_rect;
+    data->old_visible_rect = win->visible_rect;
+    data->old_client_rect  = win->client_rect;
+    data->old_surface      = old_surface;
+    data->new_surface      = new_surface;
+    data->valid_rects      = NULL;
+    if (valid_rects)
+    {
+        memcpy( data->valid_buffer, valid_rects, sizeof(data->valid_buffer) );
+        data->valid_rects = data->valid_buffer;
+    }
+
+    pos->handle      = wine_server_user_handle( hwnd );
+    pos->previous    = wine_server_user_handle( insert_after );
+    pos->swp_flags   = swp_flags;
+    pos->paint_flags = 0;
+    rect_to_server( &pos->window, window_rect );
+    rect_to_server( &pos->client, client_rect );
+    rect_to_server( &pos->visible, &visible_rect );
+    rect_to_server( &pos->surface, &visible_rect );
+    if (new_surface)
+    {
+        RECT surface_rect = new_surface->rect;
+        OffsetRect( &surface_rect, visible_rect.left, visible_rect.top );
+        rect_to_server( &pos->surface, &surface_rect );
+    }
+    memset( &pos->valid, 0, sizeof(pos->valid) );
+    if (valid_rects) rect_to_server( &pos->valid, &valid_rects[0] );
+    if (new_surface) pos->paint_flags |= SET_WINPOS_PAINT_SURFACE;
+    if (win->pixel_format) pos->paint_flags |= SET_WINPOS_PIXEL_FORMAT;
+
+    release_win_ptr( win );
+    return TRUE;
+}
+
+/***********************************************************************
+ *           finish_window_pos
+ *
+ * Last part of apply_window_pos: store the result of the server request
+ * and notify the driver.
+ */
+static BOOL finish_window_pos( struct window_pos_data *data, const window_pos_result_t *result )
+{
+    WND *win;
+    HWND hwnd = data->hwnd, surface_win = 0;
+    const RECT *window_rect = &data->window_rect, *client_rect = &data->client_rect;
+    const RECT *valid_rects = data->valid_rects;
+    RECT visible_rect = data->visible_rect;
+    UINT swp_flags = data->swp_flags;
+    BOOL ret, needs_update = FALSE;
+
+    if (!(win = get_win_ptr( hwnd )) || win == WND_DESKTOP || win == WND_OTHER_PROCESS)
     {
-        req->handle        = wine_server_user_handle( hwnd );
-        req->previous      = wine_server_user_handle( insert_after );
-        req->swp_flags     = swp_flags;
-        req->window.left   = window_rect->left;
-        req->window.top    = window_rect->top;
-        req->window.right  = window_rect->right;
-        req->window.bottom = window_rect->bottom;
-        req->client.left   = client_rect->left;
-        req->client.top    = client_rect->top;
-        req->client.right  = client_rect->right;
-        req->client.bottom = client_rect->bottom;
-        if (!EqualRect( window_rect, &visible_rect ) || new_surface || valid_rects)
-        {
-            extra_rects[0] = extra_rects[1] = visible_rect;
-            if (new_surface)
-            {
-                extra_rects[1] = new_surface->rect;
-                OffsetRect( &extra_rects[1], visible_rect.left, visible_rect.top );
-            }
-            if (valid_rects) extra_rects[2] = valid_rects[0];
-            else SetRectEmpty( &extra_rects[2] );
-            wine_server_add_data( req, extra_rects, sizeof(extra_rects) );
-        }
-        if (new_surface) req->paint_flags |= SET_WINPOS_PAINT_SURFACE;
-        if (win->pixel_format) req->paint_flags |= SET_WINPOS_PIXEL_FORMAT;
-
-        if ((ret = !wine_server_call( req )))
-        {
-            win->dwStyle      = reply->new_style;
-            win->dwExStyle    = reply->new_ex_style;
-            win->window_rect  = *window_rect;
-            win->client_rect  = *client_rect;
-            win->visible_rect = visible_rect;
-            win->surface      = new_surface;
-            surface_win       = wine_server_ptr_handle( reply->surface_win );
-            needs_update      = reply->needs_update;
-            if (get_window_long( win->parent, GWL_EXSTYLE ) & WS_EX_LAYOUTRTL)
-            {
-                RECT client;
-                get_window_rects( win->parent, COORDS_CLIENT, NULL, &client, get_thread_dpi() );
-                mirror_rect( &client, &win->window_rect );
-                mirror_rect( &client, &win->client_rect );
-                mirror_rect( &client, &win->visible_rect );
-            }
-            /* if an RTL window is resized the children have moved */
-            if (win->dwExStyle & WS_EX_LAYOUTRTL &&
-                client_rect->right - client_rect->left != old_client_rect.right - old_client_rect.left)
-                win->flags |= WIN_CHILDREN_MOVED;
-        }
+        if (data->new_surface) window_surface_release( data->new_surface );
+        return FALSE;
     }
-    SERVER_END_REQ;
 
-    if (ret)
+    if ((ret = !result->status))
     {
+        win->dwStyle      = result->new_style;
+        win->dwExStyle    = result->new_ex_style;
+        win->window_rect  = *window_rect;
+        win->client_rect  = *client_rect;
+        win->visible_rect = visible_rect;
+        win->surface      = data->new_surface;
+        surface_win       = wine_server_ptr_handle( result->surface_win );
+        needs_update      = result->needs_update;
+        if (get_window_long( win->parent, GWL_EXSTYLE ) & WS_EX_LAYOUTRTL)
+        {
+            RECT client;
+            get_window_rects( win->parent, COORDS_CLIENT, NULL, &client, get_thread_dpi() );
+            mirror_rect( &client, &win->window_rect );
+            mirror_rect( &client, &win->client_rect );
+            mirror_rect( &client, &win->visible_rect );
+        }
+        /* if an RTL window is resized the children have moved */
+        if (win->dwExStyle & WS_EX_LAYOUTRTL &&
+            client_rect->right - client_rect->left != data->old_client_rect.right - data->old_client_rect.left)
+            win->flags |= WIN_CHILDREN_MOVED;
+
         if (needs_update) update_surface_region( surface_win );
         if (((swp_flags & SWP_AGG_NOPOSCHANGE) != SWP_AGG_NOPOSCHANGE) ||
             (swp_flags & (SWP_HIDEWINDOW | SWP_SHOWWINDOW | SWP_STATECHANGED | SWP_FRAMECHANGED)))
-            invalidate_dce( win, &old_window_rect );
+            invalidate_dce( win, &data->old_window_rect );
     }
 
     release_win_ptr( win );
 
     if (ret)
     {
-        TRACE( "win %p surface %p -> %p\n", hwnd, old_surface, new_surface );
-        register_window_surface( old_surface, new_surface );
-        if (old_surface)
+        TRACE( "win %p surface %p -> %p\n", hwnd, data->old_surface, data->new_surface );
+        register_window_surface( data->old_surface, data->new_surface );
+        if (data->old_surface)
         {
             if (valid_rects)
             {
-                move_window_bits( hwnd, old_surface, new_surface, &visible_rect,
-                                  &old_visible_rect, window_rect, valid_rects );
+                move_window_bits( hwnd, data->old_surface, data->new_surface, &visible_rect,
+                                  &data->old_visible_rect, window_rect, valid_rects );
                 valid_rects = NULL;  /* prevent the driver from trying to also move the bits */
             }
-            window_surface_release( old_surface );
+            window_surface_release( data->old_surface );
         }
         else if (surface_win && surface_win != hwnd)
         {
             if (valid_rects)
             {
                 RECT rects[2];
-                int x_offset = old_visible_rect.left - visible_rect.left;
-                int y_offset = old_visible_rect.top - visible_rect.top;
+                int x_offset = data->old_visible_rect.left - visible_rect.left;
+                int y_offset = data->old_visible_rect.top - visible_rect.top;
 
                 /* if all that happened is that the whole window moved, copy everything */
                 if (!(swp_flags & SWP_FRAMECHANGED) &&
-                    old_visible_rect.right  - visible_rect.right  == x_offset &&
-                    old_visible_rect.bottom - visible_rect.bottom == y_offset &&
-                    old_client_rect.left    - client_rect->left   == x_offset &&
-                    old_client_rect.right   - client_rect->right  == x_offset &&
-                    old_client_rect.top     - client_rect->top    == y_offset &&
-                    old_client_rect.bottom  - client_rect->bottom == y_offset &&
+                    data->old_visible_rect.right  - visible_rect.right  == x_offset &&
+                    data->old_visible_rect.bottom - visible_rect.bottom == y_offset &&
+                    data->old_client_rect.left    - client_rect->left   == x_offset &&
+                    data->old_client_rect.right   - client_rect->right  == x_offset &&
+                    data->old_client_rect.top     - client_rect->top    == y_offset &&
+                    data->old_client_rect.bottom  - client_rect->bottom == y_offset &&
                     EqualRect( &valid_rects[0], client_rect ))
                 {
                     rects[0] = visible_rect;
-                    rects[1] = old_visible_rect;
+                    rects[1] = data->old_visible_rect;
                     valid_rects = rects;
                 }
                 move_window_bits_parent( hwnd, surface_win, window_rect, valid_rects );
@@ -1899,14 +2092,55 @@ static BOOL apply_window_pos( HWND hwnd, HWND insert_after, UINT swp_flags,
             }
         }
 
-        user_driver->pWindowPosChanged( hwnd, insert_after, swp_flags, window_rect,
-                                        client_rect, &visible_rect, valid_rects, new_surface );
+        user_driver->pWindowPosChanged( hwnd, data->insert_after, swp_flags, window_rect,
+                                        client_rect, &visible_rect, valid_rects, data->new_surface );
     }
-    else if (new_surface) window_surface_release( new_surface );
+    else if (data->new_surface) window_surface_release( data->new_surface );
 
     return ret;
 }
 
+/***********************************************************************
+ *           apply_window_pos
+ *
+ * Backend implementation of SetWindowPos.
+ */
+static BOOL apply_window_pos( HWND hwnd, HWND insert_after, UINT swp_flags,
+                              const RECT *window_rect, const RECT *client_rect, const RECT *valid_rects )
+{
+    struct window_pos_data data;
+    window_pos_result_t result;
+    window_pos_t pos;
+
+    if (!prepare_window_pos( &data, hwnd, insert_after, swp_flags, window_rect, client_rect,
+                             valid_rects, &pos ))
+        return FALSE;
+
+    memset( &result, 0, sizeof(result) );
+    SERVER_START_REQ( set_window_pos )
+    {
+        req->handle      = pos.handle;
+        req->previous    = pos.previous;
+        req->swp_flags   = pos.swp_flags;
+        req->paint_flags = pos.paint_flags;
+        req->window      = pos.window;
+        req->client      = pos.client;
+        wine_server_add_data( req, &pos.visible, sizeof(pos.visible) );
+        wine_server_add_data( req, &pos.surface, sizeof(pos.surface) );
+        wine_server_add_data( req, &pos.valid, sizeof(pos.valid) );
+        if (!(result.status = wine_server_call( req )))
+        {
+            result.new_style    = reply->new_style;
+            result.new_ex_style = reply->new_ex_style;
+            result.surface_win  = reply->surface_win;
+            result.needs_update = reply->needs_update;
+        }
+    }
+    SERVER_END_REQ;
+
+    return finish_window_pos( &data, &result );
+}
+
 /*******************************************************************
  *           NtUserGetWindowRgnEx (win32u.@)
  */
@@ -3087,15 +3321,29 @@ done:
     return after;
 }
 
-/* NtUserSetWindowPos implementation */
-BOOL set_window_pos( WINDOWPOS *winpos, int parent_x, int parent_y )
+/* state of a window position change between the WM_WINDOWPOSCHANGING and WM_WINDOWPOSCHANGED messages */
+struct set_window_pos_state
 {
-    RECT old_window_rect, old_client_rect, new_window_rect, new_client_rect, valid_rects[2];
+    RECT old_window_rect;
+    RECT old_client_rect;
+    RECT new_window_rect;
+    RECT new_client_rect;
+    RECT valid_rects[2];
     UINT orig_flags;
-    BOOL ret = FALSE;
-    DPI_AWARENESS_CONTEXT context;
+};
 
-    orig_flags = winpos->flags;
+/***********************************************************************
+ *           begin_set_window_pos
+ *
+ * First part of set_window_pos: validate the parameters and compute the new
+ * window rectangles. Returns FALSE if there's nothing more to do, with the
+ * result of the call in *ret.
+ */
+static BOOL begin_set_window_pos( WINDOWPOS *winpos, int parent_x, int parent_y,
+                                  struct set_window_pos_state *state, BOOL *ret )
+{
+    *ret = FALSE;
+    state->orig_flags = winpos->flags;
 
     /* First, check z-order arguments.  */
     if (!(winpos->flags & SWP_NOZORDER))
@@ -3114,7 +3362,11 @@ BOOL set_window_pos( WINDOWPOS *winpos, int parent_x, int parent_y )
 
             /* hwndInsertAfter must be a sibling of the window */
             if (!insertafter_parent) return FALSE;
-            if (insertafter_parent != parent) return TRUE;
+            if (insertafter_parent != parent)
+            {
+                *ret = TRUE;
+                return FALSE;
+            }
         }
     }
 
@@ -3134,13 +3386,11 @@ BOOL set_window_pos( WINDOWPOS *winpos, int parent_x, int parent_y )
         else if (winpos->cy > 32767) winpos->cy = 32767;
     }
 
-    context = set_thread_dpi_awareness_context( get_window_dpi_awareness_context( winpos->hwnd ));
-
-    if (!calc_winpos( winpos, &old_window_rect, &old_client_rect,
-                      &new_window_rect, &new_client_rect )) goto done;
+    if (!calc_winpos( winpos, &state->old_window_rect, &state->old_client_rect,
+                      &state->new_window_rect, &state->new_client_rect )) return FALSE;
 
     /* Fix redundant flags */
-    if (!fixup_swp_flags( winpos, &old_window_rect, parent_x, parent_y )) goto done;
+    if (!fixup_swp_flags( winpos, &state->old_window_rect, parent_x, parent_y )) return FALSE;
 
     if((winpos->flags & (SWP_NOZORDER | SWP_HIDEWINDOW | SWP_SHOWWINDOW)) != SWP_NOZORDER)
     {
@@ -3150,12 +3400,19 @@ BOOL set_window_pos( WINDOWPOS *winpos, int parent_x, int parent_y )
 
     /* Common operations */
 
-    calc_ncsize( winpos, &old_window_rect, &old_client_rect,
-                 &new_window_rect, &new_client_rect, valid_rects, parent_x, parent_y );
+    calc_ncsize( winpos, &state->old_window_rect, &state->old_client_rect,
+                 &state->new_window_rect, &state->new_client_rect, state->valid_rects, parent_x, parent_y );
+    return TRUE;
+}
 
-    if (!apply_window_pos( winpos->hwnd, winpos->hwndInsertAfter, winpos->flags,
-                           &new_window_rect, &new_client_rect, valid_rects ))
-        goto done;
+/***********************************************************************
+ *           end_set_window_pos
+ *
+ * Last part of set_window_pos, once the new position has been applied.
+ */
+static void end_set_window_pos( WINDOWPOS *winpos, const struct set_window_pos_state *state )
+{
+    UINT orig_flags = state->orig_flags;
 
     if (user_callbacks)
     {
@@ -3204,14 +3461,28 @@ BOOL set_window_pos( WINDOWPOS *winpos, int parent_x, int parent_y )
         /* WM_WINDOWPOSCHANGED is sent even if SWP_NOSENDCHANGING is set
            and always contains final window position.
          */
-        winpos->x  = new_window_rect.left;
-        winpos->y  = new_window_rect.top;
-        winpos->cx = new_window_rect.right - new_window_rect.left;
-        winpos->cy = new_window_rect.bottom - new_window_rect.top;
+        winpos->x  = state->new_window_rect.left;
+        winpos->y  = state->new_window_rect.top;
+        winpos->cx = state->new_window_rect.right - state->new_window_rect.left;
+        winpos->cy = state->new_window_rect.bottom - state->new_window_rect.top;
         send_message( winpos->hwnd, WM_WINDOWPOSCHANGED, 0, (LPARAM)winpos );
     }
-    ret = TRUE;
-done:
+}
+
+/* NtUserSetWindowPos implementation */
+BOOL set_window_pos( WINDOWPOS *winpos, int parent_x, int parent_y )
+{
+    struct set_window_pos_state state;
+    DPI_AWARENESS_CONTEXT context;
+    BOOL ret;
+
+    context = set_thread_dpi_awareness_context( get_window_dpi_awareness_context( winpos->hwnd ));
+
+    if (begin_set_window_pos( winpos, parent_x, parent_y, &state, &ret ) &&
+        (ret = apply_window_pos( winpos->hwnd, winpos->hwndInsertAfter, winpos->flags,
+                                 &state.new_window_rect, &state.new_client_rect, state.valid_rects )))
+        end_set_window_pos( winpos, &state );
+
     set_thread_dpi_awareness_context( context );
     return ret;
 }
@@ -3376,6 +3647,99 @@ done:
     return retvalue;
 }
 
+/***********************************************************************
+ *           set_multiple_window_pos
+ *
+ * Move several windows of the current thread at once, with a single server request.
+ * The batch stops after the first window that changes the z-order, since the
+ * following ones have to be checked against the new order. Returns the number
+ * of windows that have been processed.
+ */
+static int set_multiple_window_pos( WINDOWPOS *winpos, int count )
+{
+    struct set_window_pos_state *states;
+    struct window_pos_data *data;
+    window_pos_result_t *results;
+    window_pos_t *pos;
+    DPI_AWARENESS_CONTEXT context;
+    BOOL *valid, ret;
+    int i, n = 0;
+    NTSTATUS status;
+
+    states = malloc( count * sizeof(*states) );
+    data = malloc( count * sizeof(*data) );
+    results = malloc( count * sizeof(*results) );
+    pos = malloc( count * sizeof(*pos) );
+    valid = malloc( count * sizeof(*valid) );
+    if (!states || !data || !results || !pos || !valid)
+    {
+        set_window_pos( winpos, 0, 0 );
+        count = 1;
+        goto done;
+    }
+
+    /* send all the WM_WINDOWPOSCHANGING messages first */
+    for (i = 0; i < count; i++)
+    {
+        context = set_thread_dpi_awareness_context( get_window_dpi_awareness_context( winpos[i].hwnd ));
+        valid[i] = begin_set_window_pos( &winpos[i], 0, 0, &states[i], &ret );
+        set_thread_dpi_awareness_context( context );
+        if (valid[i] && (winpos[i].flags & (SWP_NOZORDER | SWP_HIDEWINDOW | SWP_SHOWWINDOW)) != SWP_NOZORDER)
+        {
+            count = i + 1;
+            break;
+        }
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (!valid[i]) continue;
+        context = set_thread_dpi_awareness_context( get_window_dpi_awareness_context( winpos[i].hwnd ));
+        valid[i] = prepare_window_pos( &data[n], winpos[i].hwnd, winpos[i].hwndInsertAfter, winpos[i].flags,
+                                       &states[i].new_window_rect, &states[i].new_client_rect,
+                                       states[i].valid_rects, &pos[n] );
+        set_thread_dpi_awareness_context( context );
+        if (valid[i]) n++;
+    }
+    if (!n) goto done;
+
+    /* then move all the windows together */
+    SERVER_START_REQ( set_window_pos_batch )
+    {
+        wine_server_add_data( req, pos, n * sizeof(*pos) );
+        wine_server_set_reply( req, results, n * sizeof(*results) );
+        if ((status = wine_server_call( req )))
+            for (i = 0; i < n; i++) results[i].status = status;
+    }
+    SERVER_END_REQ;
+
+    for (i = n = 0; i < count; i++)
+    {
+        if (!valid[i]) continue;
+        context = set_thread_dpi_awareness_context( get_window_dpi_awareness_context( winpos[i].hwnd ));
+        valid[i] = finish_window_pos( &data[n], &results[n] );
+        set_thread_dpi_awareness_context( context );
+        n++;
+    }
+
+    /* and finally send the WM_WINDOWPOSCHANGED messages */
+    for (i = 0; i < count; i++)
+    {
+        if (!valid[i]) continue;
+        context = set_thread_dpi_awareness_context( get_window_dpi_awareness_context( winpos[i].hwnd ));
+        end_set_window_pos( &winpos[i], &states[i] );
+        set_thread_dpi_awareness_context( context );
+    }
+
+done:
+    free( states );
+    free( data );
+    free( results );
+    free( pos );
+    free( valid );
+    return count;
+}
+
 /***********************************************************************
  *           NtUserEndDeferWindowPosEx (win32u.@)
  */
@@ -3383,7 +3747,7 @@ BOOL WINAPI NtUserEndDeferWindowPosEx( HDWP hdwp, BOOL async )
 {
     WINDOWPOS *winpos;
     DWP *dwp;
-    int i;
+    int i, count;
 
     TRACE( "%p\n", hdwp );
 
@@ -3397,15 +3761,24 @@ BOOL WINAPI NtUserEndDeferWindowPosEx( HDWP hdwp, BOOL async )
     }
 
     for (i = 0, winpos = dwp->winpos; i < dwp->count; i++, winpos++)
-    {
         TRACE( "hwnd %p, after %p, %d,%d (%dx%d), flags %08x\n",
                winpos->hwnd, winpos->hwndInsertAfter, winpos->x, winpos->y,
                winpos->cx, winpos->cy, winpos->flags );
 
-        if (is_current_thread_window( winpos->hwnd ))
-            set_window_pos( winpos, 0, 0 );
-        else
+    /* windows of other threads are moved by their own thread, consecutive
+     * windows of the current thread are moved together */
+    for (i = 0; i < dwp->count; i += count)
+    {
+        winpos = &dwp->winpos[i];
+        count = 1;
+        if (!is_current_thread_window( winpos->hwnd ))
+        {
             send_message( winpos->hwnd, WM_WINE_SETWINDOWPOS, 0, (LPARAM)winpos );
+            continue;
+        }
+        while (i + count < dwp->count && is_current_thread_window( winpos[count].hwnd )) count++;
+        if (count == 1) set_window_pos( winpos, 0, 0 );
+        else count = set_multiple_window_pos( winpos, count );
     }
     free( dwp->winpos );
     free( dwp );
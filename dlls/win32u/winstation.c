@@ -520,6 +520,51 @@ static HANDLE get_winstations_dir_handle(void)
     return status ? 0 : dir;
 }
 
+static void *map_section( const char *name, SIZE_T size, ACCESS_MASK access, ULONG protect )
+{
+    WCHAR buffer[64];
+    UNICODE_STRING str;
+    OBJECT_ATTRIBUTES attr;
+    LARGE_INTEGER offset;
+    SIZE_T view_size = 0;
+    HANDLE section;
+    void *ptr = NULL;
+
+    str.Buffer = buffer;
+    str.Length = str.MaximumLength = asciiz_to_unicode( buffer, name ) - sizeof(WCHAR);
+    InitializeObjectAttributes( &attr, &str, 0, 0, NULL );
+    if (NtOpenSection( &section, access, &attr )) return NULL;
+    offset.QuadPart = 0;
+    if (!NtMapViewOfSection( section, GetCurrentProcess(), &ptr, 0, 0, &offset,
+                             &view_size, ViewShare, 0, protect ) && view_size < size)
+    {
+        NtUnmapViewOfSection( GetCurrentProcess(), ptr );
+        ptr = NULL;
+    }
+    NtClose( section );
+    return ptr;
+}
+
+/***********************************************************************
+ *           map_shared_section
+ *
+ * Map a read-only view of a section that the server shares with all processes.
+ */
+void *map_shared_section( const char *name, SIZE_T size )
+{
+    return map_section( name, size, SECTION_MAP_READ, PAGE_READONLY );
+}
+
+/***********************************************************************
+ *           map_writable_shared_section
+ *
+ * Map a writable view of a section that all processes share with each other.
+ */
+void *map_writable_shared_section( const char *name, SIZE_T size )
+{
+    return map_section( name, size, SECTION_MAP_READ | SECTION_MAP_WRITE, PAGE_READWRITE );
+}
+
 /***********************************************************************
  *           get_default_desktop
  *
@@ -1563,7 +1563,12 @@ struct x11drv_window_surface
     Window                window;
     GC                    gc;
     XImage               *image;
-    RECT                  bounds;
+    RECT                  bounds; /* bounds added since the last unlock */
+    UINT64               *tiles;  /* content hash of each tile as last uploaded, 0 if unknown */
+    BYTE                 *dirty;  /* whether each tile has been drawn to since the last flush */
+    RECT                  dirty_rect; /* tiles containing all the dirty ones, in tile units */
+    DWORD                 dirty_ticks; /* time of the first change since the last flush */
+    int                   tiles_x;
     BOOL                  byteswap;
     BOOL                  is_argb;
     DWORD                 alpha_bits;
@@ -1577,6 +1582,9 @@ struct x11drv_window_surface
     BITMAPINFO            info;   /* variable size, must be last */
 };
 
+#define SURFACE_TILE_SIZE    64  /* in pixels, must be a power of 2 */
+#define SURFACE_FLUSH_PERIOD 50  /* time in ms since the first change for forcing a flush */
+
 static struct x11drv_window_surface *get_x11_surface( struct window_surface *surface )
 {
     return (struct x11drv_window_surface *)surface;
@@ -1824,14 +1832,52 @@ static void x11drv_surface_lock( struct window_surface *window_surface )
     EnterCriticalSection( &surface->crit );
 }
 
+/***********************************************************************
+ *           add_dirty_tiles
+ *
+ * Mark the tiles covered by the bounds added since the last call as dirty.
+ * Each drawing operation adds its bounds between a lock and an unlock, so
+ * collecting them at unlock time keeps distant updates apart.
+ */
+static void add_dirty_tiles( struct x11drv_window_surface *surface )
+{
+    RECT rc;
+    int y;
+
+    SetRect( &rc, 0, 0, surface->header.rect.right - surface->header.rect.left,
+             surface->header.rect.bottom - surface->header.rect.top );
+    if (IntersectRect( &rc, &rc, &surface->bounds ))
+    {
+        rc.left   = rc.left / SURFACE_TILE_SIZE;
+        rc.top    = rc.top / SURFACE_TILE_SIZE;
+        rc.right  = (rc.right + SURFACE_TILE_SIZE - 1) / SURFACE_TILE_SIZE;
+        rc.bottom = (rc.bottom + SURFACE_TILE_SIZE - 1) / SURFACE_TILE_SIZE;
+        for (y = rc.top; y < rc.bottom; y++)
+            memset( surface->dirty + y * surface->tiles_x + rc.left, 1, rc.right - rc.left );
+        if (IsRectEmpty( &surface->dirty_rect ))
+        {
+            surface->dirty_rect = rc;
+            surface->dirty_ticks = GetTickCount();
+        }
+        else UnionRect( &surface->dirty_rect, &surface->dirty_rect, &rc );
+    }
+    reset_bounds( &surface->bounds );
+}
+
 /***********************************************************************
  *           x11drv_surface_unlock
  */
 static void x11drv_surface_unlock( struct window_surface *window_surface )
 {
     struct x11drv_window_surface *surface = get_x11_surface( window_surface );
+    BOOL flush;
 
+    add_dirty_tiles( surface );
+    /* the bounds are empty again, so we need to take care of apps that never stop drawing */
+    flush = !IsRectEmpty( &surface->dirty_rect ) &&
+            GetTickCount() - surface->dirty_ticks > SURFACE_FLUSH_PERIOD;
     LeaveCriticalSection( &surface->crit );
+    if (flush) window_surface->funcs->flush( window_surface );
 }
 
 /***********************************************************************
@@ -1845,6 +1891,32 @@ static void *x11drv_surface_get_bitmap_info( struct window_surface *window_surfa
     return surface->bits;
 }
 
+/***********************************************************************
+ *           invalidate_surface_tiles
+ *
+ * Forget the uploaded contents of the tiles intersecting rect, or of all tiles.
+ */
+static void invalidate_surface_tiles( struct x11drv_window_surface *surface, const RECT *rect )
+{
+    int x, y, tiles_y = (surface->header.rect.bottom - surface->header.rect.top +
+                         SURFACE_TILE_SIZE - 1) / SURFACE_TILE_SIZE;
+    RECT rc;
+
+    if (!rect)
+    {
+        memset( surface->tiles, 0, surface->tiles_x * tiles_y * sizeof(*surface->tiles) );
+        return;
+    }
+
+    SetRect( &rc, 0, 0, surface->header.rect.right - surface->header.rect.left,
+             surface->header.rect.bottom - surface->header.rect.top );
+    if (!IntersectRect( &rc, &rc, rect )) return;
+
+    for (y = rc.top / SURFACE_TILE_SIZE; y <= (rc.bottom - 1) / SURFACE_TILE_SIZE; y++)
+        for (x = rc.left / SURFACE_TILE_SIZE; x <= (rc.right - 1) / SURFACE_TILE_SIZE; x++)
+            surface->tiles[y * surface->tiles_x + x] = 0;
+}
+
 /***********************************************************************
  *           x11drv_surface_get_bounds
  */
@@ -1883,73 +1955,158 @@ static void x11drv_surface_set_region( struct window_surface *window_surface, HR
             HeapFree( GetProcessHeap(), 0, data );
         }
     }
+    invalidate_surface_tiles( surface, NULL );
     window_surface->funcs->unlock( window_surface );
 }
 
+static UINT64 hash_surface_tile( const unsigned char *ptr, int stride, UINT bytes, int height )
+{
+    UINT64 val, hash = 0xcbf29ce484222325ull;
+    UINT i;
+
+    for ( ; height; height--, ptr += stride)
+    {
+        for (i = 0; i + sizeof(val) <= bytes; i += sizeof(val))
+        {
+            memcpy( &val, ptr + i, sizeof(val) );
+            hash = (hash ^ val) * 0x9e3779b97f4a7c15ull;
+            hash ^= hash >> 32;
+        }
+        for ( ; i < bytes; i++) hash = (hash ^ ptr[i]) * 0x100000001b3ull;
+    }
+    return hash ? hash : 1;
+}
+
+static void put_surface_image( struct x11drv_window_surface *surface, const RECT *rect )
+{
+#ifdef HAVE_LIBXXSHM
+    if (surface->shminfo.shmid != -1)
+        XShmPutImage( gdi_display, surface->window, surface->gc, surface->image,
+                      rect->left, rect->top,
+                      surface->header.rect.left + rect->left,
+                      surface->header.rect.top + rect->top,
+                      rect->right - rect->left, rect->bottom - rect->top, False );
+    else
+#endif
+    XPutImage( gdi_display, surface->window, surface->gc, surface->image,
+               rect->left, rect->top,
+               surface->header.rect.left + rect->left,
+               surface->header.rect.top + rect->top,
+               rect->right - rect->left, rect->bottom - rect->top );
+}
+
+/***********************************************************************
+ *           put_surface_tiles
+ *
+ * Upload the dirty tiles of a row whose contents changed since they were
+ * last uploaded, merging adjacent changed tiles into a single request.
+ * Returns the number of pixels uploaded.
+ */
+static UINT put_surface_tiles( struct x11drv_window_surface *surface, int row )
+{
+    const unsigned char *data = (const unsigned char *)surface->image->data;
+    int stride = surface->image->bytes_per_line, bpp = surface->image->bits_per_pixel;
+    int x, width = surface->header.rect.right - surface->header.rect.left;
+    BYTE *dirty = surface->dirty + row * surface->tiles_x;
+    UINT64 hash, *tiles = surface->tiles + row * surface->tiles_x;
+    UINT pixels = 0;
+    RECT span, tile;
+
+    span.top    = tile.top = row * SURFACE_TILE_SIZE;
+    span.bottom = tile.bottom = min( tile.top + SURFACE_TILE_SIZE,
+                                     surface->header.rect.bottom - surface->header.rect.top );
+    span.left = span.right = 0;
+
+    for (x = surface->dirty_rect.left; x < surface->dirty_rect.right; x++)
+    {
+        if (!dirty[x]) continue;
+        dirty[x] = 0;
+        tile.left  = x * SURFACE_TILE_SIZE;
+        tile.right = min( tile.left + SURFACE_TILE_SIZE, width );
+        hash = hash_surface_tile( data + tile.top * stride + tile.left * bpp / 8, stride,
+                                  (tile.right * bpp + 7) / 8 - tile.left * bpp / 8, tile.bottom - tile.top );
+        if (hash == tiles[x]) continue;
+        tiles[x] = hash;
+        if (span.right != tile.left)
+        {
+            if (span.right > span.left)
+            {
+                put_surface_image( surface, &span );
+                pixels += (span.right - span.left) * (span.bottom - span.top);
+            }
+            span.left = tile.left;
+        }
+        span.right = tile.right;
+    }
+    if (span.right > span.left)
+    {
+        put_surface_image( surface, &span );
+        pixels += (span.right - span.left) * (span.bottom - span.top);
+    }
+    return pixels;
+}
+
 /***********************************************************************
  *           x11drv_surface_flush
  */
 static void x11drv_surface_flush( struct window_surface *window_surface )
 {
     struct x11drv_window_surface *surface = get_x11_surface( window_surface );
-    unsigned char *src = surface->bits;
-    unsigned char *dst = (unsigned char *)surface->image->data;
-    struct bitblt_coords coords;
+    int width_bytes = surface->image->bytes_per_line;
+    int x, y, top, bottom, height = surface->header.rect.bottom - surface->header.rect.top;
+    unsigned char *src, *dst;
+    UINT pixels = 0;
+    BYTE *dirty;
 
     window_surface->funcs->lock( window_surface );
-    coords.x = 0;
-    coords.y = 0;
-    coords.width  = surface->header.rect.right - surface->header.rect.left;
-    coords.height = surface->header.rect.bottom - surface->header.rect.top;
-    SetRect( &coords.visrect, 0, 0, coords.width, coords.height );
-    if (IntersectRect( &coords.visrect, &coords.visrect, &surface->bounds ))
+    add_dirty_tiles( surface );
+    if (!IsRectEmpty( &surface->dirty_rect ))
     {
-        TRACE( "flushing %p %dx%d bounds %s bits %p\n",
-               surface, coords.width, coords.height,
-               wine_dbgstr_rect( &surface->bounds ), surface->bits );
+        TRACE( "flushing %p tiles %s bits %p\n", surface, wine_dbgstr_rect( &surface->dirty_rect ), surface->bits );
 
         if (surface->is_argb || surface->color_key != CLR_INVALID) update_surface_region( surface );
 
-        if (src != dst)
-        {
-            int map[256], *mapping = get_window_surface_mapping( surface->image->bits_per_pixel, map );
-            int width_bytes = surface->image->bytes_per_line;
-
-            src += coords.visrect.top * width_bytes;
-            dst += coords.visrect.top * width_bytes;
-            copy_image_byteswap( &surface->info, src, dst, width_bytes, width_bytes,
-                                 coords.visrect.bottom - coords.visrect.top,
-                                 surface->byteswap, mapping, ~0u, surface->alpha_bits );
-        }
-        else if (surface->alpha_bits)
+        for (y = surface->dirty_rect.top; y < surface->dirty_rect.bottom; y++)
         {
-            int x, y, stride = surface->image->bytes_per_line / sizeof(ULONG);
-            ULONG *ptr = (ULONG *)dst + coords.visrect.top * stride;
+            dirty = surface->dirty + y * surface->tiles_x;
+            for (x = surface->dirty_rect.left; x < surface->dirty_rect.right; x++) if (dirty[x]) break;
+            if (x == surface->dirty_rect.right) continue;
 
-            for (y = coords.visrect.top; y < coords.visrect.bottom; y++, ptr += stride)
-                for (x = coords.visrect.left; x < coords.visrect.right; x++)
-                    ptr[x] |= surface->alpha_bits;
-        }
+            top    = y * SURFACE_TILE_SIZE;
+            bottom = min( top + SURFACE_TILE_SIZE, height );
+            src = (unsigned char *)surface->bits + top * width_bytes;
+            dst = (unsigned char *)surface->image->data + top * width_bytes;
 
-#ifdef HAVE_LIBXXSHM
-        if (surface->shminfo.shmid != -1)
-            XShmPutImage( gdi_display, surface->window, surface->gc, surface->image,
-                          coords.visrect.left, coords.visrect.top,
-                          surface->header.rect.left + coords.visrect.left,
-                          surface->header.rect.top + coords.visrect.top,
-                          coords.visrect.right - coords.visrect.left,
-                          coords.visrect.bottom - coords.visrect.top, False );
-        else
-#endif
-        XPutImage( gdi_display, surface->window, surface->gc, surface->image,
-                   coords.visrect.left, coords.visrect.top,
-                   surface->header.rect.left + coords.visrect.left,
-                   surface->header.rect.top + coords.visrect.top,
-                   coords.visrect.right - coords.visrect.left,
-                   coords.visrect.bottom - coords.visrect.top );
+            /* conversions work on whole lines, the tiles that are not dirty come out unchanged */
+            if (src != dst)
+            {
+                int map[256], *mapping = get_window_surface_mapping( surface->image->bits_per_pixel, map );
+
+                copy_image_byteswap( &surface->info, src, dst, width_bytes, width_bytes, bottom - top,
+                                     surface->byteswap, mapping, ~0u, surface->alpha_bits );
+            }
+            else if (surface->alpha_bits)
+            {
+                int i, j, right, stride = width_bytes / sizeof(ULONG);
+                ULONG *ptr = (ULONG *)dst;
+
+                for (; x < surface->dirty_rect.right; x++)
+                {
+                    if (!dirty[x]) continue;
+                    right = min( (x + 1) * SURFACE_TILE_SIZE, surface->header.rect.right - surface->header.rect.left );
+                    for (i = 0; i < bottom - top; i++)
+                        for (j = x * SURFACE_TILE_SIZE; j < right; j++)
+                            ptr[i * stride + j] |= surface->alpha_bits;
+                }
+            }
+            pixels += put_surface_tiles( surface, y );
+        }
+        TRACE( "%p uploaded %u/%u pixels (%u bytes)\n", surface, pixels,
+               (surface->header.rect.right - surface->header.rect.left) * height,
+               pixels * surface->image->bits_per_pixel / 8 );
+        SetRectEmpty( &surface->dirty_rect );
         XFlush( gdi_display );
     }
-    reset_bounds( &surface->bounds );
     window_surface->funcs->unlock( window_surface );
 }
 
@@ -1980,6 +2137,8 @@ static void x11drv_surface_destroy( struct window_surface *window_surface )
     surface->crit.DebugInfo->Spare[0] = 0;
     DeleteCriticalSection( &surface->crit );
     if (surface->region) DeleteObject( surface->region );
+    HeapFree( GetProcessHeap(), 0, surface->tiles );
+    HeapFree( GetProcessHeap(), 0, surface->dirty );
     HeapFree( GetProcessHeap(), 0, surface );
 }
 
@@ -2002,7 +2161,7 @@ struct window_surface *create_surface( Window window, const XVisualInfo *vis, co
 {
     const XPixmapFormatValues *format = pixmap_formats[vis->depth];
     struct x11drv_window_surface *surface;
-    int width = rect->right - rect->left, height = rect->bottom - rect->top;
+    int width = rect->right - rect->left, height = rect->bottom - rect->top, tiles;
     int colors = format->bits_per_pixel <= 8 ? 1 << format->bits_per_pixel : 3;
 
     surface = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY,
@@ -2027,6 +2186,12 @@ struct window_surface *create_surface( Window window, const XVisualInfo *vis, co
     set_color_key( surface, color_key );
     reset_bounds( &surface->bounds );
 
+    surface->tiles_x = (width + SURFACE_TILE_SIZE - 1) / SURFACE_TILE_SIZE;
+    tiles = surface->tiles_x * ((height + SURFACE_TILE_SIZE - 1) / SURFACE_TILE_SIZE);
+    if (!(surface->tiles = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY, tiles * sizeof(*surface->tiles) )) ||
+        !(surface->dirty = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY, tiles )))
+        goto failed;
+
 #ifdef HAVE_LIBXXSHM
     surface->image = create_shm_image( vis, width, height, &surface->shminfo );
     if (!surface->image)
@@ -2097,6 +2262,7 @@ HRGN expose_surface( struct window_surface *window_surface, const RECT *rect )
     window_surface->funcs->lock( window_surface );
     OffsetRect( &rc, -window_surface->rect.left, -window_surface->rect.top );
     add_bounds_rect( &surface->bounds, &rc );
+    invalidate_surface_tiles( surface, &rc );
     if (surface->region)
     {
         region = CreateRectRgnIndirect( rect );
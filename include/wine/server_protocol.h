@@ -235,6 +235,14 @@ typedef struct
 } property_data_t;
 
 
+typedef struct
+{
+    unsigned int   wake_bits;
+    unsigned int   changed_bits;
+} queue_status_t;
+#define QUEUE_STATUS_SLOTS 16384
+
+
 typedef struct
 {
     int  left;
@@ -244,6 +252,31 @@ typedef struct
 } rectangle_t;
 
 
+typedef struct
+{
+    unsigned int   seq;
+    user_handle_t  handle;
+    user_handle_t  parent;
+    user_handle_t  owner;
+    unsigned int   style;
+    unsigned int   ex_style;
+    thread_id_t    tid;
+    process_id_t   pid;
+    lparam_t       id;
+    mod_handle_t   instance;
+    lparam_t       user_data;
+    unsigned int   is_unicode;
+    unsigned int   dpi;
+    unsigned int   monitor_dpi;
+    int            awareness;
+    rectangle_t    window;
+    rectangle_t    client;
+} window_shm_t;
+#define WINDOW_SHM_SLOTS ((LAST_USER_HANDLE - FIRST_USER_HANDLE + 1) >> 1)
+
+#define GLYPH_CACHE_SIZE (16 * 1024 * 1024)
+
+
 typedef struct
 {
     obj_handle_t    handle;
@@ -831,6 +864,28 @@ typedef struct
     lparam_t info;
 } cursor_pos_t;
 
+typedef struct
+{
+    user_handle_t  handle;
+    user_handle_t  previous;
+    unsigned short swp_flags;
+    unsigned short paint_flags;
+    rectangle_t    window;
+    rectangle_t    client;
+    rectangle_t    visible;
+    rectangle_t    surface;
+    rectangle_t    valid;
+} window_pos_t;
+
+typedef struct
+{
+    unsigned int   status;
+    unsigned int   new_style;
+    unsigned int   new_ex_style;
+    user_handle_t  surface_win;
+    int            needs_update;
+} window_pos_result_t;
+
 
 
 
@@ -2178,6 +2233,20 @@ struct write_process_memory_reply
 
 
 
+struct get_process_vm_pid_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+};
+struct get_process_vm_pid_reply
+{
+    struct reply_header __header;
+    int          unix_pid;
+    char __pad_12[4];
+};
+
+
+
 struct create_key_request
 {
     struct request_header __header;
@@ -2288,8 +2357,12 @@ struct get_key_value_reply
     struct reply_header __header;
     int          type;
     data_size_t  total;
+    int          cache_slot;
+    unsigned int generation;
     /* VARARG(data,bytes); */
 };
+#define REGISTRY_CACHE_SLOTS 4096
+#define REGISTRY_CACHE_CLOSE_SLOT 0
 
 
 
@@ -2518,8 +2591,8 @@ struct get_selector_entry_reply
 struct add_atom_request
 {
     struct request_header __header;
+    int           pin;
     /* VARARG(name,unicode_str); */
-    char __pad_12[4];
 };
 struct add_atom_reply
 {
@@ -2583,7 +2656,7 @@ struct get_msg_queue_reply
 {
     struct reply_header __header;
     obj_handle_t handle;
-    char __pad_12[4];
+    int          status_slot;
 };
 
 
@@ -2655,7 +2728,9 @@ struct send_message_request
     lparam_t        wparam;
     lparam_t        lparam;
     timeout_t       timeout;
+    obj_handle_t    section;
     /* VARARG(data,message_data); */
+    char __pad_60[4];
 };
 struct send_message_reply
 {
@@ -2710,6 +2785,7 @@ struct send_hardware_message_reply
     char __pad_28[4];
 };
 #define SEND_HWMSG_INJECTED    0x01
+#define SEND_HWMSG_COALESCE    0x02
 
 
 
@@ -2737,7 +2813,9 @@ struct get_message_reply
     unsigned int    time;
     unsigned int    active_hooks;
     data_size_t     total;
+    obj_handle_t    section;
     /* VARARG(data,message_data); */
+    char __pad_60[4];
 };
 
 
@@ -3274,6 +3352,20 @@ struct set_window_pos_reply
 #define SET_WINPOS_PIXEL_FORMAT  0x02
 
 
+
+struct set_window_pos_batch_request
+{
+    struct request_header __header;
+    /* VARARG(positions,window_positions); */
+    char __pad_12[4];
+};
+struct set_window_pos_batch_reply
+{
+    struct reply_header __header;
+    /* VARARG(results,window_pos_results); */
+};
+
+
 struct get_window_rectangles_request
 {
     struct request_header __header;
@@ -5523,6 +5615,7 @@ enum request
     REQ_set_debug_obj_info,
     REQ_read_process_memory,
     REQ_write_process_memory,
+    REQ_get_process_vm_pid,
     REQ_create_key,
     REQ_open_key,
     REQ_delete_key,
@@ -5587,6 +5680,7 @@ enum request
     REQ_get_window_children_from_point,
     REQ_get_window_tree,
     REQ_set_window_pos,
+    REQ_set_window_pos_batch,
     REQ_get_window_rectangles,
     REQ_get_window_text,
     REQ_set_window_text,
@@ -5805,6 +5899,7 @@ union generic_request
     struct set_debug_obj_info_request set_debug_obj_info_request;
     struct read_process_memory_request read_process_memory_request;
     struct write_process_memory_request write_process_memory_request;
+    struct get_process_vm_pid_request get_process_vm_pid_request;
     struct create_key_request create_key_request;
     struct open_key_request open_key_request;
     struct delete_key_request delete_key_request;
@@ -5869,6 +5964,7 @@ union generic_request
     struct get_window_children_from_point_request get_window_children_from_point_request;
     struct get_window_tree_request get_window_tree_request;
     struct set_window_pos_request set_window_pos_request;
+    struct set_window_pos_batch_request set_window_pos_batch_request;
     struct get_window_rectangles_request get_window_rectangles_request;
     struct get_window_text_request get_window_text_request;
     struct set_window_text_request set_window_text_request;
@@ -6085,6 +6181,7 @@ union generic_reply
     struct set_debug_obj_info_reply set_debug_obj_info_reply;
     struct read_process_memory_reply read_process_memory_reply;
     struct write_process_memory_reply write_process_memory_reply;
+    struct get_process_vm_pid_reply get_process_vm_pid_reply;
     struct create_key_reply create_key_reply;
     struct open_key_reply open_key_reply;
     struct delete_key_reply delete_key_reply;
@@ -6149,6 +6246,7 @@ union generic_reply
     struct get_window_children_from_point_reply get_window_children_from_point_reply;
     struct get_window_tree_reply get_window_tree_reply;
     struct set_window_pos_reply set_window_pos_reply;
+    struct set_window_pos_batch_reply set_window_pos_batch_reply;
     struct get_window_rectangles_reply get_window_rectangles_reply;
     struct get_window_text_reply get_window_text_reply;
     struct set_window_text_reply set_window_text_reply;
@@ -6286,7 +6384,7 @@ union generic_reply
 
 /* ### protocol_version begin ### */
 
-#define SERVER_PROTOCOL_VERSION 749
+#define SERVER_PROTOCOL_VERSION 760
 
 /* ### protocol_version end ### */
 
@@ -364,7 +364,8 @@ DECL_HANDLER(add_atom)
     struct unicode_str name = get_req_unicode_str();
     struct atom_table *table = get_global_table( NULL, 1 );
 
-    if (table) reply->atom = add_atom( table, &name );
+    if (table && (reply->atom = add_atom( table, &name )) && req->pin)
+        get_atom_entry( table, reply->atom )->pinned = 1;
 }
 
 /* delete a global atom */
@@ -440,7 +440,15 @@ void init_directories( struct fd *intl_fd )
     static const WCHAR intlW[] = {'N','l','s','S','e','c','t','i','o','n','L','A','N','G','_','I','N','T','L'};
     static const WCHAR user_dataW[] = {'_','_','w','i','n','e','_','u','s','e','r','_','s','h','a','r','e','d','_','d','a','t','a'};
     static const struct unicode_str intl_str = {intlW, sizeof(intlW)};
+    static const WCHAR registry_cacheW[] = {'_','_','w','i','n','e','_','r','e','g','i','s','t','r','y','_','c','a','c','h','e'};
     static const struct unicode_str user_data_str = {user_dataW, sizeof(user_dataW)};
+    static const struct unicode_str registry_cache_str = {registry_cacheW, sizeof(registry_cacheW)};
+    static const WCHAR queue_statusW[] = {'_','_','w','i','n','e','_','q','u','e','u','e','_','s','t','a','t','u','s'};
+    static const struct unicode_str queue_status_str = {queue_statusW, sizeof(queue_statusW)};
+    static const WCHAR window_shmW[] = {'_','_','w','i','n','e','_','w','i','n','d','o','w','s'};
+    static const struct unicode_str window_shm_str = {window_shmW, sizeof(window_shmW)};
+    static const WCHAR glyph_cacheW[] = {'_','_','w','i','n','e','_','g','l','y','p','h','_','c','a','c','h','e'};
+    static const struct unicode_str glyph_cache_str = {glyph_cacheW, sizeof(glyph_cacheW)};
 
     struct directory *dir_driver, *dir_device, *dir_global, *dir_kernel, *dir_nls;
     struct object *named_pipe_device, *mailslot_device, *null_device;
@@ -489,6 +497,10 @@ void init_directories( struct fd *intl_fd )
     /* mappings */
     release_object( create_fd_mapping( &dir_nls->obj, &intl_str, intl_fd, OBJ_PERMANENT, NULL ));
     release_object( create_user_data_mapping( &dir_kernel->obj, &user_data_str, OBJ_PERMANENT, NULL ));
+    release_object( create_registry_cache_mapping( &dir_kernel->obj, &registry_cache_str, OBJ_PERMANENT, NULL ));
+    release_object( create_queue_status_mapping( &dir_kernel->obj, &queue_status_str, OBJ_PERMANENT, NULL ));
+    release_object( create_window_shm_mapping( &dir_kernel->obj, &window_shm_str, OBJ_PERMANENT, NULL ));
+    release_object( create_glyph_cache_mapping( &dir_kernel->obj, &glyph_cache_str, OBJ_PERMANENT, NULL ));
     release_object( intl_fd );
 
     release_object( named_pipe_device );
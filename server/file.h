@@ -180,10 +180,19 @@ extern const pe_image_info_t *get_view_image_info( const struct memory_view *vie
 extern int get_view_nt_name( const struct memory_view *view, struct unicode_str *name );
 extern void free_mapped_views( struct process *process );
 extern int get_page_size(void);
+extern struct mapping *get_mapping_obj( struct process *process, obj_handle_t handle, unsigned int access );
 extern struct mapping *create_fd_mapping( struct object *root, const struct unicode_str *name, struct fd *fd,
                                           unsigned int attr, const struct security_descriptor *sd );
 extern struct object *create_user_data_mapping( struct object *root, const struct unicode_str *name,
                                                 unsigned int attr, const struct security_descriptor *sd );
+extern struct object *create_registry_cache_mapping( struct object *root, const struct unicode_str *name,
+                                                     unsigned int attr, const struct security_descriptor *sd );
+extern struct object *create_queue_status_mapping( struct object *root, const struct unicode_str *name,
+                                                   unsigned int attr, const struct security_descriptor *sd );
+extern struct object *create_window_shm_mapping( struct object *root, const struct unicode_str *name,
+                                                 unsigned int attr, const struct security_descriptor *sd );
+extern struct object *create_glyph_cache_mapping( struct object *root, const struct unicode_str *name,
+                                                  unsigned int attr, const struct security_descriptor *sd );
 
 /* device functions */
 
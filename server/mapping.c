@@ -42,6 +42,7 @@
 #include "process.h"
 #include "request.h"
 #include "security.h"
+#include "user.h"
 
 /* list of memory ranges, used to store committed info */
 struct ranges
@@ -995,7 +996,7 @@ struct mapping *create_fd_mapping( struct object *root, const struct unicode_str
     return NULL;
 }
 
-static struct mapping *get_mapping_obj( struct process *process, obj_handle_t handle, unsigned int access )
+struct mapping *get_mapping_obj( struct process *process, obj_handle_t handle, unsigned int access )
 {
     return (struct mapping *)get_handle_obj( process, handle, access, &mapping_ops );
 }
@@ -1097,16 +1098,30 @@ int get_page_size(void)
     return page_mask + 1;
 }
 
+/* create a mapping that is written by the server and read by the clients */
+static struct mapping *create_shared_mapping( struct object *root, const struct unicode_str *name,
+                                              unsigned int attr, mem_size_t size,
+                                              const struct security_descriptor *sd, void **ptr )
+{
+    struct mapping *mapping;
+
+    *ptr = NULL;
+    if (!(mapping = create_mapping( root, name, attr, size, SEC_COMMIT, 0,
+                                    FILE_READ_DATA | FILE_WRITE_DATA, sd ))) return NULL;
+    *ptr = mmap( NULL, mapping->size, PROT_WRITE, MAP_SHARED, get_unix_fd( mapping->fd ), 0 );
+    if (*ptr == MAP_FAILED) *ptr = NULL;
+    return mapping;
+}
+
 struct object *create_user_data_mapping( struct object *root, const struct unicode_str *name,
                                         unsigned int attr, const struct security_descriptor *sd )
 {
     void *ptr;
     struct mapping *mapping;
 
-    if (!(mapping = create_mapping( root, name, attr, sizeof(KSHARED_USER_DATA),
-                                    SEC_COMMIT, 0, FILE_READ_DATA | FILE_WRITE_DATA, sd ))) return NULL;
-    ptr = mmap( NULL, mapping->size, PROT_WRITE, MAP_SHARED, get_unix_fd( mapping->fd ), 0 );
-    if (ptr != MAP_FAILED)
+    if (!(mapping = create_shared_mapping( root, name, attr, sizeof(KSHARED_USER_DATA), sd, &ptr )))
+        return NULL;
+    if (ptr)
     {
         user_shared_data = ptr;
         user_shared_data->SystemCall = 1;
@@ -1114,6 +1129,57 @@ struct object *create_user_data_mapping( struct object *root, const struct unico
     return &mapping->obj;
 }
 
+struct object *create_registry_cache_mapping( struct object *root, const struct unicode_str *name,
+                                              unsigned int attr, const struct security_descriptor *sd )
+{
+    void *ptr;
+    struct mapping *mapping;
+
+    if (!(mapping = create_shared_mapping( root, name, attr, REGISTRY_CACHE_SLOTS * sizeof(unsigned int),
+                                           sd, &ptr )))
+        return NULL;
+    registry_cache_generations = ptr;
+    return &mapping->obj;
+}
+
+struct object *create_queue_status_mapping( struct object *root, const struct unicode_str *name,
+                                            unsigned int attr, const struct security_descriptor *sd )
+{
+    void *ptr;
+    struct mapping *mapping;
+
+    if (!(mapping = create_shared_mapping( root, name, attr, QUEUE_STATUS_SLOTS * sizeof(queue_status_t),
+                                           sd, &ptr )))
+        return NULL;
+    queue_status_slots = ptr;
+    return &mapping->obj;
+}
+
+struct object *create_window_shm_mapping( struct object *root, const struct unicode_str *name,
+                                          unsigned int attr, const struct security_descriptor *sd )
+{
+    void *ptr;
+    struct mapping *mapping;
+
+    if (!(mapping = create_shared_mapping( root, name, attr, WINDOW_SHM_SLOTS * sizeof(window_shm_t),
+                                           sd, &ptr )))
+        return NULL;
+    window_shm_slots = ptr;
+    return &mapping->obj;
+}
+
+/* create a mapping that is only written by the clients */
+struct object *create_glyph_cache_mapping( struct object *root, const struct unicode_str *name,
+                                           unsigned int attr, const struct security_descriptor *sd )
+{
+    struct mapping *mapping;
+
+    if (!(mapping = create_mapping( root, name, attr, GLYPH_CACHE_SIZE, SEC_COMMIT, 0,
+                                    FILE_READ_DATA | FILE_WRITE_DATA, sd )))
+        return NULL;
+    return &mapping->obj;
+}
+
 /* create a file mapping */
 DECL_HANDLER(create_mapping)
 {
@@ -1672,6 +1672,17 @@ DECL_HANDLER(write_process_memory)
     }
 }
 
+/* retrieve the Unix pid to access a process address space directly */
+DECL_HANDLER(get_process_vm_pid)
+{
+    struct process *process;
+
+    reply->unix_pid = -1;
+    if (!(process = get_process_from_handle( req->handle, PROCESS_VM_READ ))) return;
+    if (process->running_threads) reply->unix_pid = process->unix_pid;
+    release_object( process );
+}
+
 /* retrieve the process idle event */
 DECL_HANDLER(get_process_idle_event)
 {
@@ -65,6 +65,9 @@ struct message_result
     void                  *data;          /* message reply data */
     unsigned int           data_size;     /* size of message reply data */
     struct timeout_user   *timeout;       /* result timeout */
+    struct mapping        *section;       /* section holding large message data */
+    int                    type;          /* type of the message the result is for */
+    timeout_t              send_time;     /* time the message was sent */
 };
 
 struct message
@@ -82,8 +85,50 @@ struct message
     unsigned int           data_size; /* size of message data */
     unsigned int           unique_id; /* unique id for nested hw message waits */
     struct message_result *result;    /* result in sender queue */
+    timeout_t              queue_time; /* time the message was queued, for statistics */
 };
 
+/* per message type statistics, collected in debug mode and dumped on SIGHUP */
+struct message_stats
+{
+    unsigned int sent;            /* messages queued */
+    unsigned int received;        /* messages retrieved by the receiver */
+    unsigned int replied;         /* sent messages replied to */
+    unsigned int timeouts;        /* sent messages that timed out */
+    timeout_t    receive_time;    /* total time between queue and receive */
+    timeout_t    reply_time;      /* total time between send and reply */
+    timeout_t    max_reply_time;  /* longest time between send and reply */
+};
+
+static struct message_stats message_stats[MSG_HOOK_LL + 1];
+
+/* get the statistics for a message type, or NULL if they aren't collected */
+static inline struct message_stats *get_message_stats( enum message_type type )
+{
+    if (!debug_level || type >= ARRAY_SIZE(message_stats)) return NULL;
+    return &message_stats[type];
+}
+
+/* account for a message added to a queue */
+static void count_queued_message( struct message *msg )
+{
+    struct message_stats *stats = get_message_stats( msg->type );
+
+    if (!stats) return;
+    stats->sent++;
+    msg->queue_time = current_time;
+}
+
+/* account for a message retrieved by the receiver */
+static void count_received_message( const struct message *msg )
+{
+    struct message_stats *stats = get_message_stats( msg->type );
+
+    if (!stats) return;
+    stats->received++;
+    stats->receive_time += current_time - msg->queue_time;
+}
+
 struct timer
 {
     struct list     entry;     /* entry in timer list */
@@ -122,6 +167,7 @@ struct msg_queue
     unsigned int           wake_mask;       /* wakeup mask */
     unsigned int           changed_bits;    /* changed wakeup bits */
     unsigned int           changed_mask;    /* changed wakeup mask */
+    int                    status_slot;     /* index of the status in the shared mapping, or -1 */
     int                    paint_count;     /* pending paint messages count */
     int                    hotkey_count;    /* pending hotkey messages count */
     int                    quit_message;    /* is there a pending quit message? */
@@ -225,6 +271,10 @@ static const struct object_ops thread_input_ops =
 /* pointer to input structure of foreground thread */
 static unsigned int last_input_time;
 
+queue_status_t *queue_status_slots = NULL;  /* shared with the clients */
+static unsigned int queue_status_bitmap[QUEUE_STATUS_SLOTS / 32];
+static unsigned int queue_status_hint;
+
 static cursor_pos_t cursor_history[64];
 static unsigned int cursor_history_latest;
 
@@ -273,6 +323,31 @@ static struct thread_input *create_thread_input( struct thread *thread )
     return input;
 }
 
+/* allocate an entry in the shared queue status mapping */
+static int alloc_queue_status_slot(void)
+{
+    unsigned int i, index, bit;
+
+    if (!queue_status_slots) return -1;
+    for (i = 0; i < ARRAY_SIZE( queue_status_bitmap ); i++)
+    {
+        index = (queue_status_hint + i) % ARRAY_SIZE( queue_status_bitmap );
+        if (queue_status_bitmap[index] == ~0u) continue;
+        for (bit = 0; bit < 32; bit++) if (!(queue_status_bitmap[index] & (1u << bit))) break;
+        queue_status_bitmap[index] |= 1u << bit;
+        queue_status_hint = index;
+        memset( &queue_status_slots[index * 32 + bit], 0, sizeof(queue_status_t) );
+        return index * 32 + bit;
+    }
+    return -1;
+}
+
+static void free_queue_status_slot( int slot )
+{
+    if (slot == -1) return;
+    queue_status_bitmap[slot / 32] &= ~(1u << (slot % 32));
+}
+
 /* create a message queue object */
 static struct msg_queue *create_msg_queue( struct thread *thread, struct thread_input *input )
 {
@@ -293,6 +368,7 @@ static struct msg_queue *create_msg_queue( struct thread *thread, struct thread_
         queue->wake_mask       = 0;
         queue->changed_bits    = 0;
         queue->changed_mask    = 0;
+        queue->status_slot     = alloc_queue_status_slot();
         queue->paint_count     = 0;
         queue->hotkey_count    = 0;
         queue->quit_message    = 0;
@@ -473,11 +549,20 @@ static inline int is_signaled( struct msg_queue *queue )
     return ((queue->wake_bits & queue->wake_mask) || (queue->changed_bits & queue->changed_mask));
 }
 
+/* publish the queue bits in the shared status mapping */
+static inline void update_queue_status( struct msg_queue *queue )
+{
+    if (queue->status_slot == -1) return;
+    queue_status_slots[queue->status_slot].wake_bits = queue->wake_bits;
+    queue_status_slots[queue->status_slot].changed_bits = queue->changed_bits;
+}
+
 /* set some queue bits */
 static inline void set_queue_bits( struct msg_queue *queue, unsigned int bits )
 {
     queue->wake_bits |= bits;
     queue->changed_bits |= bits;
+    update_queue_status( queue );
     if (is_signaled( queue )) wake_up( &queue->obj, 0 );
 }
 
@@ -486,6 +571,7 @@ static inline void clear_queue_bits( struct msg_queue *queue, unsigned int bits
 {
     queue->wake_bits &= ~bits;
     queue->changed_bits &= ~bits;
+    update_queue_status( queue );
 }
 
 /* check whether msg is a keyboard message */
@@ -571,6 +657,7 @@ static int merge_message( struct thread_input *input, const struct message *msg
     }
     list_remove( ptr );
     list_add_tail( &input->msg_list, ptr );
+    input->desktop->input_stats.merged++;
     return 1;
 }
 
@@ -582,6 +669,7 @@ static void free_result( struct message_result *result )
     if (result->callback_msg) free_message( result->callback_msg );
     if (result->hardware_msg) free_message( result->hardware_msg );
     if (result->desktop) release_object( result->desktop );
+    if (result->section) release_object( result->section );
     free( result );
 }
 
@@ -624,6 +712,7 @@ static void store_message_result( struct message_result *res, lparam_t result, u
             /* queue the callback message in the sender queue */
             struct callback_msg_data *data = res->callback_msg->data;
             data->result = result;
+            count_queued_message( res->callback_msg );
             list_add_tail( &res->sender->msg_list[SEND_MESSAGE], &res->callback_msg->entry );
             set_queue_bits( res->sender, QS_SENDMESSAGE );
             res->callback_msg = NULL;
@@ -677,10 +766,12 @@ static void remove_queue_message( struct msg_queue *queue, struct message *msg,
 static void result_timeout( void *private )
 {
     struct message_result *result = private;
+    struct message_stats *stats;
 
     assert( !result->replied );
 
     result->timeout = NULL;
+    if ((stats = get_message_stats( result->type ))) stats->timeouts++;
 
     if (result->msg)  /* not received yet */
     {
@@ -712,6 +803,9 @@ static struct message_result *alloc_message_result( struct msg_queue *send_queue
         result->hardware_msg = NULL;
         result->desktop      = NULL;
         result->callback_msg = NULL;
+        result->section      = NULL;
+        result->type         = msg->type;
+        result->send_time    = current_time;
 
         if (msg->type == MSG_CALLBACK)
         {
@@ -772,8 +866,11 @@ static void receive_message( struct msg_queue *queue, struct message *msg,
     reply->time   = msg->time;
 
     if (msg->data) set_reply_data_ptr( msg->data, msg->data_size );
+    if (result && result->section)
+        reply->section = alloc_handle( current->process, result->section, SECTION_MAP_READ, 0 );
 
     list_remove( &msg->entry );
+    count_received_message( msg );
     /* put the result on the receiver result stack */
     if (result)
     {
@@ -803,11 +900,49 @@ static void reply_message( struct msg_queue *queue, lparam_t result,
     }
     if (!res->replied)
     {
+        struct message_stats *stats = get_message_stats( res->type );
+        timeout_t elapsed = current_time - res->send_time;
+
+        if (stats)
+        {
+            stats->replied++;
+            stats->reply_time += elapsed;
+            if (elapsed > stats->max_reply_time) stats->max_reply_time = elapsed;
+        }
         if (len && (res->data = memdup( data, len ))) res->data_size = len;
         store_message_result( res, result, error );
     }
 }
 
+/* dump the message statistics */
+void dump_message_stats(void)
+{
+    static const char * const names[] =
+    {
+        "ascii", "unicode", "notify", "callback", "callback_result",
+        "other_process", "posted", "hardware", "winevent", "hook_ll"
+    };
+    unsigned int i;
+
+    C_ASSERT( ARRAY_SIZE(names) == ARRAY_SIZE(message_stats) );
+
+    for (i = 0; i < ARRAY_SIZE(message_stats); i++)
+    {
+        const struct message_stats *stats = &message_stats[i];
+
+        if (!stats->sent && !stats->received) continue;
+        fprintf( stderr, "%s: sent=%u received=%u replied=%u timeouts=%u", names[i],
+                 stats->sent, stats->received, stats->replied, stats->timeouts );
+        if (stats->received)
+            fprintf( stderr, " receive avg=%uus", (unsigned int)(stats->receive_time / stats->received / 10) );
+        if (stats->replied)
+            fprintf( stderr, " reply avg=%uus max=%uus",
+                     (unsigned int)(stats->reply_time / stats->replied / 10),
+                     (unsigned int)(stats->max_reply_time / 10) );
+        fputc( '\n', stderr );
+    }
+}
+
 static int match_window( user_handle_t win, user_handle_t msg_win )
 {
     if (!win) return 1;
@@ -857,6 +992,7 @@ found:
             msg->data = NULL;
             msg->data_size = 0;
         }
+        count_received_message( msg );
         remove_queue_message( queue, msg, POST_MESSAGE );
     }
     else if (msg->data) set_reply_data( msg->data, msg->data_size );
@@ -1033,6 +1169,7 @@ static void msg_queue_destroy( struct object *obj )
     release_object( queue->input );
     if (queue->hooks) release_object( queue->hooks );
     if (queue->fd) release_object( queue->fd );
+    free_queue_status_slot( queue->status_slot );
 }
 
 static void msg_queue_poll_event( struct fd *fd, int event )
@@ -1448,6 +1585,7 @@ found:
     msg->data      = NULL;
     msg->data_size = 0;
 
+    count_queued_message( msg );
     list_add_tail( &hotkey->queue->msg_list[POST_MESSAGE], &msg->entry );
     set_queue_bits( hotkey->queue, QS_POSTMESSAGE|QS_ALLPOSTMESSAGE|QS_HOTKEY );
     hotkey->queue->hotkey_count++;
@@ -1593,6 +1731,7 @@ static void queue_hardware_message( struct desktop *desktop, struct message *msg
     else
     {
         msg->unique_id = 0;  /* will be set once we return it to the app */
+        count_queued_message( msg );
         list_add_tail( &input->msg_list, &msg->entry );
         set_queue_bits( thread->queue, get_hardware_msg_bit(msg) );
     }
@@ -1641,6 +1780,7 @@ static int send_hook_ll_message( struct desktop *desktop, struct message *hardwa
     }
     msg->result->hardware_msg = hardware_msg;
     msg->result->desktop = (struct desktop *)grab_object( desktop );
+    count_queued_message( msg );
     list_add_tail( &queue->msg_list[SEND_MESSAGE], &msg->entry );
     set_queue_bits( queue, QS_SENDMESSAGE );
     return 1;
@@ -1655,6 +1795,62 @@ static struct thread *get_foreground_thread( struct desktop *desktop, user_handl
     return NULL;
 }
 
+/* try to coalesce a raw mouse motion message with the last unread one for the same window */
+static int merge_rawinput_message( struct desktop *desktop, struct message *msg )
+{
+    const struct hardware_msg_data *msg_data = msg->data;
+    struct hardware_msg_data *prev_data;
+    struct thread_input *input;
+    struct thread *thread;
+    struct message *prev;
+    struct list *ptr;
+    unsigned int msg_code;
+    user_handle_t win;
+    int ret = 0;
+
+    if (msg_data->rawinput.type != RIM_TYPEMOUSE) return 0;
+    if (msg_data->flags != MOUSEEVENTF_MOVE || msg_data->rawinput.mouse.data) return 0;
+
+    if (msg->win && (thread = get_window_thread( msg->win )))
+    {
+        input = thread->queue->input;
+        release_object( thread );
+    }
+    else input = desktop->foreground_input;
+
+    win = find_hardware_message_window( desktop, input, msg, &msg_code, &thread );
+    if (!thread) return 0;
+    if (!win) goto done;
+
+    /* skip the mouse moves, they are coalesced too */
+    input = thread->queue->input;
+    for (ptr = list_tail( &input->msg_list ); ptr; ptr = list_prev( &input->msg_list, ptr ))
+    {
+        prev = LIST_ENTRY( ptr, struct message, entry );
+        if (prev->msg != WM_MOUSEMOVE) break;
+    }
+    if (!ptr) goto done;
+    if (prev->msg != WM_INPUT || prev->unique_id) goto done;
+    if (prev->win != msg->win || prev->wparam != msg->wparam) goto done;
+    if (prev->data_size != msg->data_size) goto done;
+    prev_data = prev->data;
+    if (prev_data->rawinput.type != RIM_TYPEMOUSE) goto done;
+    if (prev_data->flags != MOUSEEVENTF_MOVE || prev_data->rawinput.mouse.data) goto done;
+    if (prev_data->info != msg_data->info) goto done;
+    if (memcmp( &prev_data->source, &msg_data->source, sizeof(prev_data->source) )) goto done;
+
+    /* now we can merge it */
+    prev_data->rawinput.mouse.x += msg_data->rawinput.mouse.x;
+    prev_data->rawinput.mouse.y += msg_data->rawinput.mouse.y;
+    prev->time = msg->time;
+    desktop->input_stats.merged++;
+    ret = 1;
+
+done:
+    release_object( thread );
+    return ret;
+}
+
 struct rawinput_message
 {
     struct thread           *foreground;
@@ -1664,6 +1860,7 @@ struct rawinput_message
     unsigned int             message;
     struct hardware_msg_data data;
     const void              *hid_report;
+    int                      coalesce;
 };
 
 /* check if process is supposed to receive a WM_INPUT message and eventually queue it */
@@ -1722,7 +1919,8 @@ static int queue_rawinput_message( struct process* process, void *arg )
         msg->lparam = raw_msg->data.rawinput.hid.device;
     }
 
-    queue_hardware_message( desktop, msg, 1 );
+    if (raw_msg->coalesce && merge_rawinput_message( desktop, msg )) free_message( msg );
+    else queue_hardware_message( desktop, msg, 1 );
 
 done:
     if (target_thread) release_object( target_thread );
@@ -1734,7 +1932,7 @@ done:
 
 /* queue a hardware message for a mouse event */
 static int queue_mouse_message( struct desktop *desktop, user_handle_t win, const hw_input_t *input,
-                                unsigned int origin, struct msg_queue *sender )
+                                unsigned int origin, struct msg_queue *sender, int coalesce )
 {
     const struct rawinput_device *device;
     struct hardware_msg_data *msg_data;
@@ -1797,6 +1995,7 @@ static int queue_mouse_message( struct desktop *desktop, user_handle_t win, cons
         raw_msg.source     = source;
         raw_msg.time       = time;
         raw_msg.message    = WM_INPUT;
+        raw_msg.coalesce   = coalesce;
 
         msg_data = &raw_msg.data;
         msg_data->info                = input->mouse.info;
@@ -2073,6 +2272,18 @@ static int check_hw_message_filter( user_handle_t win, unsigned int msg_code,
 }
 
 
+/* account for the delivery of a hardware message in the desktop input statistics */
+static void update_input_latency( struct desktop *desktop, const struct message *msg )
+{
+    struct input_stats *stats = &desktop->input_stats;
+    unsigned int latency = get_tick_count() - msg->time;
+
+    if (latency >= 0x80000000) latency = 0;  /* message time in the future */
+    stats->delivered++;
+    stats->total_latency += latency;
+    if (latency > stats->max_latency) stats->max_latency = latency;
+}
+
 /* find a hardware message for the given queue */
 static int get_hardware_message( struct thread *thread, unsigned int hw_id, user_handle_t filter_win,
                                  unsigned int first, unsigned int last, unsigned int flags,
@@ -2154,7 +2365,12 @@ static int get_hardware_message( struct thread *thread, unsigned int hw_id, user
         }
 
         /* now we can return it */
-        if (!msg->unique_id) msg->unique_id = get_unique_id();
+        if (!msg->unique_id)
+        {
+            msg->unique_id = get_unique_id();
+            update_input_latency( input->desktop, msg );
+            count_received_message( msg );
+        }
         reply->type   = MSG_HARDWARE;
         reply->win    = win;
         reply->msg    = msg_code;
@@ -2263,6 +2479,7 @@ void post_message( user_handle_t win, unsigned int message, lparam_t wparam, lpa
 
         get_message_defaults( thread->queue, &msg->x, &msg->y, &msg->time );
 
+        count_queued_message( msg );
         list_add_tail( &thread->queue->msg_list[POST_MESSAGE], &msg->entry );
         set_queue_bits( thread->queue, QS_POSTMESSAGE|QS_ALLPOSTMESSAGE );
         if (message == WM_HOTKEY)
@@ -2295,6 +2512,7 @@ void send_notify_message( user_handle_t win, unsigned int message, lparam_t wpar
 
         get_message_defaults( thread->queue, &msg->x, &msg->y, &msg->time );
 
+        count_queued_message( msg );
         list_add_tail( &thread->queue->msg_list[SEND_MESSAGE], &msg->entry );
         set_queue_bits( thread->queue, QS_SENDMESSAGE );
     }
@@ -2335,6 +2553,7 @@ void post_win_event( struct thread *thread, unsigned int event,
             if (debug_level > 1)
                 fprintf( stderr, "post_win_event: tid %04x event %04x win %08x object_id %d child_id %d\n",
                          get_thread_id(thread), event, win, object_id, child_id );
+            count_queued_message( msg );
             list_add_tail( &thread->queue->msg_list[SEND_MESSAGE], &msg->entry );
             set_queue_bits( thread->queue, QS_SENDMESSAGE );
         }
@@ -2380,7 +2599,12 @@ DECL_HANDLER(get_msg_queue)
     struct msg_queue *queue = get_current_queue();
 
     reply->handle = 0;
-    if (queue) reply->handle = alloc_handle( current->process, queue, SYNCHRONIZE, 0 );
+    reply->status_slot = -1;
+    if (queue)
+    {
+        reply->handle = alloc_handle( current->process, queue, SYNCHRONIZE, 0 );
+        reply->status_slot = queue->status_slot;
+    }
 }
 
 
@@ -2439,6 +2663,7 @@ DECL_HANDLER(get_queue_status)
         reply->wake_bits    = queue->wake_bits;
         reply->changed_bits = queue->changed_bits;
         queue->changed_bits &= ~req->clear_bits;
+        update_queue_status( queue );
     }
     else reply->wake_bits = reply->changed_bits = 0;
 }
@@ -2498,12 +2723,21 @@ DECL_HANDLER(send_message)
                 free_message( msg );
                 break;
             }
+            /* the section stays alive until the result is freed */
+            if (req->section && msg->type == MSG_OTHER_PROCESS &&
+                !(msg->result->section = get_mapping_obj( current->process, req->section, SECTION_MAP_READ )))
+            {
+                free_message( msg );
+                break;
+            }
             /* fall through */
         case MSG_NOTIFY:
+            count_queued_message( msg );
             list_add_tail( &recv_queue->msg_list[SEND_MESSAGE], &msg->entry );
             set_queue_bits( recv_queue, QS_SENDMESSAGE );
             break;
         case MSG_POSTED:
+            count_queued_message( msg );
             list_add_tail( &recv_queue->msg_list[POST_MESSAGE], &msg->entry );
             set_queue_bits( recv_queue, QS_POSTMESSAGE|QS_ALLPOSTMESSAGE );
             if (msg->msg == WM_HOTKEY)
@@ -2548,11 +2782,13 @@ DECL_HANDLER(send_hardware_message)
 
     reply->prev_x = desktop->cursor.x;
     reply->prev_y = desktop->cursor.y;
+    desktop->input_stats.events++;
 
     switch (req->input.type)
     {
     case INPUT_MOUSE:
-        reply->wait = queue_mouse_message( desktop, req->win, &req->input, origin, sender );
+        reply->wait = queue_mouse_message( desktop, req->win, &req->input, origin, sender,
+                                           req->flags & SEND_HWMSG_COALESCE );
         break;
     case INPUT_KEYBOARD:
         reply->wait = queue_keyboard_message( desktop, req->win, &req->input, origin, sender );
@@ -2621,6 +2857,7 @@ DECL_HANDLER(get_message)
     }
     if (filter & QS_INPUT) queue->changed_bits &= ~QS_INPUT;
     if (filter & QS_PAINT) queue->changed_bits &= ~QS_PAINT;
+    update_queue_status( queue );
 
     /* then check for posted messages */
     if ((filter & QS_POSTMESSAGE) &&
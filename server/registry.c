@@ -33,6 +33,7 @@
 #include <stdarg.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -85,13 +86,19 @@ struct key
     struct key       *parent;      /* parent key */
     int               last_subkey; /* last in use subkey */
     int               nb_subkeys;  /* count of allocated subkeys */
+    int               nb_sorted;   /* count of subkeys sorted by name at the start of the array */
     struct key      **subkeys;     /* subkeys array */
+    struct key      **hash;        /* hash table of subkeys for keys with many subkeys */
+    unsigned int      hash_size;   /* size of the subkeys hash table */
+    struct key       *hash_next;   /* next key in the same bucket of the parent hash table */
     int               last_value;  /* last in use value */
     int               nb_values;   /* count of allocated values in array */
     struct key_value *values;      /* values array */
     unsigned int      flags;       /* flags */
     timeout_t         modif;       /* last modification time */
     struct list       notify_list; /* list of notifications */
+    const struct hive_image *image; /* binary hive the key was loaded from */
+    const struct hive_key   *hive; /* hive contents not expanded yet */
 };
 
 /* key flags */
@@ -102,6 +109,8 @@ struct key
 #define KEY_WOW64    0x0010  /* key contains a Wow6432Node subkey */
 #define KEY_WOWSHARE 0x0020  /* key is a Wow64 shared key (used for Software\Classes) */
 #define KEY_PREDEF   0x0040  /* key is marked as predefined */
+#define KEY_CHANGED  0x0080  /* key itself has been modified since the last save */
+#define KEY_TOUCHED  0x0100  /* only the key time and subkeys have changed since the last save */
 
 /* a key value */
 struct key_value
@@ -113,7 +122,68 @@ struct key_value
     void             *data;    /* pointer to value data */
 };
 
+/*
+ * The binary hive format is a cache of a registry text file that can be
+ * mapped directly. Each key record stores its children as a contiguous range
+ * of the key table (sorted as in memory) located after the key itself, so
+ * that keys can be created lazily the first time their contents are accessed.
+ */
+
+#define HIVE_VERSION 1
+static const char hive_signature[] = "WINE REGISTRY Binary\032";
+
+struct hive_header
+{
+    char              signature[24]; /* hive_signature */
+    unsigned int      version;     /* HIVE_VERSION */
+    unsigned int      prefix_type; /* architecture of the prefix */
+    file_pos_t        text_size;   /* size of the corresponding text file */
+    file_pos_t        text_ino;    /* inode of the corresponding text file */
+    timeout_t         text_mtime;  /* modification time of the text file, in ns */
+    file_pos_t        keys;        /* offset of the key table */
+    file_pos_t        values;      /* offset of the value table */
+    file_pos_t        data;        /* offset of the name and value data */
+    file_pos_t        size;        /* total size of the file */
+    unsigned int      key_count;   /* number of keys, the first one being the branch root */
+    unsigned int      value_count; /* number of values */
+};
+
+struct hive_key
+{
+    timeout_t         modif;       /* last modification time */
+    unsigned int      name;        /* offset of key name in data */
+    unsigned int      class;       /* offset of class name in data */
+    unsigned short    namelen;     /* length of key name */
+    unsigned short    classlen;    /* length of class name */
+    unsigned int      flags;       /* key flags (only KEY_SYMLINK) */
+    unsigned int      subkeys;     /* index of first subkey in key table */
+    unsigned int      subkey_count; /* number of subkeys */
+    unsigned int      values;      /* index of first value in value table */
+    unsigned int      value_count; /* number of values */
+};
+
+struct hive_value
+{
+    unsigned int      name;        /* offset of value name in data */
+    unsigned int      namelen;     /* length of value name */
+    unsigned int      type;        /* value type */
+    unsigned int      data;        /* offset of value data in data */
+    data_size_t       len;         /* value data length in bytes */
+};
+
+/* a mapped binary hive; never unmapped since keys may point into it */
+struct hive_image
+{
+    const struct hive_key   *keys;        /* key table */
+    const struct hive_value *values;      /* value table */
+    const char              *data;        /* name and value data */
+    unsigned int             key_count;   /* number of keys */
+    unsigned int             value_count; /* number of values */
+    file_pos_t               data_size;   /* size of data */
+};
+
 #define MIN_SUBKEYS  8   /* min. number of allocated subkeys per key */
+#define MIN_HASHED_SUBKEYS 128  /* min. number of subkeys to use a hash table */
 #define MIN_VALUES   8   /* min. number of allocated values per key */
 
 #define MAX_NAME_LEN  256    /* max. length of a key name */
@@ -126,6 +196,7 @@ static const timeout_t ticks_1601_to_1970 = (timeout_t)86400 * (369 * 365 + 89)
 static const timeout_t save_period = 30 * -TICKS_PER_SEC;  /* delay between periodic saves */
 static struct timeout_user *save_timeout_user;  /* saving timer */
 static enum prefix_type { PREFIX_UNKNOWN, PREFIX_32BIT, PREFIX_64BIT } prefix_type;
+static int use_hive_cache;  /* keep binary hive caches next to the text files */
 
 static const WCHAR root_name[] = { '\\','R','e','g','i','s','t','r','y','\\' };
 static const WCHAR wow6432node[] = {'W','o','w','6','4','3','2','N','o','d','e'};
@@ -133,22 +204,41 @@ static const WCHAR symlink_value[] = {'S','y','m','b','o','l','i','c','L','i','n
 static const struct unicode_str symlink_str = { symlink_value, sizeof(symlink_value) };
 
 static void set_periodic_save_timer(void);
-static struct key_value *find_value( const struct key *key, const struct unicode_str *name, int *index );
+static struct key_value *find_value( struct key *key, const struct unicode_str *name, int *index );
+static void sort_subkeys( struct key *key );
 
 /* information about where to save a registry branch */
 struct save_branch_info
 {
     struct key  *key;
     const char  *path;
+    int          hive_stale;  /* binary hive cache needs to be rewritten at exit */
 };
 
 #define MAX_SAVE_BRANCH_INFO 3
 static int save_branch_count;
 static struct save_branch_info save_branch_info[MAX_SAVE_BRANCH_INFO];
 
+/* a key deleted since the last save of its branch */
+struct deleted_key
+{
+    struct list       entry;    /* entry in list of deleted keys */
+    const struct key *branch;   /* branch that contained the key */
+    WCHAR            *path;     /* path of the key relative to the branch */
+    data_size_t       len;      /* length of the path */
+};
+
+static struct list deleted_keys = LIST_INIT( deleted_keys );
+static int journal_incomplete;  /* the journal can't be used until the next full save */
+
+/* changes are appended to a journal file, and the branch is saved
+ * completely once the journal gets larger than this or half the file size */
+#define MIN_JOURNAL_COMPACT_SIZE (64 * 1024)
+
 unsigned int supported_machines_count = 0;
 unsigned short supported_machines[8];
 unsigned short native_machine = 0;
+unsigned int *registry_cache_generations = NULL;  /* shared with the clients */
 
 /* information about a file being loaded */
 struct file_load_info
@@ -160,6 +250,7 @@ struct file_load_info
     int         line;     /* current input line */
     WCHAR      *tmp;      /* temp buffer to use while parsing input */
     size_t      tmplen;   /* length of temp buffer */
+    int         journal;  /* replaying a journal, key times replace the current ones */
 };
 
 
@@ -274,29 +365,143 @@ static void dump_value( const struct key_value *value, FILE *f )
     fputc( '\n', f );
 }
 
+/* get a pointer to a name or value data in a binary hive */
+static const void *get_hive_data( const struct hive_image *image, unsigned int offset, data_size_t len )
+{
+    if (offset % sizeof(WCHAR)) return NULL;
+    if (offset > image->data_size || len > image->data_size - offset) return NULL;
+    return image->data + offset;
+}
+
+/* get a binary hive value as a key_value pointing into the hive */
+static int get_hive_value( const struct hive_image *image, const struct hive_value *hive_value,
+                           struct key_value *value )
+{
+    if (!(value->name = (WCHAR *)get_hive_data( image, hive_value->name, hive_value->namelen ))) return 0;
+    if (!(value->data = (void *)get_hive_data( image, hive_value->data, hive_value->len ))) return 0;
+    value->namelen = hive_value->namelen;
+    value->type    = hive_value->type;
+    value->len     = hive_value->len;
+    return 1;
+}
+
+/* check that the subkey and value ranges of a binary hive key are valid */
+static int check_hive_key( const struct hive_image *image, const struct hive_key *hive )
+{
+    /* subkeys always follow their parent, which rules out cycles in a corrupted hive */
+    if (hive->subkey_count && hive->subkeys <= hive - image->keys) return 0;
+    if (hive->subkeys > image->key_count || hive->subkey_count > image->key_count - hive->subkeys) return 0;
+    if (hive->values > image->value_count || hive->value_count > image->value_count - hive->values) return 0;
+    return 1;
+}
+
+/* path of a key that only exists in a binary hive */
+struct hive_path
+{
+    const struct hive_path *parent;  /* parent path, NULL for the key object itself */
+    const struct key       *key;     /* key object at the root of the path */
+    const WCHAR            *name;    /* name of this path element */
+    unsigned short          namelen; /* length of the name */
+};
+
+/* dump the full path of a binary hive key */
+static void dump_hive_path( const struct hive_path *path, const struct key *base, FILE *f )
+{
+    if (!path->parent)
+    {
+        dump_path( path->key, base, f );
+        return;
+    }
+    if (path->parent->parent || path->parent->key != base)
+    {
+        dump_hive_path( path->parent, base, f );
+        fprintf( f, "\\\\" );
+    }
+    dump_strW( path->name, path->namelen, f, "[]" );
+}
+
+/* save the header and options of a key to a text file */
+static void save_key_header( const struct hive_path *path, const struct key *base, timeout_t modif,
+                             const WCHAR *class, unsigned short classlen, unsigned int flags, FILE *f )
+{
+    fprintf( f, "\n[" );
+    if (path->parent || path->key != base) dump_hive_path( path, base, f );
+    fprintf( f, "] %u\n", (unsigned int)((modif - ticks_1601_to_1970) / TICKS_PER_SEC) );
+    fprintf( f, "#time=%x%08x\n", (unsigned int)(modif >> 32), (unsigned int)modif );
+    if (class)
+    {
+        fprintf( f, "#class=\"" );
+        dump_strW( class, classlen, f, "\"\"" );
+        fprintf( f, "\"\n" );
+    }
+    if (flags & KEY_SYMLINK) fputs( "#link\n", f );
+}
+
+/* save the keys of a branch that haven't been expanded from the binary hive yet */
+static void save_hive_subkeys( const struct hive_image *image, const struct hive_key *hive,
+                               const struct hive_path *path, const struct key *base, FILE *f )
+{
+    const struct hive_key *subkey;
+    struct hive_path subpath;
+    struct key_value value;
+    const WCHAR *class = NULL;
+    unsigned short classlen = hive->classlen;
+    unsigned int i, flags = hive->flags;
+    timeout_t modif = hive->modif;
+
+    if (!check_hive_key( image, hive )) return;
+
+    if (!path->parent)  /* the key object itself may have been modified */
+    {
+        modif    = path->key->modif;
+        class    = path->key->class;
+        classlen = path->key->classlen;
+        flags    = path->key->flags;
+    }
+    else if (classlen && !(class = get_hive_data( image, hive->class, classlen ))) classlen = 0;
+
+    if (hive->value_count || !hive->subkey_count || class || (flags & KEY_SYMLINK))
+    {
+        save_key_header( path, base, modif, class, classlen, flags, f );
+        for (i = 0; i < hive->value_count; i++)
+            if (get_hive_value( image, &image->values[hive->values + i], &value )) dump_value( &value, f );
+    }
+
+    subpath.parent = path;
+    subpath.key = path->key;
+    for (i = 0; i < hive->subkey_count; i++)
+    {
+        subkey = &image->keys[hive->subkeys + i];
+        if (!(subpath.name = get_hive_data( image, subkey->name, subkey->namelen ))) continue;
+        subpath.namelen = subkey->namelen;
+        save_hive_subkeys( image, subkey, &subpath, base, f );
+    }
+}
+
 /* save a registry and all its subkeys to a text file */
-static void save_subkeys( const struct key *key, const struct key *base, FILE *f )
+static void save_subkeys( struct key *key, const struct key *base, FILE *f )
 {
+    struct hive_path path;
     int i;
 
     if (key->flags & KEY_VOLATILE) return;
+
+    path.parent = NULL;
+    path.key = key;
+    if (key->hive)
+    {
+        save_hive_subkeys( key->image, key->hive, &path, base, f );
+        return;
+    }
+
     /* save key if it has either some values or no subkeys, or needs special options */
     /* keys with no values but subkeys are saved implicitly by saving the subkeys */
     if ((key->last_value >= 0) || (key->last_subkey == -1) || key->class || (key->flags & KEY_SYMLINK))
     {
-        fprintf( f, "\n[" );
-        if (key != base) dump_path( key, base, f );
-        fprintf( f, "] %u\n", (unsigned int)((key->modif - ticks_1601_to_1970) / TICKS_PER_SEC) );
-        fprintf( f, "#time=%x%08x\n", (unsigned int)(key->modif >> 32), (unsigned int)key->modif );
-        if (key->class)
-        {
-            fprintf( f, "#class=\"" );
-            dump_strW( key->class, key->classlen, f, "\"\"" );
-            fprintf( f, "\"\n" );
-        }
-        if (key->flags & KEY_SYMLINK) fputs( "#link\n", f );
+        save_key_header( &path, base, key->modif, key->class, key->classlen, key->flags, f );
         for (i = 0; i <= key->last_value; i++) dump_value( &key->values[i], f );
     }
+    sort_subkeys( key );
     for (i = 0; i <= key->last_subkey; i++) save_subkeys( key->subkeys[i], base, f );
 }
 
@@ -433,6 +638,12 @@ static int key_close_handle( struct object *obj, struct process *process, obj_ha
     struct key * key = (struct key *) obj;
     struct notify *notify = find_notify( key, process, handle );
     if (notify) do_notification( key, notify, 1 );
+
+    /* the handle value may get reused without the process knowing it was closed,
+     * so its cached values have to be dropped */
+    if (registry_cache_generations && !list_empty( &process->thread_list ) &&
+        (!current || current->process != process))
+        registry_cache_generations[REGISTRY_CACHE_CLOSE_SLOT]++;
     return 1;  /* ok to close */
 }
 
@@ -457,6 +668,7 @@ static void key_destroy( struct object *obj )
         release_object( key->subkeys[i] );
     }
     free( key->subkeys );
+    free( key->hash );
     /* unconditionally notify everything waiting on this key */
     while ((ptr = list_head( &key->notify_list )))
     {
@@ -518,12 +730,18 @@ static struct key *alloc_key( const struct unicode_str *name, timeout_t modif )
         key->flags       = 0;
         key->last_subkey = -1;
         key->nb_subkeys  = 0;
+        key->nb_sorted   = 0;
         key->subkeys     = NULL;
+        key->hash        = NULL;
+        key->hash_size   = 0;
+        key->hash_next   = NULL;
         key->nb_values   = 0;
         key->last_value  = -1;
         key->values      = NULL;
         key->modif       = modif;
         key->parent      = NULL;
+        key->image       = NULL;
+        key->hive        = NULL;
         list_init( &key->notify_list );
         if (name->len && !(key->name = memdup( name->str, name->len )))
         {
@@ -534,6 +752,117 @@ static struct key *alloc_key( const struct unicode_str *name, timeout_t modif )
     return key;
 }
 
+/* create a key object for a key contained in a binary hive */
+static struct key *alloc_hive_key( const struct hive_image *image, const struct hive_key *hive )
+{
+    struct unicode_str name;
+    const WCHAR *class = NULL;
+    struct key *key;
+
+    if (!check_hive_key( image, hive ) ||
+        !(name.str = get_hive_data( image, hive->name, hive->namelen )) ||
+        (hive->classlen && !(class = get_hive_data( image, hive->class, hive->classlen ))))
+    {
+        set_error( STATUS_REGISTRY_CORRUPT );
+        return NULL;
+    }
+    name.len = hive->namelen;
+    if (!(key = alloc_key( &name, hive->modif ))) return NULL;
+    if (class)
+    {
+        if (!(key->class = memdup( class, hive->classlen )))
+        {
+            release_object( key );
+            return NULL;
+        }
+        key->classlen = hive->classlen;
+    }
+    key->flags = hive->flags & KEY_SYMLINK;
+    key->image = image;
+    key->hive  = hive;
+    return key;
+}
+
+/* create the subkeys and values of a key that are still contained in its binary hive */
+static int expand_key( struct key *key )
+{
+    const struct hive_image *image = key->image;
+    const struct hive_key *hive = key->hive;
+    struct key **subkeys = NULL;
+    struct key_value *values = NULL;
+    unsigned int i, nb_subkeys = 0, nb_values = 0;
+
+    if (!hive) return 1;
+
+    if (hive->subkey_count && !(subkeys = mem_alloc( hive->subkey_count * sizeof(*subkeys) ))) return 0;
+    if (hive->value_count && !(values = mem_alloc( hive->value_count * sizeof(*values) ))) goto failed;
+
+    for (nb_subkeys = 0; nb_subkeys < hive->subkey_count; nb_subkeys++)
+    {
+        struct key *subkey = alloc_hive_key( image, &image->keys[hive->subkeys + nb_subkeys] );
+
+        if (!subkey) goto failed;
+        subkey->parent = key;
+        subkeys[nb_subkeys] = subkey;
+    }
+    for (nb_values = 0; nb_values < hive->value_count; nb_values++)
+    {
+        struct key_value *value = &values[nb_values];
+
+        if (!get_hive_value( image, &image->values[hive->values + nb_values], value ))
+        {
+            set_error( STATUS_REGISTRY_CORRUPT );
+            goto failed;
+        }
+        if (value->namelen && !(value->name = memdup( value->name, value->namelen ))) goto failed;
+        if (!value->len) value->data = NULL;
+        else if (!(value->data = memdup( value->data, value->len )))
+        {
+            free( value->name );
+            goto failed;
+        }
+        if (!value->namelen) value->name = NULL;
+    }
+
+    for (i = 0; i < nb_subkeys; i++)
+        if (is_wow6432node( subkeys[i]->name, subkeys[i]->namelen ) &&
+            !is_wow6432node( key->name, key->namelen ))
+            key->flags |= KEY_WOW64;
+
+    key->subkeys     = subkeys;
+    key->nb_subkeys  = nb_subkeys;
+    key->nb_sorted   = nb_subkeys;
+    key->last_subkey = (int)nb_subkeys - 1;
+    key->values      = values;
+    key->nb_values   = nb_values;
+    key->last_value  = (int)nb_values - 1;
+    key->hive        = NULL;
+    return 1;
+
+failed:
+    if (get_error() == STATUS_REGISTRY_CORRUPT)
+    {
+        /* ignore the contents, there's no point in trying again */
+        fprintf( stderr, "wineserver: corrupted binary registry hive for key " );
+        dump_path( key, NULL, stderr );
+        fprintf( stderr, "\n" );
+        key->hive = NULL;
+    }
+    for (i = 0; i < nb_subkeys; i++)
+    {
+        subkeys[i]->parent = NULL;
+        release_object( subkeys[i] );
+    }
+    for (i = 0; i < nb_values; i++)
+    {
+        free( values[i].name );
+        free( values[i].data );
+    }
+    free( subkeys );
+    free( values );
+    return 0;
+}
+
 /* mark a key and all its parents as dirty (modified) */
 static void make_dirty( struct key *key )
 {
@@ -545,6 +874,28 @@ static void make_dirty( struct key *key )
     }
 }
 
+/* return the generation counter that is incremented when the values of a key change */
+static inline unsigned int get_key_cache_slot( const struct key *key )
+{
+    return 1 + ((unsigned long)key / sizeof(*key)) % (REGISTRY_CACHE_SLOTS - 1);
+}
+
+/* check whether a key belongs to the machine hive */
+static int is_machine_key( const struct key *key )
+{
+    static const WCHAR machineW[] = {'M','a','c','h','i','n','e'};
+
+    while (key->parent && key->parent != root_key) key = key->parent;
+    return (key->parent == root_key && key->namelen == sizeof(machineW) &&
+            !memicmp_strW( key->name, machineW, sizeof(machineW) ));
+}
+
+/* invalidate the values of a key that clients may have cached */
+static void invalidate_key_cache( const struct key *key )
+{
+    if (registry_cache_generations) registry_cache_generations[get_key_cache_slot( key )]++;
+}
+
 /* mark a key and all its subkeys as clean (not modified) */
 static void make_clean( struct key *key )
 {
@@ -552,7 +903,7 @@ static void make_clean( struct key *key )
 
     if (key->flags & KEY_VOLATILE) return;
     if (!(key->flags & KEY_DIRTY)) return;
-    key->flags &= ~KEY_DIRTY;
+    key->flags &= ~(KEY_DIRTY | KEY_CHANGED | KEY_TOUCHED);
     for (i = 0; i <= key->last_subkey; i++) make_clean( key->subkeys[i] );
 }
 
@@ -575,7 +926,10 @@ static void touch_key( struct key *key, unsigned int change )
     struct key *k;
 
     key->modif = current_time;
+    /* a subkey change only needs the key time to be saved */
+    key->flags |= (change == REG_NOTIFY_CHANGE_NAME) ? KEY_TOUCHED : KEY_CHANGED;
     make_dirty( key );
+    invalidate_key_cache( key );
 
     /* do notifications */
     check_notify( key, change, 1 );
@@ -608,18 +962,131 @@ static int grow_subkeys( struct key *key )
     return 1;
 }
 
+/* compare two key names, using the sort order of the subkeys array */
+static int compare_key_names( const WCHAR *name1, data_size_t len1, const WCHAR *name2, data_size_t len2 )
+{
+    int res = memicmp_strW( name1, name2, min( len1, len2 ) );
+
+    if (!res) res = len1 - len2;
+    return res;
+}
+
+static int compare_subkeys( const void *ptr1, const void *ptr2 )
+{
+    const struct key *key1 = *(struct key * const *)ptr1;
+    const struct key *key2 = *(struct key * const *)ptr2;
+
+    return compare_key_names( key1->name, key1->namelen, key2->name, key2->namelen );
+}
+
+/* sort the subkeys that have been appended to the array since the last enumeration */
+static void sort_subkeys( struct key *key )
+{
+    int i, j, pos, count = key->last_subkey + 1;
+    struct key **tail;
+
+    if (key->nb_sorted == count) return;
+
+    qsort( key->subkeys + key->nb_sorted, count - key->nb_sorted, sizeof(*key->subkeys), compare_subkeys );
+    if ((tail = malloc( (count - key->nb_sorted) * sizeof(*tail) )))
+    {
+        /* merge the sorted tail into the array, starting from the end */
+        memcpy( tail, key->subkeys + key->nb_sorted, (count - key->nb_sorted) * sizeof(*tail) );
+        i = key->nb_sorted - 1;
+        j = count - key->nb_sorted - 1;
+        for (pos = count - 1; j >= 0; pos--)
+        {
+            if (i >= 0 && compare_subkeys( &key->subkeys[i], &tail[j] ) > 0)
+                key->subkeys[pos] = key->subkeys[i--];
+            else
+                key->subkeys[pos] = tail[j--];
+        }
+        free( tail );
+    }
+    else qsort( key->subkeys, count, sizeof(*key->subkeys), compare_subkeys );
+    key->nb_sorted = count;
+}
+
+/* add a subkey to the hash table of its parent */
+static void add_subkey_hash( struct key *parent, struct key *key )
+{
+    unsigned int hash = hash_strW( key->name, key->namelen, parent->hash_size );
+
+    key->hash_next = parent->hash[hash];
+    parent->hash[hash] = key;
+}
+
+/* remove a subkey from the hash table of its parent */
+static void remove_subkey_hash( struct key *parent, struct key *key )
+{
+    struct key **ptr = &parent->hash[hash_strW( key->name, key->namelen, parent->hash_size )];
+
+    while (*ptr != key) ptr = &(*ptr)->hash_next;
+    *ptr = key->hash_next;
+    key->hash_next = NULL;
+}
+
+/* (re)build the hash table of subkeys; return 1 if OK, 0 on error */
+static int build_subkey_hash( struct key *key )
+{
+    unsigned int size = 2 * (key->last_subkey + 1);
+    struct key **hash;
+    int i;
+
+    if (!(hash = calloc( size, sizeof(*hash) ))) return 0;
+    free( key->hash );
+    key->hash = hash;
+    key->hash_size = size;
+    for (i = 0; i <= key->last_subkey; i++) add_subkey_hash( key, key->subkeys[i] );
+    return 1;
+}
+
+/* free the hash table of subkeys, which requires the array to be fully sorted */
+static void free_subkey_hash( struct key *key )
+{
+    int i;
+
+    sort_subkeys( key );
+    for (i = 0; i <= key->last_subkey; i++) key->subkeys[i]->hash_next = NULL;
+    free( key->hash );
+    key->hash = NULL;
+    key->hash_size = 0;
+}
+
+/* binary search for a name in the sorted part of the subkeys array */
+/* return 1 if found, and the index of the key or of where it should be inserted */
+static int search_subkeys( const struct key *key, const WCHAR *name, data_size_t len, int *index )
+{
+    int i, min = 0, max = key->nb_sorted - 1, res;
+
+    while (min <= max)
+    {
+        i = (min + max) / 2;
+        res = compare_key_names( key->subkeys[i]->name, key->subkeys[i]->namelen, name, len );
+        if (!res)
+        {
+            *index = i;
+            return 1;
+        }
+        if (res > 0) max = i - 1;
+        else min = i + 1;
+    }
+    *index = min;
+    return 0;
+}
+
 /* allocate a subkey for a given key, and return its index */
 static struct key *alloc_subkey( struct key *parent, const struct unicode_str *name,
                                  int index, timeout_t modif )
 {
     struct key *key;
-    int i;
 
     if (name->len > MAX_NAME_LEN * sizeof(WCHAR))
     {
         set_error( STATUS_INVALID_PARAMETER );
         return NULL;
     }
+    if (!expand_key( parent )) return NULL;
     if (parent->last_subkey + 1 == parent->nb_subkeys)
     {
         /* need to grow the array */
@@ -628,9 +1095,20 @@ static struct key *alloc_subkey( struct key *parent, const struct unicode_str *n
     if ((key = alloc_key( name, modif )) != NULL)
     {
         key->parent = parent;
-        for (i = ++parent->last_subkey; i > index; i--)
-            parent->subkeys[i] = parent->subkeys[i-1];
+        memmove( parent->subkeys + index + 1, parent->subkeys + index,
+                 (parent->last_subkey + 1 - index) * sizeof(*parent->subkeys) );
+        parent->last_subkey++;
         parent->subkeys[index] = key;
+        /* keys with a hash table get new subkeys appended, they are sorted on enumeration */
+        if (index < parent->nb_sorted) parent->nb_sorted++;
+        else if (index == parent->nb_sorted &&
+                 (!index || compare_subkeys( &parent->subkeys[index - 1], &key ) < 0))
+            parent->nb_sorted++;
+        if (parent->hash)
+        {
+            add_subkey_hash( parent, key );
+            if (parent->last_subkey >= parent->hash_size) build_subkey_hash( parent );
+        }
         if (is_wow6432node( key->name, key->namelen ) && !is_wow6432node( parent->name, parent->namelen ))
             parent->flags |= KEY_WOW64;
     }
@@ -641,18 +1119,23 @@ static struct key *alloc_subkey( struct key *parent, const struct unicode_str *n
 static void free_subkey( struct key *parent, int index )
 {
     struct key *key;
-    int i, nb_subkeys;
+    int nb_subkeys;
 
     assert( index >= 0 );
     assert( index <= parent->last_subkey );
 
     key = parent->subkeys[index];
-    for (i = index; i < parent->last_subkey; i++) parent->subkeys[i] = parent->subkeys[i + 1];
+    if (parent->hash) remove_subkey_hash( parent, key );
+    if (index < parent->nb_sorted) parent->nb_sorted--;
+    memmove( parent->subkeys + index, parent->subkeys + index + 1,
+             (parent->last_subkey - index) * sizeof(*parent->subkeys) );
     parent->last_subkey--;
     key->flags |= KEY_DELETED;
     key->parent = NULL;
+    invalidate_key_cache( key );
     if (is_wow6432node( key->name, key->namelen )) parent->flags &= ~KEY_WOW64;
     release_object( key );
+    if (parent->hash && parent->last_subkey + 1 < MIN_HASHED_SUBKEYS / 2) free_subkey_hash( parent );
 
     /* try to shrink the array */
     nb_subkeys = parent->nb_subkeys;
@@ -667,29 +1150,24 @@ static void free_subkey( struct key *parent, int index )
     }
 }
 
-/* find the named child of a given key and return its index */
-static struct key *find_subkey( const struct key *key, const struct unicode_str *name, int *index )
+/* find the named child of a given key */
+/* if not found, return in index where it should be inserted */
+static struct key *find_subkey( struct key *key, const struct unicode_str *name, int *index )
 {
-    int i, min, max, res;
-    data_size_t len;
+    struct key *subkey;
 
-    min = 0;
-    max = key->last_subkey;
-    while (min <= max)
+    *index = 0;
+    if (!expand_key( key )) return NULL;
+
+    if (!key->hash && key->last_subkey + 1 >= MIN_HASHED_SUBKEYS) build_subkey_hash( key );
+    if (key->hash)
     {
-        i = (min + max) / 2;
-        len = min( key->subkeys[i]->namelen, name->len );
-        res = memicmp_strW( key->subkeys[i]->name, name->str, len );
-        if (!res) res = key->subkeys[i]->namelen - name->len;
-        if (!res)
-        {
-            *index = i;
-            return key->subkeys[i];
-        }
-        if (res > 0) max = i - 1;
-        else min = i + 1;
+        for (subkey = key->hash[hash_strW( name->str, name->len, key->hash_size )]; subkey; subkey = subkey->hash_next)
+            if (!compare_key_names( subkey->name, subkey->namelen, name->str, name->len )) return subkey;
+        *index = key->last_subkey + 1;  /* append it, the array will be sorted when needed */
+        return NULL;
     }
-    *index = min;  /* this is where we should insert it */
+    if (search_subkeys( key, name->str, name->len, index )) return key->subkeys[*index];
     return NULL;
 }
 
@@ -699,6 +1177,7 @@ static struct key *find_wow64_subkey( struct key *key, const struct unicode_str
     static const struct unicode_str wow6432node_str = { wow6432node, sizeof(wow6432node) };
     int index;
 
+    if (!expand_key( key )) return key;
     if (!(key->flags & KEY_WOW64)) return key;
     if (!is_wow6432node( name->str, name->len ))
     {
@@ -850,7 +1329,7 @@ static struct key *create_key( struct key *key, const struct unicode_str *name,
 
     if (options & REG_OPTION_CREATE_LINK) key->flags |= KEY_SYMLINK;
     if (options & REG_OPTION_VOLATILE) key->flags |= KEY_VOLATILE;
-    else key->flags |= KEY_DIRTY;
+    else key->flags |= KEY_DIRTY | KEY_CHANGED;
 
     if (sd) default_set_sd( &key->obj, sd, OWNER_SECURITY_INFORMATION | GROUP_SECURITY_INFORMATION |
                             DACL_SECURITY_INFORMATION | SACL_SECURITY_INFORMATION );
@@ -926,6 +1405,8 @@ static void enum_key( struct key *key, int index, int info_class, struct enum_ke
         return;
     }
 
+    if (!expand_key( key )) return;
+
     if (index != -1)  /* -1 means use the specified key directly */
     {
         if ((index < 0) || (index > key->last_subkey))
@@ -933,6 +1414,7 @@ static void enum_key( struct key *key, int index, int info_class, struct enum_ke
             set_error( STATUS_NO_MORE_ENTRIES );
             return;
         }
+        sort_subkeys( key );
         key = key->subkeys[index];
     }
 
@@ -955,6 +1437,7 @@ static void enum_key( struct key *key, int index, int info_class, struct enum_ke
         break;
     case KeyFullInformation:
     case KeyCachedInformation:
+        if (!expand_key( key )) return;
         for (i = 0; i <= key->last_subkey; i++)
         {
             if (key->subkeys[i]->namelen > max_subkey) max_subkey = key->subkeys[i]->namelen;
@@ -978,8 +1461,8 @@ static void enum_key( struct key *key, int index, int info_class, struct enum_ke
         set_error( STATUS_INVALID_PARAMETER );
         return;
     }
-    reply->subkeys = key->last_subkey + 1;
-    reply->values  = key->last_value + 1;
+    reply->subkeys = key->hive ? key->hive->subkey_count : key->last_subkey + 1;
+    reply->values  = key->hive ? key->hive->value_count : key->last_value + 1;
     reply->modif   = key->modif;
     reply->total   = namelen + classlen;
 
@@ -1007,6 +1490,48 @@ static void enum_key( struct key *key, int index, int info_class, struct enum_ke
     if (debug_level > 1) dump_operation( key, NULL, "Enum" );
 }
 
+/* remember a deleted key so that the deletion can be written to the journal */
+static void record_deleted_key( const struct key *key )
+{
+    const struct key *branch, *k;
+    struct deleted_key *deleted;
+    data_size_t len = 0;
+    WCHAR *p;
+    int i;
+
+    if (key->flags & KEY_VOLATILE) return;
+    for (branch = key->parent; branch; branch = branch->parent)
+    {
+        for (i = 0; i < save_branch_count; i++) if (save_branch_info[i].key == branch) break;
+        if (i < save_branch_count) break;
+    }
+    if (!branch) return;
+
+    for (k = key; k != branch; k = k->parent) len += k->namelen + sizeof(WCHAR);
+    len -= sizeof(WCHAR);
+    if (!(deleted = mem_alloc( sizeof(*deleted) )))
+    {
+        journal_incomplete = 1;
+        return;
+    }
+    if (!(deleted->path = mem_alloc( len )))
+    {
+        free( deleted );
+        journal_incomplete = 1;
+        return;
+    }
+    p = deleted->path + len / sizeof(WCHAR);
+    for (k = key; k != branch; k = k->parent)
+    {
+        p -= k->namelen / sizeof(WCHAR);
+        memcpy( p, k->name, k->namelen );
+        if (p > deleted->path) *--p = '\\';
+    }
+    deleted->branch = branch;
+    deleted->len    = len;
+    list_add_tail( &deleted_keys, &deleted->entry );
+}
+
 /* delete a key and its values */
 static int delete_key( struct key *key, int recurse )
 {
@@ -1027,13 +1552,15 @@ static int delete_key( struct key *key, int recurse )
         return -1;
     }
 
+    if (!expand_key( key )) return -1;
+
     while (recurse && (key->last_subkey>=0))
         if (0 > delete_key(key->subkeys[key->last_subkey], 1))
             return -1;
 
-    for (index = 0; index <= parent->last_subkey; index++)
-        if (parent->subkeys[index] == key) break;
-    assert( index <= parent->last_subkey );
+    sort_subkeys( parent );
+    search_subkeys( parent, key->name, key->namelen, &index );
+    assert( index <= parent->last_subkey && parent->subkeys[index] == key );
 
     /* we can only delete a key that has no subkeys */
     if (key->last_subkey >= 0)
@@ -1043,6 +1570,7 @@ static int delete_key( struct key *key, int recurse )
     }
 
     if (debug_level > 1) dump_operation( key, NULL, "Delete" );
+    record_deleted_key( key );
     free_subkey( parent, index );
     touch_key( parent, REG_NOTIFY_CHANGE_NAME );
     return 0;
@@ -1074,11 +1602,14 @@ static int grow_values( struct key *key )
 }
 
 /* find the named value of a given key and return its index in the array */
-static struct key_value *find_value( const struct key *key, const struct unicode_str *name, int *index )
+static struct key_value *find_value( struct key *key, const struct unicode_str *name, int *index )
 {
     int i, min, max, res;
     data_size_t len;
 
+    *index = 0;
+    if (!expand_key( key )) return NULL;
+
     min = 0;
     max = key->last_value;
     while (min <= max)
@@ -1111,6 +1642,7 @@ static struct key_value *insert_value( struct key *key, const struct unicode_str
         set_error( STATUS_NAME_TOO_LONG );
         return NULL;
     }
+    if (!expand_key( key )) return NULL;
     if (key->last_value + 1 == key->nb_values)
     {
         if (!grow_values( key )) return NULL;
@@ -1216,6 +1748,8 @@ static void enum_value( struct key *key, int i, int info_class, struct enum_key_
         return;
     }
 
+    if (!expand_key( key )) return;
+
     if (i < 0 || i > key->last_value) set_error( STATUS_NO_MORE_ENTRIES );
     else
     {
@@ -1506,7 +2040,8 @@ static int load_key_option( struct key *key, const char *buffer, struct file_loa
             else if (*p >= 'a' && *p <= 'f') modif = (modif << 4) | (*p - 'a' + 10);
             else break;
         }
-        update_key_time( key, modif );
+        if (info->journal) key->modif = modif;
+        else update_key_time( key, modif );
     }
     if (!strncmp( buffer, "#class=", 7 ))
     {
@@ -1520,6 +2055,20 @@ static int load_key_option( struct key *key, const char *buffer, struct file_loa
         key->classlen = len;
     }
     if (!strncmp( buffer, "#link", 5 )) key->flags |= KEY_SYMLINK;
+    /* the following are only found in journal files */
+    if (!strcmp( buffer, "#replace" ))  /* the values that follow replace all the existing ones */
+    {
+        int i;
+
+        if (!expand_key( key )) return 0;
+        for (i = 0; i <= key->last_value; i++)
+        {
+            free( key->values[i].name );
+            free( key->values[i].data );
+        }
+        key->last_value = -1;
+    }
+    if (!strcmp( buffer, "#delete" )) delete_key( key, 1 );
     /* ignore unknown options */
     return 1;
 }
@@ -1634,6 +2183,7 @@ static int load_value( struct key *key, const char *buffer, struct file_load_inf
     if (!len) newptr = NULL;
     else if (!(newptr = memdup( ptr, len ))) return 0;
 
+    invalidate_key_cache( key );
     free( value->data );
     value->data = newptr;
     value->len  = len;
@@ -1678,7 +2228,7 @@ static int get_prefix_len( struct key *key, const char *name, struct file_load_i
 
 /* load all the keys from the input file */
 /* prefix_len is the number of key name prefixes to skip, or -1 for autodetection */
-static void load_keys( struct key *key, const char *filename, FILE *f, int prefix_len )
+static void load_keys( struct key *key, const char *filename, FILE *f, int prefix_len, int journal )
 {
     struct key *subkey = NULL;
     struct file_load_info info;
@@ -1690,6 +2240,7 @@ static void load_keys( struct key *key, const char *filename, FILE *f, int prefi
     info.len    = 4;
     info.tmplen = 4;
     info.line   = 0;
+    info.journal = journal;
     if (!(info.buffer = mem_alloc( info.len ))) return;
     if (!(info.tmp = mem_alloc( info.tmplen )))
     {
@@ -1762,35 +2313,436 @@ static void load_registry( struct key *key, obj_handle_t handle )
         FILE *f = fdopen( fd, "r" );
         if (f)
         {
-            load_keys( key, NULL, f, -1 );
+            load_keys( key, NULL, f, -1, 0 );
             fclose( f );
         }
         else file_set_error();
     }
 }
 
+/* buffer used to build a binary hive */
+struct hive_buffer
+{
+    struct hive_key   *keys;        /* key table */
+    struct hive_node  *nodes;       /* source of each key in the key table */
+    struct hive_value *values;      /* value table */
+    char              *data;        /* name and value data */
+    unsigned int       key_count;   /* number of keys */
+    unsigned int       key_size;    /* allocated size of key tables */
+    unsigned int       value_count; /* number of values */
+    unsigned int       value_size;  /* allocated size of value table */
+    size_t             data_len;    /* used size of data */
+    size_t             data_size;   /* allocated size of data */
+};
+
+/* source of the contents of a key being saved to a binary hive */
+struct hive_node
+{
+    struct key              *key;   /* key object if the key has been expanded */
+    const struct hive_image *image; /* hive containing the key otherwise */
+    const struct hive_key   *hive;  /* hive key if not expanded */
+};
+
+/* return the modification time of a file, in ns */
+static timeout_t get_file_mtime( const struct stat *st )
+{
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    return (timeout_t)st->st_mtime * 1000000000 + st->st_mtim.tv_nsec;
+#else
+    return (timeout_t)st->st_mtime * 1000000000;
+#endif
+}
+
+/* return the name of the binary hive cache for a registry text file */
+static char *get_hive_name( const char *path )
+{
+    char *name = mem_alloc( strlen(path) + sizeof(".bin") );
+
+    if (name) sprintf( name, "%s.bin", path );
+    return name;
+}
+
+/* return the name of the journal file for a registry text file */
+static char *get_journal_name( const char *path )
+{
+    char *name = mem_alloc( strlen(path) + sizeof(".journal") );
+
+    if (name) sprintf( name, "%s.journal", path );
+    return name;
+}
+
+/* append name or value data to a binary hive */
+static int add_hive_data( struct hive_buffer *buf, const void *ptr, data_size_t len, unsigned int *offset )
+{
+    size_t pos = (buf->data_len + 3) & ~3;
+
+    if (pos + len > UINT_MAX)
+    {
+        set_error( STATUS_NO_MEMORY );
+        return 0;
+    }
+    if (pos + len > buf->data_size)
+    {
+        size_t new_size = max( pos + len, buf->data_size + buf->data_size / 2 );
+        char *new_data;
+
+        if (!(new_data = realloc( buf->data, new_size )))
+        {
+            set_error( STATUS_NO_MEMORY );
+            return 0;
+        }
+        buf->data = new_data;
+        buf->data_size = new_size;
+    }
+    if (pos > buf->data_len) memset( buf->data + buf->data_len, 0, pos - buf->data_len );
+    if (len) memcpy( buf->data + pos, ptr, len );
+    buf->data_len = pos + len;
+    *offset = pos;
+    return 1;
+}
+
+/* append a key to the key table of a binary hive */
+static int add_hive_key( struct hive_buffer *buf, const struct hive_node *node, const WCHAR *name,
+                         unsigned short namelen, const WCHAR *class, unsigned short classlen,
+                         timeout_t modif, unsigned int flags )
+{
+    struct hive_key *hive;
+
+    if (buf->key_count == buf->key_size)
+    {
+        unsigned int new_size = max( 64, buf->key_size + buf->key_size / 2 );
+        struct hive_key *new_keys;
+        struct hive_node *new_nodes;
+
+        if (!(new_keys = realloc( buf->keys, new_size * sizeof(*new_keys) ))) goto nomem;
+        buf->keys = new_keys;
+        if (!(new_nodes = realloc( buf->nodes, new_size * sizeof(*new_nodes) ))) goto nomem;
+        buf->nodes = new_nodes;
+        buf->key_size = new_size;
+    }
+    hive = &buf->keys[buf->key_count];
+    memset( hive, 0, sizeof(*hive) );
+    hive->modif    = modif;
+    hive->namelen  = namelen;
+    hive->classlen = classlen;
+    hive->flags    = flags & KEY_SYMLINK;
+    if (!add_hive_data( buf, name, namelen, &hive->name )) return 0;
+    if (!add_hive_data( buf, class, classlen, &hive->class )) return 0;
+    buf->nodes[buf->key_count++] = *node;
+    return 1;
+
+nomem:
+    set_error( STATUS_NO_MEMORY );
+    return 0;
+}
+
+/* append a value to the value table of a binary hive */
+static int add_hive_value( struct hive_buffer *buf, const struct key_value *value )
+{
+    struct hive_value *hive;
+
+    if (buf->value_count == buf->value_size)
+    {
+        unsigned int new_size = max( 64, buf->value_size + buf->value_size / 2 );
+        struct hive_value *new_values;
+
+        if (!(new_values = realloc( buf->values, new_size * sizeof(*new_values) )))
+        {
+            set_error( STATUS_NO_MEMORY );
+            return 0;
+        }
+        buf->values = new_values;
+        buf->value_size = new_size;
+    }
+    hive = &buf->values[buf->value_count];
+    hive->namelen = value->namelen;
+    hive->type    = value->type;
+    hive->len     = value->len;
+    if (!add_hive_data( buf, value->name, value->namelen, &hive->name )) return 0;
+    if (!add_hive_data( buf, value->data, value->len, &hive->data )) return 0;
+    buf->value_count++;
+    return 1;
+}
+
+/* add the subkeys and values of a key to a binary hive */
+static int add_hive_contents( struct hive_buffer *buf, unsigned int pos )
+{
+    const struct hive_node node = buf->nodes[pos];
+    struct hive_node subnode;
+    struct key_value value;
+    unsigned int i, first_key = buf->key_count, first_value = buf->value_count;
+
+    if (node.hive)
+    {
+        const struct hive_image *image = node.image;
+
+        if (!check_hive_key( image, node.hive )) goto corrupt;
+        subnode.key   = NULL;
+        subnode.image = image;
+        for (i = 0; i < node.hive->subkey_count; i++)
+        {
+            const struct hive_key *hive = &image->keys[node.hive->subkeys + i];
+            const WCHAR *name, *class;
+
+            if (!(name = get_hive_data( image, hive->name, hive->namelen ))) goto corrupt;
+            if (!(class = get_hive_data( image, hive->class, hive->classlen ))) goto corrupt;
+            subnode.hive = hive;
+            if (!add_hive_key( buf, &subnode, name, hive->namelen, class, hive->classlen,
+                               hive->modif, hive->flags )) return 0;
+        }
+        for (i = 0; i < node.hive->value_count; i++)
+        {
+            if (!get_hive_value( image, &image->values[node.hive->values + i], &value )) goto corrupt;
+            if (!add_hive_value( buf, &value )) return 0;
+        }
+    }
+    else
+    {
+        struct key *key = node.key;
+        int j;
+
+        sort_subkeys( key );
+        for (j = 0; j <= key->last_subkey; j++)
+        {
+            struct key *subkey = key->subkeys[j];
+
+            if (subkey->flags & KEY_VOLATILE) continue;
+            subnode.key   = subkey;
+            subnode.image = subkey->image;
+            subnode.hive  = subkey->hive;
+            if (!add_hive_key( buf, &subnode, subkey->name, subkey->namelen, subkey->class,
+                               subkey->classlen, subkey->modif, subkey->flags )) return 0;
+        }
+        for (j = 0; j <= key->last_value; j++)
+            if (!add_hive_value( buf, &key->values[j] )) return 0;
+    }
+
+    buf->keys[pos].subkeys      = first_key;
+    buf->keys[pos].subkey_count = buf->key_count - first_key;
+    buf->keys[pos].values       = first_value;
+    buf->keys[pos].value_count  = buf->value_count - first_value;
+    return 1;
+
+corrupt:
+    set_error( STATUS_REGISTRY_CORRUPT );
+    return 0;
+}
+
+/* write a buffer to a file */
+static int write_hive_data( int fd, const void *ptr, size_t size )
+{
+    while (size)
+    {
+        ssize_t ret = write( fd, ptr, size );
+        if (ret == -1)
+        {
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        ptr = (const char *)ptr + ret;
+        size -= ret;
+    }
+    return 1;
+}
+
+/* save a registry branch to a binary hive cache of the corresponding text file */
+static void save_hive( struct key *key, const char *path )
+{
+    static const char padding[8];
+    struct hive_buffer buf;
+    struct hive_header header;
+    struct hive_node node;
+    struct stat st;
+    char *name = NULL, *tmp = NULL;
+    unsigned int pos;
+    size_t keys_size, values_size;
+    int fd, ret = 0;
+
+    memset( &buf, 0, sizeof(buf) );
+
+    /* the keys are stored breadth-first so that the subkeys of each key are contiguous */
+    node.key   = key;
+    node.image = key->image;
+    node.hive  = key->hive;
+    if (!add_hive_key( &buf, &node, key->name, key->namelen, key->class, key->classlen,
+                       key->modif, key->flags )) goto done;
+    for (pos = 0; pos < buf.key_count; pos++)
+        if (!add_hive_contents( &buf, pos )) goto done;
+
+    if (stat( path, &st ) == -1) goto done;
+    if (!(name = get_hive_name( path ))) goto done;
+    if (!(tmp = mem_alloc( strlen(name) + sizeof(".tmp") ))) goto done;
+    sprintf( tmp, "%s.tmp", name );
+
+    keys_size   = buf.key_count * sizeof(*buf.keys);
+    values_size = (buf.value_count * sizeof(*buf.values) + 7) & ~7;
+
+    memset( &header, 0, sizeof(header) );
+    memcpy( header.signature, hive_signature, sizeof(hive_signature) );
+    header.version     = HIVE_VERSION;
+    header.prefix_type = prefix_type;
+    header.text_size   = st.st_size;
+    header.text_ino    = st.st_ino;
+    header.text_mtime  = get_file_mtime( &st );
+    header.keys        = sizeof(header);
+    header.values      = header.keys + keys_size;
+    header.data        = header.values + values_size;
+    header.size        = header.data + buf.data_len;
+    header.key_count   = buf.key_count;
+    header.value_count = buf.value_count;
+
+    if ((fd = open( tmp, O_CREAT | O_TRUNC | O_WRONLY, 0666 )) == -1) goto done;
+    ret = (write_hive_data( fd, &header, sizeof(header) ) &&
+           write_hive_data( fd, buf.keys, keys_size ) &&
+           write_hive_data( fd, buf.values, buf.value_count * sizeof(*buf.values) ) &&
+           write_hive_data( fd, padding, values_size - buf.value_count * sizeof(*buf.values) ) &&
+           write_hive_data( fd, buf.data, buf.data_len ));
+    if (close( fd )) ret = 0;
+    if (ret) ret = !rename( tmp, name );
+    if (!ret) unlink( tmp );
+
+done:
+    if (!ret && debug_level) fprintf( stderr, "%s: could not save binary registry hive\n", path );
+    free( name );
+    free( tmp );
+    free( buf.keys );
+    free( buf.nodes );
+    free( buf.values );
+    free( buf.data );
+}
+
+/* load a registry branch from the binary hive cache of the corresponding text file */
+static int load_hive( struct key *key, const char *path )
+{
+    const struct hive_header *header;
+    const struct hive_key *root;
+    struct hive_image *image = NULL;
+    struct stat st, text_st;
+    void *base = MAP_FAILED;
+    char *name;
+    int fd;
+
+    if (key->last_subkey >= 0 || key->last_value >= 0 || key->hive) return 0;
+    if (stat( path, &text_st ) == -1) return 0;
+    if (!(name = get_hive_name( path ))) return 0;
+    fd = open( name, O_RDONLY );
+    free( name );
+    if (fd == -1) return 0;
+
+    if (!fstat( fd, &st ) && st.st_size >= sizeof(*header) && st.st_size == (size_t)st.st_size)
+        base = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if (base == MAP_FAILED) return 0;
+
+    header = base;
+    if (memcmp( header->signature, hive_signature, sizeof(hive_signature) )) goto failed;
+    if (header->version != HIVE_VERSION) goto failed;
+    if (header->size != st.st_size) goto failed;
+    if (header->text_size != text_st.st_size || header->text_ino != text_st.st_ino ||
+        header->text_mtime != get_file_mtime( &text_st )) goto failed;  /* text file has changed */
+    if (header->prefix_type != PREFIX_UNKNOWN && prefix_type != PREFIX_UNKNOWN &&
+        header->prefix_type != prefix_type) goto failed;
+    if (!header->key_count) goto failed;
+    if ((header->keys | header->values | header->data) & 7) goto failed;
+    if (header->keys > header->size ||
+        header->key_count > (header->size - header->keys) / sizeof(struct hive_key)) goto failed;
+    if (header->values > header->size ||
+        header->value_count > (header->size - header->values) / sizeof(struct hive_value)) goto failed;
+    if (header->data > header->size) goto failed;
+
+    if (!(image = mem_alloc( sizeof(*image) ))) goto failed;
+    image->keys        = (const struct hive_key *)((const char *)base + header->keys);
+    image->values      = (const struct hive_value *)((const char *)base + header->values);
+    image->data        = (const char *)base + header->data;
+    image->key_count   = header->key_count;
+    image->value_count = header->value_count;
+    image->data_size   = header->size - header->data;
+
+    root = &image->keys[0];
+    if (!check_hive_key( image, root )) goto failed;
+    if (root->classlen)
+    {
+        const WCHAR *class = get_hive_data( image, root->class, root->classlen );
+
+        if (!class || !(key->class = memdup( class, root->classlen ))) goto failed;
+        key->classlen = root->classlen;
+    }
+    if (prefix_type == PREFIX_UNKNOWN) prefix_type = header->prefix_type;
+    key->flags |= root->flags & KEY_SYMLINK;
+    key->modif  = root->modif;
+    key->image  = image;
+    key->hive   = root;
+    return 1;
+
+failed:
+    free( image );
+    munmap( base, st.st_size );
+    return 0;
+}
+
+/* check that a journal file applies to the current contents of its registry file */
+static int check_journal_base( FILE *f, const char *path )
+{
+    struct stat st;
+    unsigned int size, ino, mtime_high, mtime_low;
+    int ret;
+
+    if (stat( path, &st ) == -1) return 0;
+    ret = (fscanf( f, "WINE REGISTRY Version 2\n#base=%x,%x,%8x%8x\n",
+                   &size, &ino, &mtime_high, &mtime_low ) == 4 &&
+           size == (unsigned int)st.st_size && ino == (unsigned int)st.st_ino &&
+           (((timeout_t)mtime_high << 32) | mtime_low) == get_file_mtime( &st ));
+    rewind( f );
+    return ret;
+}
+
+/* replay the changes recorded in the journal of a registry file */
+static void load_journal( struct key *key, const char *path )
+{
+    char *name;
+    FILE *f;
+
+    if (!(name = get_journal_name( path ))) return;
+    if ((f = fopen( name, "r" )))
+    {
+        if (check_journal_base( f, path ))
+        {
+            load_keys( key, name, f, 0, 1 );
+            make_clean( key );
+        }
+        else unlink( name );  /* left over from an interrupted full save */
+        fclose( f );
+    }
+    free( name );
+}
+
 /* load one of the initial registry files */
 static int load_init_registry_from_file( const char *filename, struct key *key )
 {
     FILE *f;
+    int ret = use_hive_cache && load_hive( key, filename ), stale = 0;
 
-    if ((f = fopen( filename, "r" )))
+    if (!ret && (f = fopen( filename, "r" )))
     {
-        load_keys( key, filename, f, 0 );
+        load_keys( key, filename, f, 0, 0 );
         fclose( f );
         if (get_error() == STATUS_NOT_REGISTRY_FILE)
         {
             fprintf( stderr, "%s is not a valid registry file\n", filename );
             return 1;
         }
+        stale = use_hive_cache;
+        ret = 1;
     }
+    if (ret) load_journal( key, filename );
 
     assert( save_branch_count < MAX_SAVE_BRANCH_INFO );
 
     save_branch_info[save_branch_count].path = filename;
+    save_branch_info[save_branch_count].hive_stale = stale;
     save_branch_info[save_branch_count++].key = (struct key *)grab_object( key );
     make_object_permanent( &key->obj );
-    return (f != NULL);
+    return ret;
 }
 
 static WCHAR *format_user_registry_path( const struct sid *sid, struct unicode_str *path )
@@ -1869,6 +2821,8 @@ void init_registry(void)
 
     if (fchdir( config_dir_fd ) == -1) fatal_error( "chdir to config dir: %s\n", strerror( errno ));
 
+    if ((p = getenv( "WINEREGISTRYCACHE" ))) use_hive_cache = atoi( p );
+
     /* create the root key */
     root_key = alloc_key( &root_name, current_time );
     assert( root_key );
@@ -2008,9 +2962,105 @@ static void save_registry( struct key *key, obj_handle_t handle )
     }
 }
 
+/* free the recorded deletions of a registry branch */
+static void free_deleted_keys( const struct key *branch )
+{
+    struct deleted_key *deleted, *next;
+
+    LIST_FOR_EACH_ENTRY_SAFE( deleted, next, &deleted_keys, struct deleted_key, entry )
+    {
+        if (deleted->branch != branch) continue;
+        list_remove( &deleted->entry );
+        free( deleted->path );
+        free( deleted );
+    }
+}
+
+/* save the keys that have been modified since the last save to a journal file */
+static void save_changed_keys( const struct key *key, const struct key *base, FILE *f )
+{
+    struct hive_path path;
+    int i;
+
+    if (key->flags & KEY_VOLATILE) return;
+    if (!(key->flags & KEY_DIRTY)) return;
+    if (key->hive) return;  /* not expanded, so not modified either */
+
+    if (key->flags & KEY_CHANGED)
+    {
+        path.parent = NULL;
+        path.key = key;
+        save_key_header( &path, base, key->modif, key->class, key->classlen, key->flags, f );
+        fputs( "#replace\n", f );
+        for (i = 0; i <= key->last_value; i++) dump_value( &key->values[i], f );
+    }
+    else if (key->flags & KEY_TOUCHED)  /* the header is enough to update the time */
+    {
+        path.parent = NULL;
+        path.key = key;
+        save_key_header( &path, base, key->modif, key->class, key->classlen, key->flags, f );
+    }
+    for (i = 0; i <= key->last_subkey; i++) save_changed_keys( key->subkeys[i], base, f );
+}
+
+/* append the changes to a registry branch to its journal file */
+/* returns 0 if the branch needs to be saved completely instead */
+static int save_journal( struct key *key, const char *path )
+{
+    struct deleted_key *deleted;
+    struct stat st, journal_st;
+    char *name;
+    FILE *f;
+    int ret = 0;
+
+    if (stat( path, &st ) == -1 || !S_ISREG(st.st_mode)) return 0;
+    if (!(name = get_journal_name( path ))) return 0;
+
+    if (!stat( name, &journal_st ) &&
+        journal_st.st_size >= max( MIN_JOURNAL_COMPACT_SIZE, st.st_size / 2 )) goto done;
+    if (!(f = fopen( name, "a" ))) goto done;
+
+    if (debug_level > 1)
+    {
+        fprintf( stderr, "%s: ", name );
+        dump_operation( key, NULL, "saving changes" );
+    }
+
+    if (!ftell( f ))
+    {
+        timeout_t mtime = get_file_mtime( &st );
+
+        fprintf( f, "WINE REGISTRY Version 2\n#base=%x,%x,%08x%08x\n",
+                 (unsigned int)st.st_size, (unsigned int)st.st_ino,
+                 (unsigned int)(mtime >> 32), (unsigned int)mtime );
+    }
+    LIST_FOR_EACH_ENTRY( deleted, &deleted_keys, struct deleted_key, entry )
+    {
+        if (deleted->branch != key) continue;
+        fprintf( f, "\n[" );
+        dump_strW( deleted->path, deleted->len, f, "[]" );
+        fprintf( f, "]\n#delete\n" );
+    }
+    save_changed_keys( key, key, f );
+    ret = !fclose( f );
+
+    if (ret)
+    {
+        make_clean( key );
+        free_deleted_keys( key );
+    }
+    else journal_incomplete = 1;  /* the journal may be truncated, it has to be replaced */
+
+done:
+    free( name );
+    return ret;
+}
+
 /* save a registry branch to a file */
-static int save_branch( struct key *key, const char *path )
+static int save_branch( struct save_branch_info *info, int full )
 {
+    struct key *key = info->key;
+    const char *path = info->path;
     struct stat st;
     char *p, *tmp = NULL;
     int fd, count = 0, ret = 0;
@@ -2022,6 +3072,8 @@ static int save_branch( struct key *key, const char *path )
         return 1;
     }
 
+    if (!full && !journal_incomplete && save_journal( key, path )) return 1;
+
     /* test the file type */
 
     if ((fd = open( path, O_WRONLY )) != -1)
@@ -2075,22 +3127,34 @@ static int save_branch( struct key *key, const char *path )
         if (ret) ret = !rename( tmp, path );
         if (!ret) unlink( tmp );
     }
+    /* the binary hive is only rewritten at exit, it would be outdated by the next save anyway */
+    if (ret) info->hive_stale = use_hive_cache;
 
 done:
     free( tmp );
-    if (ret) make_clean( key );
+    if (ret)
+    {
+        make_clean( key );
+        free_deleted_keys( key );
+        if ((tmp = get_journal_name( path )))
+        {
+            unlink( tmp );
+            free( tmp );
+        }
+    }
     return ret;
 }
 
 /* periodic saving of the registry */
 static void periodic_save( void *arg )
 {
-    int i;
+    int i, ret = 1, full = journal_incomplete;
 
     if (fchdir( config_dir_fd ) == -1) return;
     save_timeout_user = NULL;
     for (i = 0; i < save_branch_count; i++)
-        save_branch( save_branch_info[i].key, save_branch_info[i].path );
+        ret &= save_branch( &save_branch_info[i], full );
+    if (full && ret) journal_incomplete = 0;
     if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
     set_periodic_save_timer();
 }
@@ -2110,12 +3174,17 @@ void flush_registry(void)
     if (fchdir( config_dir_fd ) == -1) return;
     for (i = 0; i < save_branch_count; i++)
     {
-        if (!save_branch( save_branch_info[i].key, save_branch_info[i].path ))
+        if (!save_branch( &save_branch_info[i], 1 ))
         {
             fprintf( stderr, "wineserver: could not save registry branch to %s",
                      save_branch_info[i].path );
             perror( " " );
         }
+        else if (save_branch_info[i].hive_stale)
+        {
+            save_hive( save_branch_info[i].key, save_branch_info[i].path );
+            save_branch_info[i].hive_stale = 0;
+        }
     }
     if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
 }
@@ -2253,9 +3322,17 @@ DECL_HANDLER(get_key_value)
     struct unicode_str name = get_req_unicode_str();
 
     reply->total = 0;
+    reply->cache_slot = -1;
     if ((key = get_hkey_obj( req->hkey, KEY_QUERY_VALUE )))
     {
         get_value( key, &name, &reply->type, &reply->total );
+        /* values in the machine hive are rarely modified, let the client cache them */
+        if (registry_cache_generations && is_machine_key( key ) &&
+            (!get_error() || get_error() == STATUS_OBJECT_NAME_NOT_FOUND))
+        {
+            reply->cache_slot = get_key_cache_slot( key );
+            reply->generation = registry_cache_generations[reply->cache_slot];
+        }
         release_object( key );
     }
 }
@@ -197,6 +197,7 @@ DECL_HANDLER(debug_process);
 DECL_HANDLER(set_debug_obj_info);
 DECL_HANDLER(read_process_memory);
 DECL_HANDLER(write_process_memory);
+DECL_HANDLER(get_process_vm_pid);
 DECL_HANDLER(create_key);
 DECL_HANDLER(open_key);
 DECL_HANDLER(delete_key);
@@ -261,6 +262,7 @@ DECL_HANDLER(get_window_children);
 DECL_HANDLER(get_window_children_from_point);
 DECL_HANDLER(get_window_tree);
 DECL_HANDLER(set_window_pos);
+DECL_HANDLER(set_window_pos_batch);
 DECL_HANDLER(get_window_rectangles);
 DECL_HANDLER(get_window_text);
 DECL_HANDLER(set_window_text);
@@ -478,6 +480,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_set_debug_obj_info,
     (req_handler)req_read_process_memory,
     (req_handler)req_write_process_memory,
+    (req_handler)req_get_process_vm_pid,
     (req_handler)req_create_key,
     (req_handler)req_open_key,
     (req_handler)req_delete_key,
@@ -542,6 +545,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_get_window_children_from_point,
     (req_handler)req_get_window_tree,
     (req_handler)req_set_window_pos,
+    (req_handler)req_set_window_pos_batch,
     (req_handler)req_get_window_rectangles,
     (req_handler)req_get_window_text,
     (req_handler)req_set_window_text,
@@ -1168,6 +1172,10 @@ C_ASSERT( sizeof(struct read_process_memory_reply) == 8 );
 C_ASSERT( FIELD_OFFSET(struct write_process_memory_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct write_process_memory_request, addr) == 16 );
 C_ASSERT( sizeof(struct write_process_memory_request) == 24 );
+C_ASSERT( FIELD_OFFSET(struct get_process_vm_pid_request, handle) == 12 );
+C_ASSERT( sizeof(struct get_process_vm_pid_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_process_vm_pid_reply, unix_pid) == 8 );
+C_ASSERT( sizeof(struct get_process_vm_pid_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct create_key_request, access) == 12 );
 C_ASSERT( FIELD_OFFSET(struct create_key_request, options) == 16 );
 C_ASSERT( sizeof(struct create_key_request) == 24 );
@@ -1206,7 +1214,9 @@ C_ASSERT( FIELD_OFFSET(struct get_key_value_request, hkey) == 12 );
 C_ASSERT( sizeof(struct get_key_value_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_key_value_reply, type) == 8 );
 C_ASSERT( FIELD_OFFSET(struct get_key_value_reply, total) == 12 );
-C_ASSERT( sizeof(struct get_key_value_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_key_value_reply, cache_slot) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_key_value_reply, generation) == 20 );
+C_ASSERT( sizeof(struct get_key_value_reply) == 24 );
 C_ASSERT( FIELD_OFFSET(struct enum_key_value_request, hkey) == 12 );
 C_ASSERT( FIELD_OFFSET(struct enum_key_value_request, index) == 16 );
 C_ASSERT( FIELD_OFFSET(struct enum_key_value_request, info_class) == 20 );
@@ -1277,6 +1287,7 @@ C_ASSERT( FIELD_OFFSET(struct get_selector_entry_reply, base) == 8 );
 C_ASSERT( FIELD_OFFSET(struct get_selector_entry_reply, limit) == 12 );
 C_ASSERT( FIELD_OFFSET(struct get_selector_entry_reply, flags) == 16 );
 C_ASSERT( sizeof(struct get_selector_entry_reply) == 24 );
+C_ASSERT( FIELD_OFFSET(struct add_atom_request, pin) == 12 );
 C_ASSERT( sizeof(struct add_atom_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct add_atom_reply, atom) == 8 );
 C_ASSERT( sizeof(struct add_atom_reply) == 16 );
@@ -1293,6 +1304,7 @@ C_ASSERT( FIELD_OFFSET(struct get_atom_information_reply, total) == 16 );
 C_ASSERT( sizeof(struct get_atom_information_reply) == 24 );
 C_ASSERT( sizeof(struct get_msg_queue_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_msg_queue_reply, handle) == 8 );
+C_ASSERT( FIELD_OFFSET(struct get_msg_queue_reply, status_slot) == 12 );
 C_ASSERT( sizeof(struct get_msg_queue_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_queue_fd_request, handle) == 12 );
 C_ASSERT( sizeof(struct set_queue_fd_request) == 16 );
@@ -1320,7 +1332,8 @@ C_ASSERT( FIELD_OFFSET(struct send_message_request, msg) == 28 );
 C_ASSERT( FIELD_OFFSET(struct send_message_request, wparam) == 32 );
 C_ASSERT( FIELD_OFFSET(struct send_message_request, lparam) == 40 );
 C_ASSERT( FIELD_OFFSET(struct send_message_request, timeout) == 48 );
-C_ASSERT( sizeof(struct send_message_request) == 56 );
+C_ASSERT( FIELD_OFFSET(struct send_message_request, section) == 56 );
+C_ASSERT( sizeof(struct send_message_request) == 64 );
 C_ASSERT( FIELD_OFFSET(struct post_quit_message_request, exit_code) == 12 );
 C_ASSERT( sizeof(struct post_quit_message_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct send_hardware_message_request, win) == 12 );
@@ -1351,7 +1364,8 @@ C_ASSERT( FIELD_OFFSET(struct get_message_reply, y) == 40 );
 C_ASSERT( FIELD_OFFSET(struct get_message_reply, time) == 44 );
 C_ASSERT( FIELD_OFFSET(struct get_message_reply, active_hooks) == 48 );
 C_ASSERT( FIELD_OFFSET(struct get_message_reply, total) == 52 );
-C_ASSERT( sizeof(struct get_message_reply) == 56 );
+C_ASSERT( FIELD_OFFSET(struct get_message_reply, section) == 56 );
+C_ASSERT( sizeof(struct get_message_reply) == 64 );
 C_ASSERT( FIELD_OFFSET(struct reply_message_request, remove) == 12 );
 C_ASSERT( FIELD_OFFSET(struct reply_message_request, result) == 16 );
 C_ASSERT( sizeof(struct reply_message_request) == 24 );
@@ -1550,6 +1564,8 @@ C_ASSERT( FIELD_OFFSET(struct set_window_pos_reply, new_ex_style) == 12 );
 C_ASSERT( FIELD_OFFSET(struct set_window_pos_reply, surface_win) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_window_pos_reply, needs_update) == 20 );
 C_ASSERT( sizeof(struct set_window_pos_reply) == 24 );
+C_ASSERT( sizeof(struct set_window_pos_batch_request) == 16 );
+C_ASSERT( sizeof(struct set_window_pos_batch_reply) == 8 );
 C_ASSERT( FIELD_OFFSET(struct get_window_rectangles_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct get_window_rectangles_request, relative) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_window_rectangles_request, dpi) == 20 );
@@ -34,6 +34,7 @@
 #include "process.h"
 #include "thread.h"
 #include "request.h"
+#include "user.h"
 
 #if defined(linux) && defined(__SIGRTMIN)
 /* the signal used by linuxthreads as exit signal for clone() threads */
@@ -176,6 +177,7 @@ static void sighup_callback(void)
 #ifdef DEBUG_OBJECTS
     dump_objects();
 #endif
+    dump_message_stats();
 }
 
 /* SIGTERM callback */
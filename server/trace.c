@@ -976,6 +976,46 @@ static void dump_varargs_cursor_positions( const char *prefix, data_size_t size
     remove_data( size );
 }
 
+static void dump_varargs_window_positions( const char *prefix, data_size_t size )
+{
+    const window_pos_t *pos = cur_data;
+    data_size_t len = size / sizeof(*pos);
+
+    fprintf( stderr, "%s{", prefix );
+    while (len > 0)
+    {
+        fprintf( stderr, "{handle=%08x,previous=%08x,swp_flags=%04x,paint_flags=%04x",
+                 pos->handle, pos->previous, pos->swp_flags, pos->paint_flags );
+        dump_rectangle( ",window=", &pos->window );
+        dump_rectangle( ",client=", &pos->client );
+        dump_rectangle( ",visible=", &pos->visible );
+        dump_rectangle( ",surface=", &pos->surface );
+        dump_rectangle( ",valid=", &pos->valid );
+        fputc( '}', stderr );
+        pos++;
+        if (--len) fputc( ',', stderr );
+    }
+    fputc( '}', stderr );
+    remove_data( size );
+}
+
+static void dump_varargs_window_pos_results( const char *prefix, data_size_t size )
+{
+    const window_pos_result_t *res = cur_data;
+    data_size_t len = size / sizeof(*res);
+
+    fprintf( stderr, "%s{", prefix );
+    while (len > 0)
+    {
+        fprintf( stderr, "{status=%08x,new_style=%08x,new_ex_style=%08x,surface_win=%08x,needs_update=%d}",
+                 res->status, res->new_style, res->new_ex_style, res->surface_win, res->needs_update );
+        res++;
+        if (--len) fputc( ',', stderr );
+    }
+    fputc( '}', stderr );
+    remove_data( size );
+}
+
 static void dump_varargs_message_data( const char *prefix, data_size_t size )
 {
     /* FIXME: dump the structured data */
@@ -2284,6 +2324,16 @@ static void dump_write_process_memory_request( const struct write_process_memory
     dump_varargs_bytes( ", data=", cur_size );
 }
 
+static void dump_get_process_vm_pid_request( const struct get_process_vm_pid_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
+static void dump_get_process_vm_pid_reply( const struct get_process_vm_pid_reply *req )
+{
+    fprintf( stderr, " unix_pid=%d", req->unix_pid );
+}
+
 static void dump_create_key_request( const struct create_key_request *req )
 {
     fprintf( stderr, " access=%08x", req->access );
@@ -2362,6 +2412,8 @@ static void dump_get_key_value_reply( const struct get_key_value_reply *req )
 {
     fprintf( stderr, " type=%d", req->type );
     fprintf( stderr, ", total=%u", req->total );
+    fprintf( stderr, ", cache_slot=%d", req->cache_slot );
+    fprintf( stderr, ", generation=%08x", req->generation );
     dump_varargs_bytes( ", data=", cur_size );
 }
 
@@ -2515,7 +2567,8 @@ static void dump_get_selector_entry_reply( const struct get_selector_entry_reply
 
 static void dump_add_atom_request( const struct add_atom_request *req )
 {
-    dump_varargs_unicode_str( " name=", cur_size );
+    fprintf( stderr, " pin=%d", req->pin );
+    dump_varargs_unicode_str( ", name=", cur_size );
 }
 
 static void dump_add_atom_reply( const struct add_atom_reply *req )
@@ -2558,6 +2611,7 @@ static void dump_get_msg_queue_request( const struct get_msg_queue_request *req
 static void dump_get_msg_queue_reply( const struct get_msg_queue_reply *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", status_slot=%d", req->status_slot );
 }
 
 static void dump_set_queue_fd_request( const struct set_queue_fd_request *req )
@@ -2609,6 +2663,7 @@ static void dump_send_message_request( const struct send_message_request *req )
     dump_uint64( ", wparam=", &req->wparam );
     dump_uint64( ", lparam=", &req->lparam );
     dump_timeout( ", timeout=", &req->timeout );
+    fprintf( stderr, ", section=%04x", req->section );
     dump_varargs_message_data( ", data=", cur_size );
 }
 
@@ -2658,6 +2713,7 @@ static void dump_get_message_reply( const struct get_message_reply *req )
     fprintf( stderr, ", time=%08x", req->time );
     fprintf( stderr, ", active_hooks=%08x", req->active_hooks );
     fprintf( stderr, ", total=%u", req->total );
+    fprintf( stderr, ", section=%04x", req->section );
     dump_varargs_message_data( ", data=", cur_size );
 }
 
@@ -3027,6 +3083,16 @@ static void dump_set_window_pos_reply( const struct set_window_pos_reply *req )
     fprintf( stderr, ", needs_update=%d", req->needs_update );
 }
 
+static void dump_set_window_pos_batch_request( const struct set_window_pos_batch_request *req )
+{
+    dump_varargs_window_positions( " positions=", cur_size );
+}
+
+static void dump_set_window_pos_batch_reply( const struct set_window_pos_batch_reply *req )
+{
+    dump_varargs_window_pos_results( " results=", cur_size );
+}
+
 static void dump_get_window_rectangles_request( const struct get_window_rectangles_request *req )
 {
     fprintf( stderr, " handle=%08x", req->handle );
@@ -4563,6 +4629,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_set_debug_obj_info_request,
     (dump_func)dump_read_process_memory_request,
     (dump_func)dump_write_process_memory_request,
+    (dump_func)dump_get_process_vm_pid_request,
     (dump_func)dump_create_key_request,
     (dump_func)dump_open_key_request,
     (dump_func)dump_delete_key_request,
@@ -4627,6 +4694,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_window_children_from_point_request,
     (dump_func)dump_get_window_tree_request,
     (dump_func)dump_set_window_pos_request,
+    (dump_func)dump_set_window_pos_batch_request,
     (dump_func)dump_get_window_rectangles_request,
     (dump_func)dump_get_window_text_request,
     (dump_func)dump_set_window_text_request,
@@ -4841,6 +4909,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     NULL,
     (dump_func)dump_read_process_memory_reply,
     NULL,
+    (dump_func)dump_get_process_vm_pid_reply,
     (dump_func)dump_create_key_reply,
     (dump_func)dump_open_key_reply,
     NULL,
@@ -4905,6 +4974,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_window_children_from_point_reply,
     (dump_func)dump_get_window_tree_reply,
     (dump_func)dump_set_window_pos_reply,
+    (dump_func)dump_set_window_pos_batch_reply,
     (dump_func)dump_get_window_rectangles_reply,
     (dump_func)dump_get_window_text_reply,
     NULL,
@@ -5119,6 +5189,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "set_debug_obj_info",
     "read_process_memory",
     "write_process_memory",
+    "get_process_vm_pid",
     "create_key",
     "open_key",
     "delete_key",
@@ -5183,6 +5254,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "get_window_children_from_point",
     "get_window_tree",
     "set_window_pos",
+    "set_window_pos_batch",
     "get_window_rectangles",
     "get_window_text",
     "set_window_text",
@@ -5438,6 +5510,7 @@ static const struct
     { "PROCESS_IN_JOB",              STATUS_PROCESS_IN_JOB },
     { "PROCESS_IS_TERMINATING",      STATUS_PROCESS_IS_TERMINATING },
     { "PROCESS_NOT_IN_JOB",          STATUS_PROCESS_NOT_IN_JOB },
+    { "REGISTRY_CORRUPT",            STATUS_REGISTRY_CORRUPT },
     { "REPARSE_POINT_NOT_RESOLVED",  STATUS_REPARSE_POINT_NOT_RESOLVED },
     { "SECTION_TOO_BIG",             STATUS_SECTION_TOO_BIG },
     { "SEMAPHORE_LIMIT_EXCEEDED",    STATUS_SEMAPHORE_LIMIT_EXCEEDED },
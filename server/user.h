@@ -62,6 +62,16 @@ struct global_cursor
     user_handle_t        win;              /* window that contains the cursor */
 };
 
+/* hardware input statistics of a desktop */
+struct input_stats
+{
+    unsigned int         events;           /* hardware input events received */
+    unsigned int         merged;           /* input messages coalesced with a previous one */
+    unsigned int         delivered;        /* input messages returned to an application */
+    unsigned int         max_latency;      /* max time between the event and its delivery, in ms */
+    unsigned __int64     total_latency;    /* total time between the events and their delivery */
+};
+
 struct desktop
 {
     struct object        obj;              /* object header */
@@ -77,6 +87,7 @@ struct desktop
     unsigned int         users;            /* processes and threads using this desktop */
     struct global_cursor cursor;           /* global cursor information */
     unsigned char        keystate[256];    /* asynchronous key state */
+    struct input_stats   input_stats;      /* hardware input statistics */
 };
 
 /* user handles functions */
@@ -102,6 +113,7 @@ extern struct thread *get_first_global_hook( int id );
 
 /* queue functions */
 
+extern queue_status_t *queue_status_slots;
 extern void free_msg_queue( struct thread *thread );
 extern struct hook_table *get_queue_hooks( struct thread *thread );
 extern void set_queue_hooks( struct thread *thread, struct hook_table *hooks );
@@ -120,6 +132,7 @@ extern void post_win_event( struct thread *thread, unsigned int event,
                             const WCHAR *module, data_size_t module_size,
                             user_handle_t handle );
 extern void free_hotkeys( struct desktop *desktop, user_handle_t window );
+extern void dump_message_stats(void);
 
 /* region functions */
 
@@ -150,6 +163,8 @@ extern int rect_in_region( struct region *region, const rectangle_t *rect );
 
 /* window functions */
 
+extern window_shm_t *window_shm_slots;
+
 extern struct process *get_top_window_owner( struct desktop *desktop );
 extern void get_top_window_rectangle( struct desktop *desktop, rectangle_t *rect );
 extern void post_desktop_message( struct desktop *desktop, unsigned int message,
@@ -243,6 +258,15 @@ static inline int intersect_rect( rectangle_t *dst, const rectangle_t *src1, con
     return !is_rect_empty( dst );
 }
 
+/* compute the union of two non-empty rectangles */
+static inline void union_rect( rectangle_t *dst, const rectangle_t *src1, const rectangle_t *src2 )
+{
+    dst->left   = min( src1->left, src2->left );
+    dst->top    = min( src1->top, src2->top );
+    dst->right  = max( src1->right, src2->right );
+    dst->bottom = max( src1->bottom, src2->bottom );
+}
+
 /* validate a window handle and return the full handle */
 static inline user_handle_t get_valid_window_handle( user_handle_t win )
 {
@@ -51,6 +51,20 @@ enum property_type
     PROP_TYPE_ATOM    /* plain atom */
 };
 
+/* cached array of the children of a window, with a grid index for hit testing */
+#define CHILD_GRID_MIN_COUNT 64  /* don't bother with a grid for fewer children */
+#define CHILD_GRID_SIZE      16  /* number of grid cells in each direction */
+
+struct child_cache
+{
+    unsigned int     count;        /* number of children */
+    struct window  **children;     /* children in z-order */
+    rectangle_t      bounds;       /* bounding rectangle of the children in the grid */
+    int              cell_width;   /* width of a grid cell, 0 if there is no grid */
+    int              cell_height;  /* height of a grid cell */
+    unsigned int     cells[CHILD_GRID_SIZE * CHILD_GRID_SIZE + 1];  /* offsets of the cells in 'grid' */
+    struct window  **grid;         /* children overlapping each cell, in z-order */
+};
 
 struct window
 {
@@ -72,6 +86,9 @@ struct window
     rectangle_t      client_rect;     /* client rectangle (relative to parent client area) */
     struct region   *win_region;      /* region for shaped windows (relative to window rect) */
     struct region   *update_region;   /* update region (relative to window rect) */
+    struct region   *vis_cache;       /* cached visible region (relative to window) */
+    unsigned int     vis_cache_flags; /* DCX flags the cached visible region was computed with */
+    struct child_cache *child_cache;  /* cached array of the children */
     unsigned int     style;           /* window style */
     unsigned int     ex_style;        /* window extended style */
     lparam_t         id;              /* window id */
@@ -144,18 +161,157 @@ struct user_handle_array
 
 static const rectangle_t empty_rect;
 
+window_shm_t *window_shm_slots = NULL;  /* shared with the clients */
+
 /* global window pointers */
 static struct window *shell_window;
 static struct window *shell_listview;
 static struct window *progman_window;
 static struct window *taskman_window;
 
+/* exposure of the parent deferred while processing a batch of window changes */
+static int in_batch;
+static struct window *batch_parent;
+static struct region *batch_exposed_rgn;
+
 /* magic HWND_TOP etc. pointers */
 #define WINPTR_TOP       ((struct window *)1L)
 #define WINPTR_BOTTOM    ((struct window *)2L)
 #define WINPTR_TOPMOST   ((struct window *)3L)
 #define WINPTR_NOTOPMOST ((struct window *)4L)
 
+/* drop the cached children array and grid of a window */
+static void invalidate_child_cache( struct window *win )
+{
+    struct child_cache *cache = win->child_cache;
+
+    if (!cache) return;
+    free( cache->children );
+    free( cache->grid );
+    free( cache );
+    win->child_cache = NULL;
+}
+
+/* get the range of grid cells overlapped by a rectangle */
+static void get_grid_cells( const struct child_cache *cache, const rectangle_t *rect,
+                            int *left, int *top, int *right, int *bottom )
+{
+    *left   = (rect->left - cache->bounds.left) / cache->cell_width;
+    *top    = (rect->top - cache->bounds.top) / cache->cell_height;
+    *right  = (rect->right - 1 - cache->bounds.left) / cache->cell_width;
+    *bottom = (rect->bottom - 1 - cache->bounds.top) / cache->cell_height;
+}
+
+/* build the grid index of the children of a window */
+static void build_child_grid( struct window *parent, struct child_cache *cache )
+{
+    unsigned int i, total = 0, pos[CHILD_GRID_SIZE * CHILD_GRID_SIZE];
+    int x, y, left, top, right, bottom;
+    struct window *child;
+
+    cache->bounds = empty_rect;
+    for (i = 0; i < cache->count; i++)
+    {
+        child = cache->children[i];
+        /* points are mapped to the dpi of the child, the grid only works without scaling */
+        if (child->dpi != parent->dpi) return;
+        if (is_rect_empty( &child->visible_rect )) continue;
+        if (is_rect_empty( &cache->bounds )) cache->bounds = child->visible_rect;
+        else union_rect( &cache->bounds, &cache->bounds, &child->visible_rect );
+    }
+    if (is_rect_empty( &cache->bounds )) return;
+
+    cache->cell_width  = (cache->bounds.right - cache->bounds.left + CHILD_GRID_SIZE - 1) / CHILD_GRID_SIZE;
+    cache->cell_height = (cache->bounds.bottom - cache->bounds.top + CHILD_GRID_SIZE - 1) / CHILD_GRID_SIZE;
+
+    /* count the children in each cell */
+    memset( pos, 0, sizeof(pos) );
+    for (i = 0; i < cache->count; i++)
+    {
+        child = cache->children[i];
+        if (is_rect_empty( &child->visible_rect )) continue;
+        get_grid_cells( cache, &child->visible_rect, &left, &top, &right, &bottom );
+        for (y = top; y <= bottom; y++)
+            for (x = left; x <= right; x++) pos[y * CHILD_GRID_SIZE + x]++;
+    }
+    for (i = 0; i < CHILD_GRID_SIZE * CHILD_GRID_SIZE; i++)
+    {
+        cache->cells[i] = total;
+        total += pos[i];
+        pos[i] = cache->cells[i];
+    }
+    cache->cells[i] = total;
+
+    if (!(cache->grid = mem_alloc( total * sizeof(*cache->grid) )))
+    {
+        cache->cell_width = 0;
+        return;
+    }
+    /* and fill them in z-order */
+    for (i = 0; i < cache->count; i++)
+    {
+        child = cache->children[i];
+        if (is_rect_empty( &child->visible_rect )) continue;
+        get_grid_cells( cache, &child->visible_rect, &left, &top, &right, &bottom );
+        for (y = top; y <= bottom; y++)
+            for (x = left; x <= right; x++) cache->grid[pos[y * CHILD_GRID_SIZE + x]++] = child;
+    }
+}
+
+/* get the cached children array of a window, building it if needed */
+static struct child_cache *get_child_cache( struct window *parent )
+{
+    struct child_cache *cache;
+    struct window *child;
+    unsigned int count = 0;
+
+    if (parent->child_cache) return parent->child_cache;
+
+    if (!(cache = mem_alloc( sizeof(*cache) ))) return NULL;
+    LIST_FOR_EACH_ENTRY( child, &parent->children, struct window, entry ) count++;
+    cache->count = 0;
+    cache->cell_width = cache->cell_height = 0;
+    cache->grid = NULL;
+    if (!(cache->children = mem_alloc( max( count, 1 ) * sizeof(*cache->children) )))
+    {
+        free( cache );
+        return NULL;
+    }
+    LIST_FOR_EACH_ENTRY( child, &parent->children, struct window, entry )
+        cache->children[cache->count++] = child;
+
+    if (count >= CHILD_GRID_MIN_COUNT) build_child_grid( parent, cache );
+    parent->child_cache = cache;
+    return cache;
+}
+
+/* get the children of a window that may contain a point (in parent-relative coords), in z-order */
+static struct window **get_children_at_point( struct window *parent, int x, int y, unsigned int *count )
+{
+    struct child_cache *cache;
+    unsigned int cell;
+
+    if (!(cache = get_child_cache( parent )))
+    {
+        *count = 0;
+        return NULL;
+    }
+    if (!cache->cell_width)
+    {
+        *count = cache->count;
+        return cache->children;
+    }
+    if (!point_in_rect( &cache->bounds, x, y ))
+    {
+        *count = 0;
+        return cache->children;
+    }
+    cell = ((y - cache->bounds.top) / cache->cell_height) * CHILD_GRID_SIZE +
+           (x - cache->bounds.left) / cache->cell_width;
+    *count = cache->cells[cell + 1] - cache->cells[cell];
+    return cache->grid + cache->cells[cell];
+}
+
 static void window_dump( struct object *obj, int verbose )
 {
     struct window *win = (struct window *)obj;
@@ -177,6 +333,8 @@ static void window_destroy( struct object *obj )
 
     if (win->win_region) free_region( win->win_region );
     if (win->update_region) free_region( win->update_region );
+    if (win->vis_cache) free_region( win->vis_cache );
+    invalidate_child_cache( win );
     if (win->class) release_class( win->class );
     free( win->text );
 
@@ -253,6 +411,101 @@ static unsigned int get_monitor_dpi( struct window *win )
     return win->dpi ? win->dpi : USER_DEFAULT_SCREEN_DPI;
 }
 
+/* make sure that the window entry updates are seen in order by the clients */
+static inline void window_shm_barrier(void)
+{
+#if !defined(__i386__) && !defined(__x86_64__)
+    __atomic_thread_fence( __ATOMIC_SEQ_CST );
+#endif
+}
+
+static volatile window_shm_t *get_window_shm( user_handle_t handle )
+{
+    if (!window_shm_slots) return NULL;
+    return &window_shm_slots[((handle & 0xffff) - FIRST_USER_HANDLE) >> 1];
+}
+
+/* publish the window information in the shared window mapping */
+static void update_window_shm( struct window *win )
+{
+    volatile window_shm_t *shm;
+    unsigned int monitor_dpi;
+
+    if (!win->handle || !(shm = get_window_shm( win->handle ))) return;
+
+    monitor_dpi = get_monitor_dpi( win );
+    shm->seq++;
+    window_shm_barrier();
+    shm->handle      = win->handle;
+    shm->parent      = win->parent ? win->parent->handle : 0;
+    shm->owner       = win->owner;
+    shm->style       = win->style;
+    shm->ex_style    = win->ex_style;
+    shm->tid         = win->thread ? get_thread_id( win->thread ) : 0;
+    shm->pid         = win->thread ? get_process_id( win->thread->process ) : 0;
+    shm->id          = win->id;
+    shm->instance    = win->instance;
+    shm->user_data   = win->user_data;
+    shm->is_unicode  = win->is_unicode;
+    shm->dpi         = win->dpi ? win->dpi : monitor_dpi;
+    shm->monitor_dpi = monitor_dpi;
+    shm->awareness   = win->dpi_awareness;
+    shm->window      = win->window_rect;
+    shm->client      = win->client_rect;
+    window_shm_barrier();
+    shm->seq++;
+}
+
+/* remove the window from the shared window mapping */
+static void clear_window_shm( struct window *win )
+{
+    volatile window_shm_t *shm;
+
+    if (!(shm = get_window_shm( win->handle ))) return;
+    shm->seq++;
+    window_shm_barrier();
+    shm->handle = 0;
+    window_shm_barrier();
+    shm->seq++;
+}
+
+/* drop the cached visible regions of a window and of all its children */
+static void invalidate_visible_region_tree( struct window *win )
+{
+    struct window *child;
+
+    if (win->vis_cache)
+    {
+        free_region( win->vis_cache );
+        win->vis_cache = NULL;
+    }
+    LIST_FOR_EACH_ENTRY( child, &win->children, struct window, entry )
+        invalidate_visible_region_tree( child );
+}
+
+/* drop the cached data that depends on the position, shape, style or z-order of a window */
+static void invalidate_visible_region( struct window *win )
+{
+    struct window *parent = win->parent, *sibling;
+
+    invalidate_visible_region_tree( win );
+    if (!parent) return;
+
+    /* the parent caches its children in z-order and by position */
+    invalidate_child_cache( parent );
+
+    /* the parent clips its children */
+    if (parent->vis_cache)
+    {
+        free_region( parent->vis_cache );
+        parent->vis_cache = NULL;
+    }
+    /* and the siblings clip each other, except for top-level windows */
+    if (is_desktop_window( parent )) return;
+    LIST_FOR_EACH_ENTRY( sibling, &parent->children, struct window, entry )
+        if (sibling != win) invalidate_visible_region_tree( sibling );
+}
+
 /* link a window at the right place in the siblings list */
 static void link_window( struct window *win, struct window *previous )
 {
@@ -306,6 +559,8 @@ static void link_window( struct window *win, struct window *previous )
     }
 
     win->is_linked = 1;
+    invalidate_visible_region( win );
+    update_window_shm( win );
 }
 
 /* change the parent of a window (or unlink the window if the new parent is NULL) */
@@ -325,6 +580,7 @@ static int set_parent_window( struct window *win, struct window *parent )
 
     if (parent)
     {
+        invalidate_visible_region( win );
         if (win->parent) release_object( win->parent );
         win->parent = (struct window *)grab_object( parent );
         link_window( win, WINPTR_TOP );
@@ -345,11 +601,13 @@ static int set_parent_window( struct window *win, struct window *parent )
     }
     else  /* move it to parent unlinked list */
     {
+        invalidate_visible_region( win );
         list_remove( &win->entry );  /* unlink it from the previous location */
         list_add_head( &win->parent->unlinked, &win->entry );
         win->is_linked = 0;
         win->is_orphan = 1;
     }
+    update_window_shm( win );
     return 1;
 }
 
@@ -488,6 +746,7 @@ static void detach_window_thread( struct window *win )
     /* destroyed when the desktop ref count reaches zero */
     release_object( win->desktop );
     win->thread = NULL;
+    update_window_shm( win );
 }
 
 /* get the process owning the top window of a given desktop */
@@ -561,6 +820,9 @@ static struct window *create_window( struct window *parent, struct window *owner
     win->last_active    = win->handle;
     win->win_region     = NULL;
     win->update_region  = NULL;
+    win->vis_cache      = NULL;
+    win->vis_cache_flags = 0;
+    win->child_cache    = NULL;
     win->style          = 0;
     win->ex_style       = 0;
     win->id             = 0;
@@ -810,13 +1072,26 @@ static int is_point_in_window( struct window *win, int *x, int *y, unsigned int
 static unsigned int get_children_windows( struct window *parent, atom_t atom, thread_id_t tid,
                                           user_handle_t *handles, unsigned int max_count )
 {
+    struct child_cache *cache;
     struct window *ptr;
-    unsigned int count = 0;
+    unsigned int i, count = 0;
 
-    if (!parent) return 0;
+    if (!parent || !(cache = get_child_cache( parent ))) return 0;
 
-    LIST_FOR_EACH_ENTRY( ptr, &parent->children, struct window, entry )
+    if (!atom && !tid)
     {
+        if (handles)
+        {
+            count = min( cache->count, max_count );
+            for (i = 0; i < count; i++) handles[i] = cache->children[i]->handle;
+            return count;
+        }
+        return cache->count;
+    }
+
+    for (i = 0; i < cache->count; i++)
+    {
+        ptr = cache->children[i];
         if (atom && get_class_atom(ptr->class) != atom) continue;
         if (tid && get_thread_id(ptr->thread) != tid) continue;
         if (handles)
@@ -832,12 +1107,16 @@ static unsigned int get_children_windows( struct window *parent, atom_t atom, th
 /* find child of 'parent' that contains the given point (in parent-relative coords) */
 static struct window *child_window_from_point( struct window *parent, int x, int y )
 {
-    struct window *ptr;
+    struct window *ptr, **children;
+    unsigned int i, count;
 
-    LIST_FOR_EACH_ENTRY( ptr, &parent->children, struct window, entry )
+    children = get_children_at_point( parent, x, y, &count );
+    for (i = 0; i < count; i++)
     {
         int x_child = x, y_child = y;
 
+        ptr = children[i];
+
         if (!is_point_in_window( ptr, &x_child, &y_child, parent->dpi )) continue;  /* skip it */
 
         /* if window is minimized or disabled, return at once */
@@ -856,12 +1135,16 @@ static struct window *child_window_from_point( struct window *parent, int x, int
 static int get_window_children_from_point( struct window *parent, int x, int y,
                                            struct user_handle_array *array )
 {
-    struct window *ptr;
+    struct window *ptr, **children;
+    unsigned int i, count;
 
-    LIST_FOR_EACH_ENTRY( ptr, &parent->children, struct window, entry )
+    if (!(children = get_children_at_point( parent, x, y, &count ))) return 0;
+    for (i = 0; i < count; i++)
     {
         int x_child = x, y_child = y;
 
+        ptr = children[i];
+
         if (!is_point_in_window( ptr, &x_child, &y_child, parent->dpi )) continue;  /* skip it */
 
         /* if point is in client area, and window is not minimized or disabled, check children */
@@ -1096,7 +1379,7 @@ static inline struct window *get_top_clipping_window( struct window *win )
 
 
 /* compute the visible region of a window, in window coordinates */
-static struct region *get_visible_region( struct window *win, unsigned int flags )
+static struct region *compute_visible_region( struct window *win, unsigned int flags )
 {
     struct region *tmp = NULL, *region;
     int offset_x, offset_y;
@@ -1175,6 +1458,33 @@ error:
 }
 
 
+/* get the visible region of a window, using the cached one if it is still valid */
+static struct region *get_visible_region( struct window *win, unsigned int flags )
+{
+    struct region *region;
+
+    flags &= DCX_WINDOW | DCX_CLIPCHILDREN | DCX_PARENTCLIP;
+
+    if (win->vis_cache && win->vis_cache_flags == flags)
+    {
+        if (!(region = create_empty_region())) return NULL;
+        return copy_region( region, win->vis_cache );
+    }
+
+    if (!(region = compute_visible_region( win, flags ))) return NULL;
+
+    if (!win->vis_cache && !(win->vis_cache = create_empty_region())) return region;
+    if (copy_region( win->vis_cache, region )) win->vis_cache_flags = flags;
+    else
+    {
+        free_region( win->vis_cache );
+        win->vis_cache = NULL;
+        clear_error();
+    }
+    return region;
+}
+
+
 /* clip all children with a custom pixel format out of the visible region */
 static struct region *clip_pixel_format_children( struct window *parent, struct region *parent_clip,
                                                   struct region *region, int offset_x, int offset_y )
@@ -1706,6 +2016,31 @@ static unsigned int get_window_update_flags( struct window *win, struct window *
 }
 
 
+/* flush the exposed area of the parent accumulated while processing a batch of window changes */
+static void flush_batch_exposure(void)
+{
+    if (batch_parent)
+        redraw_window( batch_parent, batch_exposed_rgn, 0, RDW_INVALIDATE | RDW_ERASE | RDW_ALLCHILDREN );
+    if (batch_exposed_rgn) free_region( batch_exposed_rgn );
+    batch_parent = NULL;
+    batch_exposed_rgn = NULL;
+}
+
+
+/* invalidate the area of a parent uncovered by a child, deferring it while processing a batch */
+static void expose_parent( struct window *parent, struct region *region )
+{
+    if (in_batch)
+    {
+        if (batch_parent != parent) flush_batch_exposure();
+        if (!batch_exposed_rgn && (batch_exposed_rgn = create_empty_region())) batch_parent = parent;
+        if (batch_exposed_rgn && union_region( batch_exposed_rgn, batch_exposed_rgn, region )) return;
+        flush_batch_exposure();
+    }
+    redraw_window( parent, region, 0, RDW_INVALIDATE | RDW_ERASE | RDW_ALLCHILDREN );
+}
+
+
 /* expose the areas revealed by a vis region change on the window parent */
 /* returns the region exposed on the window itself (in client coordinates) */
 static struct region *expose_window( struct window *win, const rectangle_t *old_window_rect,
@@ -1744,7 +2079,7 @@ static struct region *expose_window( struct window *win, const rectangle_t *old_
             {
                 /* make it relative to parent */
                 offset_region( new_vis_rgn, old_window_rect->left, old_window_rect->top );
-                redraw_window( win->parent, new_vis_rgn, 0, RDW_INVALIDATE | RDW_ERASE | RDW_ALLCHILDREN );
+                expose_parent( win->parent, new_vis_rgn );
             }
         }
     }
@@ -1780,6 +2115,8 @@ static void set_window_pos( struct window *win, struct window *previous,
     if (!(swp_flags & SWP_NOZORDER) && win->parent) link_window( win, previous );
     if (swp_flags & SWP_SHOWWINDOW) win->style |= WS_VISIBLE;
     else if (swp_flags & SWP_HIDEWINDOW) win->style &= ~WS_VISIBLE;
+    invalidate_visible_region( win );
+    update_window_shm( win );
 
     /* keep children at the same position relative to top right corner when the parent is mirrored */
     if (win->ex_style & WS_EX_LAYOUTRTL)
@@ -1788,12 +2125,17 @@ static void set_window_pos( struct window *win, struct window *previous,
         int old_size = old_client_rect.right - old_client_rect.left;
         int new_size = win->client_rect.right - win->client_rect.left;
 
-        if (old_size != new_size) LIST_FOR_EACH_ENTRY( child, &win->children, struct window, entry )
+        if (old_size != new_size)
         {
-            offset_rect( &child->window_rect, new_size - old_size, 0 );
-            offset_rect( &child->visible_rect, new_size - old_size, 0 );
-            offset_rect( &child->surface_rect, new_size - old_size, 0 );
-            offset_rect( &child->client_rect, new_size - old_size, 0 );
+            LIST_FOR_EACH_ENTRY( child, &win->children, struct window, entry )
+            {
+                offset_rect( &child->window_rect, new_size - old_size, 0 );
+                offset_rect( &child->visible_rect, new_size - old_size, 0 );
+                offset_rect( &child->surface_rect, new_size - old_size, 0 );
+                offset_rect( &child->client_rect, new_size - old_size, 0 );
+                update_window_shm( child );
+            }
+            invalidate_child_cache( win );
         }
     }
 
@@ -1935,6 +2277,7 @@ static void set_window_region( struct window *win, struct region *region, int re
 
     if (win->win_region) free_region( win->win_region );
     win->win_region = region;
+    invalidate_visible_region( win );
 
     /* expose anything revealed by the change */
     if (old_vis_rgn && ((exposed_rgn = expose_window( win, &win->window_rect, old_vis_rgn ))))
@@ -1960,6 +2303,7 @@ void free_window_handle( struct window *win )
     {
         struct region *vis_rgn = get_visible_region( win, DCX_WINDOW );
         win->style &= ~WS_VISIBLE;
+        invalidate_visible_region( win );
         if (vis_rgn)
         {
             struct region *exposed_rgn = expose_window( win, &win->window_rect, vis_rgn );
@@ -2011,6 +2355,7 @@ void free_window_handle( struct window *win )
     detach_window_thread( win );
 
     if (win->parent) set_parent_window( win, NULL );
+    clear_window_shm( win );
     free_user_handle( win->handle );
     win->handle = 0;
     release_object( win );
@@ -2066,6 +2411,8 @@ DECL_HANDLER(create_window)
     }
     win->style = req->style;
     win->ex_style = req->ex_style;
+    invalidate_visible_region( win );
+    update_window_shm( win );
 
     reply->handle    = win->handle;
     reply->parent    = win->parent ? win->parent->handle : 0;
@@ -2133,6 +2480,7 @@ DECL_HANDLER(get_desktop_window)
         {
             detach_window_thread( desktop->top_window );
             desktop->top_window->style  = WS_POPUP | WS_VISIBLE | WS_CLIPSIBLINGS | WS_CLIPCHILDREN;
+            update_window_shm( desktop->top_window );
         }
     }
 
@@ -2145,6 +2493,7 @@ DECL_HANDLER(get_desktop_window)
         {
             detach_window_thread( desktop->msg_window );
             desktop->msg_window->style = WS_POPUP | WS_CLIPSIBLINGS | WS_CLIPCHILDREN;
+            update_window_shm( desktop->msg_window );
         }
     }
 
@@ -2180,6 +2529,7 @@ DECL_HANDLER(set_window_owner)
 
     reply->prev_owner = win->owner;
     reply->full_owner = win->owner = owner ? owner->handle : 0;
+    update_window_shm( win );
 }
 
 
@@ -2254,6 +2604,8 @@ DECL_HANDLER(set_window_info)
 
     /* changing window style triggers a non-client paint */
     if (req->flags & SET_WIN_STYLE) win->paint_flags |= PAINT_NONCLIENT;
+    if (req->flags & (SET_WIN_STYLE | SET_WIN_EXSTYLE)) invalidate_visible_region( win );
+    if (req->flags & ~SET_WIN_EXTRA) update_window_shm( win );
 }
 
 
@@ -2382,21 +2734,20 @@ DECL_HANDLER(get_window_tree)
 }
 
 
-/* set the position and Z order of a window */
-DECL_HANDLER(set_window_pos)
+/* set the position and Z order of a window from a window_pos_t structure */
+static void set_window_pos_from_req( const window_pos_t *pos, window_pos_result_t *result )
 {
     rectangle_t window_rect, client_rect, visible_rect, surface_rect, valid_rect;
-    const rectangle_t *extra_rects = get_req_data();
     struct window *previous = NULL;
-    struct window *top, *win = get_window( req->handle );
-    unsigned int flags = req->swp_flags;
+    struct window *top, *win = get_window( pos->handle );
+    unsigned int flags = pos->swp_flags;
 
     if (!win) return;
     if (!win->parent) flags |= SWP_NOZORDER;  /* no Z order for the desktop */
 
     if (!(flags & SWP_NOZORDER))
     {
-        switch ((int)req->previous)
+        switch ((int)pos->previous)
         {
         case 0:   /* HWND_TOP */
             previous = WINPTR_TOP;
@@ -2411,7 +2762,7 @@ DECL_HANDLER(set_window_pos)
             previous = WINPTR_NOTOPMOST;
             break;
         default:
-            if (!(previous = get_window( req->previous ))) return;
+            if (!(previous = get_window( pos->previous ))) return;
             /* previous must be a sibling */
             if (previous->parent != win->parent)
             {
@@ -2427,20 +2778,17 @@ DECL_HANDLER(set_window_pos)
     if ((win->ex_style & WS_EX_LAYERED) && !win->is_layered) flags |= SWP_NOREDRAW;
 
     /* window rectangle must be ordered properly */
-    if (req->window.right < req->window.left || req->window.bottom < req->window.top)
+    if (pos->window.right < pos->window.left || pos->window.bottom < pos->window.top)
     {
         set_error( STATUS_INVALID_PARAMETER );
         return;
     }
 
-    window_rect = req->window;
-    client_rect = req->client;
-    if (get_req_data_size() >= sizeof(rectangle_t)) visible_rect = extra_rects[0];
-    else visible_rect = window_rect;
-    if (get_req_data_size() >= 2 * sizeof(rectangle_t)) surface_rect = extra_rects[1];
-    else surface_rect = visible_rect;
-    if (get_req_data_size() >= 3 * sizeof(rectangle_t)) valid_rect = extra_rects[2];
-    else valid_rect = empty_rect;
+    window_rect  = pos->window;
+    client_rect  = pos->client;
+    visible_rect = pos->visible;
+    surface_rect = pos->surface;
+    valid_rect   = pos->valid;
     if (win->parent && win->parent->ex_style & WS_EX_LAYOUTRTL)
     {
         mirror_rect( &win->parent->client_rect, &window_rect );
@@ -2450,21 +2798,78 @@ DECL_HANDLER(set_window_pos)
         mirror_rect( &win->parent->client_rect, &valid_rect );
     }
 
-    win->paint_flags = (win->paint_flags & ~PAINT_CLIENT_FLAGS) | (req->paint_flags & PAINT_CLIENT_FLAGS);
+    win->paint_flags = (win->paint_flags & ~PAINT_CLIENT_FLAGS) | (pos->paint_flags & PAINT_CLIENT_FLAGS);
     if (win->paint_flags & PAINT_HAS_PIXEL_FORMAT) update_pixel_format_flags( win );
 
     set_window_pos( win, previous, flags, &window_rect, &client_rect,
                     &visible_rect, &surface_rect, &valid_rect );
 
-    reply->new_style = win->style;
-    reply->new_ex_style = win->ex_style;
+    result->new_style = win->style;
+    result->new_ex_style = win->ex_style;
 
     top = get_top_clipping_window( win );
     if (is_visible( top ) && (top->paint_flags & PAINT_HAS_SURFACE))
     {
-        reply->surface_win = top->handle;
-        reply->needs_update = !!(top->paint_flags & (PAINT_HAS_PIXEL_FORMAT | PAINT_PIXEL_FORMAT_CHILD));
+        result->surface_win = top->handle;
+        result->needs_update = !!(top->paint_flags & (PAINT_HAS_PIXEL_FORMAT | PAINT_PIXEL_FORMAT_CHILD));
+    }
+}
+
+
+/* set the position and Z order of a window */
+DECL_HANDLER(set_window_pos)
+{
+    const rectangle_t *extra_rects = get_req_data();
+    window_pos_result_t result = { 0 };
+    window_pos_t pos;
+
+    pos.handle      = req->handle;
+    pos.previous    = req->previous;
+    pos.swp_flags   = req->swp_flags;
+    pos.paint_flags = req->paint_flags;
+    pos.window      = req->window;
+    pos.client      = req->client;
+    if (get_req_data_size() >= sizeof(rectangle_t)) pos.visible = extra_rects[0];
+    else pos.visible = pos.window;
+    if (get_req_data_size() >= 2 * sizeof(rectangle_t)) pos.surface = extra_rects[1];
+    else pos.surface = pos.visible;
+    if (get_req_data_size() >= 3 * sizeof(rectangle_t)) pos.valid = extra_rects[2];
+    else pos.valid = empty_rect;
+
+    set_window_pos_from_req( &pos, &result );
+
+    reply->new_style    = result.new_style;
+    reply->new_ex_style = result.new_ex_style;
+    reply->surface_win  = result.surface_win;
+    reply->needs_update = result.needs_update;
+}
+
+
+/* set the position and Z order of several windows at once */
+DECL_HANDLER(set_window_pos_batch)
+{
+    const window_pos_t *pos = get_req_data();
+    window_pos_result_t *results;
+    data_size_t i, count = get_req_data_size() / sizeof(*pos);
+
+    if (!count || count * sizeof(*results) > get_reply_max_size())
+    {
+        set_error( STATUS_INVALID_PARAMETER );
+        return;
+    }
+    if (!(results = set_reply_data_size( count * sizeof(*results) ))) return;
+    memset( results, 0, count * sizeof(*results) );
+
+    /* the parts of the parent uncovered by the moved children are only invalidated once */
+    in_batch = 1;
+    for (i = 0; i < count; i++)
+    {
+        set_window_pos_from_req( &pos[i], &results[i] );
+        results[i].status = get_error();
+        clear_error();
     }
+    flush_batch_exposure();
+    in_batch = 0;
 }
 
 
@@ -2776,6 +3181,7 @@ DECL_HANDLER(update_window_zorder)
         {
             list_remove( &win->entry );
             list_add_before( &ptr->entry, &win->entry );
+            invalidate_visible_region( win );
         }
         break;
     }
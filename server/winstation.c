@@ -237,6 +237,7 @@ static struct desktop *create_desktop( const struct unicode_str *name, unsigned
             desktop->users = 0;
             memset( &desktop->cursor, 0, sizeof(desktop->cursor) );
             memset( desktop->keystate, 0, sizeof(desktop->keystate) );
+            memset( &desktop->input_stats, 0, sizeof(desktop->input_stats) );
             list_add_tail( &winstation->desktops, &desktop->entry );
             list_init( &desktop->hotkeys );
         }
@@ -248,9 +249,15 @@ static struct desktop *create_desktop( const struct unicode_str *name, unsigned
 static void desktop_dump( struct object *obj, int verbose )
 {
     struct desktop *desktop = (struct desktop *)obj;
+    const struct input_stats *stats = &desktop->input_stats;
 
     fprintf( stderr, "Desktop flags=%x winstation=%p top_win=%p hooks=%p\n",
              desktop->flags, desktop->winstation, desktop->top_window, desktop->global_hooks );
+    if (verbose && stats->events)
+        fprintf( stderr, "  input events=%u merged=%u delivered=%u latency avg=%u max=%u\n",
+                 stats->events, stats->merged, stats->delivered,
+                 stats->delivered ? (unsigned int)(stats->total_latency / stats->delivered) : 0,
+                 stats->max_latency );
 }
 
 static int desktop_link_name( struct object *obj, struct object_name *name, struct object *parent )